@@ -3,6 +3,7 @@
 
 LIB_API Camera::Camera() : Node()
 {
+	setKind(KIND_CAMERA);
 }
 
 LIB_API Camera::~Camera()
@@ -54,10 +55,10 @@ glm::mat4 LIB_API Camera::getProjMatrix()
 	return glm::perspective(fov, aspect, nearPlane, farPlane);
 }
 
-//return the inverse matrix of the camera (using camera's final position)
+//return the inverse matrix of the camera (using camera's final position), cached by Node
 glm::mat4 LIB_API Camera::getInverse()
 {
-	return glm::inverse(getFinal());
+	return getFinalInverse();
 }
 
 string LIB_API Camera::getType()
@@ -9,7 +9,7 @@
 */
 
 class LIB_API Camera :
-	public virtual Node
+	public Node
 {
 private:
 	/**
@@ -40,6 +40,8 @@ private:
 	float aspect=1.0f;
 
 public:
+	static const Kind KIND = KIND_CAMERA;		///< See Node::as()
+
 	/**
 	Constructor for the camera
 	@see Object.h
@@ -0,0 +1,241 @@
+#include "Engine.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <chrono>
+
+
+LIB_API Clusters::Clusters(unsigned int views)
+	: views{ views }
+{
+	bounds.resize(views * COUNT);
+	boundsProj.resize(views, glm::mat4(0.0f));
+	scratch.resize(COUNT * MAX_LIGHTS_PER_CLUSTER);
+	scratchCount.resize(COUNT);
+}
+
+void LIB_API Clusters::setLights(const LightData *lights, unsigned int count)
+{
+	count = glm::min(count, MAX_LIGHTS);
+
+	//global lights first, so the shader can loop over them without indirection
+	//(two passes rather than std::stable_partition, which allocates a scratch buffer every frame)
+	auto isGlobal = [](const LightData &l) {
+		return l.position.w == 0.0f || l.range.x <= 0.0f;
+	};
+	this->lights.clear();
+	for (unsigned int c = 0; c < count; c++)
+		if (isGlobal(lights[c]))
+			this->lights.push_back(lights[c]);
+	globalLights = (unsigned int)this->lights.size();
+	for (unsigned int c = 0; c < count; c++)
+		if (!isGlobal(lights[c]))
+			this->lights.push_back(lights[c]);
+
+	grid.assign(views * COUNT, glm::uvec2(0));
+	indices.clear();
+	buildTime = 0;
+	assignments = 0;
+	overflows = 0;
+}
+
+void LIB_API Clusters::updateBounds(unsigned int view, const glm::mat4 &proj, float nearPlane, float farPlane)
+{
+	glm::mat4 invProj = glm::inverse(proj);
+	for (unsigned int z = 0; z < GRID_Z; z++)
+	{
+		//exponential slices: the same distribution used by the fragment shader
+		float d0 = nearPlane * powf(farPlane / nearPlane, (float)z / GRID_Z);
+		float d1 = nearPlane * powf(farPlane / nearPlane, (float)(z + 1) / GRID_Z);
+		for (unsigned int y = 0; y < GRID_Y; y++)
+			for (unsigned int x = 0; x < GRID_X; x++)
+			{
+				Bounds &b = bounds[view * COUNT + x + GRID_X * (y + GRID_Y * z)];
+				b.min = glm::vec3(FLT_MAX);
+				b.max = glm::vec3(-FLT_MAX);
+				for (int corner = 0; corner < 4; corner++)
+				{
+					//tile corner on the near plane, then along its ray to both slice depths
+					glm::vec2 ndc = glm::vec2(x + (corner & 1), y + (corner >> 1)) / glm::vec2(GRID_X, GRID_Y) * 2.0f - 1.0f;
+					glm::vec4 p = invProj * glm::vec4(ndc, -1.0f, 1.0f);
+					glm::vec3 ray = glm::vec3(p) / p.w;
+					ray /= -ray.z;
+					b.min = glm::min(b.min, glm::min(ray * d0, ray * d1));
+					b.max = glm::max(b.max, glm::max(ray * d0, ray * d1));
+				}
+			}
+	}
+	boundsProj[view] = proj;
+}
+
+void LIB_API Clusters::build(unsigned int view, FrameBlock &frame)
+{
+	auto start = std::chrono::high_resolution_clock::now();
+
+	//near and far planes from a glm::perspective() matrix
+	const glm::mat4 &proj = frame.projection;
+	float nearPlane = proj[3][2] / (proj[2][2] - 1.0f);
+	float farPlane = proj[3][2] / (proj[2][2] + 1.0f);
+	float sliceScale = GRID_Z / logf(farPlane / nearPlane);
+	float sliceBias = sliceScale * logf(nearPlane);
+
+	if (boundsProj[view] != proj)
+		updateBounds(view, proj, nearPlane, farPlane);
+
+	frame.clusterGrid = glm::uvec4(GRID_X, GRID_Y, GRID_Z, view * COUNT);
+	frame.clusterDepth = glm::vec4(nearPlane, farPlane, sliceScale, sliceBias);
+	frame.lightInfo = glm::uvec4(globalLights, (unsigned int)lights.size(), 0, 0);
+
+	//bound every light once, then fill the clusters slice by slice
+	unsigned int local = (unsigned int)lights.size() - globalLights;
+	spans.resize(local);
+	if (jobs != nullptr && local > JOB_LIGHTS)
+	{
+		jobs->parallelFor("cluster lights", local, JOB_LIGHTS, [this, &frame](unsigned int begin, unsigned int end) { boundLights(frame, begin, end); });
+		jobs->parallelFor("clusters", GRID_Z, 1, [this, view](unsigned int begin, unsigned int end) { assignLights(view, begin, end); });
+	}
+	else
+	{
+		boundLights(frame, 0, local);
+		assignLights(view, 0, GRID_Z);
+	}
+
+	//compact the fixed-size lists
+	for (unsigned int cluster = 0; cluster < COUNT; cluster++)
+	{
+		grid[view * COUNT + cluster] = glm::uvec2((unsigned int)indices.size(), scratchCount[cluster]);
+		const unsigned short *first = &scratch[cluster * MAX_LIGHTS_PER_CLUSTER];
+		indices.insert(indices.end(), first, first + scratchCount[cluster]);
+	}
+
+	buildTime += std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::high_resolution_clock::now() - start).count();
+}
+
+void Clusters::boundLights(const FrameBlock &frame, unsigned int begin, unsigned int end)
+{
+	const glm::mat4 &proj = frame.projection;
+	float nearPlane = frame.clusterDepth.x;
+	float farPlane = frame.clusterDepth.y;
+	float sliceScale = frame.clusterDepth.z;
+	float sliceBias = frame.clusterDepth.w;
+	for (unsigned int l = begin; l < end; l++)
+	{
+		const LightData &light = lights[globalLights + l];
+		Span &span = spans[l];
+		glm::vec3 c = glm::vec3(frame.view * glm::vec4(glm::vec3(light.position), 1.0f));
+		float r = light.range.x;
+		span.center = c;
+		span.radius = r;
+		span.z0 = 1;
+		span.z1 = 0;
+
+		//depth range (positive distances along the view direction)
+		float dMin = -c.z - r;
+		float dMax = -c.z + r;
+		if (dMax < nearPlane || dMin > farPlane)
+			continue;
+
+		//screen rectangle: project the sphere's box, clipped against the near plane
+		glm::vec2 ndcMin = glm::vec2(1.0f);
+		glm::vec2 ndcMax = glm::vec2(-1.0f);
+		for (int corner = 0; corner < 8; corner++)
+		{
+			glm::vec4 p = glm::vec4(
+				c.x + ((corner & 1) ? r : -r),
+				c.y + ((corner & 2) ? r : -r),
+				glm::min(c.z + ((corner & 4) ? r : -r), -nearPlane),
+				1.0f);
+			p = proj * p;
+			glm::vec2 ndc = glm::vec2(p) / p.w;
+			ndcMin = glm::min(ndcMin, ndc);
+			ndcMax = glm::max(ndcMax, ndc);
+		}
+		if (ndcMax.x < -1.0f || ndcMax.y < -1.0f || ndcMin.x > 1.0f || ndcMin.y > 1.0f)
+			continue;
+		span.x0 = (int)glm::clamp((ndcMin.x * 0.5f + 0.5f) * GRID_X, 0.0f, GRID_X - 1.0f);
+		span.x1 = (int)glm::clamp((ndcMax.x * 0.5f + 0.5f) * GRID_X, 0.0f, GRID_X - 1.0f);
+		span.y0 = (int)glm::clamp((ndcMin.y * 0.5f + 0.5f) * GRID_Y, 0.0f, GRID_Y - 1.0f);
+		span.y1 = (int)glm::clamp((ndcMax.y * 0.5f + 0.5f) * GRID_Y, 0.0f, GRID_Y - 1.0f);
+		span.z0 = (int)glm::clamp(logf(glm::max(dMin, nearPlane)) * sliceScale - sliceBias, 0.0f, GRID_Z - 1.0f);
+		span.z1 = (int)glm::clamp(logf(glm::min(dMax, farPlane)) * sliceScale - sliceBias, 0.0f, GRID_Z - 1.0f);
+	}
+}
+
+void Clusters::assignLights(unsigned int view, unsigned int zBegin, unsigned int zEnd)
+{
+	std::fill(scratchCount.begin() + zBegin * GRID_X * GRID_Y, scratchCount.begin() + zEnd * GRID_X * GRID_Y, 0);
+
+	//lights in order, so that every cluster lists them as a single thread would
+	unsigned int rangeAssignments = 0;
+	unsigned int rangeOverflows = 0;
+	for (unsigned int l = 0; l < spans.size(); l++)
+	{
+		const Span &span = spans[l];
+		int z0 = glm::max(span.z0, (int)zBegin);
+		int z1 = glm::min(span.z1, (int)zEnd - 1);
+		float r = span.radius;
+		for (int z = z0; z <= z1; z++)
+			for (int y = span.y0; y <= span.y1; y++)
+				for (int x = span.x0; x <= span.x1; x++)
+				{
+					//sphere against the cluster's box
+					unsigned int cluster = x + GRID_X * (y + GRID_Y * z);
+					const Bounds &b = bounds[view * COUNT + cluster];
+					glm::vec3 d = glm::clamp(span.center, b.min, b.max) - span.center;
+					if (glm::dot(d, d) > r * r)
+						continue;
+
+					if (scratchCount[cluster] == MAX_LIGHTS_PER_CLUSTER)
+					{
+						rangeOverflows++;
+						continue;
+					}
+					scratch[cluster * MAX_LIGHTS_PER_CLUSTER + scratchCount[cluster]++] = (unsigned short)(globalLights + l);
+					rangeAssignments++;
+				}
+	}
+
+	//once per range, the stats are shared by the jobs
+	assignments += rangeAssignments;
+	overflows += rangeOverflows;
+}
+
+const vector<LightData> LIB_API & Clusters::getLights()
+{
+	return lights;
+}
+
+const vector<glm::uvec2> LIB_API & Clusters::getGrid()
+{
+	return grid;
+}
+
+const vector<unsigned int> LIB_API & Clusters::getIndices()
+{
+	return indices;
+}
+
+unsigned int LIB_API Clusters::getGlobalLights()
+{
+	return globalLights;
+}
+
+long long LIB_API Clusters::getBuildTime()
+{
+	return buildTime;
+}
+
+unsigned int LIB_API Clusters::getAssignments()
+{
+	return assignments;
+}
+
+unsigned int LIB_API Clusters::getOverflows()
+{
+	return overflows;
+}
+
+void LIB_API Clusters::setJobSystem(JobSystem *jobs)
+{
+	this->jobs = jobs;
+}
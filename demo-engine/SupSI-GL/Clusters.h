@@ -0,0 +1,164 @@
+#pragma once
+
+/**
+@struct LightData
+std430 mirror of the "Light" structure read by the fragment shader.
+Positions are in world coordinates, w = 0 for directional lights (xyz is then the direction towards the light)
+*/
+struct LightData
+{
+	glm::vec4 position;
+	glm::vec4 ambient;
+	glm::vec4 diffuse;
+	glm::vec4 specular;
+	glm::vec4 range;		///< x: influence radius, 0 if the light reaches the whole scene
+};
+
+/**
+* Supsi-GE, clustered lighting class
+* The view frustum is split into GRID_X * GRID_Y screen tiles and GRID_Z exponential depth slices (froxels).
+* Every frame the lights with a finite influence radius are assigned on the CPU to the froxels they touch, so
+* that each fragment only iterates over the lights affecting its own cluster. Lights without a radius
+* (and directional ones) are "global" and are applied to every fragment.
+* With a JobSystem (see setJobSystem()), many lights are bounded in parallel blocks, then assigned one depth slice per job:
+* the slices do not share clusters, and every slice lists its lights in order, as on a single thread.
+* The class does not touch OpenGL: the resulting arrays are uploaded by the Engine into the
+* Ssbo::BINDING_LIGHTS, Ssbo::BINDING_CLUSTERS and Ssbo::BINDING_LIGHT_INDICES buffers.
+*/
+class LIB_API Clusters
+{
+public:
+	static const unsigned int GRID_X = 16;
+	static const unsigned int GRID_Y = 9;
+	static const unsigned int GRID_Z = 24;
+	static const unsigned int COUNT = GRID_X * GRID_Y * GRID_Z;		///< Clusters per view
+	static const unsigned int MAX_LIGHTS = 1024;					///< Absolute limit of lights per frame
+	static const unsigned int MAX_LIGHTS_PER_CLUSTER = 256;			///< Exceeding lights are dropped (see getOverflows())
+	static const unsigned int JOB_LIGHTS = 64;						///< Local lights per job, fewer are assigned on one thread
+
+	/**
+	Constructor
+	@param views Number of views sharing the light list (e.g. one per eye)
+	*/
+	Clusters(unsigned int views = 1);
+
+	/**
+	Starts a new frame with the given lights, up to MAX_LIGHTS. Global lights are moved in front.
+	@param lights The frame's lights
+	@param count Number of lights
+	*/
+	void setLights(const LightData *lights, unsigned int count);
+
+	/**
+	Assigns the local lights to the clusters of a view.
+	The view's projection and view matrices are read from "frame", which also receives the
+	grid parameters needed by the shader (clusterGrid, clusterDepth, lightInfo).
+	Must be called once per view, after setLights().
+	@param view The view index, lower than the number of views
+	@param frame The view's frame block
+	*/
+	void build(unsigned int view, FrameBlock &frame);
+
+	/**
+	Returns the frame's lights, global ones first
+	*/
+	const vector<LightData>& getLights();
+
+	/**
+	Returns the offset and count (in getIndices()) of the lights of every cluster, views one after the other
+	*/
+	const vector<glm::uvec2>& getGrid();
+
+	/**
+	Returns the light indices referenced by getGrid()
+	*/
+	const vector<unsigned int>& getIndices();
+
+	/**
+	Returns the number of global lights
+	*/
+	unsigned int getGlobalLights();
+
+	/**
+	Returns the time spent in build() since the last setLights(), in microseconds
+	*/
+	long long getBuildTime();
+
+	/**
+	Returns the number of light to cluster assignments since the last setLights()
+	*/
+	unsigned int getAssignments();
+
+	/**
+	Returns the number of assignments dropped because a cluster was full
+	*/
+	unsigned int getOverflows();
+
+	/**
+	Sets the job system build() runs on, nullptr to run on the calling thread
+	*/
+	void setJobSystem(JobSystem *jobs);
+
+private:
+	/**
+	@struct Bounds
+	View-space bounding box of a cluster
+	*/
+	struct Bounds
+	{
+		glm::vec3 min;
+		glm::vec3 max;
+	};
+
+	/**
+	@struct Span
+	View-space sphere of a local light and the range of clusters it may touch, empty (z0 > z1) if outside the view
+	*/
+	struct Span
+	{
+		glm::vec3 center;
+		float radius;
+		int x0, x1, y0, y1, z0, z1;
+	};
+
+	/**
+	Recomputes the view-space bounding boxes of a view's clusters
+	*/
+	void updateBounds(unsigned int view, const glm::mat4 &proj, float nearPlane, float farPlane);
+
+	/**
+	Computes the spans of the local lights [begin, end), counted from the first local light
+	*/
+	void boundLights(const FrameBlock &frame, unsigned int begin, unsigned int end);
+
+	/**
+	Fills the scratch lists of the clusters in the depth slices [zBegin, zEnd)
+	*/
+	void assignLights(unsigned int view, unsigned int zBegin, unsigned int zEnd);
+
+	unsigned int views;
+	unsigned int globalLights = 0;
+	vector<LightData> lights;
+	vector<glm::uvec2> grid;
+	vector<unsigned int> indices;
+
+	/**
+	@var bounds
+	Cluster bounding boxes per view, only recomputed when the projection changes
+	*/
+	vector<Bounds> bounds;
+	vector<glm::mat4> boundsProj;
+
+	/**
+	@var scratch
+	Per-cluster fixed-size light lists filled during build() and then compacted into "indices"
+	*/
+	vector<unsigned short> scratch;
+	vector<unsigned short> scratchCount;
+	vector<Span> spans;
+
+	JobSystem *jobs = nullptr;
+	long long buildTime = 0;
+	std::atomic<unsigned int> assignments{ 0 };
+	std::atomic<unsigned int> overflows{ 0 };
+};
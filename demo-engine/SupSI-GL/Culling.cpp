@@ -0,0 +1,306 @@
+#include "Engine.h"
+
+#include <cfloat>
+#include <chrono>
+
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#define CULLING_SSE
+#include <xmmintrin.h>
+#endif
+
+
+Culling::Frustum LIB_API Culling::Frustum::fromMatrix(const glm::mat4 &viewProj)
+{
+	//rows of the matrix (Gribb/Hartmann)
+	glm::vec4 row[4];
+	for (int i = 0; i < 4; i++)
+		row[i] = glm::vec4(viewProj[0][i], viewProj[1][i], viewProj[2][i], viewProj[3][i]);
+
+	Frustum f;
+	f.planes[0] = row[3] + row[0];
+	f.planes[1] = row[3] - row[0];
+	f.planes[2] = row[3] + row[1];
+	f.planes[3] = row[3] - row[1];
+	f.planes[4] = row[3] + row[2];
+	f.planes[5] = row[3] - row[2];
+	for (glm::vec4 &p : f.planes)
+		p /= glm::length(glm::vec3(p));
+	return f;
+}
+
+Culling::Frustum LIB_API Culling::Frustum::enclosing(const glm::mat4 &viewProjA, const glm::mat4 &viewProjB)
+{
+	const glm::mat4 *viewProj[2] = { &viewProjA, &viewProjB };
+	Frustum frustum[2];
+	glm::vec3 corners[2][8];
+	for (int f = 0; f < 2; f++)
+	{
+		frustum[f] = fromMatrix(*viewProj[f]);
+		glm::mat4 inv = glm::inverse(*viewProj[f]);
+		for (int c = 0; c < 8; c++)
+		{
+			glm::vec4 p = inv * glm::vec4((c & 1) ? 1.0f : -1.0f, (c & 2) ? 1.0f : -1.0f, (c & 4) ? 1.0f : -1.0f, 1.0f);
+			corners[f][c] = glm::vec3(p) / p.w;
+		}
+	}
+
+	Frustum result;
+	for (int p = 0; p < 6; p++)
+	{
+		//open plane, unless one of the two contains the other frustum
+		result.planes[p] = glm::vec4(0.0f, 0.0f, 0.0f, 1.0f);
+		for (int f = 0; f < 2; f++)
+		{
+			const glm::vec4 &plane = frustum[f].planes[p];
+			bool contains = true;
+			for (const glm::vec3 &corner : corners[1 - f])
+				if (glm::dot(glm::vec3(plane), corner) + plane.w < -1e-3f * (1.0f + glm::length(corner)))
+				{
+					contains = false;
+					break;
+				}
+			if (contains)
+			{
+				result.planes[p] = plane;
+				break;
+			}
+		}
+	}
+	return result;
+}
+
+void LIB_API Culling::clear()
+{
+	count = 0;
+	for (vector<float> *v : { &cx, &cy, &cz, &r, &bx, &by, &bz })
+		v->clear();
+	for (int i = 0; i < 3; i++)
+	{
+		ax[i].clear();
+		ay[i].clear();
+		az[i].clear();
+	}
+}
+
+unsigned int LIB_API Culling::add(const glm::mat4 &model, float radius, const glm::vec3 &boxMin, const glm::vec3 &boxMax)
+{
+	if (radius < 0.0f)
+		return ALWAYS_VISIBLE;
+
+	//pad to a multiple of 4 with bounds that are never inside (negative radius)
+	if (count % 4 == 0)
+	{
+		for (vector<float> *v : { &cx, &cy, &cz, &bx, &by, &bz })
+			v->resize(count + 4, 0.0f);
+		r.resize(count + 4, -FLT_MAX);
+		for (int i = 0; i < 3; i++)
+		{
+			ax[i].resize(count + 4, 0.0f);
+			ay[i].resize(count + 4, 0.0f);
+			az[i].resize(count + 4, 0.0f);
+		}
+	}
+
+	//sphere around the origin, scaled by the largest axis
+	float scale = glm::max(glm::length(glm::vec3(model[0])), glm::max(glm::length(glm::vec3(model[1])), glm::length(glm::vec3(model[2]))));
+	cx[count] = model[3].x;
+	cy[count] = model[3].y;
+	cz[count] = model[3].z;
+	r[count] = radius * scale;
+
+	//oriented box
+	glm::vec3 center = glm::vec3(model * glm::vec4((boxMin + boxMax) * 0.5f, 1.0f));
+	glm::vec3 half = (boxMax - boxMin) * 0.5f;
+	bx[count] = center.x;
+	by[count] = center.y;
+	bz[count] = center.z;
+	for (int i = 0; i < 3; i++)
+	{
+		glm::vec3 axis = glm::vec3(model[i]) * half[i];
+		ax[i][count] = axis.x;
+		ay[i][count] = axis.y;
+		az[i][count] = axis.z;
+	}
+
+	return count++;
+}
+
+unsigned int LIB_API Culling::test(const Frustum &frustum, unsigned int first, bool full)
+{
+#ifdef CULLING_SSE
+	if (simd)
+	{
+		const __m128 zero = _mm_setzero_ps();
+		const __m128 signMask = _mm_set1_ps(-0.0f);
+		__m128 x = _mm_loadu_ps(&cx[first]);
+		__m128 y = _mm_loadu_ps(&cy[first]);
+		__m128 z = _mm_loadu_ps(&cz[first]);
+		__m128 negR = _mm_sub_ps(zero, _mm_loadu_ps(&r[first]));
+		__m128 inside = _mm_cmpeq_ps(zero, zero);
+
+		for (const glm::vec4 &plane : frustum.planes)
+		{
+			__m128 nx = _mm_set1_ps(plane.x);
+			__m128 ny = _mm_set1_ps(plane.y);
+			__m128 nz = _mm_set1_ps(plane.z);
+			__m128 nw = _mm_set1_ps(plane.w);
+
+			//sphere: signed distance of the center against the radius
+			__m128 d = _mm_add_ps(_mm_add_ps(_mm_mul_ps(nx, x), _mm_mul_ps(ny, y)), _mm_add_ps(_mm_mul_ps(nz, z), nw));
+			inside = _mm_and_ps(inside, _mm_cmpge_ps(d, negR));
+			if (!full)
+				continue;
+
+			//box: signed distance of the center against the projected half extents
+			__m128 db = _mm_add_ps(_mm_add_ps(_mm_mul_ps(nx, _mm_loadu_ps(&bx[first])), _mm_mul_ps(ny, _mm_loadu_ps(&by[first]))),
+				_mm_add_ps(_mm_mul_ps(nz, _mm_loadu_ps(&bz[first])), nw));
+			__m128 extent = zero;
+			for (int i = 0; i < 3; i++)
+			{
+				__m128 e = _mm_add_ps(_mm_add_ps(_mm_mul_ps(nx, _mm_loadu_ps(&ax[i][first])), _mm_mul_ps(ny, _mm_loadu_ps(&ay[i][first]))),
+					_mm_mul_ps(nz, _mm_loadu_ps(&az[i][first])));
+				extent = _mm_add_ps(extent, _mm_andnot_ps(signMask, e));
+			}
+			inside = _mm_and_ps(inside, _mm_cmpge_ps(db, _mm_sub_ps(zero, extent)));
+		}
+		return (unsigned int)_mm_movemask_ps(inside);
+	}
+#endif
+
+	//same sums as the SSE code, in the same order
+	unsigned int mask = 0;
+	for (unsigned int c = 0; c < 4; c++)
+	{
+		unsigned int i = first + c;
+		bool inside = true;
+		for (const glm::vec4 &plane : frustum.planes)
+		{
+			inside &= (plane.x * cx[i] + plane.y * cy[i]) + (plane.z * cz[i] + plane.w) >= -r[i];
+			if (!full)
+				continue;
+
+			float extent = 0.0f;
+			for (int a = 0; a < 3; a++)
+				extent += fabsf((plane.x * ax[a][i] + plane.y * ay[a][i]) + plane.z * az[a][i]);
+			inside &= (plane.x * bx[i] + plane.y * by[i]) + (plane.z * bz[i] + plane.w) >= -extent;
+		}
+		mask |= (inside ? 1u : 0u) << c;
+	}
+	return mask;
+}
+
+void LIB_API Culling::cull(const glm::mat4 *viewProj, unsigned int views)
+{
+	auto start = std::chrono::high_resolution_clock::now();
+
+	views = glm::clamp(views, 1u, MAX_VIEWS);
+	this->views = views;
+	Frustum frustum[MAX_VIEWS];
+	for (unsigned int v = 0; v < views; v++)
+		frustum[v] = Frustum::fromMatrix(viewProj[v]);
+
+	//first pass against a single frustum containing every view
+	Frustum all;
+	if (views == 1)
+		all = frustum[0];
+	else if (views == 2)
+		all = Frustum::enclosing(viewProj[0], viewProj[1]);
+	else
+		for (glm::vec4 &p : all.planes)
+			p = glm::vec4(0.0f, 0.0f, 0.0f, 1.0f);
+
+	visible.assign(count, 0);
+	culled = 0;
+	for (unsigned int v = 0; v < MAX_VIEWS; v++)
+		drawn[v] = 0;
+
+	if (jobs != nullptr && count > JOB_BOUNDS)
+		jobs->parallelFor("culling", (count + JOB_BOUNDS - 1) / JOB_BOUNDS, 1, [&](unsigned int begin, unsigned int end)
+		{
+			cullRange(all, frustum, begin * JOB_BOUNDS, glm::min(end * JOB_BOUNDS, count));
+		});
+	else
+		cullRange(all, frustum, 0, count);
+
+	cullTime += std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::high_resolution_clock::now() - start).count();
+}
+
+void Culling::cullRange(const Frustum &all, const Frustum *frustum, unsigned int begin, unsigned int end)
+{
+	unsigned int rangeCulled = 0;
+	unsigned int rangeDrawn[MAX_VIEWS] = {};
+	for (unsigned int first = begin; first < end; first += 4)
+	{
+		unsigned int n = glm::min(end - first, 4u);
+		unsigned int inside = test(all, first, false) & ((1u << n) - 1);
+		for (unsigned int c = 0; c < n; c++)
+			if (!(inside & (1u << c)))
+				rangeCulled++;
+		if (!inside)
+			continue;
+
+		//refine per view
+		for (unsigned int v = 0; v < views; v++)
+		{
+			unsigned int mask = test(frustum[v], first, true) & inside;
+			for (unsigned int c = 0; c < n; c++)
+				if (mask & (1u << c))
+				{
+					visible[first + c] |= (unsigned char)(1u << v);
+					rangeDrawn[v]++;
+				}
+		}
+	}
+
+	//once per range, the stats are shared by the jobs
+	culled += rangeCulled;
+	for (unsigned int v = 0; v < views; v++)
+		drawn[v] += rangeDrawn[v];
+}
+
+void LIB_API Culling::setJobSystem(JobSystem *jobs)
+{
+	this->jobs = jobs;
+}
+
+void LIB_API Culling::setSimd(bool enable)
+{
+	simd = enable;
+}
+
+void LIB_API Culling::setViewMask(unsigned int index, unsigned int mask)
+{
+	if (index == ALWAYS_VISIBLE)
+		return;
+	for (unsigned int v = 0; v < views; v++)
+		if (((visible[index] >> v) & 1) && !((mask >> v) & 1))
+			drawn[v]--;
+	visible[index] &= (unsigned char)mask;
+}
+
+unsigned int LIB_API Culling::getViews()
+{
+	return views;
+}
+
+unsigned int LIB_API Culling::getTested()
+{
+	return count;
+}
+
+unsigned int LIB_API Culling::getCulled()
+{
+	return culled;
+}
+
+unsigned int LIB_API Culling::getDrawn(unsigned int view)
+{
+	return view < MAX_VIEWS ? drawn[view].load() : 0;
+}
+
+long long LIB_API Culling::getCullTime()
+{
+	long long time = cullTime;
+	cullTime = 0;
+	return time;
+}
@@ -0,0 +1,155 @@
+#pragma once
+
+/**
+* Supsi-GE, view-frustum culling class
+* Mesh bounds (a sphere around the mesh origin and a local bounding box, see Mesh.h) are transformed to
+* world coordinates and stored as structures of arrays, so that they can be tested four at a time with SSE.
+* Every frame all the bounds are first tested against a single frustum enclosing every view (both eyes),
+* then the survivors are refined against each view's own frustum, with the sphere first and the oriented box last.
+* With a JobSystem (see setJobSystem()), large sets of bounds are tested in parallel blocks.
+* The class does not touch OpenGL: List::renderNodes() and IndirectBatch read the resulting per-view masks.
+*/
+class LIB_API Culling
+{
+public:
+	static const unsigned int MAX_VIEWS = 8;				///< Views are stored as bits of an unsigned char
+	static const unsigned int ALWAYS_VISIBLE = 0xFFFFFFFF;	///< Returned by add() for objects without bounds
+	static const unsigned int JOB_BOUNDS = 1024;			///< Bounds per job, smaller sets are tested on one thread
+
+	/**
+	@struct Frustum
+	Six normalized planes (left, right, bottom, top, near, far), inside when dot(plane, point) >= 0
+	*/
+	struct Frustum
+	{
+		glm::vec4 planes[6];
+
+		/**
+		Extracts the planes of a projection * view matrix
+		*/
+		static Frustum fromMatrix(const glm::mat4 &viewProj);
+
+		/**
+		Returns a frustum enclosing both frustums, built from the planes of either one that contain the other.
+		Planes that no frustum can provide are left open.
+		*/
+		static Frustum enclosing(const glm::mat4 &viewProjA, const glm::mat4 &viewProjB);
+	};
+
+	/**
+	Removes all the bounds
+	*/
+	void clear();
+
+	/**
+	Adds the bounds of an object
+	@param model World matrix of the object
+	@param radius Radius of the bounding sphere centered on the object's origin, negative if the object has no bounds
+	@param boxMin Minimum corner of the local bounding box
+	@param boxMax Maximum corner of the local bounding box
+	@return the index to pass to isVisible(), or ALWAYS_VISIBLE
+	*/
+	unsigned int add(const glm::mat4 &model, float radius, const glm::vec3 &boxMin, const glm::vec3 &boxMax);
+
+	/**
+	Tests all the bounds against the views
+	@param viewProj The projection * view matrix of each view
+	@param views Number of views, at most MAX_VIEWS
+	*/
+	void cull(const glm::mat4 *viewProj, unsigned int views);
+
+	/**
+	Returns true if an object is visible in a view
+	@param index The value returned by add()
+	@param view The view index
+	*/
+	inline bool isVisible(unsigned int index, unsigned int view)
+	{
+		return index == ALWAYS_VISIBLE || (visible[index] >> view) & 1;
+	}
+
+	/**
+	Returns the views in which an object is visible, one bit per view
+	@param index The value returned by add()
+	*/
+	inline unsigned int getViewMask(unsigned int index)
+	{
+		return index == ALWAYS_VISIBLE ? 0xFF : visible[index];
+	}
+
+	/**
+	Restricts the views in which an object is visible, for later culling stages (see Occlusion.h)
+	@param index The value returned by add()
+	@param mask The views in which the object is still visible, one bit per view
+	*/
+	void setViewMask(unsigned int index, unsigned int mask);
+
+	/**
+	Tests the bounds on the threads of a job system, nullptr to test them on the calling thread only
+	*/
+	void setJobSystem(JobSystem *jobs);
+
+	/**
+	Tests four bounds at a time with SSE when available (the default), or one at a time with the scalar code,
+	which computes the same sums in the same order and gives the same results
+	*/
+	void setSimd(bool enable);
+
+	/**
+	Returns the number of views of the last cull()
+	*/
+	unsigned int getViews();
+
+	/**
+	Returns the number of bounds tested by the last cull()
+	*/
+	unsigned int getTested();
+
+	/**
+	Returns the number of bounds outside the enclosing frustum in the last cull()
+	*/
+	unsigned int getCulled();
+
+	/**
+	Returns the number of bounds visible in a view in the last cull()
+	@param view The view index
+	*/
+	unsigned int getDrawn(unsigned int view);
+
+	/**
+	Returns the time spent in cull() since the last getCullTime() call, in microseconds
+	*/
+	long long getCullTime();
+
+private:
+	/**
+	Tests four bounds, starting from "first", against a frustum
+	@param full True to also test the oriented boxes, false for the spheres only
+	@return one bit per bound, set when inside
+	*/
+	unsigned int test(const Frustum &frustum, unsigned int first, bool full);
+
+	/**
+	Tests the bounds [begin, end), begin being a multiple of 4, and adds the results to the stats
+	*/
+	void cullRange(const Frustum &all, const Frustum *frustum, unsigned int begin, unsigned int end);
+
+	unsigned int count = 0;
+	JobSystem *jobs = nullptr;
+	bool simd = true;
+
+	/**
+	@var cx
+	World-space bounds, structure of arrays padded to a multiple of 4:
+	sphere center and radius, box center and half-extent axes (box axis i scaled by its half size)
+	*/
+	vector<float> cx, cy, cz, r;
+	vector<float> bx, by, bz;
+	vector<float> ax[3], ay[3], az[3];
+
+	vector<unsigned char> visible;
+	unsigned int views = 1;
+	std::atomic<unsigned int> culled{ 0 };
+	std::atomic<unsigned int> drawn[MAX_VIEWS] = {};
+	long long cullTime = 0;
+};
@@ -0,0 +1,120 @@
+#include "Engine.h"
+
+
+//smallest decrease, so that a frame over the budget always changes something
+#define MIN_DOWN_STEP 0.02f
+
+
+LIB_API DynamicResolution::DynamicResolution(double budget, float minScale, float maxScale)
+{
+	this->budget = budget;
+	this->minScale = minScale;
+	this->maxScale = glm::max(maxScale, minScale);
+	scale = this->maxScale;
+}
+
+void LIB_API DynamicResolution::setBudget(double budget)
+{
+	this->budget = budget;
+}
+
+double LIB_API DynamicResolution::getBudget()
+{
+	return budget;
+}
+
+void LIB_API DynamicResolution::setBounds(float minScale, float maxScale)
+{
+	this->minScale = minScale;
+	this->maxScale = glm::max(maxScale, minScale);
+	scale = glm::clamp(scale, this->minScale, this->maxScale);
+}
+
+float LIB_API DynamicResolution::getMinScale()
+{
+	return minScale;
+}
+
+float LIB_API DynamicResolution::getMaxScale()
+{
+	return maxScale;
+}
+
+void LIB_API DynamicResolution::setThresholds(float low, float high)
+{
+	this->low = low;
+	this->high = glm::max(high, low);
+}
+
+void LIB_API DynamicResolution::setUpStep(float step)
+{
+	upStep = step;
+}
+
+float LIB_API DynamicResolution::update(double gpuTime)
+{
+	frame++;
+	if (gpuTime <= 0.0)
+		return scale;
+	if (settle > 0)
+	{
+		settle--;
+		return scale;
+	}
+
+	if (gpuTime > budget * high)
+	{
+		over++;
+		under = 0;
+	}
+	else if (gpuTime < budget * low)
+	{
+		under++;
+		over = 0;
+	}
+	else
+		over = under = 0;
+
+	//aim at the middle of the band, the GPU time going with the square of the scale
+	float target = scale * (float)sqrt(budget * (low + high) * 0.5 / gpuTime);
+	float next = scale;
+	if (gpuTime > budget || over >= DOWN_FRAMES)
+		next = glm::min(target, scale - MIN_DOWN_STEP);
+	else if (under >= UP_FRAMES)
+		next = glm::min(target, scale + upStep);
+	next = glm::clamp(next, minScale, maxScale);
+
+	if (next != scale)
+	{
+		if (log)
+			log(frame, scale, next, gpuTime);
+		scale = next;
+		over = under = 0;
+		settle = SETTLE_FRAMES;
+		changes++;
+	}
+	return scale;
+}
+
+float LIB_API DynamicResolution::getScale()
+{
+	return scale;
+}
+
+void LIB_API DynamicResolution::reset(float scale)
+{
+	this->scale = glm::clamp(scale, minScale, maxScale);
+	over = under = settle = 0;
+}
+
+unsigned int LIB_API DynamicResolution::getChanges()
+{
+	unsigned int result = changes;
+	changes = 0;
+	return result;
+}
+
+void LIB_API DynamicResolution::setLog(const Log &log)
+{
+	this->log = log;
+}
@@ -0,0 +1,100 @@
+#pragma once
+
+/**
+* Supsi-GE, dynamic resolution controller class
+* Chooses the resolution scale (per axis, the pixels rendered are proportional to its square) of the next frames from
+* the GPU time of the previous ones, to hold the display rate under load spikes:
+*  - a frame over the budget is a missed frame: the scale goes down right away
+*  - frames above the "high" threshold (a fraction of the budget) for DOWN_FRAMES frames in a row also lower it
+*  - frames below the "low" threshold for UP_FRAMES frames in a row raise it, by a limited step
+*  - in between nothing changes (hysteresis), so that noise around the budget does not make the scale oscillate
+* The new scale aims at the middle of the band, assuming a GPU time proportional to the pixels. After a change the
+* next SETTLE_FRAMES measurements are ignored: GPU timings come back some frames late and still belong to the old scale.
+* Every change is passed to the log callback. The class does not touch OpenGL.
+*/
+class LIB_API DynamicResolution
+{
+public:
+	static const unsigned int DOWN_FRAMES = 2;		///< Frames above the high threshold before scaling down
+	static const unsigned int UP_FRAMES = 30;		///< Frames below the low threshold before scaling up
+	static const unsigned int SETTLE_FRAMES = 3;	///< Frames ignored after a change
+
+	/**
+	Log callback: frame number, previous and new scale, GPU time in milliseconds that caused the change
+	*/
+	typedef std::function<void(unsigned int frame, float from, float to, double gpuTime)> Log;
+
+	/**
+	Constructor, starts at the maximum scale
+	@param budget GPU time per frame in milliseconds
+	@param minScale Lowest scale
+	@param maxScale Highest scale
+	*/
+	DynamicResolution(double budget = 1000.0 / 90.0, float minScale = 0.5f, float maxScale = 1.0f);
+
+	/**
+	Sets the GPU time per frame, in milliseconds (the display period)
+	*/
+	void setBudget(double budget);
+	double getBudget();
+
+	/**
+	Sets the range of the scale, the current scale is clamped to it
+	*/
+	void setBounds(float minScale, float maxScale);
+	float getMinScale();
+	float getMaxScale();
+
+	/**
+	Sets the hysteresis band, as fractions of the budget (0.7 and 0.9 by default)
+	*/
+	void setThresholds(float low, float high);
+
+	/**
+	Sets the largest increase of the scale in one change (0.05 by default), decreases are not limited
+	*/
+	void setUpStep(float step);
+
+	/**
+	Takes the GPU time of a frame and returns the scale of the next one
+	@param gpuTime GPU time in milliseconds, ignored if not positive (no measurement yet)
+	@return The scale
+	*/
+	float update(double gpuTime);
+
+	/**
+	Returns the current scale
+	*/
+	float getScale();
+
+	/**
+	Sets the scale, clamped to the bounds, and starts over
+	*/
+	void reset(float scale);
+
+	/**
+	Returns the number of scale changes since the last call
+	*/
+	unsigned int getChanges();
+
+	/**
+	Sets the log callback, nullptr to disable it
+	*/
+	void setLog(const Log &log);
+
+private:
+	double budget;
+	float minScale;
+	float maxScale;
+	float low = 0.7f;
+	float high = 0.9f;
+	float upStep = 0.05f;
+
+	float scale;
+	unsigned int frame = 0;
+	unsigned int over = 0;		//frames in a row above the band
+	unsigned int under = 0;		//frames in a row below the band
+	unsigned int settle = 0;	//measurements still to ignore
+	unsigned int changes = 0;
+	Log log;
+};
@@ -31,6 +31,7 @@ int APIENTRY DllMain(HANDLE instDLL, DWORD reason, LPVOID _reserved)
 #include <GL/glew.h>
 #include "GL/freeglut.h"
 #include <FreeImage.h>
+#include <chrono>
 
 #include "oxr.h"
 
@@ -66,42 +67,142 @@ glm::mat4 ortho;
 
 // Textures:
 unsigned int texId = 0;
-unsigned int fboTexId[EYE_LAST] = { 0, 0 };
 
-// FBO:      
-Fbo *fbo[EYE_LAST] = { nullptr, nullptr };
+// Frame graphs, see FrameGraph.h:
+FrameGraph *desktopGraph = nullptr;
+vector<unsigned int> desktopTextures;		// One per physical target
+vector<Fbo *> desktopFbos;					// One per pass, nullptr for the passes drawing into the window
+unsigned int eyeColor[EYE_LAST] = { 0, 0 };	// Graph resources sampled by the composite pass
+GLint windowViewport[4];
+FrameGraph *xrGraph = nullptr;
+vector<unsigned int> xrTextures;			// Periphery targets of the foveated eyes, the rest is imported
+vector<Fbo *> xrFbos;
+List *graphList = nullptr;					// List rendered by the graph being executed
 
 // Passthrough shader:
 Shader *passthroughVs = nullptr;
 Shader *passthroughFs = nullptr;
 Program *passthroughShader = nullptr;
+
+// Depth copy shader, the passthrough quad writing a depth texture into any depth format:
+Shader *depthCopyFs = nullptr;
+Program *depthCopyShader = nullptr;
 int ptProjLoc = -1;
 int ptMvLoc = -1;
 int ptColorLoc = -1;
 
 
+// Mesh shader variants:
+ShaderCache *shaderCache = nullptr;
+
+// Shared geometry and multi-draw-indirect submission:
+MeshPool *meshPool = nullptr;
+IndirectBatch *indirectBatch = nullptr;
+bool indirect = false;
+
+// GPU occlusion culling of the indirect commands, off by default:
+HiZ *hiz = nullptr;
+bool gpuCulling = false;
+
+// Submission stats, reset each second:
+unsigned int drawCalls = 0;
+long long submitTime = 0;
+long long prepareTime = 0;
+
+// Uniform blocks:
+Ubo *frameUbo = nullptr;
+
+// Single-pass stereo for OpenXR, requested before initOpenXR():
+bool singlePassStereo = false;
+bool pipelinedFrames = false;
+
+// Resolution of the eyes driven by their GPU time, measured with a ring of timer queries read GPU_TIMERS - 1 frames late:
+#define GPU_TIMERS 4
+DynamicResolution *dynamicResolution = nullptr;
+GLuint gpuTimers[GPU_TIMERS] = {};
+unsigned int gpuTimerFrames = 0;
+
+// Fixed foveated rendering of the eyes, requested before initOpenXR(), and the layout of each eye in the current frame:
+bool foveatedRendering = false;
+bool foveated = false;
+Foveation foveation[OvXR::EYE_LAST];
+unsigned int peripheryPass[OvXR::EYE_LAST] = { 0, 0 };
+
+// Samples passing the depth test in the eye passes, with a ring of occlusion queries read GPU_TIMERS - 1 frames late:
+// the fill of the foveated eyes measured on the device, to compare with a run at full resolution
+GLuint sampleQueries[GPU_TIMERS] = {};
+unsigned long long samplePixels[GPU_TIMERS] = {};	// Pixels of the eyes in the frame of each query
+bool sampleCopies[GPU_TIMERS] = {};					// Depth copies in the frame of each query, one sample per pixel
+unsigned int sampleFrames = 0;
+unsigned long long shadedSamples = 0;
+unsigned long long shadedPixels = 0;
+
+// Viewport restored once a quad layer is rendered:
+GLint quadViewport[4];
+
+// Planes of the eye projections, also submitted with the depth layers:
+const float xrNearPlane = 0.1f;
+const float xrFarPlane = 1000.f;
+FramePacer *framePacer = nullptr;
+Engine::StereoMode stereoMode = Engine::STEREO_OFF;
+Ubo *stereoUbo = nullptr;
+
+// Worker threads of the frame preparation (transforms, culling):
+JobSystem *jobs = nullptr;
+
+// Transient per-frame data, rewound by Engine::swap():
+FrameArena *frameArena = nullptr;
+
+// List rebuilt every frame by renderScene(Node*) and renderOpenXR():
+List *frameList = nullptr;
+
+// Application updates on their own thread, off until startSimulation(), and the snapshot of the current frame:
+Simulation *simulation = nullptr;
+const Snapshot *frameSnapshot = nullptr;
+
+// Last captured state of the active camera, kept until a camera just switched to shows up in a snapshot:
+Snapshot::CameraState frameCamera;
+bool frameCameraValid = false;
+
+// Node last reported missing from the snapshots, so that the error is not repeated every frame:
+const Node *missingNode = nullptr;
+
+// Flattened copy of the rendered tree, rebuilt when its shape changes:
+Hierarchy *hierarchy = nullptr;
+
+// Scene nodes, one pool per type (see Engine::createNode()):
+ScenePools scenePools;
+
+// Index of the last loaded scene (see Engine::find()):
+Registry registry;
+
+// View-frustum culling:
+Culling *culling = nullptr;
+
+// Software occlusion culling, off by default:
+Occlusion *occlusion = nullptr;
+bool occlusionCulling = false;
+
+// Ordering of the opaque meshes against overdraw:
+Engine::DepthMode depthMode = Engine::DEPTH_UNSORTED;
+const char *depthModeNames[Engine::DEPTH_LAST] = { "unsorted", "front to back", "depth pre-pass" };
+
+// Overdraw benchmark, OVERDRAW_FRAMES frames per depth mode:
+const int OVERDRAW_FRAMES = 60;
+int overdrawFrame = -1;				// -1 when not running
+Engine::DepthMode overdrawRestore = Engine::DEPTH_UNSORTED;
+unsigned long long overdrawFragments = 0;
+unsigned long long overdrawPixels = 0;
+
+// Clustered lights:
+Clusters *clusters = nullptr;
+Ssbo *lightSsbo = nullptr;
+Ssbo *clusterSsbo = nullptr;
+Ssbo *lightIndexSsbo = nullptr;
+
 unsigned int boxVertexVbo = 0;
 unsigned int boxTexCoordVbo = 0;
 
-////////////////////////////////////////////////////////////// XXXXXXXXX
-static void screenshot_ppm(const char *filename, unsigned int width,
-	unsigned int height, GLubyte **pixels) {
-	size_t i, j, cur;
-	const size_t format_nchannels = 3;
-	FILE *f = fopen(filename, "w");
-	fprintf(f, "P3\n%d %d\n%d\n", width, height, 255);
-	*pixels = (GLubyte*)realloc(*pixels, format_nchannels * sizeof(GLubyte) * width * height);
-	glReadPixels(0, 0, width, height, GL_RGB, GL_UNSIGNED_BYTE, *pixels);
-	for (i = 0; i < height; i++) {
-		for (j = 0; j < width; j++) {
-			cur = format_nchannels * ((height - i - 1) * width + j);
-			fprintf(f, "%3d %3d %3d ", (*pixels)[cur], (*pixels)[cur + 1], (*pixels)[cur + 2]);
-		}
-		fprintf(f, "\n");
-	}
-	fclose(f);
-}
-
 /**
  * This callback is invoked once each 3 seconds in order to calculate fps
  * @param value passepartout value
@@ -110,17 +211,213 @@ void timerCallback(int value)
 {
 	int fps = frames;
 	frames = 0;
-	if(fpsFlag)
+	if (fpsFlag)
+	{
 		std::cout << "fps: " << fps << std::endl;
+		if (clusters)
+			std::cout << "   lights: " << clusters->getLights().size() << " (" << clusters->getGlobalLights() << " global)"
+				<< ", cluster assignments: " << clusters->getAssignments() << " (" << clusters->getOverflows() << " dropped)"
+				<< ", cluster build: " << clusters->getBuildTime() << " us" << std::endl;
+		if (culling)
+			std::cout << "   culling: " << culling->getTested() << " meshes, " << culling->getCulled() << " outside both eyes, "
+				<< culling->getDrawn(0) << "/" << culling->getDrawn(1) << " drawn per eye, "
+				<< (fps ? culling->getCullTime() / fps : 0) << " us per frame" << std::endl;
+		if (occlusion && occlusionCulling)
+			std::cout << "   occlusion: " << occlusion->getOccluders() << " occluders, " << occlusion->getTriangles() << " triangles, "
+				<< occlusion->getOccluded() << "/" << occlusion->getTested() << " boxes hidden, "
+				<< (fps ? occlusion->getCullTime() / fps : 0) << " us per frame (" << occlusion->getThreads() << " threads)" << std::endl;
+		if (simulation && simulation->isRunning())
+		{
+			unsigned int steps = simulation->getSteps();
+			std::cout << "   simulation: " << steps << " updates, " << (steps ? simulation->getUpdateTime() / steps : 0) << " us per update" << std::endl;
+		}
+		if (framePacer)
+		{
+			unsigned int paced = framePacer->getFrames();
+			std::cout << "   frame pacing: " << paced << " frames, " << (paced ? framePacer->getLatency() / paced : 0) << " us from wait to submission, "
+				<< (paced ? framePacer->getWaitTime() / paced : 0) << " us blocked per frame" << std::endl;
+		}
+		if (dynamicResolution)
+			std::cout << "   dynamic resolution: scale " << dynamicResolution->getScale() << " (" << xr.getRenderWidth() << "x" << xr.getRenderHeight()
+				<< " per eye, budget " << dynamicResolution->getBudget() << " ms), " << dynamicResolution->getChanges() << " changes" << std::endl;
+		if (foveated)
+		{
+			const Foveation::Rect &inset = foveation[OvXR::EYE_LEFT].getInset();
+			std::cout << "   foveation: " << inset.width << "x" << inset.height << " inset, periphery " << foveation[OvXR::EYE_LEFT].getPeripheryWidth()
+				<< "x" << foveation[OvXR::EYE_LEFT].getPeripheryHeight() << ", " << 100.0 * foveation[OvXR::EYE_LEFT].getShadedPixels() / glm::max(foveation[OvXR::EYE_LEFT].getFullPixels(), 1ull)
+				<< "% of the pixels shaded (estimate)" << std::endl;
+		}
+		if (shadedPixels)
+			std::cout << "   eye fill (" << (foveated ? "foveated" : "full resolution") << "): " << (double)shadedSamples / shadedPixels
+				<< " samples passed per pixel" << std::endl;
+		if (jobs && fps)
+			std::cout << "   jobs: " << jobs->getExecuted() / fps << " per frame, " << jobs->getStolen() / fps << " stolen ("
+				<< jobs->getThreads() << " threads)" << std::endl;
+		if (fps)
+			std::cout << "   submission (" << (indirect ? (gpuCulling ? "indirect, hi-z" : "indirect") : "direct") << ", " << depthModeNames[depthMode] << "): " << drawCalls / fps << " draw calls, "
+				<< submitTime / fps << " us cpu per frame, " << prepareTime / fps << " us frame preparation, "
+				<< Transform::getInversions() / fps << " normal matrices computed" << std::endl;
+		if (shaderCache)
+			shaderCache->printStats();
+	}
+	drawCalls = 0;
+	submitTime = 0;
+	prepareTime = 0;
+	shadedSamples = 0;
+	shadedPixels = 0;
+	Transform::resetInversions();
 
 	// Register the next update:
 	glutTimerFunc(1000, timerCallback, 0);
 }
 
+/**
+ * Converts a rigid transformation into an OpenXR pose
+ * @param matrix rotation and translation, without scaling
+ * @return the pose
+ */
+XrPosef toXrPose(const glm::mat4 &matrix)
+{
+	glm::quat rotation = glm::quat_cast(glm::mat3(matrix));
+	XrPosef pose;
+	pose.orientation = { rotation.x, rotation.y, rotation.z, rotation.w };
+	pose.position = { matrix[3].x, matrix[3].y, matrix[3].z };
+	return pose;
+}
+
+/**
+ * Accumulates the samples of the oldest eye query, if the GPU is done with it, and moves the ring on
+ */
+void collectSamples()
+{
+	sampleFrames++;
+	unsigned int slot = sampleFrames % GPU_TIMERS;
+	GLint available = 0;
+	if (sampleFrames >= GPU_TIMERS)
+		glGetQueryObjectiv(sampleQueries[slot], GL_QUERY_RESULT_AVAILABLE, &available);
+	if (!available)
+		return;
+
+	GLuint64 samples = 0;
+	glGetQueryObjectui64v(sampleQueries[slot], GL_QUERY_RESULT, &samples);
+	if (sampleCopies[slot])
+		samples -= glm::min(samples, (GLuint64)samplePixels[slot]);
+	shadedSamples += samples;
+	shadedPixels += samplePixels[slot];
+}
+
+/**
+ * Accumulates the fragments shaded by a frame while the overdraw benchmark runs, and moves on to the next depth mode
+ * every OVERDRAW_FRAMES frames
+ * @param pixels number of pixels of the frame, all eyes
+ */
+void measureOverdraw(unsigned long long pixels)
+{
+	if (overdrawFrame < 0)
+		return;
+	overdrawFragments += shaderCache->collectFragmentCount();
+	overdrawPixels += pixels;
+	if (++overdrawFrame < OVERDRAW_FRAMES)
+		return;
+
+	std::cout << "   overdraw (" << depthModeNames[depthMode] << "): "
+		<< (double)overdrawFragments / (double)overdrawPixels << " shaded fragments per pixel" << std::endl;
+	overdrawFragments = 0;
+	overdrawPixels = 0;
+	overdrawFrame = 0;
+	if (depthMode + 1 < Engine::DEPTH_LAST)
+		depthMode = (Engine::DepthMode)(depthMode + 1);
+	else
+	{
+		depthMode = overdrawRestore;
+		overdrawFrame = -1;
+		shaderCache->setCounting(false);
+	}
+}
+
+/**
+ * Creates the textures and FBOs of a compiled frame graph: one texture per physical target, one FBO per pass rendering
+ * into transient targets.
+ */
+void realizeGraph(FrameGraph *graph, vector<unsigned int> &textures, vector<Fbo *> &fbos)
+{
+	textures.assign(graph->getNrOfTargets(), 0);
+	if (!textures.empty())
+		glGenTextures((GLsizei)textures.size(), textures.data());
+	for (unsigned int c = 0; c < textures.size(); c++)
+	{
+		const FrameGraph::Target &target = graph->getTargetInfo(c);
+		glBindTexture(GL_TEXTURE_2D, textures[c]);
+		if (target.format == FrameGraph::FORMAT_DEPTH24)
+			glTexImage2D(GL_TEXTURE_2D, 0, GL_DEPTH_COMPONENT24, target.sizeX, target.sizeY, 0, GL_DEPTH_COMPONENT, GL_FLOAT, nullptr);
+		else
+			glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, target.sizeX, target.sizeY, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+		glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+		glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	}
+
+	fbos.assign(graph->getNrOfPasses(), nullptr);
+	for (unsigned int c = 0; c < graph->getNrOfPasses(); c++)
+	{
+		if (graph->isCulled(c))
+			continue;
+		int colors = 0;
+		for (unsigned int resource : graph->getWrites(c))
+		{
+			unsigned int target = graph->getTarget(resource);
+			if (target == FrameGraph::NONE)
+				continue;
+			if (fbos[c] == nullptr)
+				fbos[c] = new Fbo();
+			if (graph->getTargetInfo(target).format == FrameGraph::FORMAT_DEPTH24)
+				fbos[c]->bindTexture(Fbo::MAX_ATTACHMENTS - 1, Fbo::BIND_DEPTHTEXTURE, textures[target]);
+			else
+			{
+				fbos[c]->bindTexture(colors, Fbo::BIND_COLORTEXTURE, textures[target], colors);
+				colors++;
+			}
+		}
+		if (fbos[c] && !fbos[c]->isOk())
+			std::cout << "[ERROR] Invalid FBO" << std::endl;
+	}
+	Fbo::disable();
+
+	std::cout << "Frame graph '" << graph->getName() << "': " << graph->getNrOfTargets() << " render targets, "
+		<< graph->getMemory() / 1024 << " KB (" << graph->getUnaliasedMemory() / 1024 << " KB without aliasing, "
+		<< graph->getImportedMemory() / 1024 << " KB imported)" << std::endl;
+}
+
+void freeGraph(FrameGraph *graph, vector<unsigned int> &textures, vector<Fbo *> &fbos)
+{
+	for (Fbo *f : fbos)
+		delete f;
+	fbos.clear();
+	if (!textures.empty())
+		glDeleteTextures((GLsizei)textures.size(), textures.data());
+	textures.clear();
+	delete graph;
+}
+
 void closeCallback()
 {
 	std::cout << "Requestin Exit" << std::endl;
 
+	// The scene belongs to this thread again:
+	delete simulation;
+	simulation = nullptr;
+
+	// No more xrWaitFrame() once the session ends:
+	delete framePacer;
+	framePacer = nullptr;
+	if (gpuTimers[0])
+		glDeleteQueries(GPU_TIMERS, gpuTimers);
+	if (sampleQueries[0])
+		glDeleteQueries(GPU_TIMERS, sampleQueries);
+	delete dynamicResolution;
+	dynamicResolution = nullptr;
+
     xr.endSession();
     xr.free();
 	
@@ -128,14 +425,35 @@ void closeCallback()
 	glDeleteBuffers(1, &boxVertexVbo);
 	glDeleteBuffers(1, &boxTexCoordVbo);
 	glDeleteVertexArrays(1, &globalVao);
-	for (int c = 0; c < 2; c++)
-	{
-		delete fbo[c];
-		glDeleteTextures(1, &fboTexId[c]);
-	}
+	freeGraph(desktopGraph, desktopTextures, desktopFbos);
+	freeGraph(xrGraph, xrTextures, xrFbos);
+	delete depthCopyShader;
+	delete depthCopyFs;
 	delete passthroughShader;
 	delete passthroughFs;
 	delete passthroughVs;
+	delete shaderCache;
+	delete hiz;
+	delete indirectBatch;
+	delete meshPool;
+	//the meshes destroyed below must not give their geometry back to it
+	meshPool = nullptr;
+	delete frameUbo;
+	delete stereoUbo;
+	delete lightSsbo;
+	delete clusterSsbo;
+	delete lightIndexSsbo;
+	delete clusters;
+	delete culling;
+	delete occlusion;
+	delete frameList;
+	delete hierarchy;
+	delete jobs;
+	delete frameArena;
+
+	// Meshes release their buffers, while the context is still alive:
+	registry.setRoot(nullptr);
+	scenePools.clear();
 }
 
 
@@ -200,87 +518,299 @@ void logInfo()
 	std::cout << std::endl;
 }
 
+// Mesh shaders: templates specialized by ShaderCache, which prepends the #version line and the feature #defines
 const char *vertShader = R"(
-   #version 440 core
+#ifdef MULTIVIEW
+   #extension GL_OVR_multiview2 : require
+#endif
+#ifdef INSTANCED_STEREO
+   #extension GL_ARB_shader_viewport_layer_array : enable
+   #extension GL_AMD_vertex_shader_layer : enable
+#endif
 
-   uniform mat4 projection;
-   uniform mat4 modelview;	
+#ifdef STEREO
+   #ifdef MULTIVIEW
+   layout(num_views = 2) in;
+   #endif
+
+   // Camera data of both eyes, written once per frame (see Ubo.h):
+   struct Frame
+   {
+      mat4 projection;
+      mat4 view;
+      vec4 eyePosition;
+      uvec4 clusterGrid;
+      vec4 clusterDepth;
+      uvec4 lightInfo;
+   };
+   layout(std140, binding = 1) uniform StereoFrameData
+   {
+      Frame frames[2];
+   };
+   flat out uint eye;
+   #define projection frames[eye].projection
+   #define view frames[eye].view
+#else
+   // Per-view camera data, written once per frame (see Ubo.h):
+   layout(std140, binding = 0) uniform FrameData
+   {
+      mat4 projection;
+      mat4 view;
+      vec4 eyePosition;
+      uvec4 clusterGrid;
+      vec4 clusterDepth;
+      uvec4 lightInfo;
+   };
+#endif
+
+#ifdef INDIRECT
+   // Per-draw data, indexed by the command's base instance (see IndirectBatch.h):
+   struct Draw
+   {
+      mat4 model;
+      vec4 emission;
+      vec4 ambient;
+      vec4 diffuse;
+      vec4 specular;
+      vec4 params;
+      vec4 boxMin;
+      vec4 boxMax;
+      mat4 normalMatrix;
+   };
+   layout(std430, binding = 3) readonly buffer DrawBuffer
+   {
+      Draw draws[];
+   };
+   layout(location = 3) in uint in_DrawId;
+   flat out uint drawId;
+   #define model draws[in_DrawId].model
+#else
+   uniform mat4 model;
+#endif
+
+#ifndef NORMAL_MATRIX
+   // Rigid or uniformly scaled model, the fragment shader normalizes away the scale (see Transform.h):
+   #define normalMatrix mat3(model)
+#elif defined(INDIRECT)
+   #define normalMatrix mat3(draws[in_DrawId].normalMatrix)
+#else
    uniform mat3 normalMatrix;
+#endif
 
    layout(location = 0) in vec3 in_Position;
    layout(location = 1) in vec3 in_Normal;
 	layout(location = 2) in vec2 in_TexCoord;
 
    out vec4 fragPosition;
+   out vec3 viewPosition;
    out vec3 normal;
    out float dist;
 	out vec2 texCoord; 
 
+   // Same depth in the pre-pass and in the GL_EQUAL shading pass:
+   invariant gl_Position;
+
    void main(void)
    {
-      fragPosition = modelview * vec4(in_Position, 1.0f);
-      gl_Position = projection * fragPosition;      
+      // Eye of this vertex, both are drawn by the same call:
+#if defined(MULTIVIEW)
+      eye = gl_ViewID_OVR;
+#elif defined(INSTANCED_STEREO)
+      eye = uint(gl_InstanceID) & 1u;
+      gl_Layer = int(eye);
+#endif
+
+      fragPosition = model * vec4(in_Position, 1.0f);
+      viewPosition = (view * fragPosition).xyz;
+      gl_Position = projection * vec4(viewPosition, 1.0f);
+#ifndef DEPTH_ONLY
       normal = normalMatrix * in_Normal;
 		dist = abs(gl_Position.z / 100.0f);
 		texCoord = in_TexCoord; 
+#ifdef INDIRECT
+      drawId = in_DrawId;
+#endif
+#endif
    }
 )";
 
 
 ////////////////////////////
 const char *fragShader = R"(
-   #version 440 core
-	
-   #define MAX_LIGHTS 16
-
    in vec4 fragPosition;
+   in vec3 viewPosition;
    in vec3 normal; 
 	in vec2 texCoord;  
    in float dist;   
 
    out vec4 fragOutput;
 
+#ifdef COUNT_FRAGMENTS
+   // Overdraw measurement, fragments failing the depth test must not be counted:
+   layout(early_fragment_tests) in;
+   layout(binding = 0, offset = 0) uniform atomic_uint fragmentCount;
+#endif
+
+#ifdef TEXTURED
 	// Texture mapping: 
 	layout(binding = 0) uniform sampler2D texSampler;
+#endif
+
+#ifdef STEREO
+   // Camera data of both eyes:
+   struct Frame
+   {
+      mat4 projection;
+      mat4 view;
+      vec4 eyePosition;
+      uvec4 clusterGrid;
+      vec4 clusterDepth;
+      uvec4 lightInfo;
+   };
+   layout(std140, binding = 1) uniform StereoFrameData
+   {
+      Frame frames[2];
+   };
+   flat in uint eye;
+   #define projection frames[eye].projection
+   #define view frames[eye].view
+   #define eyePosition frames[eye].eyePosition
+   #define clusterGrid frames[eye].clusterGrid
+   #define clusterDepth frames[eye].clusterDepth
+   #define lightInfo frames[eye].lightInfo
+#else
+   // Per-view camera data:
+   layout(std140, binding = 0) uniform FrameData
+   {
+      mat4 projection;
+      mat4 view;
+      vec4 eyePosition;
+      uvec4 clusterGrid;   // clusters along x, y, z, first cluster of this view
+      vec4 clusterDepth;   // near, far, slice scale, slice bias
+      uvec4 lightInfo;     // global lights, total lights
+   };
+#endif
 
    // Material properties:
+#ifdef INDIRECT
+   struct Draw
+   {
+      mat4 model;
+      vec4 emission;
+      vec4 ambient;
+      vec4 diffuse;
+      vec4 specular;
+      vec4 params;
+      vec4 boxMin;
+      vec4 boxMax;
+      mat4 normalMatrix;
+   };
+   layout(std430, binding = 3) readonly buffer DrawBuffer
+   {
+      Draw draws[];
+   };
+   flat in uint drawId;
+   #define matEmission draws[drawId].emission
+   #define matAmbient draws[drawId].ambient
+   #define matDiffuse draws[drawId].diffuse
+   #define matSpecular draws[drawId].specular
+   #define matShininess draws[drawId].params.x
+#else
    uniform vec4 matEmission;
    uniform vec4 matAmbient;
    uniform vec4 matDiffuse;
    uniform vec4 matSpecular;
    uniform float matShininess;
+#endif
+
+   // Light properties, written once per frame (world coordinates, see Clusters.h):
+   struct Light
+   {
+      vec4 position;
+      vec4 ambient;
+      vec4 diffuse;
+      vec4 specular;
+      vec4 range;
+   };
+   layout(std430, binding = 0) readonly buffer LightBuffer
+   {
+      Light lights[];
+   };
+#ifndef DIRECTIONAL_ONLY
+   layout(std430, binding = 1) readonly buffer ClusterBuffer
+   {
+      uvec2 clusters[];
+   };
+   layout(std430, binding = 2) readonly buffer LightIndexBuffer
+   {
+      uint lightIndices[];
+   };
+#endif
+
+   vec3 _normal;
+   vec3 viewDirection;
+
+   vec4 shade(Light light)
+   {
+      // Diffuse term (w = 0 for directional lights):
+      vec3 lightVector = light.position.xyz - fragPosition.xyz * light.position.w;
+      vec3 lightDirection = normalize(lightVector);
+      float nDotL = dot(lightDirection, _normal);
+      if (nDotL <= 0.0f)
+         return vec4(0.0f);
+
+      // Fade out towards the influence radius, so that clusters do not show:
+      float attenuation = 1.0f;
+      if (light.range.x > 0.0f)
+      {
+         float d = length(lightVector) / light.range.x;
+         attenuation = clamp(1.0f - d * d * d * d, 0.0f, 1.0f);
+         attenuation *= attenuation;
+      }
+
+      vec4 color = matDiffuse * nDotL * light.diffuse;
 
-   // Light properties:
-   uniform int lightNumber;
-   uniform vec3 arrLightPosition[MAX_LIGHTS];
-   uniform vec4 arrLightAmbient[MAX_LIGHTS];
-   uniform vec4 arrLightDiffuse[MAX_LIGHTS];
-   uniform vec4 arrLightSpecular[MAX_LIGHTS];
+      // Specular term:
+      vec3 halfVector = normalize(lightDirection + viewDirection);
+      float nDotHV = dot(_normal, halfVector);
+      color += matSpecular * pow(nDotHV, matShininess) * light.specular;
+      return color * attenuation;
+   }
 
    void main(void)
    {      
+#ifdef COUNT_FRAGMENTS
+      atomicCounterIncrement(fragmentCount);
+#endif
+
 		// Texture element: 
+#ifdef TEXTURED
 		vec4 texel = texture(texSampler, texCoord); 
+#else
+		vec4 texel = vec4(1.0f);
+#endif
 
       // Ambient term:
-      vec4 fragColor = matEmission + matAmbient * arrLightAmbient[0];
+      vec4 fragColor = matEmission;
+      if (lightInfo.y > 0u)
+         fragColor += matAmbient * lights[0].ambient;
 		
-	  vec3 _normal = normalize(normal);
-	  for(int i = 0; i < lightNumber; i++) 
-	  {
-		  // Diffuse term:
-		  vec3 lightDirection = normalize(arrLightPosition[i] - fragPosition.xyz);      
-		  float nDotL = dot(lightDirection, _normal);   
-		  if (nDotL > 0.0f)
-		  {
-			 fragColor += matDiffuse * nDotL * arrLightDiffuse[i];
-      
-			 // Specular term:
-			 vec3 halfVector = normalize(lightDirection + normalize(-fragPosition.xyz));                     
-			 float nDotHV = dot(_normal, halfVector);         
-			 fragColor += matSpecular * pow(nDotHV, matShininess) * arrLightSpecular[i];
-		  } 
-      }
+	  _normal = normalize(normal);
+	  viewDirection = normalize(eyePosition.xyz - fragPosition.xyz);
+
+      // Lights reaching the whole scene (unrolled up to the variant's light bucket, see ShaderCache.cpp):
+      SHADE_GLOBAL_LIGHTS
+
+#ifndef DIRECTIONAL_ONLY
+      // Lights of this fragment's cluster:
+      vec4 clip = projection * vec4(viewPosition, 1.0f);
+      uvec3 tile;
+      tile.xy = uvec2(clamp((clip.xy / clip.w * 0.5f + 0.5f) * vec2(clusterGrid.xy), vec2(0.0f), vec2(clusterGrid.xy - 1u)));
+      tile.z = uint(clamp(log(-viewPosition.z) * clusterDepth.z - clusterDepth.w, 0.0f, float(clusterGrid.z - 1u)));
+      uvec2 cluster = clusters[clusterGrid.w + tile.x + clusterGrid.x * (tile.y + clusterGrid.y * tile.z)];
+      for (uint i = 0u; i < cluster.y; i++)
+         fragColor += shade(lights[lightIndices[cluster.x + i]]);
+#endif
      
       // Final color:
 		fragOutput = texel * vec4(fragColor.xyz, 1.0f);
@@ -331,41 +861,72 @@ const char *passthroughFragShader = R"(
    }
 )";
 
+const char *depthCopyFragShader = R"(
+   #version 440 core
 
+   in vec2 texCoord;
 
-void Engine::initShaders()
-{
-	// Compile vertex shader:
-	vs = new Shader();
-	vs->loadFromMemory(Shader::TYPE_VERTEX, vertShader);
-
-	// Compile fragment shader:
-	fs = new Shader();
-	fs->loadFromMemory(Shader::TYPE_FRAGMENT, fragShader);
+   // Size of the source area, in texels:
+   uniform float sourceWidth;
+   uniform float sourceHeight;
 
-	pr = new Program{ vs, fs };
+   layout(binding = 0) uniform sampler2D depthSampler;
 
-	pr->build();
-	pr->render();
-	pr->bindLayoutLocation(0, "in_Position");
-	pr->bindLayoutLocation(1, "in_Normal");
-	pr->bindLayoutLocation(2, "in_TexCoord");
+   void main(void)
+   {
+      // Nearest texel, depths are not filtered:
+      gl_FragDepth = texelFetch(depthSampler, ivec2(texCoord * vec2(sourceWidth, sourceHeight)), 0).r;
+   }
+)";
 
-	pr->bindLocation(Location::PROJECTION_MATRIX, "projection");
-	pr->bindLocation(Location::MODLVIEW_MATRIX, "modelview");
-	pr->bindLocation(Location::NORMAL_MATRIX, "normalMatrix");
 
-	pr->bindLocation(Location::MATERIAL_AMBIENT, "matAmbient");
-	pr->bindLocation(Location::MATERIAL_EMISSIVE, "matEmission");
-	pr->bindLocation(Location::MATERIAL_DIFFUSE, "matDiffuse");
-	pr->bindLocation(Location::MATERIAL_SPECULAR, "matSpecular");
-	pr->bindLocation(Location::MATERIAL_SHININESS, "matShininess");
 
-	pr->bindLocation(Location::LIGHT_TOTAL, "lightNumber");
-	pr->bindLocation(Location::LIGHT_ARRAY_POSITION, "arrLightPosition");
-	pr->bindLocation(Location::LIGHT_ARRAY_DIFFUSE, "arrLightDiffuse");
-	pr->bindLocation(Location::LIGHT_ARRAY_SPECULAR, "arrLightSpecular");
-	pr->bindLocation(Location::LIGHT_ARRAY_AMBIENT, "arrLightAmbient");
+void Engine::initShaders()
+{
+	// Mesh shader variants, compiled on first use:
+	shaderCache = new ShaderCache(vertShader, fragShader);
+	shaderCache->bindLocation(Location::MODEL_MATRIX, "model");
+	shaderCache->bindLocation(Location::NORMAL_MATRIX, "normalMatrix");
+
+	shaderCache->bindLocation(Location::MATERIAL_AMBIENT, "matAmbient");
+	shaderCache->bindLocation(Location::MATERIAL_EMISSIVE, "matEmission");
+	shaderCache->bindLocation(Location::MATERIAL_DIFFUSE, "matDiffuse");
+	shaderCache->bindLocation(Location::MATERIAL_SPECULAR, "matSpecular");
+	shaderCache->bindLocation(Location::MATERIAL_SHININESS, "matShininess");
+
+	// Default variant (untextured, no lights), so that getProgram() is valid before the first frame:
+	if (shaderCache->render(ShaderCache::getLightKey(0, 0)) == nullptr)
+		std::cout << "[ERROR] Unable to build the default shader variant" << std::endl;
+	shaderCache->finish();
+
+	// Geometry shared by the meshes, filled while loading:
+	meshPool = new MeshPool();
+	indirectBatch = new IndirectBatch(meshPool);
+	hiz = new HiZ();
+	if (!hiz->init())
+		std::cout << "[ERROR] Unable to build the Hi-Z shaders" << std::endl;
+
+	// Uniform blocks (bindings are fixed in the shaders):
+	frameUbo = new Ubo(sizeof(FrameBlock), EYE_LAST);
+	stereoUbo = new Ubo(sizeof(FrameBlock) * EYE_LAST);
+
+	// Frame data:
+	frameArena = new FrameArena(64 * 1024);
+	frameList = new List();
+	jobs = new JobSystem(0);
+	hierarchy = new Hierarchy();
+	hierarchy->setJobSystem(jobs);
+
+	// Light buffers (bindings are fixed in the shaders):
+	clusters = new Clusters(EYE_LAST);
+	clusters->setJobSystem(jobs);
+	culling = new Culling();
+	culling->setJobSystem(jobs);
+	occlusion = new Occlusion();
+	occlusion->setJobSystem(jobs);
+	lightSsbo = new Ssbo();
+	clusterSsbo = new Ssbo();
+	lightIndexSsbo = new Ssbo();
 
 
 	passthroughVs = new Shader();
@@ -385,11 +946,44 @@ void Engine::initShaders()
 	passthroughShader->bindLocation(Location::PROJECTION_MATRIX, "projection");
 	passthroughShader->bindLocation(Location::MODLVIEW_MATRIX, "modelview");
 	passthroughShader->bindLocation(Location::COLOR, "color");
+
+	depthCopyFs = new Shader();
+	depthCopyFs->loadFromMemory(Shader::TYPE_FRAGMENT, depthCopyFragShader);
+
+	depthCopyShader = new Program{ passthroughVs, depthCopyFs };
+	depthCopyShader->build();
+	depthCopyShader->render();
+	depthCopyShader->bindLayoutLocation(0, "in_Position");
+	depthCopyShader->bindLayoutLocation(2, "in_TexCoord");
+	depthCopyShader->bindLocation(Location::PROJECTION_MATRIX, "projection");
+	depthCopyShader->bindLocation(Location::MODLVIEW_MATRIX, "modelview");
+	depthCopyShader->bindLocation(Location::SOURCE_WIDTH, "sourceWidth");
+	depthCopyShader->bindLocation(Location::SOURCE_HEIGHT, "sourceHeight");
 }
 
 Program LIB_API * Engine::getProgram()
 {
-	return pr;
+	return shaderCache->getCurrent();
+}
+
+ShaderCache LIB_API * Engine::getShaderCache()
+{
+	return shaderCache;
+}
+
+MeshPool LIB_API * Engine::getMeshPool()
+{
+	return meshPool;
+}
+
+IndirectBatch LIB_API * Engine::getIndirectBatch()
+{
+	return indirectBatch;
+}
+
+HiZ LIB_API * Engine::getHiZ()
+{
+	return hiz;
 }
 
 Shader LIB_API  * Engine::getShader()
@@ -397,34 +991,307 @@ Shader LIB_API  * Engine::getShader()
 	return program;
 }
 
-void loadFboAndItsTexture() {
-	// Load FBO and its texture:
+Ubo LIB_API * Engine::getFrameUbo()
+{
+	return frameUbo;
+}
+
+Clusters LIB_API * Engine::getClusters()
+{
+	return clusters;
+}
+
+Culling LIB_API * Engine::getCulling()
+{
+	return culling;
+}
+
+JobSystem LIB_API * Engine::getJobSystem()
+{
+	return jobs;
+}
+
+FrameArena LIB_API * Engine::getFrameArena()
+{
+	return frameArena;
+}
+
+Occlusion LIB_API * Engine::getOcclusion()
+{
+	return occlusion;
+}
+
+void LIB_API Engine::loadFrames(List* list, FrameBlock* frames, int count)
+{
+	auto start = std::chrono::high_resolution_clock::now();
+	list->loadLights(*clusters);
+	glm::mat4 viewProj[Culling::MAX_VIEWS];
+	for (int c = 0; c < count; c++)
+	{
+		clusters->build(c, frames[c]);
+		frameUbo->update(&frames[c], c);
+		viewProj[c] = frames[c].projection * frames[c].view;
+	}
+	if (stereoMode != STEREO_OFF && count == EYE_LAST)
+		stereoUbo->update(frames);
+
+	glm::vec3 eye(0.0f);
+	for (int c = 0; c < count; c++)
+		eye += glm::vec3(frames[c].eyePosition) / (float)count;
+	list->sortQueue(depthMode == DEPTH_FRONT_TO_BACK, eye);
+	list->loadBounds(*culling);
+	culling->cull(viewProj, count);
+	hiz->begin(viewProj, count);
+	if (occlusionCulling)
+	{
+		occlusion->begin(viewProj, count);
+		list->cullOccluded(*occlusion, *culling);
+	}
+
+	// Everything the views share, the per-view passes only consume it:
+	list->preparePacket(*culling, *clusters);
+	prepareTime += std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::high_resolution_clock::now() - start).count();
+
+	lightSsbo->update(clusters->getLights().data(), (unsigned int)(clusters->getLights().size() * sizeof(LightData)));
+	clusterSsbo->update(clusters->getGrid().data(), (unsigned int)(clusters->getGrid().size() * sizeof(glm::uvec2)));
+	lightIndexSsbo->update(clusters->getIndices().data(), (unsigned int)(clusters->getIndices().size() * sizeof(unsigned int)));
+	lightSsbo->render(Ssbo::BINDING_LIGHTS);
+	clusterSsbo->render(Ssbo::BINDING_CLUSTERS);
+	lightIndexSsbo->render(Ssbo::BINDING_LIGHT_INDICES);
+}
+
+void loadDesktopGraph() {
 	GLint prevViewport[4];
 	glGetIntegerv(GL_VIEWPORT, prevViewport);
 
+	// Each eye renders into half of the window, then both are composited:
+	desktopGraph = new FrameGraph("desktop");
+	unsigned int window = desktopGraph->importTexture("window", APP_WINDOWSIZEX, APP_WINDOWSIZEY, FrameGraph::FORMAT_RGBA8);
 	for (int c = 0; c < EYE_LAST; c++)
 	{
-		int fboSizeX = APP_WINDOWSIZEX;
-		int fboSizeY = APP_WINDOWSIZEY;
-		glGenTextures(1, &fboTexId[c]);
-		glBindTexture(GL_TEXTURE_2D, fboTexId[c]);
-		glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, fboSizeX, fboSizeY, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
-		glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-		glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-
-		fbo[c] = new Fbo();
-		fbo[c]->bindTexture(0, Fbo::BIND_COLORTEXTURE, fboTexId[c]);
-		fbo[c]->bindRenderBuffer(1, Fbo::BIND_DEPTHBUFFER, fboSizeX, fboSizeY);
-		if (!fbo[c]->isOk())
-			std::cout << "[ERROR] Invalid FBO" << std::endl;
+		eyeColor[c] = desktopGraph->createTexture(c == EYE_LEFT ? "left color" : "right color", APP_FBOSIZEX, APP_FBOSIZEY, FrameGraph::FORMAT_RGBA8);
+		unsigned int depth = desktopGraph->createTexture(c == EYE_LEFT ? "left depth" : "right depth", APP_FBOSIZEX, APP_FBOSIZEY, FrameGraph::FORMAT_DEPTH24);
+		unsigned int pass = desktopGraph->addPass(c == EYE_LEFT ? "left eye" : "right eye", [c](unsigned int pass)
+		{
+			// Render into this FBO:
+			desktopFbos[pass]->render();
+
+			// Clear the FBO content:
+			glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+			// 3D rendering:
+			frameUbo->render(Ubo::BINDING_FRAME, c);
+			auto start = std::chrono::high_resolution_clock::now();
+			drawCalls += graphList->renderNodes(c);
+			submitTime += std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::high_resolution_clock::now() - start).count();
+		});
+		desktopGraph->write(pass, eyeColor[c]);
+		desktopGraph->write(pass, depth);
 	}
-	Fbo::disable();
+	unsigned int composite = desktopGraph->addPass("composite", [](unsigned int)
+	{
+		// Done with the FBOs, go back to rendering into the window context buffers:
+		Fbo::disable();
+		glViewport(0, 0, windowViewport[2], windowViewport[3]);
+
+		// Set a matrix for the left "eye":    
+		glm::mat4 f = glm::mat4(1.0f);
+		ortho = glm::ortho(0.0f, (float)APP_WINDOWSIZEX, 0.0f, (float)APP_WINDOWSIZEY, -1.0f, 1.0f);
+		// Setup the passthrough shader:
+		passthroughShader->render();
+		passthroughShader->setMatrix(Location::PROJECTION_MATRIX, ortho);
+		passthroughShader->setMatrix(Location::MODLVIEW_MATRIX, f);
+		passthroughShader->setVertex(Location::COLOR, glm::vec4(1.0f, 0.0f, 0.0f, 0.0f));
+
+		glBindVertexArray(globalVao);
+		glBindBuffer(GL_ARRAY_BUFFER, boxVertexVbo);
+		glVertexAttribPointer((GLuint)0, 2, GL_FLOAT, GL_FALSE, 0, nullptr);
+		glEnableVertexAttribArray(0);
+
+		glDisableVertexAttribArray(1); // We don't need normals for the 2D quad
+
+		glBindBuffer(GL_ARRAY_BUFFER, boxTexCoordVbo);
+		glVertexAttribPointer((GLuint)2, 2, GL_FLOAT, GL_FALSE, 0, nullptr);
+		glEnableVertexAttribArray(2);
+
+		// Bind the FBO buffer as texture and render:
+		glBindTexture(GL_TEXTURE_2D, desktopTextures[desktopGraph->getTarget(eyeColor[EYE_LEFT])]);
+		glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+
+		// Do the same for the right "eye": 
+		f = glm::translate(glm::mat4(1.0f), glm::vec3(APP_WINDOWSIZEX / 2, 0.0f, 0.0f));
+		passthroughShader->setMatrix(Location::MODLVIEW_MATRIX, f);
+		passthroughShader->setVertex(Location::COLOR, glm::vec4(0.0f, .0f, 1.0f, 0.0f));
+		glBindTexture(GL_TEXTURE_2D, desktopTextures[desktopGraph->getTarget(eyeColor[EYE_RIGHT])]);
+		glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+	});
+	desktopGraph->read(composite, eyeColor[EYE_LEFT]);
+	desktopGraph->read(composite, eyeColor[EYE_RIGHT]);
+	desktopGraph->write(composite, window);
+
+	if (desktopGraph->compile())
+		realizeGraph(desktopGraph, desktopTextures, desktopFbos);
 	glViewport(0, 0, prevViewport[2], prevViewport[3]);
 	glClearColor(1.0f, 1.0f, 1.0f, 1.0f);
 }
 
+/**
+ * Writes the lower left width x height texels of a depth texture over the whole viewport, with a full-screen quad:
+ * unlike a blit, it works whatever the depth format of the target.
+ */
+void copyDepth(GLuint texture, unsigned int width, unsigned int height)
+{
+	depthCopyShader->render();
+	depthCopyShader->setMatrix(Location::PROJECTION_MATRIX, glm::ortho(0.0f, (float)APP_FBOSIZEX, 0.0f, (float)APP_FBOSIZEY, -1.0f, 1.0f));
+	depthCopyShader->setMatrix(Location::MODLVIEW_MATRIX, glm::mat4(1.0f));
+	depthCopyShader->setFloat(Location::SOURCE_WIDTH, (float)width);
+	depthCopyShader->setFloat(Location::SOURCE_HEIGHT, (float)height);
+
+	glBindVertexArray(globalVao);
+	glBindBuffer(GL_ARRAY_BUFFER, boxVertexVbo);
+	glVertexAttribPointer((GLuint)0, 2, GL_FLOAT, GL_FALSE, 0, nullptr);
+	glEnableVertexAttribArray(0);
+	glDisableVertexAttribArray(1);
+	glBindBuffer(GL_ARRAY_BUFFER, boxTexCoordVbo);
+	glVertexAttribPointer((GLuint)2, 2, GL_FLOAT, GL_FALSE, 0, nullptr);
+	glEnableVertexAttribArray(2);
+
+	glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+	glDepthFunc(GL_ALWAYS);
+	glActiveTexture(GL_TEXTURE0);
+	glBindTexture(GL_TEXTURE_2D, texture);
+	glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+	glDepthFunc(GL_LESS);
+	glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+}
+
+void loadXrGraph() {
+	int sizeX = xr.getSwapchainWidth();
+	int sizeY = xr.getSwapchainHeight();
+
+	// Swapchain images and the depth buffers (depth swapchains when the runtime takes depth layers) are owned by the OpenXR renderer:
+	xrGraph = new FrameGraph(stereoMode == Engine::STEREO_OFF ? "openxr" : "openxr stereo");
+	unsigned int depth = xrGraph->importTexture("depth", sizeX, sizeY * (stereoMode == Engine::STEREO_OFF ? 1 : OvXR::EYE_LAST), FrameGraph::FORMAT_DEPTH24);
+
+	// Both eyes at once, into the layers of a single swapchain:
+	if (stereoMode != Engine::STEREO_OFF)
+	{
+		unsigned int swapchain = xrGraph->importTexture("stereo swapchain", sizeX, sizeY * OvXR::EYE_LAST, FrameGraph::FORMAT_RGBA8);
+		unsigned int pass = xrGraph->addPass("stereo", [](unsigned int)
+		{
+			// Nothing acquired, nothing to render into or to release:
+			if (!xr.lockStereoSwapchain())
+				return;
+
+			glViewport(0, 0, xr.getRenderWidth(), xr.getRenderHeight());
+			glClearColor(0, 0, 0, 1);
+			glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+			stereoUbo->render(Ubo::BINDING_STEREO);
+			auto start = std::chrono::high_resolution_clock::now();
+			drawCalls += graphList->renderStereo();
+			submitTime += std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::high_resolution_clock::now() - start).count();
+
+			xr.unlockStereoSwapchain();
+		});
+		xrGraph->write(pass, swapchain);
+		xrGraph->write(pass, depth);
+	}
+	else
+		for (int i = 0; i < OvXR::EYE_LAST; i++)
+		{
+			// Foveated, the periphery goes first into its own smaller targets:
+			unsigned int periphery = FrameGraph::NONE;
+			unsigned int peripheryDepth = FrameGraph::NONE;
+			if (foveated)
+			{
+				unsigned int peripheryX = (unsigned int)ceil(sizeX * foveation[i].getScale());
+				unsigned int peripheryY = (unsigned int)ceil(sizeY * foveation[i].getScale());
+				periphery = xrGraph->createTexture(i == OvXR::EYE_LEFT ? "left periphery" : "right periphery", peripheryX, peripheryY, FrameGraph::FORMAT_RGBA8);
+				peripheryDepth = xrGraph->createTexture(i == OvXR::EYE_LEFT ? "left periphery depth" : "right periphery depth", peripheryX, peripheryY, FrameGraph::FORMAT_DEPTH24);
+				peripheryPass[i] = xrGraph->addPass(i == OvXR::EYE_LEFT ? "left periphery" : "right periphery", [i](unsigned int pass)
+				{
+					const Foveation &f = foveation[i];
+					xrFbos[pass]->render();
+
+					glViewport(0, 0, f.getPeripheryWidth(), f.getPeripheryHeight());
+					glClearColor(0, 0, 0, 1);
+					glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+					// Nothing to shade under the inset, a depth of 0 rejects it before the fragment shader:
+					const Foveation::Rect &hole = f.getHole();
+					if (hole.width > 0)
+					{
+						glEnable(GL_SCISSOR_TEST);
+						glScissor(hole.x, hole.y, hole.width, hole.height);
+						glClearDepth(0.0);
+						glClear(GL_DEPTH_BUFFER_BIT);
+						glClearDepth(1.0);
+						glDisable(GL_SCISSOR_TEST);
+					}
+
+					frameUbo->render(Ubo::BINDING_FRAME, i);
+					auto start = std::chrono::high_resolution_clock::now();
+					drawCalls += graphList->renderNodes(i);
+					submitTime += std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::high_resolution_clock::now() - start).count();
+				});
+				xrGraph->write(peripheryPass[i], periphery);
+				xrGraph->write(peripheryPass[i], peripheryDepth);
+			}
+
+			unsigned int swapchain = xrGraph->importTexture(i == OvXR::EYE_LEFT ? "left swapchain" : "right swapchain", sizeX, sizeY, FrameGraph::FORMAT_RGBA8);
+			unsigned int pass = xrGraph->addPass(i == OvXR::EYE_LEFT ? "left eye" : "right eye", [i, peripheryDepth](unsigned int)
+			{
+				OvXR::OvEye e = (OvXR::OvEye) i;
+
+				if (!xr.lockSwapchain(e))
+					return;
+
+				glViewport(0, 0, xr.getRenderWidth(), xr.getRenderHeight());
+				glClearColor(0, 0, 0, 1);
+				if (foveated)
+				{
+					// Periphery upscaled over the whole eye (its depth too, for the depth layers), then the inset on top:
+					const Foveation &f = foveation[i];
+					GLint target = 0;
+					glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &target);
+					glBindFramebuffer(GL_READ_FRAMEBUFFER, xrFbos[peripheryPass[i]]->getHandle());
+					glBlitFramebuffer(0, 0, f.getPeripheryWidth(), f.getPeripheryHeight(), 0, 0, xr.getRenderWidth(), xr.getRenderHeight(), GL_COLOR_BUFFER_BIT, GL_LINEAR);
+					glBindFramebuffer(GL_READ_FRAMEBUFFER, target);
+
+					// The depth swapchain format is picked by the runtime, a depth blit would need it to match the periphery's:
+					if (xr.hasDepthLayers())
+						copyDepth(xrTextures[xrGraph->getTarget(peripheryDepth)], f.getPeripheryWidth(), f.getPeripheryHeight());
+
+					const Foveation::Rect &inset = f.getInset();
+					glEnable(GL_SCISSOR_TEST);
+					glScissor(inset.x, inset.y, inset.width, inset.height);
+				}
+				glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+				frameUbo->render(Ubo::BINDING_FRAME, i);
+				auto start = std::chrono::high_resolution_clock::now();
+				drawCalls += graphList->renderNodes(i);
+				submitTime += std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::high_resolution_clock::now() - start).count();
+
+				if (foveated)
+					glDisable(GL_SCISSOR_TEST);
+				xr.unlockSwapchain(e);
+			});
+			if (periphery != FrameGraph::NONE)
+			{
+				xrGraph->read(pass, periphery);
+				xrGraph->read(pass, peripheryDepth);
+			}
+			xrGraph->write(pass, swapchain);
+			xrGraph->write(pass, depth);
+		}
+
+	// The swapchains are imported, only the periphery targets (if any) are allocated:
+	if (xrGraph->compile())
+		realizeGraph(xrGraph, xrTextures, xrFbos);
+}
+
 void setUpBox() {
 	////////////////////////////
 	// Build passthrough shader:
@@ -523,7 +1390,7 @@ void LIB_API Engine::init(int argc, char *argv[], string title)
 	glEnable(GL_DEBUG_OUTPUT_SYNCHRONOUS);
 #endif // _DEBUG
 
-	loadFboAndItsTexture();
+	loadDesktopGraph();
 	setUpBox();
 }
 
@@ -532,9 +1399,69 @@ Node LIB_API * Engine::load(string scene)
 	OvoReader ovoReader = {};
 	char * sceneChar = new char[scene.length() + 1];
 	strcpy(sceneChar, scene.c_str());
-	Node* res = ovoReader.readOVOfile(sceneChar);
+	Node* res = ovoReader.readOVOfile(sceneChar, &registry);
 	return res;
 }
+
+Node LIB_API * Engine::find(int id)
+{
+	return registry.find(id);
+}
+
+Node LIB_API * Engine::find(const string &name)
+{
+	return registry.find(name);
+}
+
+Registry LIB_API * Engine::getRegistry()
+{
+	return &registry;
+}
+
+Node LIB_API * Engine::createNode()
+{
+	return scenePools.createNode();
+}
+
+Mesh LIB_API * Engine::createMesh()
+{
+	return scenePools.createMesh();
+}
+
+Light LIB_API * Engine::createLight()
+{
+	return scenePools.createLight();
+}
+
+Camera LIB_API * Engine::createCamera()
+{
+	return scenePools.createCamera();
+}
+
+bool LIB_API Engine::destroyNode(Node *node)
+{
+	//the snapshots still being rendered point to the nodes, their slots cannot be reused until the simulation stops
+	if (simulation != nullptr && simulation->isRunning())
+	{
+		std::cout << "[ERROR] Cannot destroy nodes while the simulation runs" << std::endl;
+		return false;
+	}
+
+	//the active camera must outlive the frames rendered with it
+	for (Node *n = active; n != nullptr; n = n->getParent())
+		if (n == node)
+		{
+			std::cout << "[ERROR] Cannot destroy the active camera" << std::endl;
+			return false;
+		}
+
+	if (!scenePools.destroy(node))
+	{
+		std::cout << "[ERROR] Node not created by the engine" << std::endl;
+		return false;
+	}
+	return true;
+}
 void LIB_API Engine::clear()
 {
 	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
@@ -547,118 +1474,137 @@ void LIB_API Engine::clear()
 void LIB_API Engine::swap()
 {
 	glutSwapBuffers();
+	frameArena->nextFrame();
 }
 
 
 
-//fills the list recoursively iterating the tree
-void fillListRecursive(List* list, Node* node, glm::mat4 parent)
+//empties the list and fills it with the tree under "node", in depth-first order
+void fillList(List* list, Node* node)
 {
-	glm::mat4 f = parent * node->getPosMatrix();
-	list->addNode(node, f);
-
-	for (Node* child : node->getChildren())
+	//while the simulation runs the scene graph is not ours, only its snapshots are
+	if (simulation != nullptr && simulation->isRunning())
 	{
-		fillListRecursive(list, child, f);
+		frameSnapshot = simulation->acquire();
+		if (frameSnapshot == nullptr)
+		{
+			list->clear();
+			return;
+		}
+		unsigned int index = frameSnapshot->find(node);
+		if (index == Snapshot::NOT_FOUND)
+		{
+			if (missingNode != node)
+				std::cout << "[ERROR] The node is not part of the simulated scene" << std::endl;
+			missingNode = node;
+			list->clear();
+			return;
+		}
+		list->fill(frameSnapshot, index);
+		return;
 	}
+	frameSnapshot = nullptr;
+
+	list->clear();
+	if (!hierarchy->isBuilt(node))
+		hierarchy->build(node);
+
+	//if not rendering a root node, start from the "parent" final matrix so the node will be rendered in the correct absolute position
+	hierarchy->update(node->getParent() == nullptr ? glm::mat4(1) : node->getParent()->getFinal());
+	const glm::mat4 *world = hierarchy->getWorld();
+	for (unsigned int i = 0; i < hierarchy->getCount(); i++)
+		list->addNode(hierarchy->getNode(i), world[i]);
 }
 
 List LIB_API * Engine::createList(Node* node)
 {
 	List* list = new List();
-	if (node->getParent() == nullptr)
-		fillListRecursive(list, node, glm::mat4(1));
-	//if not rendering a root node, pass the "parent" final matrix so the node will be rendered in the correct absolute position
-	else
-		fillListRecursive(list, node, node->getParent()->getFinal());
+	fillList(list, node);
 	return list;
 }
 
 
-//fills the rendering list, renders and return the list
+//fills the engine's frame list, renders and return the list
 List LIB_API * Engine::renderScene(Node* node)
 {
-	List* list =createList(node);
-	renderScene(list);
-	return list;
+	fillList(frameList, node);
+	renderScene(frameList);
+	return frameList;
 }
 
 //renders the list
 void LIB_API Engine::renderScene(List* list)
 {
+	// Store the current viewport size, restored by the composite pass:
+	glGetIntegerv(GL_VIEWPORT, windowViewport);
 
-	pr->render();
-
-	// Store the current viewport size:
-	GLint prevViewport[4];
-	glGetIntegerv(GL_VIEWPORT, prevViewport);
-
-	// Render to each eye: 
-	
-	for (int c = 0; c < EYE_LAST; c++)
+	// Per-frame data, same camera for both eyes. While the simulation owns the scene the camera comes from the
+	// snapshot: a camera just switched to is not in it yet, the previous one is kept until it is.
+	FrameBlock frameData[EYE_LAST];
+	if (simulation != nullptr && simulation->isRunning())
 	{
-		// Render into this FBO:
-		fbo[c]->render();
-
-		// Clear the FBO content:
-		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-
-		// 3D rendering:
-		list->renderWithCamera(active->getInverse());
-
-		bool capture = false;
-		if (capture)
+		const Snapshot::CameraState *camera = frameSnapshot != nullptr ? frameSnapshot->findCamera(active) : nullptr;
+		if (camera != nullptr)
 		{
-			unsigned char* imageData = (unsigned char *)malloc((int)( APP_WINDOWSIZEX * APP_WINDOWSIZEY * (3)));
-			screenshot_ppm("out.ppm", APP_WINDOWSIZEX, APP_WINDOWSIZEY, (GLubyte **)&imageData);
-		
+			frameCamera = *camera;
+			frameCameraValid = true;
+		}
+		if (!frameCameraValid)
+			return;
+		for (int c = 0; c < EYE_LAST; c++)
+		{
+			frameData[c].projection = frameCamera.projection;
+			frameData[c].view = frameCamera.view;
+			frameData[c].eyePosition = frameCamera.world[3];
 		}
-		
 	}
-	
-	// Done with the FBO, go back to rendering into the window context buffers:
-	Fbo::disable();
-	glViewport(0, 0, prevViewport[2], prevViewport[3]);
-
-	////////////////
-	// 2D rendering:
-
-	// Set a matrix for the left "eye":    
-	glm::mat4 f = glm::mat4(1.0f);
-	ortho= glm::ortho(0.0f, (float)APP_WINDOWSIZEX, 0.0f, (float)APP_WINDOWSIZEY, -1.0f, 1.0f);
-	// Setup the passthrough shader:
-	passthroughShader->render();
-	passthroughShader->setMatrix(Location::PROJECTION_MATRIX, ortho);
-	passthroughShader->setMatrix(Location::MODLVIEW_MATRIX, f);
-	passthroughShader->setVertex(Location::COLOR, glm::vec4(1.0f, 0.0f, 0.0f, 0.0f));
-
-	glBindVertexArray(globalVao);
-	glBindBuffer(GL_ARRAY_BUFFER, boxVertexVbo);
-	glVertexAttribPointer((GLuint) 0, 2, GL_FLOAT, GL_FALSE, 0, nullptr);
-	glEnableVertexAttribArray(0);
-
-	glDisableVertexAttribArray(1); // We don't need normals for the 2D quad
-
-	glBindBuffer(GL_ARRAY_BUFFER, boxTexCoordVbo);
-	glVertexAttribPointer((GLuint) 2, 2, GL_FLOAT, GL_FALSE, 0, nullptr);
-	glEnableVertexAttribArray(2);
-
-	// Bind the FBO buffer as texture and render:
-	glBindTexture(GL_TEXTURE_2D, fboTexId[EYE_LEFT]);
-	glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+	else
+		for (int c = 0; c < EYE_LAST; c++)
+		{
+			frameData[c].projection = active->getProjMatrix();
+			frameData[c].view = active->getInverse();
+			frameData[c].eyePosition = active->getFinal()[3];
+		}
+	loadFrames(list, frameData, EYE_LAST);
 
-	// Do the same for the right "eye": 
-	f = glm::translate(glm::mat4(1.0f), glm::vec3(APP_WINDOWSIZEX / 2, 0.0f, 0.0f));
-	passthroughShader->setMatrix(Location::MODLVIEW_MATRIX, f);
-	passthroughShader->setVertex(Location::COLOR, glm::vec4(0.0f, .0f, 1.0f, 0.0f));
-	glBindTexture(GL_TEXTURE_2D, fboTexId[EYE_RIGHT]);
-	glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+	// Render both eyes and composite them into the window:
+	graphList = list;
+	desktopGraph->execute();
+	graphList = nullptr;
 
+	measureOverdraw((unsigned long long)APP_FBOSIZEX * APP_FBOSIZEY * EYE_LAST);
 	frames++;
 }
 void LIB_API Engine::setActiveCamera(Camera* camera)
 {
 	active = camera;
+	if (simulation != nullptr)
+		simulation->setCamera(camera);
+}
+
+void LIB_API Engine::startSimulation(Node* root, void(*update)(double), double rate)
+{
+	if (simulation == nullptr)
+		simulation = new Simulation();
+	simulation->setCamera(active);
+	frameCameraValid = false;
+	missingNode = nullptr;
+	simulation->start(root, update != nullptr ? Simulation::Update(update) : Simulation::Update(), rate);
+}
+
+void LIB_API Engine::stopSimulation()
+{
+	if (simulation != nullptr)
+		simulation->stop();
+	frameSnapshot = nullptr;
+}
+
+void LIB_API Engine::post(const std::function<void()> &event)
+{
+	if (simulation != nullptr && simulation->isRunning())
+		simulation->post(event);
+	else
+		event();
 }
 
 Camera LIB_API * Engine::getActiveCamera()
@@ -673,10 +1619,12 @@ int LIB_API Engine::getMaxRenderLights()
 
 void LIB_API Engine::setMaxRenderLights(int n)
 {
-	if (n <= 8 && n > 0)
-		this->maxRenderLights = n;
-	else
-		this->maxRenderLights = 8;
+	if (n < 1)
+	{
+		std::cout << "[ERROR] Invalid number of lights: " << n << std::endl;
+		return;
+	}
+	this->maxRenderLights = glm::min(n, (int)Clusters::MAX_LIGHTS);
 }
 
 
@@ -694,6 +1642,67 @@ void LIB_API Engine::wireframeSwitch()
 	}
 }
 
+void LIB_API Engine::indirectSwitch()
+{
+	indirect = !indirect;
+}
+
+bool LIB_API Engine::isIndirect()
+{
+	return indirect;
+}
+
+void LIB_API Engine::gpuCullingSwitch()
+{
+	gpuCulling = !gpuCulling;
+}
+
+bool LIB_API Engine::isGpuCulling()
+{
+	return gpuCulling && indirect && !foveated;
+}
+
+void LIB_API Engine::occlusionSwitch()
+{
+	occlusionCulling = !occlusionCulling;
+}
+
+bool LIB_API Engine::isOcclusionCulling()
+{
+	return occlusionCulling;
+}
+
+void LIB_API Engine::setDepthMode(DepthMode mode)
+{
+	if (mode < DEPTH_LAST)
+		depthMode = mode;
+}
+
+Engine::DepthMode LIB_API Engine::getDepthMode()
+{
+	return depthMode;
+}
+
+void LIB_API Engine::depthModeSwitch()
+{
+	setDepthMode((DepthMode)((depthMode + 1) % DEPTH_LAST));
+}
+
+void LIB_API Engine::benchmarkOverdraw()
+{
+	if (overdrawFrame >= 0)
+		return;
+
+	std::cout << "overdraw benchmark, " << OVERDRAW_FRAMES << " frames per mode:" << std::endl;
+	overdrawRestore = depthMode;
+	depthMode = DEPTH_UNSORTED;
+	shaderCache->setCounting(true);
+	shaderCache->collectFragmentCount();
+	overdrawFragments = 0;
+	overdrawPixels = 0;
+	overdrawFrame = 0;
+}
+
 void LIB_API Engine::clearColor(float r, float g, float b)
 {
 	glClearColor(r, g, b, 1.0f);
@@ -729,6 +1738,11 @@ void LIB_API Engine::showFps()
 	fpsFlag = !fpsFlag;
 }
 
+void LIB_API Engine::profileShaders()
+{
+	shaderCache->setProfiling(!shaderCache->isProfiling());
+}
+
 //callbacks
 void LIB_API Engine::reshape(void(*reshapeFunc)(int, int))
 {
@@ -758,8 +1772,119 @@ void LIB_API Engine::mouseWheel(void(*wheelFunc)(int, int, int, int))
 	glutMouseWheelFunc(wheelFunc);
 }
 
+void LIB_API Engine::setSinglePassStereo(bool enable)
+{
+	if (enable && foveatedRendering)
+	{
+		std::cout << "[ERROR] Single-pass stereo cannot be combined with foveated rendering" << std::endl;
+		return;
+	}
+	singlePassStereo = enable;
+}
+
+Engine::StereoMode LIB_API Engine::getStereoMode()
+{
+	return stereoMode;
+}
+
+void LIB_API Engine::setPipelinedFrames(bool enable)
+{
+	pipelinedFrames = enable;
+}
+
+void LIB_API Engine::setDynamicResolution(bool enable, float minScale, float maxScale)
+{
+	delete dynamicResolution;
+	dynamicResolution = nullptr;
+	if (!enable)
+		return;
+
+	dynamicResolution = new DynamicResolution(1000.0 / 90.0, minScale, maxScale);
+	dynamicResolution->setLog([](unsigned int frame, float from, float to, double gpuTime)
+	{
+		std::cout << "Dynamic resolution: scale " << from << " -> " << to << " at frame " << frame << " (" << gpuTime << " ms on the gpu)" << std::endl;
+	});
+}
+
+int LIB_API Engine::createQuadLayer(unsigned int width, unsigned int height, const glm::mat4 &pose, const glm::vec2 &size, bool headLocked, int order)
+{
+	XrExtent2Df extent;
+	extent.width = size.x;
+	extent.height = size.y;
+	return xr.addQuadLayer(width, height, toXrPose(pose), extent, headLocked, order);
+}
+
+bool LIB_API Engine::beginQuadLayer(int quad, const glm::vec4 &clearColor)
+{
+	glGetIntegerv(GL_VIEWPORT, quadViewport);
+	if (!xr.lockQuadLayer(quad))
+		return false;
+
+	GLfloat previous[4];
+	glGetFloatv(GL_COLOR_CLEAR_VALUE, previous);
+	glClearColor(clearColor.r, clearColor.g, clearColor.b, clearColor.a);
+	glClear(GL_COLOR_BUFFER_BIT);
+	glClearColor(previous[0], previous[1], previous[2], previous[3]);
+	return true;
+}
+
+void LIB_API Engine::endQuadLayer(int quad)
+{
+	xr.unlockQuadLayer(quad);
+	glViewport(quadViewport[0], quadViewport[1], quadViewport[2], quadViewport[3]);
+}
+
+void LIB_API Engine::setQuadLayerPose(int quad, const glm::mat4 &pose)
+{
+	xr.setQuadLayerPose(quad, toXrPose(pose));
+}
+
+void LIB_API Engine::setQuadLayerVisible(int quad, bool visible)
+{
+	xr.setQuadLayerVisible(quad, visible);
+}
+
+void LIB_API Engine::setFoveatedRendering(bool enable, float radiusX, float radiusY, float peripheryScale)
+{
+	// The eyes share their passes with single-pass stereo, foveation needs one pass per eye:
+	if (enable && singlePassStereo)
+	{
+		std::cout << "[ERROR] Foveated rendering cannot be combined with single-pass stereo" << std::endl;
+		return;
+	}
+	foveatedRendering = enable;
+	for (int i = 0; i < OvXR::EYE_LAST; i++)
+	{
+		foveation[i].setRadii(radiusX, radiusY);
+		foveation[i].setScale(peripheryScale);
+	}
+}
+
 bool LIB_API Engine::initOpenXR()
 {
+	// Single-pass stereo needs an array swapchain, created by xr.init():
+	stereoMode = STEREO_OFF;
+	if (singlePassStereo)
+	{
+		if (GLEW_OVR_multiview2)
+			stereoMode = STEREO_MULTIVIEW;
+		else if (GLEW_ARB_shader_viewport_layer_array || GLEW_AMD_vertex_shader_layer)
+			stereoMode = STEREO_INSTANCED;
+		if (stereoMode != STEREO_OFF && !xr.enableStereoArray(stereoMode == STEREO_MULTIVIEW))
+			stereoMode = STEREO_OFF;
+		const char *names[] = { "off", "multiview", "instanced" };
+		std::cout << "Single-pass stereo: " << names[stereoMode] << std::endl;
+	}
+
+	// Swapchains for the largest scale, the eyes are rendered into a part of them:
+	if (dynamicResolution)
+	{
+		xr.setMaxRenderScale(dynamicResolution->getMaxScale());
+		xr.setRenderScale(dynamicResolution->getScale());
+		glGenQueries(GPU_TIMERS, gpuTimers);
+		gpuTimerFrames = 0;
+	}
+
     xr.init();
 
 	XrQuaternionf quat;
@@ -772,6 +1897,7 @@ bool LIB_API Engine::initOpenXR()
 	identityPose.position = pos;
 
     xr.setReferenceSpace(identityPose, XR_REFERENCE_SPACE_TYPE_LOCAL);
+	xr.setDepthRange(xrNearPlane, xrFarPlane);
 
     xr.beginSession();
 
@@ -796,35 +1922,117 @@ bool LIB_API Engine::initOpenXR()
     cout << "Manufacturer name: " << xr.getManufacturerName() << endl;
     cout << "risoluzione: " << xr.getHmdIdealHorizRes() << "x" << xr.getHmdIdealVertRes() << endl;
 
+	foveated = foveatedRendering;
+	loadXrGraph();
+	glGenQueries(GPU_TIMERS, sampleQueries);
+	sampleFrames = 0;
+
+	// The first frame is waited for right away:
+	if (pipelinedFrames)
+	{
+		framePacer = new FramePacer();
+		framePacer->start([](FramePacer::Frame &frame)
+		{
+			XrFrameState frameState;
+			if (!xr.waitFrame(frameState))
+				return false;
+			frame.displayTime = frameState.predictedDisplayTime;
+			frame.period = frameState.predictedDisplayPeriod;
+			frame.shouldRender = frameState.shouldRender == XR_TRUE;
+			return true;
+		});
+	}
 	return true;
 }
 
 void LIB_API Engine::renderOpenXR(Node* node, const glm::mat4 &wasdMat)
 {
-	List* list = createList(node);
-	pr->render();
+	List* list = frameList;
+	fillList(list, node);
 
-    xr.beginFrame();
+	// Pipelined, the frame was waited for while the previous one was rendered:
+	FramePacer::Frame frame;
+	if (framePacer != nullptr && framePacer->acquire(frame))
+	{
+		XrFrameState frameState;
+		frameState.type = XR_TYPE_FRAME_STATE;
+		frameState.next = nullptr;
+		frameState.predictedDisplayTime = frame.displayTime;
+		frameState.predictedDisplayPeriod = frame.period;
+		frameState.shouldRender = frame.shouldRender ? XR_TRUE : XR_FALSE;
+
+		// Not begun, the pacer must not wait for another frame (xrWaitFrame() would block until this one begins, with
+		// this thread blocked in acquire()): it is stopped, the next frames are waited for here
+		if (!xr.beginFrame(frameState))
+		{
+			std::cout << "[ERROR] Frame not begun, frame pacing stopped" << std::endl;
+			delete framePacer;
+			framePacer = nullptr;
+			return;
+		}
+		framePacer->begun();
+	}
+	else if (!xr.beginFrame())
+		return;
 
-	for (int i = 0; i < 2; i++)
+	// Per-frame data: both eyes and the lights are uploaded once
+	FrameBlock frameData[OvXR::EYE_LAST];
+	for (int i = 0; i < OvXR::EYE_LAST; i++)
 	{
 		OvXR::OvEye e = (OvXR::OvEye) i;
-        glm::mat4 headMat = xr.getEyeModelviewMatrix(e, wasdMat);
-        glm::mat4 proj = xr.getProjMatrix(e, 0.1f, 1000.f);
-
-        xr.lockSwapchain(e);
-
-        glViewport(0, 0, xr.getHmdIdealHorizRes(), xr.getHmdIdealVertRes());
-		glClearColor(0, 0, 0, 1);
-		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-		
-        list->renderXR(proj, headMat);
+		frameData[i].projection = xr.getProjMatrix(e, xrNearPlane, xrFarPlane);
+		frameData[i].view = xr.getEyeModelviewMatrix(e, wasdMat);
+		frameData[i].eyePosition = glm::inverse(frameData[i].view)[3];
+		if (foveated)
+			foveation[i].layout(xr.getRenderWidth(), xr.getRenderHeight(), Foveation::getCenter(frameData[i].projection));
+	}
+	loadFrames(list, frameData, OvXR::EYE_LAST);
+
+	// Eyes or single-pass stereo, see loadXrGraph(), timed for the dynamic resolution (unless the shaders are being profiled):
+	bool timed = dynamicResolution != nullptr && !shaderCache->isProfiling();
+	if (timed)
+		glBeginQuery(GL_TIME_ELAPSED, gpuTimers[gpuTimerFrames % GPU_TIMERS]);
+	unsigned int sampleSlot = sampleFrames % GPU_TIMERS;
+	glBeginQuery(GL_SAMPLES_PASSED, sampleQueries[sampleSlot]);
+	graphList = list;
+	xrGraph->execute();
+	graphList = nullptr;
+	glEndQuery(GL_SAMPLES_PASSED);
+	samplePixels[sampleSlot] = (unsigned long long)xr.getRenderWidth() * xr.getRenderHeight() * OvXR::EYE_LAST;
+	sampleCopies[sampleSlot] = foveated && xr.hasDepthLayers();
+	collectSamples();
+	if (timed)
+	{
+		glEndQuery(GL_TIME_ELAPSED);
+		gpuTimerFrames++;
+
+		// The oldest query, so that the CPU does not wait for the GPU:
+		double gpuTime = 0.0;
+		GLuint oldest = gpuTimers[gpuTimerFrames % GPU_TIMERS];
+		GLint available = 0;
+		if (gpuTimerFrames >= GPU_TIMERS)
+			glGetQueryObjectiv(oldest, GL_QUERY_RESULT_AVAILABLE, &available);
+		if (available)
+		{
+			GLuint64 elapsed = 0;
+			glGetQueryObjectui64v(oldest, GL_QUERY_RESULT, &elapsed);
+			gpuTime = elapsed / 1000000.0;
+		}
 
-        xr.unlockSwapchain(e);
+		// The budget is the display period, when the runtime tells it:
+		if (xr.getPredictedDisplayPeriod() > 0)
+			dynamicResolution->setBudget(xr.getPredictedDisplayPeriod() / 1000000.0);
+		xr.setRenderScale(dynamicResolution->update(gpuTime));
 	}
 
     xr.endFrame();
+	if (framePacer != nullptr)
+		framePacer->submitted();
 
+	if (foveated)
+		measureOverdraw(foveation[OvXR::EYE_LEFT].getShadedPixels() + foveation[OvXR::EYE_RIGHT].getShadedPixels());
+	else
+		measureOverdraw((unsigned long long)xr.getRenderWidth() * xr.getRenderHeight() * OvXR::EYE_LAST);
 	frames++;
 }
 
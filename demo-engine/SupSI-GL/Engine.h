@@ -13,10 +13,15 @@
 
 /// INCLUDE
 /// system dependecies (external / system library)
+#include <atomic>
+#include <cstddef>
 #include <iostream>
 #include <string>
 #include <vector>
+#include <functional>
+#include <mutex>
 #include <fstream>
+#include <unordered_map>
 
 /// USING
 using namespace std;
@@ -33,20 +38,42 @@ using namespace std;
 #include <glm/gtc/matrix_inverse.hpp>
 
 /// object dependecies (internal, 1st party)
+#include "FrameArena.h"
+#include "NameTable.h"
+#include "JobSystem.h"
+#include "Pool.h"
 #include "Object.h"
 #include "Vertex.h"
 #include "Face.h"
+#include "Ubo.h"
+#include "Clusters.h"
+#include "Culling.h"
+#include "Occlusion.h"
+#include "Transform.h"
 #include "Node.h"
+#include "Hierarchy.h"
+#include "Registry.h"
 #include "Camera.h"
 #include "Light.h"
 #include "Texture.h"
 #include "Material.h"
 #include "Mesh.h"
+#include "ScenePools.h"
 #include "OvoReader.h"
+#include "Simulation.h"
+#include "FramePacer.h"
+#include "DynamicResolution.h"
+#include "Foveation.h"
 #include "List.h"
 #include "shader.h"
 #include "Program.h"
+#include "ShaderCache.h"
 #include "Fbo.h"
+#include "Ssbo.h"
+#include "MeshPool.h"
+#include "IndirectBatch.h"
+#include "HiZ.h"
+#include "FrameGraph.h"
 
 
 
@@ -81,24 +108,50 @@ private:
 	/**
 	@var maxRenderLights
 	The maximum number of light managed by the engine.
-	Defaults to 8, with 8 being the maximum absolute limit due to the engine is just a
-	OpenGL wrapper. Since OpenGL rarely operates more than 8 concurrent light sources,
-	it's necessary to provide a priority system to have more than that.
+	Defaults to 8, the absolute limit being Clusters::MAX_LIGHTS. Lights are culled per cluster
+	(see Clusters.h), so each fragment only pays for the lights that reach it.
+	When the scene has more lights than that, the priority system selects the ones to render.
 	For additional details on the priority system
 	@see "Light.h"
 	*/
-	int maxRenderLights = 8; //number of rendered lights, the max value is 8 (due to OpenGL constraints), if a grater value is passed as argument 8 will be used instead
+	int maxRenderLights = 8; //number of rendered lights, if a greater value than Clusters::MAX_LIGHTS is passed as argument Clusters::MAX_LIGHTS will be used instead, values lower than 1 are ignored
 
 
 	// Shaders:
-	Shader *vs = nullptr;
-	Shader *fs = nullptr;
 	Shader *program = nullptr;
-	Program *pr = nullptr;
 
 	void initShaders();
 public:
 
+	/**
+	@enum DepthMode
+	How opaque meshes are ordered against overdraw (see List.h):
+	*  - DEPTH_UNSORTED drawn grouped by shader variant
+	*  - DEPTH_FRONT_TO_BACK sorted by distance from the eyes, so that hidden fragments fail the depth test
+	*  - DEPTH_PREPASS depth-only pass first, then shading with GL_EQUAL: each pixel is shaded once
+	*/
+	enum DepthMode : unsigned int
+	{
+		DEPTH_UNSORTED = 0,
+		DEPTH_FRONT_TO_BACK,
+		DEPTH_PREPASS,
+		DEPTH_LAST
+	};
+
+	/**
+	@enum StereoMode
+	How renderOpenXR() draws the two eyes:
+	*  - STEREO_OFF one pass per eye, each into its own swapchain
+	*  - STEREO_MULTIVIEW one pass, GL_OVR_multiview2 broadcasts every draw to both layers of an array swapchain
+	*  - STEREO_INSTANCED one pass, every draw is instanced twice and each instance writes its eye's layer
+	*/
+	enum StereoMode : unsigned int
+	{
+		STEREO_OFF = 0,
+		STEREO_MULTIVIEW,
+		STEREO_INSTANCED,
+	};
+
 	/**
 	@static Either creates or returns the Engine instance's memory address
 	*/
@@ -126,10 +179,59 @@ public:
 
 	/**
 	Reads and loads a graphic scene from a OVO file. Returns such scene graph.
+	The scene becomes the one indexed by the engine's registry, see find().
 	@param scene The path to the OVO file
 	*/
 	Node* load(string scene);
 
+	/**
+	Returns the node of the last loaded scene with an id, nullptr if there is none (see Registry.h).
+	Thread safe, but while the simulation runs the node belongs to it: change it through post(), see startSimulation().
+	@param id The identifier, see Object::getId()
+	*/
+	Node* find(int id);
+
+	/**
+	Returns the first node of the last loaded scene with a name, nullptr if there is none
+	@see find(int id)
+	*/
+	Node* find(const string &name);
+
+	/**
+	Returns the registry indexing the last loaded scene
+	*/
+	Registry* getRegistry();
+
+	/**
+	Creates a scene node in the engine's pools (see ScenePools.h): nodes of the same type are stored contiguously,
+	in creation order. The engine owns them and releases them at exit or with destroyNode(), they must not be deleted.
+	*/
+	Node* createNode();
+
+	/**
+	@see createNode()
+	*/
+	Mesh* createMesh();
+
+	/**
+	@see createNode()
+	*/
+	Light* createLight();
+
+	/**
+	@see createNode()
+	*/
+	Camera* createCamera();
+
+	/**
+	Destroys a node created by the engine and its whole subtree, e.g. a scene returned by load() that is no longer
+	needed: the nodes are detached, leave the registry and their slots are reused. The snapshots of a running simulation
+	refer to the nodes, call it after stopSimulation(). The subtree must not hold the active camera.
+	@param node The node
+	@return false, with an error, if the simulation runs, the node was not created by the engine or holds the active camera
+	*/
+	bool destroyNode(Node *node);
+
 	/**
 	Cleans the memory buffers. Particularly the OpenGL's depth and color buffer
 	*/
@@ -143,7 +245,8 @@ public:
 	void swap();
 
 	/**
-	Creates the list to be rendered by renderScene()
+	Creates the list to be rendered by renderScene(), owned by the caller.
+	While the simulation runs the node must be part of its scene, see startSimulation(), the list is empty otherwise.
 	@param node The current Node to be added to the scene's graph
 	*/
 	List* createList(Node* node);
@@ -155,6 +258,7 @@ public:
 	- Sets the active projection matrix
 	- renders with the active camera
 	- If necessary, renders 2D text object (e.g for GUI / user help
+	The returned list is owned by the engine and refilled by the next call.
 	@param node The current Node to be added to the scene's graph
 	*/
 	List* renderScene(Node* node);
@@ -165,6 +269,28 @@ public:
 	*/
 	void renderScene(List* list);
 
+	/**
+	Starts running the application's updates on a simulation thread (see Simulation.h). From then on the scene graph
+	belongs to that thread: renderScene() and renderOpenXR() draw the latest snapshot of "root", and changes to the
+	scene coming from the input callbacks must go through post().
+	@param root The scene
+	@param update The application's update, called with the elapsed time in seconds, can be nullptr
+	@param rate Updates per second
+	*/
+	void startSimulation(Node* root, void(*update)(double), double rate = 90.0);
+
+	/**
+	Stops the simulation thread, the scene graph belongs to the rendering thread again
+	*/
+	void stopSimulation();
+
+	/**
+	Runs a change to the scene on the thread that owns it: on the simulation thread, before its next update,
+	when it runs, immediately otherwise
+	@param event The change
+	*/
+	void post(const std::function<void()> &event);
+
 	/**
 	Sets a new active camera
 	@param camera Pinter to the newly selected camera
@@ -182,9 +308,9 @@ public:
 	int getMaxRenderLights();
 
 	/**
-	Sets the maximum number of lights to "n",
-	provided that "n" is lower than 8. Else it's set to 8.
-	@param n The new maximum number of light. Accepts integer values in the [1;8] range
+	Sets the maximum number of lights to "n", clamped to Clusters::MAX_LIGHTS.
+	Values lower than 1 are rejected and the current maximum is kept.
+	@param n The new maximum number of light. Accepts integer values in the [1;Clusters::MAX_LIGHTS] range
 	*/
 	void setMaxRenderLights(int n);
 
@@ -196,6 +322,59 @@ public:
 	*/
 	void wireframeSwitch();
 
+	/**
+	Toggles between drawing the meshes one by one and submitting them with
+	multi-draw-indirect calls (see IndirectBatch.h).
+	*/
+	void indirectSwitch();
+
+	/**
+	Returns true when the meshes are submitted with multi-draw-indirect calls
+	*/
+	bool isIndirect();
+
+	/**
+	Toggles the GPU occlusion culling of the multi-draw-indirect commands (see HiZ.h)
+	*/
+	void gpuCullingSwitch();
+
+	/**
+	Returns true when the meshes are submitted with multi-draw-indirect calls culled on the GPU
+	*/
+	bool isGpuCulling();
+
+	/**
+	Toggles the software occlusion culling of the meshes (see Occlusion.h)
+	*/
+	void occlusionSwitch();
+
+	/**
+	Returns true when the meshes hidden by the largest ones are not drawn
+	*/
+	bool isOcclusionCulling();
+
+	/**
+	Sets how opaque meshes are ordered against overdraw
+	@param mode The new mode, DEPTH_UNSORTED by default
+	*/
+	void setDepthMode(DepthMode mode);
+
+	/**
+	Returns how opaque meshes are ordered against overdraw
+	*/
+	DepthMode getDepthMode();
+
+	/**
+	Cycles through the depth modes
+	*/
+	void depthModeSwitch();
+
+	/**
+	Renders a few frames with each depth mode and prints the fragments shaded per pixel
+	(counted with an atomic counter, see ShaderCache.h), then restores the current mode.
+	*/
+	void benchmarkOverdraw();
+
 
 	/**
 	Sets the window background color.
@@ -240,6 +419,11 @@ public:
 	*/
 	void showFps();
 
+	/**
+	Used to start/stop measuring the GPU cost of each shader variant (printed with the FPS, see ShaderCache.h).
+	*/
+	void profileShaders();
+
 	/**
 	Callback functions
 	The following methods are used to bind callbacks to events (sets the event's handler)
@@ -277,9 +461,146 @@ public:
 	*/
 	void mouseWheel(void(*wheelFunc)(int, int, int, int));
 
+	/**
+	Requests single-pass stereo rendering for OpenXR, multiview when available and instanced stereo otherwise.
+	Must be called before initOpenXR(), which falls back to one pass per eye when neither is supported.
+	Rejected while foveated rendering is enabled, see setFoveatedRendering().
+	@param enable True to render both eyes in one pass
+	*/
+	void setSinglePassStereo(bool enable);
+
+	/**
+	Returns how renderOpenXR() draws the two eyes
+	*/
+	StereoMode getStereoMode();
+
+	/**
+	Requests pipelined OpenXR frames: xrWaitFrame() is called on a frame pacing thread (see FramePacer.h), so that the
+	render thread prepares the next frame while the current one is being displayed. Must be called before initOpenXR().
+	@param enable True to wait for the frames on their own thread
+	*/
+	void setPipelinedFrames(bool enable);
+
+	/**
+	Enables dynamic resolution for OpenXR: the resolution of the eyes follows their GPU time, measured with timer queries,
+	to hold the display rate (see DynamicResolution.h). Must be called before initOpenXR(), which creates the swapchains
+	for the largest scale.
+	@param enable True to enable it
+	@param minScale Lowest scale, relative to the runtime's recommended resolution
+	@param maxScale Highest scale
+	*/
+	void setDynamicResolution(bool enable, float minScale = 0.5f, float maxScale = 1.0f);
+
+	/**
+	Enables fixed foveated rendering of the OpenXR eyes: the periphery is rendered at a reduced resolution and upscaled,
+	and only an inset around the projection center at full resolution (see Foveation.h). Must be called before
+	initOpenXR(). Rejected while single-pass stereo is requested, since the eyes would share their passes.
+	Hi-Z culling is not used while foveated, since the periphery's depth does not hold the inset.
+	@param enable True to enable it
+	@param radiusX Half width of the inset, as a fraction of the half width of the eye
+	@param radiusY Half height of the inset, as a fraction of the half height of the eye
+	@param peripheryScale Resolution of the periphery, per axis
+	*/
+	void setFoveatedRendering(bool enable, float radiusX = 0.35f, float radiusY = 0.35f, float peripheryScale = 0.5f);
+
 	bool initOpenXR();
     void renderOpenXR(Node* n, const glm::mat4 &wasdMat = glm::mat4{1.f});
 
+	/**
+	Creates an OpenXR quad layer (see OvXR::addQuadLayer()): a panel composited by the runtime every frame with the
+	last image rendered into it, for menus and HUDs that seldom change. Must be called after initOpenXR().
+	@param width Width of the panel's image, in pixels
+	@param height Height of the panel's image, in pixels
+	@param pose Placement of the panel's center, facing +Z, in the tracking space (in the head's space if headLocked)
+	@param size Size of the panel, in meters
+	@param headLocked True to move the panel with the head
+	@param order Composition order: negative behind the scene, otherwise in front of it, higher on top
+	@return The quad layer, -1 on failure
+	*/
+	int createQuadLayer(unsigned int width, unsigned int height, const glm::mat4 &pose, const glm::vec2 &size, bool headLocked = false, int order = 1);
+
+	/**
+	Binds the image of a quad layer, cleared to the given color, to render its new content with OpenGL until
+	endQuadLayer(). Without a new image the runtime keeps showing the last one.
+	@param quad The quad layer
+	@param clearColor Background of the panel, with straight alpha
+	@return True if the image can be rendered
+	*/
+	bool beginQuadLayer(int quad, const glm::vec4 &clearColor = glm::vec4(0.0f));
+	void endQuadLayer(int quad);
+
+	/**
+	Moves or hides a quad layer, without rendering it again
+	*/
+	void setQuadLayerPose(int quad, const glm::mat4 &pose);
+	void setQuadLayerVisible(int quad, bool visible);
+
+	/**
+	Returns the program currently in use for the meshes, a variant of the shader cache.
+	Until the first frame selects one, the default variant built by init() (untextured, no lights)
+	*/
 	Program* getProgram();
 	Shader* getShader();
+
+	/**
+	Returns the mesh shader variants
+	*/
+	ShaderCache* getShaderCache();
+
+	/**
+	Returns the geometry shared by all the meshes, nullptr before init()
+	*/
+	MeshPool* getMeshPool();
+
+	/**
+	Returns the multi-draw-indirect batch
+	*/
+	IndirectBatch* getIndirectBatch();
+
+	/**
+	Returns the GPU occlusion culling stage of the indirect path
+	*/
+	HiZ* getHiZ();
+
+	/**
+	Returns the uniform buffer holding the per-eye camera data (binding Ubo::BINDING_FRAME)
+	*/
+	Ubo* getFrameUbo();
+
+	/**
+	Returns the light clusters of the current frame
+	*/
+	Clusters* getClusters();
+
+	/**
+	Returns the view-frustum culling stage of the current frame
+	*/
+	Culling* getCulling();
+
+	/**
+	Returns the engine's job system, shared by the frame preparation stages (see JobSystem.h)
+	*/
+	JobSystem* getJobSystem();
+
+	/**
+	Returns the allocator of the transient per-frame data, rewound by swap() (see FrameArena.h)
+	*/
+	FrameArena* getFrameArena();
+
+	/**
+	Returns the software occlusion culling stage of the current frame
+	*/
+	Occlusion* getOcclusion();
+
+	/**
+	Prepares the per-frame data of "count" views: passes the list's lights to the clusters,
+	builds the clusters of each view, then uploads the frame blocks and the light buffers.
+	The list's meshes are culled against the views as well (see Culling.h), and everything the views share
+	is gathered into the list's frame packet (see List::preparePacket()), so that each view only walks its visible set.
+	Only the projection, view and eyePosition fields of the frame blocks need to be set.
+	@param list The list to be rendered
+	@param frames The views' frame blocks, at most one per eye
+	@param count The number of views
+	*/
+	void loadFrames(List* list, FrameBlock* frames, int count);
 };
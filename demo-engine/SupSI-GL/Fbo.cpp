@@ -78,8 +78,8 @@ bool Fbo::isOk()
  * @param textureNumber a value between 0 and OvFbo::MAX_ATTACHMENTS to identify texture position
  * @param operation one of the enumerated operations of type OvFbo::BIND_*
  * @param texture pointer to a texture class
- * @param param1 free param 1, according to the operation
- * @param param2 free param 2, according to the operation
+ * @param param1 free param 1, according to the operation (color attachment number for BIND_COLORTEXTURE)
+ * @param param2 free param 2, according to the operation (mipmap level for BIND_COLORTEXTURE)
  * @return true on success, false on fail
  */
 bool Fbo::bindTexture(unsigned int textureNumber, unsigned int operation, unsigned int texture, int param1, int param2)
@@ -99,7 +99,7 @@ bool Fbo::bindTexture(unsigned int textureNumber, unsigned int operation, unsign
 	{
 		//////////////////////////
 	case BIND_COLORTEXTURE: //		
-		glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0 + param1, GL_TEXTURE_2D, texture, 0);
+		glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0 + param1, GL_TEXTURE_2D, texture, param2);
 		drawBuffer[textureNumber] = param1;
 		break;
 
@@ -121,8 +121,9 @@ bool Fbo::bindTexture(unsigned int textureNumber, unsigned int operation, unsign
 
 	// Get some texture information:
 	glBindTexture(GL_TEXTURE_2D, texture);
-	glGetTexLevelParameteriv(GL_TEXTURE_2D, 0, GL_TEXTURE_WIDTH, &sizeX);
-	glGetTexLevelParameteriv(GL_TEXTURE_2D, 0, GL_TEXTURE_HEIGHT, &sizeY);
+	int level = operation == BIND_COLORTEXTURE ? param2 : 0;
+	glGetTexLevelParameteriv(GL_TEXTURE_2D, level, GL_TEXTURE_WIDTH, &sizeX);
+	glGetTexLevelParameteriv(GL_TEXTURE_2D, level, GL_TEXTURE_HEIGHT, &sizeY);
 	return updateMrtCache();
 }
 
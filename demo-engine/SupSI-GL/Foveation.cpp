@@ -0,0 +1,100 @@
+#include "Engine.h"
+
+
+LIB_API Foveation::Foveation(float radiusX, float radiusY, float scale)
+{
+	setRadii(radiusX, radiusY);
+	setScale(scale);
+}
+
+void LIB_API Foveation::setRadii(float radiusX, float radiusY)
+{
+	this->radiusX = glm::clamp(radiusX, 0.0f, 1.0f);
+	this->radiusY = glm::clamp(radiusY, 0.0f, 1.0f);
+}
+
+float LIB_API Foveation::getRadiusX()
+{
+	return radiusX;
+}
+
+float LIB_API Foveation::getRadiusY()
+{
+	return radiusY;
+}
+
+void LIB_API Foveation::setScale(float scale)
+{
+	this->scale = glm::clamp(scale, 0.05f, 1.0f);
+}
+
+float LIB_API Foveation::getScale()
+{
+	return scale;
+}
+
+void LIB_API Foveation::layout(unsigned int width, unsigned int height, const glm::vec2 &center)
+{
+	this->width = width;
+	this->height = height;
+	peripheryWidth = glm::max((unsigned int)(width * scale + 0.5f), 1u);
+	peripheryHeight = glm::max((unsigned int)(height * scale + 0.5f), 1u);
+
+	//inset around the projection center, inside the viewport
+	float centerX = (center.x * 0.5f + 0.5f) * width;
+	float centerY = (center.y * 0.5f + 0.5f) * height;
+	int x0 = glm::clamp((int)floor(centerX - radiusX * width * 0.5f), 0, (int)width);
+	int x1 = glm::clamp((int)ceil(centerX + radiusX * width * 0.5f), 0, (int)width);
+	int y0 = glm::clamp((int)floor(centerY - radiusY * height * 0.5f), 0, (int)height);
+	int y1 = glm::clamp((int)ceil(centerY + radiusY * height * 0.5f), 0, (int)height);
+	inset = { x0, y0, x1 - x0, y1 - y0 };
+
+	//periphery pixels entirely inside the inset, minus the ones the filtering reads
+	float toPeripheryX = (float)peripheryWidth / width;
+	float toPeripheryY = (float)peripheryHeight / height;
+	int hx0 = (int)ceil(x0 * toPeripheryX) + 1;
+	int hx1 = (int)floor(x1 * toPeripheryX) - 1;
+	int hy0 = (int)ceil(y0 * toPeripheryY) + 1;
+	int hy1 = (int)floor(y1 * toPeripheryY) - 1;
+	if (hx1 > hx0 && hy1 > hy0)
+		hole = { hx0, hy0, hx1 - hx0, hy1 - hy0 };
+	else
+		hole = { 0, 0, 0, 0 };
+}
+
+const Foveation::Rect LIB_API & Foveation::getInset() const
+{
+	return inset;
+}
+
+unsigned int LIB_API Foveation::getPeripheryWidth() const
+{
+	return peripheryWidth;
+}
+
+unsigned int LIB_API Foveation::getPeripheryHeight() const
+{
+	return peripheryHeight;
+}
+
+const Foveation::Rect LIB_API & Foveation::getHole() const
+{
+	return hole;
+}
+
+unsigned long long LIB_API Foveation::getShadedPixels() const
+{
+	return (unsigned long long)peripheryWidth * peripheryHeight - (unsigned long long)hole.width * hole.height
+		+ (unsigned long long)inset.width * inset.height;
+}
+
+unsigned long long LIB_API Foveation::getFullPixels() const
+{
+	return (unsigned long long)width * height;
+}
+
+glm::vec2 LIB_API Foveation::getCenter(const glm::mat4 &projection)
+{
+	glm::vec4 clip = projection * glm::vec4(0.0f, 0.0f, -1.0f, 1.0f);
+	return glm::vec2(clip) / clip.w;
+}
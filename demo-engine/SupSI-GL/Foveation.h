@@ -0,0 +1,88 @@
+#pragma once
+
+/**
+* Supsi-GE, fixed foveated rendering layout class
+* Lens distortion spreads the periphery of an eye over more pixels than it needs, so the periphery is rendered at a
+* reduced resolution into its own target, then upscaled into the eye's image, and only a rectangle around the
+* projection center (the inset) is rendered at full resolution on top of it, with a scissor.
+* This class computes the rectangles of one eye: the inset in the eye's image and the hole left in the periphery target,
+* where nothing needs to be shaded since the inset covers it. The hole stays one periphery pixel away from the border of
+* the inset, so that the filtered upscale never reads it.
+* The class does not touch OpenGL.
+*/
+class LIB_API Foveation
+{
+public:
+	/**
+	@struct Rect
+	A rectangle in pixels, lower left corner and size
+	*/
+	struct Rect
+	{
+		int x;
+		int y;
+		int width;
+		int height;
+	};
+
+	/**
+	Constructor
+	@param radiusX Half width of the inset, as a fraction of the half width of the eye
+	@param radiusY Half height of the inset, as a fraction of the half height of the eye
+	@param scale Resolution of the periphery, per axis
+	*/
+	Foveation(float radiusX = 0.35f, float radiusY = 0.35f, float scale = 0.5f);
+
+	void setRadii(float radiusX, float radiusY);
+	float getRadiusX();
+	float getRadiusY();
+	void setScale(float scale);
+	float getScale();
+
+	/**
+	Computes the rectangles of an eye
+	@param width Width of the eye's viewport, in pixels
+	@param height Height of the eye's viewport, in pixels
+	@param center Projection center, in normalized device coordinates (see getCenter())
+	*/
+	void layout(unsigned int width, unsigned int height, const glm::vec2 &center);
+
+	/**
+	Returns the inset, in the eye's viewport
+	*/
+	const Rect &getInset() const;
+
+	/**
+	Returns the size of the periphery's viewport
+	*/
+	unsigned int getPeripheryWidth() const;
+	unsigned int getPeripheryHeight() const;
+
+	/**
+	Returns the part of the periphery covered by the inset, in the periphery's viewport, empty for small insets
+	*/
+	const Rect &getHole() const;
+
+	/**
+	Returns the pixels shaded with foveation (periphery without the hole, plus the inset), and without (the viewport)
+	*/
+	unsigned long long getShadedPixels() const;
+	unsigned long long getFullPixels() const;
+
+	/**
+	Returns where the view direction lands in normalized device coordinates, for an off-center projection
+	*/
+	static glm::vec2 getCenter(const glm::mat4 &projection);
+
+private:
+	float radiusX;
+	float radiusY;
+	float scale;
+
+	unsigned int width = 0;
+	unsigned int height = 0;
+	unsigned int peripheryWidth = 0;
+	unsigned int peripheryHeight = 0;
+	Rect inset = { 0, 0, 0, 0 };
+	Rect hole = { 0, 0, 0, 0 };
+};
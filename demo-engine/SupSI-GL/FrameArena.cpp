@@ -0,0 +1,89 @@
+#include "Engine.h"
+
+// C/C++:
+#include <cstdint>
+#include <iostream>
+
+
+FrameArena::FrameArena(size_t capacity, unsigned int frames)
+	: current{ 0 }
+	, peak{ 0 }
+	, overflows{ 0 }
+{
+	blocks.resize(frames ? frames : 1);
+	for (Block &block : blocks)
+	{
+		block.data = new unsigned char[capacity];
+		block.capacity = capacity;
+		block.used = 0;
+		block.needed = 0;
+	}
+}
+
+FrameArena::~FrameArena()
+{
+	for (Block &block : blocks)
+	{
+		for (void *p : block.overflow)
+			::operator delete(p);
+		delete[] block.data;
+	}
+}
+
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+/**
+ * Allocates memory valid until this frame's block is rewound, DEFAULT_FRAMES calls to nextFrame() later.
+ * @param size size in bytes
+ * @param alignment power of two the address must be a multiple of
+ * @return pointer to the memory
+ */
+void *FrameArena::allocate(size_t size, size_t alignment)
+{
+	Block &block = blocks[current];
+	block.needed += size + alignment;
+
+	// Bump:
+	uintptr_t base = (uintptr_t)block.data;
+	uintptr_t address = (base + block.used + alignment - 1) & ~(uintptr_t)(alignment - 1);
+	if (address + size <= base + block.capacity)
+	{
+		block.used = (size_t)(address - base) + size;
+		return (void *)address;
+	}
+
+	// Out of space, the heap takes over until the block grows:
+	void *p = ::operator new(size);
+	block.overflow.push_back(p);
+	overflows++;
+
+	// Done:
+	return p;
+}
+
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+/**
+ * Ends the current frame: moves to the next block, rewinding it. The block is enlarged first if it is smaller
+ * than the largest frame so far.
+ */
+void FrameArena::nextFrame()
+{
+	peak = glm::max(peak, blocks[current].needed);
+	current = (current + 1) % blocks.size();
+	Block &block = blocks[current];
+
+	for (void *p : block.overflow)
+		::operator delete(p);
+	block.overflow.clear();
+	if (peak > block.capacity)
+	{
+		delete[] block.data;
+		block.capacity = peak + peak / 2;
+		block.data = new unsigned char[block.capacity];
+	}
+
+	// Done:
+	block.used = 0;
+	block.needed = 0;
+}
@@ -0,0 +1,79 @@
+#pragma once
+
+/**
+* Supsi-GE, per-frame linear allocator class
+* Transient data of a frame (light lists, scratch arrays, ...) is bump allocated from a block of memory that is
+* recycled as a whole instead of being freed piece by piece. There is one block per frame in flight: nextFrame()
+* moves to the next one and rewinds it, so that what was allocated during the last frames stays valid meanwhile.
+* When a frame needs more than its block, the excess comes from the heap and the block is enlarged the next time it
+* is rewound: after a few frames a steady-state frame does not touch the heap at all.
+* FrameAllocator adapts the arena to the STL containers (see FrameVector); deallocation is a no-op.
+*/
+class LIB_API FrameArena {
+	//////////
+public: //
+//////////
+
+	// Constants:
+	static const unsigned int DEFAULT_FRAMES = 3;	///< Frames in flight
+
+	// Const/dest:
+	FrameArena(size_t capacity, unsigned int frames = DEFAULT_FRAMES);
+	~FrameArena();
+
+	// Get/set:
+	inline unsigned int getFrames() { return (unsigned int)blocks.size(); }
+	inline size_t getCapacity() { return blocks[current].capacity; }
+	inline size_t getUsed() { return blocks[current].used; }
+	inline size_t getPeak() { return peak; }
+	inline unsigned int getOverflows() { return overflows; }
+
+	// Management:
+	void *allocate(size_t size, size_t alignment = alignof(std::max_align_t));
+	void nextFrame();
+
+
+	///////////
+private: //
+///////////
+
+	struct Block
+	{
+		unsigned char *data;
+		size_t capacity;
+		size_t used;
+		size_t needed;						///< Bytes requested this frame, including the overflows
+		vector<void *> overflow;			///< Heap allocations past the capacity, released when rewound
+	};
+
+	// Generic data:
+	vector<Block> blocks;
+	unsigned int current;					///< Block of the current frame
+	size_t peak;							///< Largest frame so far, in bytes
+	unsigned int overflows;					///< Heap allocations so far, for the stats
+};
+
+
+/**
+* STL allocator drawing from a FrameArena. Containers using it must not outlive the frames in flight.
+*/
+template <class T>
+class FrameAllocator
+{
+public:
+	typedef T value_type;
+
+	FrameAllocator(FrameArena *arena) : arena{ arena } {}
+	template <class U> FrameAllocator(const FrameAllocator<U> &other) : arena{ other.arena } {}
+
+	T *allocate(size_t n) { return static_cast<T *>(arena->allocate(n * sizeof(T), alignof(T))); }
+	void deallocate(T *, size_t) {}
+
+	template <class U> bool operator==(const FrameAllocator<U> &other) const { return arena == other.arena; }
+	template <class U> bool operator!=(const FrameAllocator<U> &other) const { return arena != other.arena; }
+
+	FrameArena *arena;
+};
+
+template <class T>
+using FrameVector = vector<T, FrameAllocator<T>>;
@@ -0,0 +1,357 @@
+#include "Engine.h"
+
+// C/C++:
+#include <algorithm>
+#include <iostream>
+
+
+FrameGraph::FrameGraph(const string &name)
+	: name{ name }
+	, compiled{ false }
+	, memory{ 0 }
+	, unaliasedMemory{ 0 }
+	, importedMemory{ 0 }
+{}
+
+FrameGraph::~FrameGraph()
+{}
+
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+/**
+ * Tells whether a pass was removed by compile().
+ * @param pass pass index as returned by addPass()
+ * @return true when culled or invalid
+ */
+bool FrameGraph::isCulled(unsigned int pass)
+{
+	if (pass >= passes.size())
+		return true;
+	return passes[pass].culled;
+}
+
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+/**
+ * Tells whether a resource is owned outside of the graph.
+ * @param resource resource index as returned by createTexture() or importTexture()
+ * @return true for imported resources
+ */
+bool FrameGraph::isImported(unsigned int resource)
+{
+	if (resource >= resources.size())
+		return false;
+	return resources[resource].imported;
+}
+
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+/**
+ * Gets the physical target a transient resource was assigned to by compile().
+ * @param resource resource index as returned by createTexture()
+ * @return target index (see getTargetInfo()) or NONE for imported and unused resources
+ */
+unsigned int FrameGraph::getTarget(unsigned int resource)
+{
+	if (resource >= resources.size())
+		return NONE;
+	return resources[resource].target;
+}
+
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+/**
+ * Gets the resources written by a pass, in declaration order.
+ * @param pass pass index as returned by addPass()
+ * @return list of resource indexes
+ */
+const vector<unsigned int> &FrameGraph::getWrites(unsigned int pass)
+{
+	static const vector<unsigned int> empty;
+	if (pass >= passes.size())
+		return empty;
+	return passes[pass].writes;
+}
+
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+/**
+ * Size of a texel.
+ * @param format one of the FORMAT_* values
+ * @return size in bytes, 0 for unknown formats
+ */
+unsigned int FrameGraph::getBytesPerPixel(unsigned int format)
+{
+	switch (format)
+	{
+	case FORMAT_RGBA8:	return 4;
+	case FORMAT_DEPTH24:	return 4;		// Padded by every driver
+	default:				return 0;
+	}
+}
+
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+/**
+ * Declares a texture owned by the graph.
+ * @param name name, for the reports
+ * @param sizeX width in pixels
+ * @param sizeY height in pixels
+ * @param format one of the FORMAT_* values
+ * @return resource index
+ */
+unsigned int FrameGraph::createTexture(const string &name, int sizeX, int sizeY, unsigned int format)
+{
+	Resource resource;
+	resource.name = name;
+	resource.sizeX = sizeX;
+	resource.sizeY = sizeY;
+	resource.format = format;
+	resource.imported = false;
+	resource.firstPass = NONE;
+	resource.lastPass = NONE;
+	resource.target = NONE;
+	resources.push_back(resource);
+	compiled = false;
+
+	// Done:
+	return (unsigned int)resources.size() - 1;
+}
+
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+/**
+ * Declares a texture owned outside of the graph. Passes writing imported textures are never culled.
+ * @param name name, for the reports
+ * @param sizeX width in pixels
+ * @param sizeY height in pixels
+ * @param format one of the FORMAT_* values
+ * @return resource index
+ */
+unsigned int FrameGraph::importTexture(const string &name, int sizeX, int sizeY, unsigned int format)
+{
+	unsigned int resource = createTexture(name, sizeX, sizeY, format);
+	resources[resource].imported = true;
+
+	// Done:
+	return resource;
+}
+
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+/**
+ * Appends a pass. Passes are executed in the order they are added.
+ * @param name name, for the reports
+ * @param callback rendering procedure, receives the pass index
+ * @return pass index
+ */
+unsigned int FrameGraph::addPass(const string &name, std::function<void(unsigned int)> callback)
+{
+	Pass pass;
+	pass.name = name;
+	pass.callback = callback;
+	pass.culled = false;
+	passes.push_back(pass);
+	compiled = false;
+
+	// Done:
+	return (unsigned int)passes.size() - 1;
+}
+
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+/**
+ * Declares that a pass samples a resource.
+ * @param pass pass index
+ * @param resource resource index
+ * @return true on success, false on fail
+ */
+bool FrameGraph::read(unsigned int pass, unsigned int resource)
+{
+	// Safety net:
+	if (pass >= passes.size() || resource >= resources.size())
+	{
+		std::cout << "[ERROR] Invalid params" << std::endl;
+		return false;
+	}
+
+	passes[pass].reads.push_back(resource);
+	compiled = false;
+
+	// Done:
+	return true;
+}
+
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+/**
+ * Declares that a pass renders into a resource.
+ * @param pass pass index
+ * @param resource resource index
+ * @return true on success, false on fail
+ */
+bool FrameGraph::write(unsigned int pass, unsigned int resource)
+{
+	// Safety net:
+	if (pass >= passes.size() || resource >= resources.size())
+	{
+		std::cout << "[ERROR] Invalid params" << std::endl;
+		return false;
+	}
+
+	passes[pass].writes.push_back(resource);
+	compiled = false;
+
+	// Done:
+	return true;
+}
+
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+/**
+ * Culls the unused passes, computes the lifetimes and assigns the transient resources to physical targets.
+ * @return true on success, false on fail (a transient read before being written)
+ */
+bool FrameGraph::compile()
+{
+	unsigned int nrOfPasses = (unsigned int)passes.size();
+	unsigned int nrOfResources = (unsigned int)resources.size();
+
+	// Reference counts: a pass is needed as long as one of its writes is, a resource as long as someone reads it:
+	vector<unsigned int> passRefs(nrOfPasses);
+	vector<unsigned int> resourceRefs(nrOfResources, 0);
+	for (unsigned int c = 0; c < nrOfPasses; c++)
+	{
+		passes[c].culled = false;
+		passRefs[c] = (unsigned int)passes[c].writes.size();
+		for (unsigned int r : passes[c].reads)
+			resourceRefs[r]++;
+	}
+	for (unsigned int c = 0; c < nrOfResources; c++)
+		if (resources[c].imported)
+			resourceRefs[c]++;
+
+	// Cull, starting from the resources nobody reads:
+	vector<unsigned int> unused;
+	for (unsigned int c = 0; c < nrOfResources; c++)
+		if (resourceRefs[c] == 0)
+			unused.push_back(c);
+	for (unsigned int c = 0; c < nrOfPasses; c++)
+		if (passRefs[c] == 0)
+		{
+			passes[c].culled = true;
+			for (unsigned int r : passes[c].reads)
+				if (--resourceRefs[r] == 0)
+					unused.push_back(r);
+		}
+	while (!unused.empty())
+	{
+		unsigned int resource = unused.back();
+		unused.pop_back();
+		for (unsigned int c = 0; c < nrOfPasses; c++)
+		{
+			if (passes[c].culled)
+				continue;
+			unsigned int writes = (unsigned int)std::count(passes[c].writes.begin(), passes[c].writes.end(), resource);
+			if (writes == 0)
+				continue;
+			passRefs[c] -= writes;
+			if (passRefs[c] == 0)
+			{
+				passes[c].culled = true;
+				for (unsigned int r : passes[c].reads)
+					if (--resourceRefs[r] == 0)
+						unused.push_back(r);
+			}
+		}
+	}
+
+	// Lifetimes over the surviving passes:
+	for (Resource &resource : resources)
+	{
+		resource.firstPass = NONE;
+		resource.lastPass = NONE;
+		resource.target = NONE;
+	}
+	for (unsigned int c = 0; c < nrOfPasses; c++)
+	{
+		if (passes[c].culled)
+			continue;
+		for (unsigned int r : passes[c].reads)
+			if (resources[r].firstPass == NONE && !resources[r].imported)
+			{
+				std::cout << "[ERROR] Frame graph '" << name << "': pass '" << passes[c].name << "' reads '" << resources[r].name << "' before it is written" << std::endl;
+				compiled = false;
+				return false;
+			}
+		for (unsigned int i = 0; i < 2; i++)
+			for (unsigned int r : (i ? passes[c].writes : passes[c].reads))
+			{
+				if (resources[r].firstPass == NONE)
+					resources[r].firstPass = c;
+				resources[r].lastPass = c;
+			}
+	}
+
+	// Alias: by order of first use, give each resource the first compatible target free by then:
+	vector<unsigned int> order;
+	for (unsigned int c = 0; c < nrOfResources; c++)
+		if (!resources[c].imported && resources[c].firstPass != NONE)
+			order.push_back(c);
+	std::stable_sort(order.begin(), order.end(), [this](unsigned int a, unsigned int b) { return resources[a].firstPass < resources[b].firstPass; });
+
+	targets.clear();
+	memory = 0;
+	unaliasedMemory = 0;
+	importedMemory = 0;
+	for (unsigned int r : order)
+	{
+		Resource &resource = resources[r];
+		unsigned long long size = (unsigned long long)resource.sizeX * resource.sizeY * getBytesPerPixel(resource.format);
+		unaliasedMemory += size;
+		for (unsigned int t = 0; t < targets.size() && resource.target == NONE; t++)
+			if (targets[t].sizeX == resource.sizeX && targets[t].sizeY == resource.sizeY && targets[t].format == resource.format && targets[t].lastPass < resource.firstPass)
+				resource.target = t;
+		if (resource.target == NONE)
+		{
+			Target target;
+			target.sizeX = resource.sizeX;
+			target.sizeY = resource.sizeY;
+			target.format = resource.format;
+			resource.target = (unsigned int)targets.size();
+			targets.push_back(target);
+			memory += size;
+		}
+		targets[resource.target].lastPass = resource.lastPass;
+	}
+	for (const Resource &resource : resources)
+		if (resource.imported)
+			importedMemory += (unsigned long long)resource.sizeX * resource.sizeY * getBytesPerPixel(resource.format);
+
+	// Done:
+	compiled = true;
+	return true;
+}
+
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+/**
+ * Runs the surviving passes in order.
+ * @return true on success, false if the graph is not compiled
+ */
+bool FrameGraph::execute()
+{
+	// Safety net:
+	if (!compiled)
+	{
+		std::cout << "[ERROR] Frame graph '" << name << "' not compiled" << std::endl;
+		return false;
+	}
+
+	for (unsigned int c = 0; c < passes.size(); c++)
+		if (!passes[c].culled && passes[c].callback)
+			passes[c].callback(c);
+
+	// Done:
+	return true;
+}
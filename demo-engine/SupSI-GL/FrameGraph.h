@@ -0,0 +1,109 @@
+#pragma once
+
+/**
+* Supsi-GE, frame graph class
+* Describes a frame as a list of passes, each declaring the render targets it reads and writes, instead of creating
+* FBOs and textures by hand. Targets are either transient (owned by the graph, alive only between their first and
+* last use) or imported (owned by someone else, e.g. the window or an OpenXR swapchain, and always kept).
+* compile():
+*  - culls the passes whose results are never read, walking back from the imported targets,
+*  - computes the lifetime of every transient target over the remaining passes,
+*  - aliases transients with the same size and format whose lifetimes do not overlap onto the same physical target,
+*  - reports the render target memory of the configuration.
+* The class only does the bookkeeping and does not touch OpenGL: the owner creates one texture per physical target
+* (see getTarget()) and the Fbo of each pass, execute() then calls the surviving passes in order.
+*/
+class LIB_API FrameGraph {
+	//////////
+public: //
+//////////
+
+	// Constants:
+	static const unsigned int NONE = 0xFFFFFFFF;	///< No physical target: imported or unused resources
+
+	// Enumerations:
+	enum : unsigned int ///< Target formats
+	{
+		FORMAT_RGBA8 = 0,
+		FORMAT_DEPTH24,
+
+		// Terminator:
+		FORMAT_LAST,
+	};
+
+	// Physical target:
+	struct Target
+	{
+		int sizeX, sizeY;
+		unsigned int format;
+		unsigned int lastPass;			///< Last pass using it, while aliasing
+	};
+
+	// Const/dest:
+	FrameGraph(const string &name);
+	~FrameGraph();
+
+	// Get/set:
+	inline const string &getName() { return name; }
+	inline unsigned int getNrOfPasses() { return (unsigned int)passes.size(); }
+	inline unsigned int getNrOfResources() { return (unsigned int)resources.size(); }
+	inline unsigned int getNrOfTargets() { return (unsigned int)targets.size(); }
+	inline const Target &getTargetInfo(unsigned int target) { return targets[target]; }
+	inline unsigned long long getMemory() { return memory; }
+	inline unsigned long long getUnaliasedMemory() { return unaliasedMemory; }
+	inline unsigned long long getImportedMemory() { return importedMemory; }
+	inline bool isCompiled() { return compiled; }
+	bool isCulled(unsigned int pass);
+	bool isImported(unsigned int resource);
+	unsigned int getTarget(unsigned int resource);
+	const vector<unsigned int> &getWrites(unsigned int pass);
+	static unsigned int getBytesPerPixel(unsigned int format);
+
+	// Management:
+	unsigned int createTexture(const string &name, int sizeX, int sizeY, unsigned int format);
+	unsigned int importTexture(const string &name, int sizeX, int sizeY, unsigned int format);
+	unsigned int addPass(const string &name, std::function<void(unsigned int)> callback);
+	bool read(unsigned int pass, unsigned int resource);
+	bool write(unsigned int pass, unsigned int resource);
+	bool compile();
+
+	// Rendering:
+	bool execute();
+
+
+	///////////
+private: //
+///////////
+
+	// Graph nodes:
+	struct Resource
+	{
+		string name;
+		int sizeX, sizeY;
+		unsigned int format;
+		bool imported;
+		unsigned int firstPass, lastPass;	///< Lifetime over the surviving passes
+		unsigned int target;
+	};
+
+	struct Pass
+	{
+		string name;
+		std::function<void(unsigned int)> callback;
+		vector<unsigned int> reads;
+		vector<unsigned int> writes;
+		bool culled;
+	};
+
+	// Generic data:
+	string name;
+	vector<Resource> resources;
+	vector<Pass> passes;
+	vector<Target> targets;
+	bool compiled;
+
+	// Stats:
+	unsigned long long memory;				///< Physical transient targets, after aliasing
+	unsigned long long unaliasedMemory;		///< Transient targets of the surviving passes, without aliasing
+	unsigned long long importedMemory;
+};
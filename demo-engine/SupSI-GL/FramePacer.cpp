@@ -0,0 +1,150 @@
+#include "Engine.h"
+
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+
+struct FramePacer::Data
+{
+	std::thread thread;
+	Wait wait;
+
+	//handoff between the two threads, guarded by mutex
+	std::mutex mutex;
+	std::condition_variable changed;
+	bool running = false;
+	bool ready = false;			//a waited frame is there to acquire
+	bool waiting = false;		//the acquired frame has not begun yet
+	Frame frame;
+	std::chrono::high_resolution_clock::time_point waited;
+
+	//render thread only
+	std::chrono::high_resolution_clock::time_point acquired;
+
+	std::atomic<unsigned int> frames{ 0 };
+	std::atomic<long long> waitTime{ 0 };
+	std::atomic<long long> latency{ 0 };
+};
+
+
+LIB_API FramePacer::FramePacer()
+{
+	data = new Data();
+}
+
+LIB_API FramePacer::~FramePacer()
+{
+	stop();
+	delete data;
+}
+
+void LIB_API FramePacer::start(const Wait &wait)
+{
+	stop();
+	data->wait = wait;
+	data->running = true;
+	data->ready = false;
+	data->waiting = false;
+	data->thread = std::thread(&FramePacer::run, this);
+}
+
+void LIB_API FramePacer::stop()
+{
+	{
+		std::lock_guard<std::mutex> lock(data->mutex);
+		data->running = false;
+	}
+	data->changed.notify_all();
+	if (data->thread.joinable())
+		data->thread.join();
+}
+
+bool LIB_API FramePacer::isRunning()
+{
+	std::lock_guard<std::mutex> lock(data->mutex);
+	return data->running;
+}
+
+bool LIB_API FramePacer::acquire(Frame &frame)
+{
+	auto start = std::chrono::high_resolution_clock::now();
+	std::unique_lock<std::mutex> lock(data->mutex);
+	data->changed.wait(lock, [this] { return data->ready || !data->running; });
+	if (!data->ready)
+		return false;
+
+	frame = data->frame;
+	data->ready = false;
+	data->waiting = true;
+	data->acquired = data->waited;
+	data->waitTime += std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::high_resolution_clock::now() - start).count();
+	return true;
+}
+
+void LIB_API FramePacer::begun()
+{
+	{
+		std::lock_guard<std::mutex> lock(data->mutex);
+		data->waiting = false;
+	}
+	data->changed.notify_all();
+}
+
+void LIB_API FramePacer::submitted()
+{
+	data->frames++;
+	data->latency += std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::high_resolution_clock::now() - data->acquired).count();
+}
+
+void FramePacer::run()
+{
+	while (true)
+	{
+		//one frame ahead at most: the previous one must be taken and begun
+		{
+			std::unique_lock<std::mutex> lock(data->mutex);
+			data->changed.wait(lock, [this] { return !data->running || (!data->ready && !data->waiting); });
+			if (!data->running)
+				return;
+		}
+
+		Frame frame;
+		bool ok = data->wait(frame);
+		auto waited = std::chrono::high_resolution_clock::now();
+
+		{
+			std::lock_guard<std::mutex> lock(data->mutex);
+			if (!ok)
+			{
+				std::cout << "[ERROR] Frame wait failed, frame pacing stopped" << std::endl;
+				data->running = false;
+			}
+			else
+			{
+				data->frame = frame;
+				data->waited = waited;
+				data->ready = true;
+			}
+		}
+		data->changed.notify_all();
+		if (!ok)
+			return;
+	}
+}
+
+unsigned int LIB_API FramePacer::getFrames()
+{
+	return data->frames.exchange(0);
+}
+
+long long LIB_API FramePacer::getWaitTime()
+{
+	return data->waitTime.exchange(0);
+}
+
+long long LIB_API FramePacer::getLatency()
+{
+	return data->latency.exchange(0);
+}
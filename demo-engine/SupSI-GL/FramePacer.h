@@ -0,0 +1,98 @@
+#pragma once
+
+/**
+* Supsi-GE, frame pacing thread class
+* Calls the runtime's frame wait (xrWaitFrame() for OpenXR) on its own thread, so that the render thread does not block
+* in it: while the render thread prepares and submits frame N, the pacing thread is already waiting for frame N + 1,
+* and the predicted display time of the next frame is usually available as soon as the render thread asks for it.
+*
+* The pacing thread waits for at most one frame ahead: after handing a frame to acquire() it does not call the wait
+* function again until the render thread calls begun(), as the OpenXR spec requires every xrWaitFrame() to be followed
+* by its xrBeginFrame() before the next one.
+* Frame rate and latency (from the end of the wait to the submission of the frame) are measured for the stats.
+* The class does not touch OpenGL nor OpenXR.
+*/
+class LIB_API FramePacer
+{
+public:
+	/**
+	@struct Frame
+	The result of a frame wait, times in nanoseconds of the runtime's clock
+	*/
+	struct Frame
+	{
+		long long displayTime;		///< Predicted display time of the frame
+		long long period;			///< Predicted time between two displayed frames
+		bool shouldRender;			///< False when the runtime will not display the frame's layers
+	};
+
+	/**
+	Wait function, called on the pacing thread: blocks until the runtime is ready for a new frame and fills "frame".
+	Returns false on failure, which stops the pacing thread.
+	*/
+	typedef std::function<bool(Frame &frame)> Wait;
+
+	FramePacer();
+
+	/**
+	Destructor, stops the thread
+	*/
+	~FramePacer();
+
+	/**
+	Starts the pacing thread, which immediately waits for the first frame
+	*/
+	void start(const Wait &wait);
+
+	/**
+	Stops the pacing thread, after the current wait. A frame waited but not begun is dropped.
+	*/
+	void stop();
+
+	/**
+	Returns true if the pacing thread is running
+	*/
+	bool isRunning();
+
+	/**
+	Takes the next waited frame, blocking until there is one. To be called by the render thread, followed by begun().
+	@param frame Filled with the frame
+	@return false if the pacing thread is stopped or its wait failed
+	*/
+	bool acquire(Frame &frame);
+
+	/**
+	Tells the pacing thread that the acquired frame has begun (xrBeginFrame()): it can wait for the next one
+	*/
+	void begun();
+
+	/**
+	Marks the acquired frame as submitted (xrEndFrame()), for the stats
+	*/
+	void submitted();
+
+	/**
+	Returns the number of frames submitted since the last call
+	*/
+	unsigned int getFrames();
+
+	/**
+	Returns the time the render thread spent blocked in acquire() since the last call, in microseconds
+	*/
+	long long getWaitTime();
+
+	/**
+	Returns the time spent between the end of the waits and the submissions since the last call, in microseconds:
+	divided by getFrames() it is the average latency the pacing adds to a frame
+	*/
+	long long getLatency();
+
+private:
+	/**
+	Main loop of the pacing thread
+	*/
+	void run();
+
+	struct Data;
+	Data *data;
+};
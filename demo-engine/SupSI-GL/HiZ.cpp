@@ -0,0 +1,447 @@
+#include "Engine.h"
+
+// Glew (include it before GL.h):
+#include <GL/glew.h>
+
+// C/C++:
+#include <iostream>
+
+
+// Full screen triangle, without attributes:
+static const char *reduceVertShader = R"(
+   #version 440 core
+
+   void main(void)
+   {
+      vec2 p = vec2((gl_VertexID << 1) & 2, gl_VertexID & 2);
+      gl_Position = vec4(p * 2.0f - 1.0f, 0.0f, 1.0f);
+   }
+)";
+
+// Max of the source texels covered by each destination texel, the last row and column also take the odd ones left over:
+static const char *reduceFragShader = R"(
+   #version 440 core
+
+   // Base level of the texture set to the level to reduce:
+   layout(binding = 0) uniform sampler2D source;
+
+   out float depth;
+
+   void main(void)
+   {
+      ivec2 sourceSize = textureSize(source, 0);
+      ivec2 size = max(sourceSize / 2, ivec2(1));
+      ivec2 texel = ivec2(gl_FragCoord.xy);
+      ivec2 first = texel * 2;
+      ivec2 last = min(first + 1, sourceSize - 1);
+      if (texel.x == size.x - 1)
+         last.x = sourceSize.x - 1;
+      if (texel.y == size.y - 1)
+         last.y = sourceSize.y - 1;
+
+      float z = 0.0f;
+      for (int y = first.y; y <= last.y; y++)
+         for (int x = first.x; x <= last.x; x++)
+            z = max(z, texelFetch(source, ivec2(x, y), 0).r);
+      depth = z;
+   }
+)";
+
+// Box test of every command of a view:
+static const char *cullCompShader = R"(
+   #version 440 core
+
+   layout(local_size_x = 64) in;
+
+   // Per-draw data (see IndirectBatch.h):
+   struct Draw
+   {
+      mat4 model;
+      vec4 emission;
+      vec4 ambient;
+      vec4 diffuse;
+      vec4 specular;
+      vec4 params;
+      vec4 boxMin;
+      vec4 boxMax;
+      mat4 normalMatrix;
+   };
+   layout(std430, binding = 3) readonly buffer DrawBuffer
+   {
+      Draw draws[];
+   };
+
+   // Indirect commands, written in place:
+   struct Command
+   {
+      uint count;
+      uint instanceCount;
+      uint firstIndex;
+      uint baseVertex;
+      uint baseInstance;
+   };
+   layout(std430, binding = 4) buffer CommandBuffer
+   {
+      Command commands[];
+   };
+   layout(std430, binding = 5) buffer FlagBuffer
+   {
+      uint rejected[];
+   };
+
+   layout(binding = 0) uniform sampler2D pyramid;
+
+   uniform mat4 viewProj;
+   uniform int first;
+   uniform int count;
+   uniform int phase;
+   uniform int width;
+   uniform int height;
+
+   bool visible(Draw d)
+   {
+      if (d.boxMin.w == 0.0f)
+         return true;
+
+      // Screen rectangle and nearest depth of the box:
+      mat4 m = viewProj * d.model;
+      vec3 lo = vec3(1e30f);
+      vec3 hi = vec3(-1e30f);
+      for (int c = 0; c < 8; c++)
+      {
+         vec3 corner = vec3((c & 1) != 0 ? d.boxMax.x : d.boxMin.x, (c & 2) != 0 ? d.boxMax.y : d.boxMin.y, (c & 4) != 0 ? d.boxMax.z : d.boxMin.z);
+         vec4 p = m * vec4(corner, 1.0f);
+         if (p.w <= 1e-4f)
+            return true;
+         lo = min(lo, p.xyz / p.w);
+         hi = max(hi, p.xyz / p.w);
+      }
+
+      // Outside the view: left to the frustum culling
+      if (lo.x > 1.0f || lo.y > 1.0f || hi.x < -1.0f || hi.y < -1.0f)
+         return true;
+
+      // Rectangle in level 0 texels (half resolution), then the level where it spans at most 2x2 texels:
+      vec2 size = vec2(width, height) * 0.5f;
+      vec2 texMin = clamp(lo.xy * 0.5f + 0.5f, 0.0f, 1.0f) * size;
+      vec2 texMax = clamp(hi.xy * 0.5f + 0.5f, 0.0f, 1.0f) * size;
+      float extent = max(texMax.x - texMin.x, texMax.y - texMin.y);
+      int level = clamp(int(ceil(log2(max(extent, 1.0f)))), 0, textureQueryLevels(pyramid) - 1);
+
+      ivec2 levelSize = textureSize(pyramid, level);
+      ivec2 t0 = min(ivec2(texMin) >> level, levelSize - 1);
+      ivec2 t1 = min(ivec2(texMax) >> level, levelSize - 1);
+      float zMax = 0.0f;
+      for (int y = t0.y; y <= t1.y; y++)
+         for (int x = t0.x; x <= t1.x; x++)
+            zMax = max(zMax, texelFetch(pyramid, ivec2(x, y), level).r);
+      return lo.z * 0.5f + 0.5f <= zMax;
+   }
+
+   void main(void)
+   {
+      uint i = gl_GlobalInvocationID.x;
+      if (i >= uint(count))
+         return;
+
+      uint c = uint(first) + i;
+      bool pass = visible(draws[commands[c].baseInstance]);
+      if (phase == 0)
+      {
+         commands[c].instanceCount = pass ? 1u : 0u;
+         rejected[c] = pass ? 0u : 1u;
+      }
+      else
+         commands[c].instanceCount = (pass && rejected[c] != 0u) ? 1u : 0u;
+   }
+)";
+
+
+HiZ::HiZ()
+	: flagBuffer{ 0 }
+	, flagCapacity{ 0 }
+	, reduceVs{ nullptr }
+	, reduceFs{ nullptr }
+	, reduce{ nullptr }
+	, cullCs{ nullptr }
+	, cullProgram{ nullptr }
+{
+	for (unsigned int v = 0; v < Culling::MAX_VIEWS; v++)
+	{
+		viewProj[v] = glm::mat4(1.0f);
+		sizeX[v] = 0;
+		sizeY[v] = 0;
+		levels[v] = 0;
+		depth[v] = 0;
+		pyramid[v] = 0;
+	}
+
+	// Allocate OGL data:
+	glGenBuffers(1, &flagBuffer);
+	glGenVertexArrays(1, &vao);
+}
+
+HiZ::~HiZ()
+{
+	for (unsigned int v = 0; v < Culling::MAX_VIEWS; v++)
+	{
+		for (Fbo *f : fbo[v])
+			delete f;
+		glDeleteTextures(1, &depth[v]);
+		glDeleteTextures(1, &pyramid[v]);
+	}
+	glDeleteBuffers(1, &flagBuffer);
+	glDeleteVertexArrays(1, &vao);
+	delete reduce;
+	delete reduceVs;
+	delete reduceFs;
+	delete cullProgram;
+	delete cullCs;
+}
+
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+/**
+ * Compiles the reduction and culling shaders.
+ * @return true on success, false on fail
+ */
+bool HiZ::init()
+{
+	reduceVs = new Shader();
+	reduceFs = new Shader();
+	if (!reduceVs->loadFromMemory(Shader::TYPE_VERTEX, reduceVertShader) || !reduceFs->loadFromMemory(Shader::TYPE_FRAGMENT, reduceFragShader))
+		return false;
+	reduce = new Program{ reduceVs, reduceFs };
+	if (!reduce->build())
+		return false;
+
+	cullCs = new Shader();
+	if (!cullCs->loadFromMemory(Shader::TYPE_COMPUTE, cullCompShader))
+		return false;
+	cullProgram = new Program{ cullCs };
+	if (!cullProgram->build())
+		return false;
+	cullProgram->bindLocation(Location::CULL_VIEW_PROJECTION, "viewProj");
+	cullProgram->bindLocation(Location::CULL_FIRST, "first");
+	cullProgram->bindLocation(Location::CULL_COUNT, "count");
+	cullProgram->bindLocation(Location::CULL_PHASE, "phase");
+	cullProgram->bindLocation(Location::CULL_WIDTH, "width");
+	cullProgram->bindLocation(Location::CULL_HEIGHT, "height");
+
+	// Done:
+	return true;
+}
+
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+/**
+ * Sets the matrices of the views for the current frame.
+ * @param viewProj the projection * view matrix of each view
+ * @param views number of views, at most Culling::MAX_VIEWS
+ */
+void HiZ::begin(const glm::mat4 *viewProj, unsigned int views)
+{
+	views = glm::min(views, Culling::MAX_VIEWS);
+	for (unsigned int v = 0; v < views; v++)
+		this->viewProj[v] = viewProj[v];
+}
+
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+/**
+ * (Re)allocates the pyramid of a view when the size of its depth buffer changes. A new pyramid is cleared to the far
+ * plane, so that everything passes the test until it is built.
+ * The framebuffer and the viewport are preserved.
+ * @param view the view index
+ * @param width width of the depth buffer
+ * @param height height of the depth buffer
+ * @return true on success, false on fail
+ */
+bool HiZ::resize(unsigned int view, int width, int height)
+{
+	if (width == sizeX[view] && height == sizeY[view])
+		return true;
+
+	GLint viewport[4];
+	GLint drawFbo;
+	glGetIntegerv(GL_VIEWPORT, viewport);
+	glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &drawFbo);
+
+	// Release the previous size:
+	for (Fbo *f : fbo[view])
+		delete f;
+	fbo[view].clear();
+	glDeleteTextures(1, &depth[view]);
+	glDeleteTextures(1, &pyramid[view]);
+
+	sizeX[view] = width;
+	sizeY[view] = height;
+	int levelX = glm::max(width / 2, 1);
+	int levelY = glm::max(height / 2, 1);
+	levels[view] = 1;
+	while (levels[view] < MAX_LEVELS && glm::max(levelX >> levels[view], levelY >> levels[view]) > 0)
+		levels[view]++;
+
+	// Depth copy:
+	glGenTextures(1, &depth[view]);
+	glBindTexture(GL_TEXTURE_2D, depth[view]);
+	glTexStorage2D(GL_TEXTURE_2D, 1, GL_DEPTH_COMPONENT24, width, height);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_COMPARE_MODE, GL_NONE);
+
+	// Pyramid, cleared to the far plane:
+	glGenTextures(1, &pyramid[view]);
+	glBindTexture(GL_TEXTURE_2D, pyramid[view]);
+	glTexStorage2D(GL_TEXTURE_2D, levels[view], GL_R32F, levelX, levelY);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST_MIPMAP_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	float farDepth = 1.0f;
+	for (unsigned int l = 0; l < levels[view]; l++)
+	{
+		glClearTexImage(pyramid[view], l, GL_RED, GL_FLOAT, &farDepth);
+
+		Fbo *f = new Fbo();
+		f->bindTexture(0, Fbo::BIND_COLORTEXTURE, pyramid[view], 0, l);
+		if (!f->isOk())
+		{
+			std::cout << "[ERROR] Invalid Hi-Z level " << l << std::endl;
+			delete f;
+			sizeX[view] = sizeY[view] = 0;
+			glBindTexture(GL_TEXTURE_2D, 0);
+			glBindFramebuffer(GL_FRAMEBUFFER, drawFbo);
+			glViewport(viewport[0], viewport[1], viewport[2], viewport[3]);
+			return false;
+		}
+		fbo[view].push_back(f);
+	}
+	glBindTexture(GL_TEXTURE_2D, 0);
+
+	glBindFramebuffer(GL_FRAMEBUFFER, drawFbo);
+	glViewport(viewport[0], viewport[1], viewport[2], viewport[3]);
+
+	// Done:
+	return true;
+}
+
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+/**
+ * Builds the pyramid of a view from the depth buffer of the bound framebuffer, within the current viewport.
+ * The framebuffer and the viewport are preserved.
+ * @param view the view index
+ * @return true on success, false on fail
+ */
+bool HiZ::build(unsigned int view)
+{
+	// Safety net:
+	if (view >= Culling::MAX_VIEWS || reduce == nullptr)
+	{
+		std::cout << "[ERROR] Invalid params" << std::endl;
+		return false;
+	}
+
+	GLint viewport[4];
+	GLint drawFbo;
+	glGetIntegerv(GL_VIEWPORT, viewport);
+	glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &drawFbo);
+	if (!resize(view, viewport[2], viewport[3]))
+		return false;
+
+	// Copy the depth buffer:
+	glBindFramebuffer(GL_READ_FRAMEBUFFER, drawFbo);
+	glBindTexture(GL_TEXTURE_2D, depth[view]);
+	glCopyTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, viewport[0], viewport[1], viewport[2], viewport[3]);
+
+	// Reduce it, one level at a time (the source level is isolated through the base and max levels):
+	GLboolean depthTest = glIsEnabled(GL_DEPTH_TEST);
+	glDisable(GL_DEPTH_TEST);
+	reduce->render();
+	glBindVertexArray(vao);
+	for (unsigned int l = 0; l < levels[view]; l++)
+	{
+		if (l > 0)
+		{
+			glBindTexture(GL_TEXTURE_2D, pyramid[view]);
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, l - 1);
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, l - 1);
+		}
+		fbo[view][l]->render();
+		glDrawArrays(GL_TRIANGLES, 0, 3);
+	}
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, 0);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, levels[view] - 1);
+	glBindTexture(GL_TEXTURE_2D, 0);
+	glBindVertexArray(0);
+
+	// Back to the view:
+	if (depthTest)
+		glEnable(GL_DEPTH_TEST);
+	glBindFramebuffer(GL_FRAMEBUFFER, drawFbo);
+	glViewport(viewport[0], viewport[1], viewport[2], viewport[3]);
+
+	// Done:
+	return true;
+}
+
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+/**
+ * Tests the commands of a view against its pyramid, writing their instance counts.
+ * The batch must have been uploaded for this frame.
+ * @param batch the indirect batch about to be rendered
+ * @param view the view index
+ * @param phase PHASE_REUSE before the first draw, PHASE_RETEST after build()
+ * @return true on success, false on fail
+ */
+bool HiZ::cull(IndirectBatch &batch, unsigned int view, unsigned int phase)
+{
+	// Safety net:
+	if (view >= Culling::MAX_VIEWS || cullProgram == nullptr)
+	{
+		std::cout << "[ERROR] Invalid params" << std::endl;
+		return false;
+	}
+	unsigned int first = batch.getFirstCommand(view);
+	unsigned int count = batch.getCommandCount(view);
+	if (count == 0)
+		return true;
+
+	// A view without a pyramid of the right size gets a cleared one:
+	GLint viewport[4];
+	glGetIntegerv(GL_VIEWPORT, viewport);
+	if (!resize(view, viewport[2], viewport[3]))
+		return false;
+
+	// Rejection flags, one per command of every view:
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, flagBuffer);
+	if (first + count > flagCapacity)
+	{
+		flagCapacity = glm::max(glm::max(first + count, flagCapacity * 2), 64u);
+		glBufferData(GL_SHADER_STORAGE_BUFFER, flagCapacity * sizeof(unsigned int), nullptr, GL_DYNAMIC_COPY);
+	}
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+
+	cullProgram->render();
+	cullProgram->setMatrix(Location::CULL_VIEW_PROJECTION, viewProj[view]);
+	cullProgram->setInt(Location::CULL_FIRST, (int)first);
+	cullProgram->setInt(Location::CULL_COUNT, (int)count);
+	cullProgram->setInt(Location::CULL_PHASE, (int)phase);
+	cullProgram->setInt(Location::CULL_WIDTH, sizeX[view]);
+	cullProgram->setInt(Location::CULL_HEIGHT, sizeY[view]);
+	batch.getDrawSsbo().render(Ssbo::BINDING_DRAWS);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, Ssbo::BINDING_COMMANDS, batch.getIndirectBuffer());
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, Ssbo::BINDING_CULL_FLAGS, flagBuffer);
+	glBindTexture(GL_TEXTURE_2D, pyramid[view]);
+
+	glDispatchCompute((count + 63) / 64, 1, 1);
+
+	// The commands are read by the next glMultiDrawElementsIndirect():
+	glMemoryBarrier(GL_COMMAND_BARRIER_BIT | GL_SHADER_STORAGE_BARRIER_BIT);
+	glBindTexture(GL_TEXTURE_2D, 0);
+
+	// Done:
+	return true;
+}
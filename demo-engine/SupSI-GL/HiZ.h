@@ -0,0 +1,73 @@
+#pragma once
+
+/**
+* Supsi-GE, GPU hierarchical-Z occlusion culling class
+* Each view keeps a max-depth mip pyramid (R32F, level 0 at half the resolution of the view) built from its depth
+* buffer, one Fbo per level. A compute shader tests the bounding box of every indirect command of a view (see
+* IndirectBatch.h) against the pyramid and writes the result into the command's instance count, so that hidden meshes
+* are skipped by glMultiDrawElementsIndirect() without any read back.
+* Culling runs in two phases per view, reusing the previous frame:
+*  - PHASE_REUSE tests the commands against last frame's pyramid; the survivors are drawn,
+*  - the pyramid is rebuilt from the resulting depth buffer,
+*  - PHASE_RETEST tests the commands rejected by the first phase against the new pyramid and draws only the
+*    newly visible ones.
+* Since the second pyramid holds only geometry actually drawn in this frame, nothing visible is ever lost.
+*/
+class LIB_API HiZ {
+	//////////
+public: //
+//////////
+
+	// Constants:
+	static const unsigned int MAX_LEVELS = 16;		///< Enough for 65536 pixels
+
+	// Enumerations:
+	enum : unsigned int ///< Culling phases
+	{
+		PHASE_REUSE = 0,
+		PHASE_RETEST,
+	};
+
+	// Const/dest:
+	HiZ();
+	~HiZ();
+
+	// Get/set:
+	inline unsigned int getLevels(unsigned int view) { return view < Culling::MAX_VIEWS ? levels[view] : 0; }
+	inline unsigned int getPyramid(unsigned int view) { return view < Culling::MAX_VIEWS ? pyramid[view] : 0; }
+
+	// Management:
+	bool init();
+	void begin(const glm::mat4 *viewProj, unsigned int views);
+	bool build(unsigned int view);
+
+	// Rendering:
+	bool cull(IndirectBatch &batch, unsigned int view, unsigned int phase);
+
+
+	///////////
+private: //
+///////////
+
+	// Internal methods:
+	bool resize(unsigned int view, int width, int height);
+
+	// Generic data:
+	glm::mat4 viewProj[Culling::MAX_VIEWS];
+	int sizeX[Culling::MAX_VIEWS];					///< Size of the depth buffer each pyramid was built for
+	int sizeY[Culling::MAX_VIEWS];
+	unsigned int levels[Culling::MAX_VIEWS];
+
+	// OGL stuff:
+	unsigned int depth[Culling::MAX_VIEWS];			///< Copy of the depth buffer of each view
+	unsigned int pyramid[Culling::MAX_VIEWS];		///< Mipmapped max-depth texture of each view
+	vector<Fbo *> fbo[Culling::MAX_VIEWS];			///< One per pyramid level
+	unsigned int flagBuffer;						///< Commands rejected by PHASE_REUSE
+	unsigned int flagCapacity;
+	unsigned int vao;								///< Empty, for the full screen triangle
+	Shader *reduceVs;
+	Shader *reduceFs;
+	Program *reduce;
+	Shader *cullCs;
+	Program *cullProgram;
+};
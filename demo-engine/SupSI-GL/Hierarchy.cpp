@@ -0,0 +1,178 @@
+#include "Engine.h"
+
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#define HIERARCHY_SSE
+#include <xmmintrin.h>
+#endif
+
+
+LIB_API Hierarchy::Hierarchy()
+{
+}
+
+void LIB_API Hierarchy::multiply(const glm::mat4 &a, const glm::mat4 &b, glm::mat4 &result)
+{
+#ifdef HIERARCHY_SSE
+	//column j of the result is a * b[j], a linear combination of the columns of a
+	const __m128 a0 = _mm_loadu_ps(&a[0][0]);
+	const __m128 a1 = _mm_loadu_ps(&a[1][0]);
+	const __m128 a2 = _mm_loadu_ps(&a[2][0]);
+	const __m128 a3 = _mm_loadu_ps(&a[3][0]);
+	for (int j = 0; j < 4; j++)
+	{
+		__m128 c = _mm_mul_ps(a0, _mm_set1_ps(b[j][0]));
+		c = _mm_add_ps(c, _mm_mul_ps(a1, _mm_set1_ps(b[j][1])));
+		c = _mm_add_ps(c, _mm_mul_ps(a2, _mm_set1_ps(b[j][2])));
+		c = _mm_add_ps(c, _mm_mul_ps(a3, _mm_set1_ps(b[j][3])));
+		_mm_storeu_ps(&result[j][0], c);
+	}
+#else
+	result = a * b;
+#endif
+}
+
+void LIB_API Hierarchy::build(Node *root)
+{
+	this->root = root;
+	version = Node::getStructureVersion();
+	nodes.clear();
+	parents.clear();
+
+	//depth first, children pushed in reverse to keep their order
+	stack.clear();
+	stack.emplace_back(root, (unsigned int)NO_PARENT);
+	while (!stack.empty())
+	{
+		Node *node = stack.back().first;
+		unsigned int parent = stack.back().second;
+		stack.pop_back();
+
+		unsigned int index = (unsigned int)nodes.size();
+		nodes.push_back(node);
+		parents.push_back(parent);
+		const vector<Node*> &children = node->getChildren();
+		for (size_t c = children.size(); c > 0; c--)
+			stack.emplace_back(children[c - 1], index);
+	}
+
+	//a subtree ends where the last one of its children ends
+	unsigned int count = (unsigned int)nodes.size();
+	ends.resize(count);
+	for (unsigned int i = 0; i < count; i++)
+		ends[i] = i + 1;
+	for (unsigned int i = count - 1; i > 0; i--)
+		ends[parents[i]] = glm::max(ends[parents[i]], ends[i]);
+
+	local.resize(count);
+	world.resize(count);
+	partition();
+}
+
+bool LIB_API Hierarchy::isBuilt(Node *root)
+{
+	return root == this->root && version == Node::getStructureVersion();
+}
+
+void LIB_API Hierarchy::partition()
+{
+	spine.clear();
+	ranges.clear();
+	unsigned int count = (unsigned int)nodes.size();
+	unsigned int threads = getThreads();
+	if (threads < 2 || count < MIN_PARALLEL_NODES)
+		return;
+
+	//subtrees small enough become ranges, the nodes above them are the spine
+	unsigned int target = glm::max(count / (4 * threads), 1u);
+	for (unsigned int i = 0; i < count;)
+	{
+		if (ends[i] - i <= target)
+		{
+			ranges.push_back({ i, ends[i] });
+			i = ends[i];
+		}
+		else
+			spine.push_back(i++);
+	}
+}
+
+void Hierarchy::pass(const glm::mat4 &base, unsigned int begin, unsigned int end, bool gather)
+{
+	if (gather)
+		for (unsigned int i = begin; i < end; i++)
+			local[i] = nodes[i]->getPosMatrix();
+
+	//only the root has no parent
+	if (begin == 0 && begin < end)
+		multiply(base, local[begin++], world[0]);
+	for (unsigned int i = begin; i < end; i++)
+		multiply(world[parents[i]], local[i], world[i]);
+}
+
+void Hierarchy::forward(const glm::mat4 &base, bool gather)
+{
+	if (ranges.empty())
+	{
+		pass(base, 0, getCount(), gather);
+		return;
+	}
+
+	for (unsigned int i : spine)
+		pass(base, i, i + 1, gather);
+	jobs->parallelFor("transforms", (unsigned int)ranges.size(), 1, [&](unsigned int begin, unsigned int end)
+	{
+		for (unsigned int r = begin; r < end; r++)
+			pass(base, ranges[r].begin, ranges[r].end, gather);
+	});
+}
+
+void LIB_API Hierarchy::update(const glm::mat4 &base)
+{
+	forward(base, true);
+}
+
+void LIB_API Hierarchy::computeWorld(const glm::mat4 &base)
+{
+	forward(base, false);
+}
+
+unsigned int LIB_API Hierarchy::getCount()
+{
+	return (unsigned int)nodes.size();
+}
+
+Node LIB_API * Hierarchy::getNode(unsigned int index)
+{
+	return nodes[index];
+}
+
+unsigned int LIB_API Hierarchy::getParent(unsigned int index)
+{
+	return parents[index];
+}
+
+unsigned int LIB_API Hierarchy::getSubtreeEnd(unsigned int index)
+{
+	return ends[index];
+}
+
+glm::mat4 LIB_API * Hierarchy::getLocal()
+{
+	return local.data();
+}
+
+const glm::mat4 LIB_API * Hierarchy::getWorld()
+{
+	return world.data();
+}
+
+unsigned int LIB_API Hierarchy::getThreads()
+{
+	return jobs != nullptr ? jobs->getThreads() : 1;
+}
+
+void LIB_API Hierarchy::setJobSystem(JobSystem *jobs)
+{
+	this->jobs = jobs;
+	partition();
+}
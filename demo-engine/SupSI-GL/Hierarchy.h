@@ -0,0 +1,135 @@
+#pragma once
+
+/**
+* Supsi-GE, flattened transform hierarchy class
+* The subtree of a scene node is linearized in depth-first order: every node comes after its parent, which is
+* referenced by index, and the subtree of a node is the contiguous range [i, getSubtreeEnd(i)). Local and world
+* matrices are stored in contiguous arrays, so that all the world matrices are computed by a single forward pass
+* (world[i] = world[parent[i]] * local[i]) with SSE 4x4 multiplies instead of one recursive call per node.
+*
+* With a JobSystem (see setJobSystem()), the array is split into subtrees of at most about getCount() / (4 * threads)
+* nodes. The nodes above them (the "spine") are computed first, then the subtrees run as jobs, which only read their
+* own nodes and the spine: the result does not depend on the number of threads.
+* The linearization must be rebuilt when the tree changes, see isBuilt(). The class does not touch OpenGL.
+*/
+class LIB_API Hierarchy
+{
+public:
+	static const unsigned int NO_PARENT = 0xFFFFFFFF;		///< Parent index of the root
+	static const unsigned int MIN_PARALLEL_NODES = 8192;	///< Smaller hierarchies are always updated on one thread
+
+	/**
+	Constructor
+	*/
+	Hierarchy();
+
+	/**
+	Linearizes the subtree of a node
+	@param root The node, it does not need to be the root of the scene
+	*/
+	void build(Node *root);
+
+	/**
+	Returns true if the hierarchy was built from "root" and no node was reparented, detached or destroyed since then
+	@param root The node
+	*/
+	bool isBuilt(Node *root);
+
+	/**
+	Reads the local matrix of every node and computes the world matrices
+	@param base World matrix of the root's parent, identity for the scene root
+	*/
+	void update(const glm::mat4 &base);
+
+	/**
+	Computes the world matrices from the local matrices already stored, without reading the nodes
+	@param base World matrix of the root's parent, identity for the scene root
+	*/
+	void computeWorld(const glm::mat4 &base);
+
+	/**
+	Returns the number of nodes
+	*/
+	unsigned int getCount();
+
+	/**
+	Returns the node at an index, in depth-first order
+	*/
+	Node* getNode(unsigned int index);
+
+	/**
+	Returns the parent index of a node, NO_PARENT for the root
+	*/
+	unsigned int getParent(unsigned int index);
+
+	/**
+	Returns the index following the last node of a node's subtree
+	*/
+	unsigned int getSubtreeEnd(unsigned int index);
+
+	/**
+	Returns the local matrices, one per node. They can be changed before computeWorld().
+	*/
+	glm::mat4* getLocal();
+
+	/**
+	Returns the world matrices of the last update, one per node
+	*/
+	const glm::mat4* getWorld();
+
+	/**
+	Returns the number of update threads
+	*/
+	unsigned int getThreads();
+
+	/**
+	Runs the subtrees on the threads of a job system, nullptr to update on the calling thread only
+	*/
+	void setJobSystem(JobSystem *jobs);
+
+	/**
+	Returns a * b, with SSE when available
+	*/
+	static void multiply(const glm::mat4 &a, const glm::mat4 &b, glm::mat4 &result);
+
+private:
+	/**
+	@struct Range
+	Nodes [begin, end), a set of whole subtrees
+	*/
+	struct Range
+	{
+		unsigned int begin;
+		unsigned int end;
+	};
+
+	/**
+	Splits the nodes between the spine and the ranges run as jobs
+	*/
+	void partition();
+
+	/**
+	Runs the forward pass over the nodes [begin, end), reading the local matrices first when "gather" is set.
+	The parents of the nodes must be in the range or already computed.
+	*/
+	void pass(const glm::mat4 &base, unsigned int begin, unsigned int end, bool gather);
+
+	/**
+	Runs the spine, then the ranges
+	*/
+	void forward(const glm::mat4 &base, bool gather);
+
+	JobSystem *jobs = nullptr;
+	Node *root = nullptr;
+	unsigned int version = 0;			///< Node::getStructureVersion() when built
+
+	vector<Node*> nodes;
+	vector<unsigned int> parents;
+	vector<unsigned int> ends;			///< Subtree ends
+	vector<glm::mat4> local;
+	vector<glm::mat4> world;
+
+	vector<unsigned int> spine;			///< Nodes above the ranges, computed first on one thread
+	vector<Range> ranges;
+	vector<std::pair<Node*, unsigned int>> stack;	///< Scratch for build()
+};
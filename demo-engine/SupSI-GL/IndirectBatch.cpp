@@ -0,0 +1,269 @@
+#include "Engine.h"
+
+// Glew (include it before GL.h):
+#include <GL/glew.h>
+
+// C/C++:
+#include <algorithm>
+#include <iostream>
+
+
+IndirectBatch::IndirectBatch(MeshPool *pool)
+	: pool{ pool }
+	, owner{ nullptr }
+	, viewGroups{}
+	, indirectCapacity{ 0 }
+	, drawIdCapacity{ 0 }
+{
+	// Allocate OGL data:
+	glGenBuffers(1, &indirectBuffer);
+	glGenBuffers(1, &drawIdBuffer);
+}
+
+IndirectBatch::~IndirectBatch()
+{
+	glDeleteBuffers(1, &indirectBuffer);
+	glDeleteBuffers(1, &drawIdBuffer);
+}
+
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+/**
+ * Starts a new batch.
+ * @param owner the list the batch is going to be built from, see getOwner()
+ */
+void IndirectBatch::clear(const void *owner)
+{
+	this->owner = owner;
+	items.clear();
+}
+
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+/**
+ * Adds a mesh to the batch. Meshes that are not in the pool are ignored.
+ * @param mesh the mesh
+ * @param model its world matrix
+ * @param viewMask views in which the mesh is visible, one bit per view
+ */
+void IndirectBatch::add(Mesh *mesh, const glm::mat4 &model, unsigned int viewMask)
+{
+	if (mesh->getPoolEntry() == MeshPool::INVALID_ENTRY || viewMask == 0)
+		return;
+
+	Item item;
+	item.mesh = mesh;
+	item.texture = mesh->getMaterial() ? mesh->getMaterial()->getTexture() : nullptr;
+	item.features = mesh->getShaderFeatures();
+	item.viewMask = viewMask;
+	item.order = (unsigned int)items.size();
+	item.model = model;
+	items.push_back(item);
+}
+
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+/**
+ * Sorts the meshes added since clear() into groups and uploads the commands and the per-draw data.
+ * @param views number of views to build commands for, at most Culling::MAX_VIEWS
+ * @param instances instances of each command, sharing the same draw data (2 for instanced stereo)
+ * @return true on success, false on fail
+ */
+bool IndirectBatch::upload(unsigned int views, unsigned int instances)
+{
+	views = glm::min(views, Culling::MAX_VIEWS);
+
+	//grouped by features and texture; "order" is the position in the render queue the items were added from (see
+	//List::sortQueue()), so within a group the commands keep the queue's order, front to back when it is depth sorted
+	std::sort(items.begin(), items.end(), [](const Item &a, const Item &b) {
+		if (a.features != b.features)
+			return a.features < b.features;
+		if (a.texture != b.texture)
+			return a.texture < b.texture;
+		return a.order < b.order;
+	});
+
+	draws.clear();
+	commands.clear();
+	groups.clear();
+	for (const Item &item : items)
+	{
+		DrawData d;
+		d.model = item.model;
+		Material *m = item.mesh->getMaterial();
+		if (m)
+		{
+			d.emission = m->getEmission();
+			d.ambient = m->getAmbient();
+			d.diffuse = m->getDiffuse();
+			d.specular = m->getSpecular();
+			d.params = glm::vec4((float)m->getShininess(), 0.0f, 0.0f, 0.0f);
+		}
+		else
+		{
+			// Same defaults as a new Material:
+			d.emission = glm::vec4(0.0f, 0.0f, 0.0f, 0.0f);
+			d.ambient = glm::vec4(0.8f, 0.8f, 0.8f, 0.8f);
+			d.diffuse = glm::vec4(0.5f, 0.5f, 0.5f, 1.0f);
+			d.specular = glm::vec4(0.5f, 0.5f, 0.5f, 1.0f);
+			d.params = glm::vec4(128.0f, 0.0f, 0.0f, 0.0f);
+		}
+
+		// Bounds, for the GPU occlusion culling:
+		float hasBounds = item.mesh->getRadius() < 0.0f ? 0.0f : 1.0f;
+		d.boxMin = glm::vec4(item.mesh->getBoxMin(), hasBounds);
+		d.boxMax = glm::vec4(item.mesh->getBoxMax(), hasBounds);
+		d.normalMatrix = glm::mat4(item.mesh->getTransform()->getNormalMatrix());
+
+		draws.push_back(d);
+	}
+
+	// Commands of each view, back to back:
+	for (unsigned int v = 0; v < views; v++)
+	{
+		viewGroups[v] = (unsigned int)groups.size();
+		for (unsigned int i = 0; i < items.size(); i++)
+		{
+			const Item &item = items[i];
+			if (!(item.viewMask & (1u << v)))
+				continue;
+
+			const MeshPool::Entry &e = pool->getEntry(item.mesh->getPoolEntry());
+			Command c;
+			c.count = e.indexCount;
+			c.instanceCount = instances;
+			c.firstIndex = e.firstIndex;
+			c.baseVertex = e.baseVertex;
+			c.baseInstance = i;
+
+			if (groups.size() == viewGroups[v] || groups.back().texture != item.texture || groups.back().features != item.features)
+				groups.push_back({ item.texture, item.features, (unsigned int)commands.size(), 0 });
+			groups.back().count++;
+			commands.push_back(c);
+		}
+	}
+	for (unsigned int v = views; v <= Culling::MAX_VIEWS; v++)
+		viewGroups[v] = (unsigned int)groups.size();
+
+	if (!drawSsbo.update(draws.data(), (unsigned int)(draws.size() * sizeof(DrawData))))
+		return false;
+
+	// Commands, reallocated only when growing:
+	glBindBuffer(GL_DRAW_INDIRECT_BUFFER, indirectBuffer);
+	if (commands.size() > indirectCapacity || indirectCapacity == 0)
+	{
+		indirectCapacity = glm::max(glm::max((unsigned int)commands.size(), indirectCapacity * 2), 64u);
+		glBufferData(GL_DRAW_INDIRECT_BUFFER, indirectCapacity * sizeof(Command), nullptr, GL_DYNAMIC_DRAW);
+	}
+	glBufferSubData(GL_DRAW_INDIRECT_BUFFER, 0, commands.size() * sizeof(Command), commands.data());
+	glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+
+	// Draw IDs are constant (0, 1, 2...), they only need to cover the draws:
+	if (draws.size() > drawIdCapacity)
+	{
+		drawIdCapacity = glm::max(glm::max((unsigned int)draws.size(), drawIdCapacity * 2), 64u);
+		vector<unsigned int> ids(drawIdCapacity);
+		for (unsigned int c = 0; c < drawIdCapacity; c++)
+			ids[c] = c;
+		glBindBuffer(GL_ARRAY_BUFFER, drawIdBuffer);
+		glBufferData(GL_ARRAY_BUFFER, drawIdCapacity * sizeof(unsigned int), ids.data(), GL_STATIC_DRAW);
+		glBindBuffer(GL_ARRAY_BUFFER, 0);
+		pool->setDrawIds(drawIdBuffer);
+	}
+	pool->setDrawIdDivisor(instances);
+
+	// Done:
+	return true;
+}
+
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+/**
+ * Returns the position of the first command of a view in the indirect buffer.
+ * @param view the view index
+ * @return the command index
+ */
+unsigned int IndirectBatch::getFirstCommand(unsigned int view)
+{
+	if (view >= Culling::MAX_VIEWS || viewGroups[view] == viewGroups[view + 1])
+		return 0;
+	return groups[viewGroups[view]].first;
+}
+
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+/**
+ * Returns the number of commands of a view, stored back to back from getFirstCommand().
+ * @param view the view index
+ * @return the number of commands
+ */
+unsigned int IndirectBatch::getCommandCount(unsigned int view)
+{
+	if (view >= Culling::MAX_VIEWS || viewGroups[view] == viewGroups[view + 1])
+		return 0;
+	const Group &last = groups[viewGroups[view + 1] - 1];
+	return last.first + last.count - groups[viewGroups[view]].first;
+}
+
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+/**
+ * Submits the commands of a view, one glMultiDrawElementsIndirect() per group.
+ * The frame block and the light buffers must already be bound.
+ * @param lightKey light part of the shader variant key (see ShaderCache::getLightKey())
+ * @param view the view index
+ * @return the number of draw calls issued
+ */
+unsigned int IndirectBatch::render(unsigned int lightKey, unsigned int view)
+{
+	if (view >= Culling::MAX_VIEWS || viewGroups[view] == viewGroups[view + 1])
+		return 0;
+
+	ShaderCache *shaders = Engine::getInstance().getShaderCache();
+	pool->render();
+	drawSsbo.render(Ssbo::BINDING_DRAWS);
+	glBindBuffer(GL_DRAW_INDIRECT_BUFFER, indirectBuffer);
+
+	for (unsigned int c = viewGroups[view]; c < viewGroups[view + 1]; c++)
+	{
+		const Group &g = groups[c];
+		shaders->render(lightKey | g.features | ShaderCache::FEATURE_INDIRECT);
+		if (g.texture)
+			g.texture->render();
+		glMultiDrawElementsIndirect(GL_TRIANGLES, GL_UNSIGNED_INT, (void *)(g.first * sizeof(Command)), g.count, 0);
+	}
+	shaders->finish();
+
+	glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+	glBindVertexArray(0);
+	return viewGroups[view + 1] - viewGroups[view];
+}
+
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+/**
+ * Submits the commands of a view into the depth buffer only, with a single glMultiDrawElementsIndirect():
+ * depth-only variants ignore texture and material, so groups do not matter.
+ * @param view the view index
+ * @param features extra feature bits of the variant, e.g. ShaderCache::FEATURE_MULTIVIEW
+ * @return the number of draw calls issued
+ */
+unsigned int IndirectBatch::renderDepth(unsigned int view, unsigned int features)
+{
+	unsigned int count = getCommandCount(view);
+	if (count == 0)
+		return 0;
+
+	ShaderCache *shaders = Engine::getInstance().getShaderCache();
+	pool->render();
+	drawSsbo.render(Ssbo::BINDING_DRAWS);
+	glBindBuffer(GL_DRAW_INDIRECT_BUFFER, indirectBuffer);
+
+	shaders->render(features | ShaderCache::FEATURE_DEPTH_ONLY | ShaderCache::FEATURE_INDIRECT);
+	glMultiDrawElementsIndirect(GL_TRIANGLES, GL_UNSIGNED_INT, (void *)(getFirstCommand(view) * sizeof(Command)), count, 0);
+	shaders->finish();
+
+	glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+	glBindVertexArray(0);
+	return 1;
+}
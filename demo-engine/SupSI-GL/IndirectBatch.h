@@ -0,0 +1,115 @@
+#pragma once
+
+/**
+@struct DrawData
+std430 mirror of the "Draw" structure read by the indirect shader variants: per-draw model matrix, material and bounds
+*/
+struct DrawData
+{
+	glm::mat4 model;
+	glm::vec4 emission;
+	glm::vec4 ambient;
+	glm::vec4 diffuse;
+	glm::vec4 specular;
+	glm::vec4 params;		///< x: shininess
+	glm::vec4 boxMin;		///< Local bounding box, w: 1 when the mesh has bounds, 0 otherwise (see HiZ.h)
+	glm::vec4 boxMax;
+	glm::mat4 normalMatrix;	///< Read by the FEATURE_NORMAL_MATRIX variants only (see Transform.h)
+};
+
+/**
+* Supsi-GE, multi-draw-indirect submission class
+* An IndirectBatch turns a set of meshes into indirect draw commands over the MeshPool geometry.
+* Model matrices and materials of all the draws are stored in the Ssbo::BINDING_DRAWS buffer: every command
+* uses its own index as base instance, which the shaders read back through the MeshPool::ATTRIB_DRAWID
+* per-instance attribute. Draws are grouped by texture and shader variant, since each group needs
+* its own texture binding: the whole set is then submitted with one glMultiDrawElementsIndirect() per group.
+* The batch is built once per frame with the visibility of each mesh (see Culling.h): the per-draw data is shared,
+* while each view gets its own range of commands, made only of the meshes visible in that view.
+*/
+class LIB_API IndirectBatch {
+	//////////
+public: //
+//////////
+
+	// Const/dest:
+	IndirectBatch(MeshPool *pool);
+	~IndirectBatch();
+
+	// Get/set:
+	inline unsigned int getDrawCount() { return (unsigned int)draws.size(); }
+	inline unsigned int getGroupCount() { return (unsigned int)groups.size(); }
+	inline const void *getOwner() { return owner; }
+	inline unsigned int getIndirectBuffer() { return indirectBuffer; }
+	inline Ssbo &getDrawSsbo() { return drawSsbo; }
+	unsigned int getFirstCommand(unsigned int view);
+	unsigned int getCommandCount(unsigned int view);
+
+	// Management:
+	void clear(const void *owner);
+	void add(Mesh *mesh, const glm::mat4 &model, unsigned int viewMask = 0xFF);
+	bool upload(unsigned int views = 1, unsigned int instances = 1);
+
+	// Rendering:
+	unsigned int render(unsigned int lightKey, unsigned int view = 0);
+	unsigned int renderDepth(unsigned int view = 0, unsigned int features = 0);
+
+
+	///////////
+private: //
+///////////
+
+	/**
+	@struct Command
+	Layout of a GL_DRAW_INDIRECT_BUFFER entry for glMultiDrawElementsIndirect()
+	*/
+	struct Command
+	{
+		unsigned int count;
+		unsigned int instanceCount;
+		unsigned int firstIndex;
+		unsigned int baseVertex;
+		unsigned int baseInstance;
+	};
+
+	/**
+	@struct Group
+	Consecutive commands sharing texture and shader variant
+	*/
+	struct Group
+	{
+		Texture *texture;
+		unsigned int features;
+		unsigned int first;
+		unsigned int count;
+	};
+
+	/**
+	@struct Item
+	A mesh added since the last clear()
+	*/
+	struct Item
+	{
+		Mesh *mesh;
+		Texture *texture;
+		unsigned int features;
+		unsigned int viewMask;
+		unsigned int order;				///< Position in the list, breaks the sort ties
+		glm::mat4 model;
+	};
+
+	MeshPool *pool;
+	const void *owner;					///< The list the batch was built from
+	vector<Item> items;
+	vector<DrawData> draws;
+	vector<Command> commands;
+	vector<Group> groups;
+	unsigned int viewGroups[Culling::MAX_VIEWS + 1];	///< First group of each view, plus the end
+
+	// OGL stuff:
+	Ssbo drawSsbo;
+	unsigned int indirectBuffer;
+	unsigned int indirectCapacity;		///< Commands allocated in video memory
+	unsigned int drawIdBuffer;
+	unsigned int drawIdCapacity;		///< Draw IDs allocated in video memory
+};
@@ -0,0 +1,197 @@
+#include "Engine.h"
+
+#include <chrono>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+
+//a thread's queue: the owner works at the back, thieves at the front
+struct alignas(64) JobQueue
+{
+	std::mutex mutex;
+	unsigned int head = 0;		//front, grows when stealing
+	unsigned int tail = 0;		//back, grows when pushing
+};
+
+struct JobSystem::Data
+{
+	std::unique_ptr<JobQueue[]> queues;
+	vector<Job> jobs;			//QUEUE_SIZE per thread, ring buffers indexed by head and tail
+	vector<std::thread> workers;
+
+	std::mutex sleepMutex;
+	std::condition_variable wake;
+	std::atomic<int> queued{ 0 };
+	std::atomic<bool> stop{ false };
+
+	std::atomic<unsigned int> executed{ 0 };
+	std::atomic<unsigned int> stolen{ 0 };
+	std::chrono::high_resolution_clock::time_point start;
+};
+
+//worker index of the calling thread, valid for the job system it belongs to
+static thread_local const JobSystem *currentSystem = nullptr;
+static thread_local unsigned int currentWorker = 0;
+
+
+LIB_API JobSystem::JobSystem(unsigned int threads)
+{
+	if (threads == 0)
+		threads = glm::max(std::thread::hardware_concurrency(), 1u);
+	this->threads = threads;
+
+	data = new Data();
+	data->queues.reset(new JobQueue[threads]);
+	data->jobs.resize(threads * QUEUE_SIZE);
+	data->start = std::chrono::high_resolution_clock::now();
+	for (unsigned int t = 1; t < threads; t++)
+		data->workers.emplace_back(&JobSystem::work, this, t);
+}
+
+LIB_API JobSystem::~JobSystem()
+{
+	{
+		std::lock_guard<std::mutex> lock(data->sleepMutex);
+		data->stop = true;
+	}
+	data->wake.notify_all();
+	for (std::thread &w : data->workers)
+		w.join();
+	delete data;
+}
+
+void LIB_API JobSystem::run(const char *name, Function function, void *data, unsigned int begin, unsigned int end, Counter &counter)
+{
+	Job job = { name, function, data, begin, end, &counter };
+	counter++;
+
+	unsigned int worker = currentSystem == this ? currentWorker : 0;
+	JobQueue &queue = this->data->queues[worker];
+	{
+		std::lock_guard<std::mutex> lock(queue.mutex);
+		if (queue.tail - queue.head < QUEUE_SIZE)
+		{
+			this->data->jobs[worker * QUEUE_SIZE + queue.tail % QUEUE_SIZE] = job;
+			queue.tail++;
+			function = nullptr;
+		}
+	}
+
+	//full queue, run it now
+	if (function != nullptr)
+	{
+		execute(job, worker);
+		return;
+	}
+
+	//the lock makes sure that a worker going to sleep sees the new job
+	this->data->queued++;
+	{
+		std::lock_guard<std::mutex> lock(this->data->sleepMutex);
+	}
+	this->data->wake.notify_one();
+}
+
+bool JobSystem::runOne(unsigned int worker)
+{
+	Job job;
+	bool found = false;
+
+	//own queue first, most recent job
+	JobQueue &own = data->queues[worker];
+	{
+		std::lock_guard<std::mutex> lock(own.mutex);
+		if (own.tail != own.head)
+		{
+			own.tail--;
+			job = data->jobs[worker * QUEUE_SIZE + own.tail % QUEUE_SIZE];
+			found = true;
+		}
+	}
+
+	//then the oldest job of the others
+	for (unsigned int t = 1; t < threads && !found; t++)
+	{
+		unsigned int victim = (worker + t) % threads;
+		JobQueue &queue = data->queues[victim];
+		std::lock_guard<std::mutex> lock(queue.mutex);
+		if (queue.tail != queue.head)
+		{
+			job = data->jobs[victim * QUEUE_SIZE + queue.head % QUEUE_SIZE];
+			queue.head++;
+			found = true;
+			data->stolen++;
+		}
+	}
+
+	if (!found)
+		return false;
+	data->queued--;
+	execute(job, worker);
+	return true;
+}
+
+void JobSystem::execute(const Job &job, unsigned int worker)
+{
+	if (trace)
+	{
+		auto start = std::chrono::high_resolution_clock::now();
+		job.function(job.data, job.begin, job.end);
+		auto end = std::chrono::high_resolution_clock::now();
+		trace(job.name, worker, std::chrono::duration_cast<std::chrono::microseconds>(start - data->start).count(),
+			std::chrono::duration_cast<std::chrono::microseconds>(end - data->start).count());
+	}
+	else
+		job.function(job.data, job.begin, job.end);
+
+	data->executed++;
+	(*job.counter)--;
+}
+
+void JobSystem::work(unsigned int worker)
+{
+	currentSystem = this;
+	currentWorker = worker;
+	while (!data->stop)
+	{
+		if (runOne(worker))
+			continue;
+		std::unique_lock<std::mutex> lock(data->sleepMutex);
+		data->wake.wait(lock, [this] { return data->stop || data->queued > 0; });
+	}
+}
+
+void LIB_API JobSystem::wait(Counter &counter)
+{
+	unsigned int worker = currentSystem == this ? currentWorker : 0;
+	while (counter > 0)
+		if (!runOne(worker))
+			std::this_thread::yield();
+}
+
+unsigned int LIB_API JobSystem::getThreads()
+{
+	return threads;
+}
+
+unsigned int LIB_API JobSystem::getWorker()
+{
+	return currentWorker;
+}
+
+void LIB_API JobSystem::setTrace(const Trace &trace)
+{
+	this->trace = trace;
+}
+
+unsigned int LIB_API JobSystem::getExecuted()
+{
+	return data->executed.exchange(0);
+}
+
+unsigned int LIB_API JobSystem::getStolen()
+{
+	return data->stolen.exchange(0);
+}
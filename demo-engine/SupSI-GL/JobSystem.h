@@ -0,0 +1,142 @@
+#pragma once
+
+/**
+* Supsi-GE, work-stealing job system class
+* A job is a function called on a range of indices [begin, end). Every thread (the thread that created the job system,
+* worker 0, plus getThreads() - 1 workers) has its own queue: a thread pushes and pops its jobs at the back of its queue,
+* most recent first, and steals from the front of the other queues when its own is empty, oldest (and largest) first.
+*
+* Dependencies are expressed with counters: run() increments a counter and the job decrements it once done, wait()
+* returns when the counter is back to zero. A thread waiting on a counter runs jobs meanwhile instead of blocking, so
+* that jobs can wait on other jobs, and parallelFor() can be nested.
+* Jobs are plain structures in fixed-size queues: running them does not allocate. When a queue is full, the job is
+* run immediately by the thread submitting it.
+* An optional trace callback is called after every job, with its name, worker and timings.
+* The class does not touch OpenGL.
+*/
+class LIB_API JobSystem
+{
+public:
+	static const unsigned int QUEUE_SIZE = 4096;		///< Jobs per thread queue
+
+	/**
+	Number of unfinished jobs, see run() and wait()
+	*/
+	typedef std::atomic<int> Counter;
+
+	/**
+	Job function, called with the data passed to run() and the job's range
+	*/
+	typedef void (*Function)(void *data, unsigned int begin, unsigned int end);
+
+	/**
+	Trace callback: job name, worker index, start and end times in microseconds since the job system was created
+	*/
+	typedef std::function<void(const char *name, unsigned int worker, long long start, long long end)> Trace;
+
+	/**
+	Constructor
+	@param threads Number of threads including the calling one, 0 for one per hardware thread
+	*/
+	JobSystem(unsigned int threads = 0);
+
+	/**
+	Destructor, waits for the running jobs and stops the workers. Queued jobs are not run.
+	*/
+	~JobSystem();
+
+	/**
+	Queues a job on the calling thread's queue
+	@param name Name of the job, for the trace, must stay valid
+	@param function The function
+	@param data Passed to the function, must stay valid until the job is done
+	@param begin Start of the range
+	@param end End of the range
+	@param counter Incremented now, decremented when the job is done
+	*/
+	void run(const char *name, Function function, void *data, unsigned int begin, unsigned int end, Counter &counter);
+
+	/**
+	Runs jobs until a counter reaches zero
+	*/
+	void wait(Counter &counter);
+
+	/**
+	Calls f(begin, end) on consecutive ranges of at most "grain" indices covering [0, count), in parallel, and waits for them
+	@param name Name of the jobs, for the trace
+	@param count Number of indices
+	@param grain Indices per job
+	@param f The function
+	*/
+	template <class F> void parallelFor(const char *name, unsigned int count, unsigned int grain, const F &f)
+	{
+		Counter counter(0);
+		grain = glm::max(grain, 1u);
+		for (unsigned int begin = 0; begin < count; begin += grain)
+			run(name, &invoke<F>, (void *)&f, begin, glm::min(begin + grain, count), counter);
+		wait(counter);
+	}
+
+	/**
+	Returns the number of threads, including the one that created the job system
+	*/
+	unsigned int getThreads();
+
+	/**
+	Returns the index of the calling thread, 0 for threads that are not workers
+	*/
+	static unsigned int getWorker();
+
+	/**
+	Sets the trace callback, called by the workers after every job: it must be thread safe. nullptr to disable it.
+	Set it while no job is running.
+	*/
+	void setTrace(const Trace &trace);
+
+	/**
+	Returns the number of jobs run, and stolen from another thread's queue, since the last call
+	*/
+	unsigned int getExecuted();
+	unsigned int getStolen();
+
+private:
+	/**
+	@struct Job
+	A queued job
+	*/
+	struct Job
+	{
+		const char *name;
+		Function function;
+		void *data;
+		unsigned int begin;
+		unsigned int end;
+		Counter *counter;
+	};
+
+	/**
+	Takes a job from the calling thread's queue or steals one, and runs it
+	@return false if every queue was empty
+	*/
+	bool runOne(unsigned int worker);
+
+	/**
+	Runs a job and decrements its counter
+	*/
+	void execute(const Job &job, unsigned int worker);
+
+	/**
+	Main loop of the worker threads
+	*/
+	void work(unsigned int worker);
+
+	template <class F> static void invoke(void *data, unsigned int begin, unsigned int end)
+	{
+		(*(const F *)data)(begin, end);
+	}
+
+	struct Data;
+	Data *data;
+	unsigned int threads;
+	Trace trace;
+};
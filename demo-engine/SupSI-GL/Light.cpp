@@ -1,15 +1,8 @@
 #include "Engine.h"
-#include "GL/freeglut.h"
-
-/*
-std::vector<glm::vec3> Light::vec_positions{};
-std::vector<glm::vec4> Light::vec_specular{};
-std::vector<glm::vec4> Light::vec_ambient{};
-std::vector<glm::vec4> Light::vec_diffuse{};
-*/
 
 LIB_API  Light::Light() : Node()
 {
+	setKind(KIND_LIGHT);
 }
 
 LIB_API Light::~Light()
@@ -65,6 +58,15 @@ void LIB_API Light::setAttenuation(float attenuation)
 	this->attenuation = attenuation;
 }
 
+float LIB_API Light::getRadius()
+{
+	return radius;
+}
+void LIB_API Light::setRadius(float radius)
+{
+	this->radius = radius;
+}
+
 int LIB_API Light::getPriority()
 {
 	return priority;
@@ -88,50 +90,21 @@ void LIB_API Light::setLightNumber(int n)
 
 void LIB_API Light::render()
 {
-	static std::vector<glm::vec3> vec_positions{};
-	static std::vector<glm::vec4> vec_specular{};
-	static std::vector<glm::vec4> vec_ambient{};
-	static std::vector<glm::vec4> vec_diffuse{};
-
-	//return;
-	if (isOn)
-	{
-		lightNumber = lightNumber - GL_LIGHT0;
-
-		if (lightNumber == 0)
-		{
-			vec_positions.clear();
-			vec_ambient.clear();
-			vec_diffuse.clear();
-			vec_specular.clear();
-		}
-
-		Program *p = Engine::getInstance().getProgram();
-
-		vec_positions.push_back(glm::vec3(0.f)); //0 becasue transformation have already been applied
-		vec_ambient.push_back(color * 0.3f);
-		vec_specular.push_back(color * 0.6f);
-		vec_diffuse.push_back(color * 0.9f);
-
-
-		p->setVertex(Location::LIGHT_ARRAY_POSITION, vec_positions.data(), vec_positions.size());
-		p->setVertex(Location::LIGHT_ARRAY_AMBIENT, vec_ambient.data(), vec_ambient.size());
-		p->setVertex(Location::LIGHT_ARRAY_DIFFUSE, vec_diffuse.data(), vec_diffuse.size());
-		p->setVertex(Location::LIGHT_ARRAY_SPECULAR, vec_specular.data(), vec_specular.size());
-		p->setInt(Location::LIGHT_TOTAL, vec_positions.size());
-	}
-
 }
 
-/*
-void Light::loadToShader()
+bool LIB_API Light::loadToData(LightData &data, const glm::mat4 &finalMat)
 {
-	Program *p = Engine::getInstance().getProgram();
+	if (!isOn)
+		return false;
 
-	p->setVertex(Location::LIGHT_ARRAY_POSITION, vec_positions.data(), vec_positions.size());
-	p->setVertex(Location::LIGHT_ARRAY_AMBIENT, vec_ambient.data(), vec_ambient.size());
-	p->setVertex(Location::LIGHT_ARRAY_DIFFUSE, vec_diffuse.data(), vec_diffuse.size());
-	p->setVertex(Location::LIGHT_ARRAY_SPECULAR, vec_specular.data(), vec_specular.size());
-	p->setInt(Location::LIGHT_TOTAL, vec_positions.size());
+	if (w == 0.0f)
+		//directional lights shine along their direction: store the vector pointing towards the light
+		data.position = glm::vec4(glm::normalize(glm::mat3(finalMat) * -direction), 0.0f);
+	else
+		data.position = glm::vec4(glm::vec3(finalMat[3]), 1.0f);
+	data.ambient = color * 0.3f;
+	data.specular = color * 0.6f;
+	data.diffuse = color * 0.9f;
+	data.range = glm::vec4(radius, 0.0f, 0.0f, 0.0f);
+	return true;
 }
-*/
\ No newline at end of file
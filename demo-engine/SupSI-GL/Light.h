@@ -7,7 +7,7 @@
 * @authors D.Nasi, J.Petralli, D.Calabria
 */
 class LIB_API Light :
-	public virtual Node
+	public Node
 {
 private:
 	/**
@@ -32,8 +32,7 @@ private:
 
 	/**
 	@var lightNumber
-	The light's identification number for OpenGL.
-	Used to pass the variuous GL_LIGHTx (e.g GL_LIGHT0, GL_LIGHT1, ...) and the accompainig methods glLight()
+	The light's slot inside the frame's light buffer (see Clusters.h), assigned by the List every frame
 	*/
 	int lightNumber;
 
@@ -66,14 +65,16 @@ private:
 	*/
 	float cutoff=180.0f; //must be between 0 e 90, 180 if omni/point
 
-	/*
-		static std::vector<glm::vec3> vec_positions;
-		static std::vector<glm::vec4> vec_specular;
-		static std::vector<glm::vec4> vec_ambient;
-		static std::vector<glm::vec4> vec_diffuse;
+	/**
+	@var radius
+	Influence radius of the light: the light has no effect beyond this distance.
+	0 means an unbounded light, applied to the whole scene. Defaults to 0.
 	*/
+	float radius = 0.0f;
 
 public:
+	static const Kind KIND = KIND_LIGHT;		///< See Node::as()
+
 	/**
 	Constructor
 	@see Object.h
@@ -146,6 +147,17 @@ public:
 	*/
 	void setAttenuation(float attenuation);
 
+	/**
+	Returns the influence radius
+	*/
+	float getRadius();
+
+	/**
+	Sets the influence radius
+	@param radius The new radius, 0 for an unbounded light
+	*/
+	void setRadius(float radius);
+
 	/**
 	Returns the priority value
 	*/
@@ -158,8 +170,8 @@ public:
 	void setPriority(int priority);
 
 	/**
-	Assigns a new idetification number to the light
-	@param lightNumber The new identifier number for the light
+	Assigns the light's slot inside the light buffer
+	@param lightNumber The new slot for the light
 	*/
 	void setLightNumber(int lightNumber);
 
@@ -170,16 +182,19 @@ public:
 	string getType();
 
 	/**
-	Renders the light source
-	This method changes "rendering mode" depending on w's and cutoff's values. Done to avoid additional subclasses.
-	The positioning vector used has all values set to 0, the only exception being w.
-	It's done this way as all linear applications used to position the light source were applied before the call to this method.
-
-	For the base definition
+	Lights are not drawn: their contribution reaches the shaders through the light buffer
+	filled once per frame by List::loadLights().
 	@see Object.h
 	*/
 	void render();
 
-	//static void loadToShader();
+	/**
+	Fills the shader representation of the light.
+	The position is taken from the final matrix, w selects between point (1) and directional (0) lights.
+	Returns false (leaving "data" untouched) when the light is off.
+	@param data The light data to be filled
+	@param finalMat The light's matrix with all the previous transformations applied to
+	*/
+	bool loadToData(LightData &data, const glm::mat4 &finalMat);
 };
 
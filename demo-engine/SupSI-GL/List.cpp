@@ -1,9 +1,13 @@
 #include "Engine.h"
+#include <GL/glew.h>
 #include "GL/freeglut.h"
 
+#include <algorithm>
+
 
 LIB_API List::List() : Object()
 {
+	setKind(KIND_LIST);
 }
 
 
@@ -17,8 +21,8 @@ int LIB_API List::findLightPos(int priority)
 	if (lightsCount == 0)
 		return 0;
 	for (int i = 0; i < lightsCount;i++) {
-		Light* light = dynamic_cast<Light*>( list.at(i).node);
-		if (priority > light->getPriority())
+		Light* light = static_cast<Light*>(list[i].node);		//the first lightsCount nodes are lights
+		if (priority > (captured ? lightStates[i].priority : light->getPriority()))
 			return i;
 	}
 	return lightsCount;
@@ -27,11 +31,27 @@ int LIB_API List::findLightPos(int priority)
 void LIB_API List::addNode(Node* node, glm::mat4 finalMat)
 {
 	NodeMat x = {node, finalMat};
-	if (node->getType().compare("light")==0) 
+	node->getTransform()->update(finalMat);
+	queue.clear();
+	batched = false;
+	packed = false;
+	Light* light = node->as<Light>();
+	if (light != nullptr)
 	{
-		Light* light = dynamic_cast<Light*>(node);
-		list.insert(list.begin()+ findLightPos(light->getPriority()), x);
+		int pos = findLightPos(light->getPriority());
+		list.insert(list.begin() + pos, x);
 		lightsCount+=1;
+
+		//a live light added to a captured list gets its state now
+		if (captured)
+		{
+			Snapshot::LightState state;
+			state.light = light;
+			state.index = (unsigned int)pos;
+			state.priority = light->getPriority();
+			state.on = light->loadToData(state.data, finalMat);
+			lightStates.insert(lightStates.begin() + pos, state);
+		}
 	}
 	else {
 		list.push_back(x);
@@ -41,7 +61,45 @@ void LIB_API List::addNode(Node* node, glm::mat4 finalMat)
 
 void LIB_API List::clear()
 {
+	captured = false;
+	lightStates.clear();
 	list.clear();
+	lightsCount = 0;
+	queue.clear();
+	batched = false;
+	packed = false;
+}
+
+void LIB_API List::fill(const Snapshot *snapshot, unsigned int index)
+{
+	clear();
+	captured = true;
+	if (index >= snapshot->getCount())
+		return;
+
+	//a subtree is a range of the depth-first order
+	unsigned int end = snapshot->getSubtreeEnd(index);
+
+	//lights first, already in the list's order (see Snapshot::capture()), then the other nodes in depth-first order
+	for (unsigned int i = 0; i < snapshot->getLightCount(); i++)
+	{
+		const Snapshot::LightState &state = snapshot->getLight(i);
+		if (state.index < index || state.index >= end)
+			continue;
+		const glm::mat4 &world = snapshot->getWorld(state.index);
+		state.light->getTransform()->update(world);
+		list.push_back({ state.light, world });
+		lightStates.push_back(state);
+	}
+	lightsCount = (int)lightStates.size();
+	for (unsigned int i = index; i < end; i++)
+	{
+		Node *node = snapshot->getNode(i);
+		if (node->as<Light>() != nullptr)
+			continue;
+		node->getTransform()->update(snapshot->getWorld(i));
+		list.push_back({ node, snapshot->getWorld(i) });
+	}
 }
 
 void LIB_API List::render()
@@ -52,62 +110,273 @@ void LIB_API List::render()
 void LIB_API List::renderWithCamera(glm::mat4 invCamera)
 {
 	Engine &e = Engine::getInstance();
-	Program* prog = e.getProgram();
 
+	FrameBlock frame;
+	frame.projection = e.getActiveCamera()->getProjMatrix();
+	frame.view = invCamera;
+	frame.eyePosition = glm::inverse(invCamera)[3];
+	e.loadFrames(this, &frame, 1);
+	e.getFrameUbo()->render(Ubo::BINDING_FRAME);
+
+	renderNodes();
+}
+
+void LIB_API List::loadLights(Clusters &clusters)
+{
+	//lights are at the beginning of the list, highest priority first
+	//low priority lights that exceed the maxRenderLights value defined by the engine are not rendered
+	Engine &e = Engine::getInstance();
 	int maxLights = e.getMaxRenderLights();
-	int count = 0;
-	for (NodeMat i : list) {
-		//doesn't render low priority lights that exceed the maxRenderLights value defined by the engine
-		if (!(count >= maxLights && count < lightsCount)) {
-			//if the node is a light sets the lightNumber param (GL_LIGHT0, 1, ...)
-			if (count < lightsCount) {
-				Light* light = dynamic_cast<Light*>(i.node);
-				light->setLightNumber(GL_LIGHT0 + count);
-			}
-			else
-			{
-				//Light::loadToShader();
-			}
-
-			prog->setMatrix(Location::PROJECTION_MATRIX, e.getActiveCamera()->getProjMatrix());
-			prog->setMatrix(Location::MODLVIEW_MATRIX, invCamera * i.finalMat);
-			prog->setMatrix(Location::NORMAL_MATRIX, glm::mat3{ glm::inverseTranspose(invCamera * i.finalMat) });
-
-			i.node->render();
+	FrameVector<LightData> lights{ FrameAllocator<LightData>(e.getFrameArena()) };
+	lights.reserve(glm::min(lightsCount, maxLights));
+	for (int count = 0; count < lightsCount && count < maxLights; count++)
+	{
+		//captured lights belong to the simulation thread, only their copied state is read
+		if (captured)
+		{
+			if (lightStates[count].on)
+				lights.push_back(lightStates[count].data);
+			continue;
 		}
-		count++;
+		Light* light = static_cast<Light*>(list[count].node);
+		light->setLightNumber((int)lights.size());
+		LightData data;
+		if (light->loadToData(data, list.at(count).finalMat))
+			lights.push_back(data);
+	}
+	clusters.setLights(lights.data(), (unsigned int)lights.size());
+}
+
+void LIB_API List::buildQueue()
+{
+	//group the draws by variant, so that each program is bound once per pass
+	if (queue.size() == list.size() - lightsCount)
+		return;
+
+	queue.clear();
+	for (unsigned int i = lightsCount; i < list.size(); i++)
+		queue.push_back({ list[i].node->getShaderFeatures(), (int)i, list[i].node->as<Mesh>(), Culling::ALWAYS_VISIBLE, 0.0f });
+	std::sort(queue.begin(), queue.end(), [](const Draw &a, const Draw &b) {
+		return a.features < b.features || (a.features == b.features && a.index < b.index);
+	});
+	depthSorted = false;
+}
+
+void LIB_API List::sortQueue(bool frontToBack, const glm::vec3 &eye)
+{
+	buildQueue();
+	if (!frontToBack)
+	{
+		//back to the variant order of buildQueue()
+		if (depthSorted)
+			std::sort(queue.begin(), queue.end(), [](const Draw &a, const Draw &b) {
+				return a.features < b.features || (a.features == b.features && a.index < b.index);
+			});
+		depthSorted = false;
+		return;
+	}
+
+	//nearest origin first: more variant switches, but hidden fragments are rejected by the early depth test
+	for (Draw &d : queue)
+	{
+		glm::vec3 delta = glm::vec3(list[d.index].finalMat[3]) - eye;
+		d.depth = glm::dot(delta, delta);
 	}
+	std::sort(queue.begin(), queue.end(), [](const Draw &a, const Draw &b) {
+		return a.depth < b.depth || (a.depth == b.depth && a.index < b.index);
+	});
+	depthSorted = true;
+	batched = false;
+	packed = false;
 }
 
+void LIB_API List::loadBounds(Culling &culling)
+{
+	buildQueue();
+	culling.clear();
+	for (Draw &d : queue)
+		if (d.mesh)
+			d.bounds = culling.add(list[d.index].finalMat, d.mesh->getRadius(), d.mesh->getBoxMin(), d.mesh->getBoxMax());
+
+	//visibility changed, the indirect commands and the packet must be rebuilt
+	batched = false;
+	packed = false;
+}
+
+void LIB_API List::preparePacket(Culling &culling, Clusters &clusters)
+{
+	buildQueue();
+	packet.lightKey = ShaderCache::getLightKey(clusters.getGlobalLights(), (unsigned int)clusters.getLights().size());
 
-void LIB_API List::renderXR(glm::mat4 proj, glm::mat4 head)
+	//one pass over the queue for all the views, the eye passes only read their list
+	unsigned int views = glm::min(culling.getViews(), Culling::MAX_VIEWS);
+	for (vector<unsigned int> &visible : packet.visible)
+		visible.clear();
+	for (unsigned int i = 0; i < queue.size(); i++)
+	{
+		unsigned int mask = culling.getViewMask(queue[i].bounds);
+		for (unsigned int v = 0; v < views; v++)
+			if ((mask >> v) & 1)
+				packet.visible[v].push_back(i);
+		if (mask & 3)
+			packet.visible[Culling::MAX_VIEWS].push_back(i);
+	}
+	packed = true;
+}
+
+void LIB_API List::cullOccluded(Occlusion &occlusion, Culling &culling)
+{
+	for (const Draw &d : queue)
+		if (d.mesh && d.mesh->isOccluder() && culling.getViewMask(d.bounds))
+			occlusion.addOccluder(list[d.index].finalMat, d.mesh->getRadius(), d.mesh->getOccluderPositions(), d.mesh->getOccluderVertices(), d.mesh->getOccluderIndices(), d.mesh->getOccluderTriangles());
+	occlusion.render();
+
+	for (const Draw &d : queue)
+	{
+		if (!d.mesh || d.bounds == Culling::ALWAYS_VISIBLE)
+			continue;
+		unsigned int mask = culling.getViewMask(d.bounds);
+		unsigned int visible = mask;
+		for (unsigned int v = 0; v < culling.getViews(); v++)
+			if (((mask >> v) & 1) && !occlusion.test(v, list[d.index].finalMat, d.mesh->getBoxMin(), d.mesh->getBoxMax()))
+				visible &= ~(1u << v);
+		if (visible != mask)
+			culling.setViewMask(d.bounds, visible);
+	}
+}
+
+//depth pre-pass state: depth only, then shading of the fragments matching it
+static void beginDepthPass()
+{
+	glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+}
+
+static void beginShadingPass()
+{
+	glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+	glDepthFunc(GL_EQUAL);
+	glDepthMask(GL_FALSE);
+}
+
+static void endShadingPass()
+{
+	glDepthFunc(GL_LESS);
+	glDepthMask(GL_TRUE);
+}
+
+static unsigned int renderBatch(IndirectBatch &batch, unsigned int lightKey, unsigned int view, bool prepass, unsigned int stereoKey)
+{
+	if (!prepass)
+		return batch.render(lightKey | stereoKey, view);
+
+	beginDepthPass();
+	unsigned int drawCalls = batch.renderDepth(view, stereoKey);
+	beginShadingPass();
+	drawCalls += batch.render(lightKey | stereoKey, view);
+	endShadingPass();
+	return drawCalls;
+}
+
+unsigned int LIB_API List::renderNodes(unsigned int view)
+{
+	return submit(view, 0);
+}
+
+unsigned int LIB_API List::renderStereo()
+{
+	Engine::StereoMode mode = Engine::getInstance().getStereoMode();
+	if (mode == Engine::STEREO_MULTIVIEW)
+		return submit(0, ShaderCache::FEATURE_MULTIVIEW);
+	if (mode == Engine::STEREO_INSTANCED)
+		return submit(0, ShaderCache::FEATURE_INSTANCED_STEREO);
+	return 0;
+}
+
+unsigned int LIB_API List::submit(unsigned int view, unsigned int stereoKey)
 {
 	Engine &e = Engine::getInstance();
-	Program* prog = e.getProgram();
+	ShaderCache* shaders = e.getShaderCache();
+	Culling* culling = e.getCulling();
+	bool prepass = e.getDepthMode() == Engine::DEPTH_PREPASS;
+	if (view >= Culling::MAX_VIEWS)
+		return 0;
 
-	int maxLights = e.getMaxRenderLights();
-	int count = 0;
-	for (NodeMat i : list) {
-		//doesn't render low priority lights that exceed the maxRenderLights value defined by the engine
-		if (!(count >= maxLights && count < lightsCount)) {
-			//if the node is a light sets the lightNumber param (GL_LIGHT0, 1, ...)
-			if (count < lightsCount) {
-				Light* light = dynamic_cast<Light*>(i.node);
-				light->setLightNumber(GL_LIGHT0 + count);
-			}
-			else
-			{
-				//Light::loadToShader();
-			}
-
-			prog->setMatrix(Location::PROJECTION_MATRIX, proj);
-			prog->setMatrix(Location::MODLVIEW_MATRIX, head * i.finalMat);
-			prog->setMatrix(Location::NORMAL_MATRIX, glm::mat3{ glm::inverseTranspose(head * i.finalMat) });
-
-			i.node->render();
+	//normally prepared by Engine::loadFrames(), once for all the views
+	if (!packed)
+		preparePacket(*culling, *e.getClusters());
+	unsigned int lightKey = packet.lightKey;
+
+	//in stereo, meshes visible in either eye are drawn once for both, twice as instances for instanced stereo
+	unsigned int instances = (stereoKey & ShaderCache::FEATURE_INSTANCED_STEREO) ? 2 : 1;
+	const vector<unsigned int> &visible = packet.visible[stereoKey ? Culling::MAX_VIEWS : view];
+
+	if (e.isIndirect())
+	{
+		IndirectBatch* batch = e.getIndirectBatch();
+		if (!batched || batch->getOwner() != this || batchedStereo != stereoKey)
+		{
+			batch->clear(this);
+			for (const Draw &d : queue)
+				if (d.mesh)
+				{
+					unsigned int mask = culling->getViewMask(d.bounds);
+					batch->add(d.mesh, list[d.index].finalMat, stereoKey ? ((mask & 3) ? 1 : 0) : mask);
+				}
+			batch->upload(stereoKey ? 1 : culling->getViews(), instances);
+			batched = true;
+			batchedStereo = stereoKey;
+		}
+
+		//the Hi-Z pyramids are per eye, not available in stereo
+		if (!e.isGpuCulling() || stereoKey)
+			return renderBatch(*batch, lightKey, view, prepass, stereoKey);
+
+		//draw what was visible last frame, then what this frame's depth reveals (see HiZ.h)
+		HiZ* hiz = e.getHiZ();
+		hiz->cull(*batch, view, HiZ::PHASE_REUSE);
+		unsigned int drawCalls = renderBatch(*batch, lightKey, view, prepass, stereoKey);
+		hiz->build(view);
+		hiz->cull(*batch, view, HiZ::PHASE_RETEST);
+		return drawCalls + renderBatch(*batch, lightKey, view, prepass, stereoKey);
+	}
+
+	unsigned int drawCalls = 0;
+	if (prepass)
+	{
+		beginDepthPass();
+		for (unsigned int i : visible)
+		{
+			const Draw &d = queue[i];
+			if (!d.mesh)
+				continue;
+			Program* prog = shaders->render(ShaderCache::FEATURE_DEPTH_ONLY | stereoKey);
+			prog->setMatrix(Location::MODEL_MATRIX, list[d.index].finalMat);
+			d.mesh->renderGeometry(instances);
+			drawCalls++;
+		}
+		shaders->finish();
+		beginShadingPass();
+	}
+
+	for (unsigned int i : visible)
+	{
+		const Draw &d = queue[i];
+		Program* prog = shaders->render(lightKey | d.features | stereoKey);
+		prog->setMatrix(Location::MODEL_MATRIX, list[d.index].finalMat);
+		if (d.features & ShaderCache::FEATURE_NORMAL_MATRIX)
+			prog->setMatrix(Location::NORMAL_MATRIX, list[d.index].node->getTransform()->getNormalMatrix());
+		if (d.mesh)
+		{
+			d.mesh->renderInstances(instances);
+			drawCalls++;
 		}
-		count++;
+		else
+			list[d.index].node->render();
 	}
+	shaders->finish();
+	if (prepass)
+		endShadingPass();
+	return drawCalls;
 }
 
 vector<Node*> LIB_API List::getNodes()
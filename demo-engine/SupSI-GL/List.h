@@ -43,6 +43,85 @@ private:
 	List of the grahp's nodes in "struct NodeMat" format
 	*/
 	vector<NodeMat> list;
+
+	/**
+	@struct Draw
+	A render queue entry: shader features of a node, its position in "list",
+	the node itself when it is a mesh, its bounds in the engine's Culling
+	and its squared distance from the eyes (see sortQueue())
+	*/
+	struct Draw
+	{
+		unsigned int features;
+		int index;
+		Mesh* mesh;
+		unsigned int bounds;
+		float depth;
+	};
+
+	/**
+	@var queue
+	Non-light nodes sorted by shader variant, built by the first renderNodes() call
+	*/
+	vector<Draw> queue;
+
+	/**
+	@struct FramePacket
+	What the views of a frame share, prepared once per frame by preparePacket(): the light part
+	of the shader keys and, for each view, the positions in "queue" of the nodes visible in it,
+	in submission order. Entry Culling::MAX_VIEWS holds the nodes visible in either of the first
+	two views, for single-pass stereo.
+	*/
+	struct FramePacket
+	{
+		unsigned int lightKey;
+		vector<unsigned int> visible[Culling::MAX_VIEWS + 1];
+	};
+
+	/**
+	@var packet
+	The current frame's packet, valid when "packed" is true
+	*/
+	FramePacket packet;
+	bool packed = false;
+
+	/**
+	@var batched
+	True once the engine's IndirectBatch has been built from this list
+	*/
+	bool batched = false;
+
+	/**
+	@var depthSorted
+	True when "queue" is sorted front to back instead of by shader variant
+	*/
+	bool depthSorted = false;
+
+	/**
+	@var captured
+	True when the list was filled from a snapshot (see Simulation.h): the lights are ordered and loaded from
+	lightStates, a copy of the snapshot's, and the Light objects are not touched
+	*/
+	bool captured = false;
+	vector<Snapshot::LightState> lightStates;
+
+	/**
+	@var batchedStereo
+	Stereo feature bits the engine's IndirectBatch was built for, 0 for one view at a time
+	*/
+	unsigned int batchedStereo = 0;
+
+	/**
+	Sorts the non-light nodes by shader variant into "queue", unless already done
+	*/
+	void buildQueue();
+
+	/**
+	Draws the visible non-light nodes, see renderNodes()
+	@param view The view index, ignored in stereo
+	@param stereoKey ShaderCache::FEATURE_MULTIVIEW or FEATURE_INSTANCED_STEREO to draw both eyes at once, 0 otherwise
+	*/
+	unsigned int submit(unsigned int view, unsigned int stereoKey);
 public:
 	/**
 	Constructor
@@ -68,27 +147,97 @@ public:
 	*/
 	void clear();
 
+	/**
+	Empties the list and fills it with the nodes of a snapshot. The state of the lights is copied, so that they are
+	ordered and loaded without reading the Light objects, which belong to the simulation thread. The snapshot is not
+	referenced afterwards.
+	@param snapshot The snapshot
+	@param index The node whose subtree is listed, see Snapshot::find(), 0 for the whole snapshot
+	*/
+	void fill(const Snapshot *snapshot, unsigned int index = 0);
+
 	/**
 	See "Object.h" for the base principle.
-	It asks the Engine for the maximum number of the lights and assigns the lights' lightNumber.
-	Then it traverse the list to fill the maximum number available of light sources (if there are enough in the scene)
-	and renders the scene, lights first.
+	Renders the list as seen from the origin.
 	@see Object.h
 	*/
 	void render();
 
 	/**
 	Renders the world from a specific Camera, corresponding to the "invCamera" camera.
+	Loads the frame data and the lights (see Engine::loadFrames()), then draws the list.
 	For additional details.
 	@see Camera.h
 	@param invCamera The chosen Camera's inverse matrix
 	*/
 	void renderWithCamera(glm::mat4 invCamera);
 
+	/**
+	Passes the highest priority lights, up to the maximum number of lights allowed by the engine,
+	to the light clusters. Meant to be called once per frame.
+	@param clusters The clusters receiving the frame's lights
+	*/
+	void loadLights(Clusters &clusters);
+
+	/**
+	Passes the bounds of the meshes to the culling stage. Meant to be called once per frame,
+	before Culling::cull().
+	@param culling The culling stage
+	*/
+	void loadBounds(Culling &culling);
+
+	/**
+	Sorts the non-light nodes front to back from "eye", so that hidden fragments fail the depth test
+	before being shaded, or back by shader variant. Meant to be called once per frame, before loadBounds().
+	@param frontToBack True to sort by distance, false to group by shader variant
+	@param eye Position the distances are measured from, in world coordinates
+	*/
+	void sortQueue(bool frontToBack, const glm::vec3 &eye);
+
+	/**
+	Builds the frame packet consumed by renderNodes() and renderStereo(): the visible nodes of every view
+	and the light part of the shader keys, so that the per-view passes only walk their own visible set.
+	Meant to be called once per frame, after the culling stages.
+	@param culling The culling stage, with the final view masks
+	@param clusters The clusters holding the frame's lights
+	*/
+	void preparePacket(Culling &culling, Clusters &clusters);
+
+	/**
+	Rasterizes the visible meshes that can be occluders, then hides from each view the meshes whose bounding box
+	is behind them. Meant to be called once per frame, after Culling::cull() and Occlusion::begin().
+	@param occlusion The software occlusion culling stage
+	@param culling The culling stage, whose view masks are updated
+	*/
+	void cullOccluded(Occlusion &occlusion, Culling &culling);
+
+	/**
+	Draws every non-light node visible in a view, as listed by the frame packet (see preparePacket()),
+	uploading only its model matrix.
+	Nodes are drawn grouped by shader variant (see ShaderCache.h), chosen from their
+	features and from the frame's lights.
+	When the engine is in indirect mode the meshes are instead submitted through the
+	engine's IndirectBatch, built once from the list and reused for every eye, and
+	optionally culled on the GPU against the view's depth (see HiZ.h).
+	With Engine::DEPTH_PREPASS the visible meshes are first drawn into the depth buffer only,
+	then shaded with GL_EQUAL, so that each pixel is shaded once.
+	The frame block and the light buffers must already be bound.
+	Returns the number of draw calls issued.
+	@param view The view index, as passed to Engine::loadFrames()
+	*/
+	unsigned int renderNodes(unsigned int view = 0);
+
+	/**
+	Same as renderNodes(), but draws both eyes in a single pass with the engine's stereo mode
+	(see Engine::getStereoMode()): each mesh visible in either eye is submitted once.
+	The Ubo::BINDING_STEREO block and the light buffers must already be bound.
+	Returns the number of draw calls issued, 0 when single-pass stereo is off.
+	*/
+	unsigned int renderStereo();
+
 	/**
 	Returns a standard list with all the nodes without their matrices
 	*/
-	void renderXR(glm::mat4 proj, glm::mat4 head);
 	vector<Node*> getNodes();
 
 	/**
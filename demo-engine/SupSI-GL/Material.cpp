@@ -3,6 +3,7 @@
 
 LIB_API Material::Material() : Object()
 {
+	setKind(KIND_MATERIAL);
 	emission = glm::vec4(0.0f, 0.0f, 0.0f, 0.0f);
 	ambient = glm::vec4(0.8f, 0.8f, 0.8f, 0.8f);
 	diffuse = glm::vec4(0.5f, 0.5f, 0.5f, 1.0f);
@@ -74,10 +75,9 @@ void LIB_API Material::render()
 	p->setVertex(Location::MATERIAL_EMISSIVE, emission);
 	p->setVertex(Location::MATERIAL_SPECULAR, specular);
 
-	if (texture == nullptr)
-		setTexture(&Texture::getBlankTexture());
-
-	texture->render();
+	//untextured materials are drawn by a shader variant that does not sample (see ShaderCache.h)
+	if (texture != nullptr)
+		texture->render();
 }
 
 string LIB_API Material::getType()
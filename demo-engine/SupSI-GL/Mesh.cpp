@@ -4,6 +4,11 @@
 
 LIB_API  Mesh::Mesh() : Node()
 {
+	setKind(KIND_MESH);
+	poolEntry = MeshPool::INVALID_ENTRY;
+	radius = -1.0f;
+	boxMin = glm::vec3(0.0f);
+	boxMax = glm::vec3(0.0f);
 
 }
 
@@ -11,6 +16,11 @@ LIB_API  Mesh::~Mesh()
 {
 	glDeleteBuffers(2, m_vboID);
 	glDeleteVertexArrays(1, &m_vaoID);
+
+	// The shared geometry too, unless the engine is already gone:
+	MeshPool* pool = Engine::getInstance().getMeshPool();
+	if (pool != nullptr && poolEntry != MeshPool::INVALID_ENTRY)
+		pool->remove(poolEntry);
 }
 
 Material LIB_API * Mesh::getMaterial()
@@ -24,20 +34,95 @@ void LIB_API Mesh::setMaterial(Material *material)
 }
 
 void LIB_API Mesh::render()
+{
+	renderInstances(1);
+}
+
+void LIB_API Mesh::renderInstances(unsigned int instances)
 {
 	if (material != nullptr)
 	{
 		material->render();
 	}
 
+	renderGeometry(instances);
+}
+
+void LIB_API Mesh::renderGeometry(unsigned int instances)
+{
 	// Bind vertex array
 	glBindVertexArray(m_vaoID);
 	// Render primitives (trianglese) from array data
-	glDrawElements(GL_TRIANGLES, 3 * m_numFaces, GL_UNSIGNED_INT, nullptr);
+	if (instances == 1)
+		glDrawElements(GL_TRIANGLES, 3 * m_numFaces, GL_UNSIGNED_INT, nullptr);
+	else
+		glDrawElementsInstanced(GL_TRIANGLES, 3 * m_numFaces, GL_UNSIGNED_INT, nullptr, instances);
 	// Disable VAO when not needed:
 	glBindVertexArray(0);
 }
 
+unsigned int LIB_API Mesh::getShaderFeatures()
+{
+	unsigned int features = 0;
+	if (material != nullptr && material->getTexture() != nullptr)
+		features |= ShaderCache::FEATURE_TEXTURED;
+	if (getTransform()->getKind() == Transform::GENERAL)
+		features |= ShaderCache::FEATURE_NORMAL_MATRIX;
+	return features;
+}
+
+unsigned int LIB_API Mesh::getPoolEntry()
+{
+	return poolEntry;
+}
+
+void LIB_API Mesh::setBounds(float radius, glm::vec3 boxMin, glm::vec3 boxMax)
+{
+	this->radius = radius;
+	this->boxMin = boxMin;
+	this->boxMax = boxMax;
+}
+
+float LIB_API Mesh::getRadius()
+{
+	return radius;
+}
+
+glm::vec3 LIB_API Mesh::getBoxMin()
+{
+	return boxMin;
+}
+
+glm::vec3 LIB_API Mesh::getBoxMax()
+{
+	return boxMax;
+}
+
+bool LIB_API Mesh::isOccluder()
+{
+	return !occluderIndices.empty();
+}
+
+const float LIB_API * Mesh::getOccluderPositions()
+{
+	return occluderPositions.data();
+}
+
+unsigned int LIB_API Mesh::getOccluderVertices()
+{
+	return (unsigned int)occluderPositions.size() / 3;
+}
+
+const unsigned int LIB_API * Mesh::getOccluderIndices()
+{
+	return occluderIndices.data();
+}
+
+unsigned int LIB_API Mesh::getOccluderTriangles()
+{
+	return (unsigned int)occluderIndices.size() / 3;
+}
+
 string LIB_API Mesh::getType()
 {
 	return "mesh";
@@ -94,6 +179,22 @@ void LIB_API Mesh::fillData(
 	// Disable VAO when not needed:
 	glBindVertexArray(0);
 
+	// Copy into the shared geometry as well, for the indirect path:
+	MeshPool* pool = Engine::getInstance().getMeshPool();
+	if (pool != nullptr && poolEntry != MeshPool::INVALID_ENTRY)
+		pool->remove(poolEntry);
+	if (pool != nullptr)
+		poolEntry = pool->add(coordinates, normals, textureCoordinates, nVertices, faces, nFaces);
+
+	// Keep the positions of the small meshes, for the software occlusion culling:
+	occluderPositions.clear();
+	occluderIndices.clear();
+	if (nFaces <= MAX_OCCLUDER_TRIANGLES)
+	{
+		occluderPositions.assign(coordinates, coordinates + 3 * nVertices);
+		occluderIndices.assign(faces, faces + 3 * nFaces);
+	}
+
 	// free in memory data arrays after have the copy to video memory
 	delete[] coordinates;
 	delete[] textureCoordinates;
@@ -9,22 +9,49 @@
 * @authors D.Nasi, J.Petralli, D.Calabria
 */
 
-class LIB_API Mesh : public virtual Node
+class LIB_API Mesh : public Node
 {
 private:
 	/**
 	@var material
 	Pointer to the mesh' material
 	*/
-	Material* material;
+	Material* material = nullptr;
 
 	unsigned int m_vaoID;
 	unsigned int m_vboID[2];
 
 	unsigned int m_numVertices;
 	unsigned int m_numFaces;
+	/**
+	@var poolEntry
+	The mesh' geometry in the shared MeshPool, used by the indirect path (see IndirectBatch.h), removed with the mesh
+	*/
+	unsigned int poolEntry;
+	/**
+	@var radius
+	Radius of the bounding sphere centered on the mesh' origin, negative when the bounds are unknown
+	*/
+	float radius;
+	glm::vec3 boxMin;
+	glm::vec3 boxMax;
+	/**
+	@var occluderPositions
+	CPU copy of the geometry, rasterized by the software occlusion culling (see Occlusion.h), only for meshes
+	of at most MAX_OCCLUDER_TRIANGLES triangles
+	*/
+	vector<float> occluderPositions;
+	vector<unsigned int> occluderIndices;
 	
 public:
+	/**
+	Larger meshes are not kept as occluders: one would take more than a quarter of the frame's triangle budget,
+	and their geometry would be held twice, on the GPU and on the CPU
+	*/
+	static const unsigned int MAX_OCCLUDER_TRIANGLES = Occlusion::MAX_TRIANGLES / 4;
+
+	static const Kind KIND = KIND_MESH;		///< See Node::as()
+
 	/**
 	Constructor
 	@see Object.h
@@ -53,12 +80,57 @@ public:
 	*/
 	void render();
 
+	/**
+	Sets the material and draws the mesh "instances" times, e.g. once per eye for instanced stereo
+	@param instances Number of instances
+	*/
+	void renderInstances(unsigned int instances);
+
+	/**
+	Draws the triangles without setting the material, for depth-only passes
+	@param instances Number of instances
+	*/
+	void renderGeometry(unsigned int instances = 1);
+
+	/**
+	Returns ShaderCache::FEATURE_TEXTURED when the material has a texture, and
+	ShaderCache::FEATURE_NORMAL_MATRIX when the world matrix is neither rigid nor uniformly scaled
+	@see Node.h
+	*/
+	unsigned int getShaderFeatures();
+
 	/**
 	Returns "mesh"
 	@see Object.h
 	*/
 	string getType();
 
+	/**
+	Returns the mesh' entry in the engine's MeshPool, MeshPool::INVALID_ENTRY if not there
+	*/
+	unsigned int getPoolEntry();
+	/**
+	Sets the mesh' local bounds, used for culling (see Culling.h)
+	@param radius Radius of the bounding sphere centered on the mesh' origin
+	@param boxMin Minimum corner of the bounding box
+	@param boxMax Maximum corner of the bounding box
+	*/
+	void setBounds(float radius, glm::vec3 boxMin, glm::vec3 boxMax);
+	/**
+	Returns the radius of the bounding sphere, negative if the mesh has no bounds
+	*/
+	float getRadius();
+	glm::vec3 getBoxMin();
+	glm::vec3 getBoxMax();
+	/**
+	Returns true if the mesh keeps a CPU copy of its geometry and can be used as occluder (see Occlusion.h),
+	i.e. it has at most MAX_OCCLUDER_TRIANGLES triangles
+	*/
+	bool isOccluder();
+	const float* getOccluderPositions();
+	unsigned int getOccluderVertices();
+	const unsigned int* getOccluderIndices();
+	unsigned int getOccluderTriangles();
 	void fillData(float* coordinates, float* textureCoordinates, float* normals, unsigned int nVertices, unsigned int* faces, unsigned int nFaces);
 };
 
@@ -0,0 +1,299 @@
+#include "Engine.h"
+
+// Glew (include it before GL.h):
+#include <GL/glew.h>
+
+// C/C++:
+#include <iostream>
+
+
+// Floats per interleaved vertex: position, normal, texture coordinates:
+#define VERTEX_FLOATS 8
+
+
+MeshPool::MeshPool()
+	: vertexCount{ 0 }
+	, vertexCapacity{ 0 }
+	, indexCount{ 0 }
+	, indexCapacity{ 0 }
+	, vbo{ 0 }
+	, ibo{ 0 }
+	, drawIdVbo{ 0 }
+	, drawIdDivisor{ 1 }
+{
+	// Allocate OGL data:
+	glGenVertexArrays(1, &vao);
+}
+
+MeshPool::~MeshPool()
+{
+	glDeleteBuffers(1, &vbo);
+	glDeleteBuffers(1, &ibo);
+	glDeleteVertexArrays(1, &vao);
+}
+
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+/**
+ * Adds the geometry of a mesh to the pool, in the first free ranges large enough or else at the end. The arrays are not kept.
+ * @param coordinates 3 floats per vertex
+ * @param normals 3 floats per vertex
+ * @param textureCoordinates 2 floats per vertex
+ * @param nVertices number of vertices
+ * @param faces 3 indices per face, relative to the mesh's first vertex
+ * @param nFaces number of faces
+ * @return the entry ID, or INVALID_ENTRY on fail
+ */
+unsigned int MeshPool::add(const float *coordinates, const float *normals, const float *textureCoordinates, unsigned int nVertices, const unsigned int *faces, unsigned int nFaces)
+{
+	// Safety net:
+	if (coordinates == nullptr || normals == nullptr || textureCoordinates == nullptr || faces == nullptr)
+	{
+		std::cout << "[ERROR] Invalid params" << std::endl;
+		return INVALID_ENTRY;
+	}
+
+	// Holes left by removed meshes first, then the end of the buffers:
+	unsigned int baseVertex = take(freeVertices, nVertices);
+	unsigned int firstIndex = take(freeIndices, 3 * nFaces);
+	reserve(baseVertex == INVALID_ENTRY ? vertexCount + nVertices : vertexCount, firstIndex == INVALID_ENTRY ? indexCount + 3 * nFaces : indexCount);
+	if (baseVertex == INVALID_ENTRY)
+	{
+		baseVertex = vertexCount;
+		vertexCount += nVertices;
+	}
+	if (firstIndex == INVALID_ENTRY)
+	{
+		firstIndex = indexCount;
+		indexCount += 3 * nFaces;
+	}
+
+	// Interleave:
+	vector<float> vertices(VERTEX_FLOATS * nVertices);
+	for (unsigned int c = 0; c < nVertices; c++)
+	{
+		float *v = &vertices[VERTEX_FLOATS * c];
+		memcpy(v, coordinates + 3 * c, 3 * sizeof(float));
+		memcpy(v + 3, normals + 3 * c, 3 * sizeof(float));
+		memcpy(v + 6, textureCoordinates + 2 * c, 2 * sizeof(float));
+	}
+
+	glBindBuffer(GL_ARRAY_BUFFER, vbo);
+	glBufferSubData(GL_ARRAY_BUFFER, VERTEX_FLOATS * sizeof(float) * baseVertex, VERTEX_FLOATS * sizeof(float) * nVertices, vertices.data());
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+	glBindBuffer(GL_COPY_WRITE_BUFFER, ibo);
+	glBufferSubData(GL_COPY_WRITE_BUFFER, sizeof(unsigned int) * firstIndex, 3 * sizeof(unsigned int) * nFaces, faces);
+	glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+
+	Entry entry;
+	entry.firstIndex = firstIndex;
+	entry.indexCount = 3 * nFaces;
+	entry.baseVertex = baseVertex;
+	entry.vertexCount = nVertices;
+	if (freeEntries.empty())
+	{
+		entries.push_back(entry);
+		return (unsigned int)entries.size() - 1;
+	}
+	unsigned int id = freeEntries.back();
+	freeEntries.pop_back();
+	entries[id] = entry;
+
+	// Done:
+	return id;
+}
+
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+/**
+ * Removes the geometry of a mesh: its ranges are reused by the next meshes added, and so is its ID.
+ * @param id entry ID, as returned by add()
+ * @return false if the ID is not an entry in use
+ */
+bool MeshPool::remove(unsigned int id)
+{
+	if (id >= entries.size() || entries[id].baseVertex == INVALID_ENTRY)
+		return false;
+
+	Entry &entry = entries[id];
+	release(freeVertices, entry.baseVertex, entry.vertexCount, vertexCount);
+	release(freeIndices, entry.firstIndex, entry.indexCount, indexCount);
+	entry.indexCount = 0;
+	entry.vertexCount = 0;
+	entry.baseVertex = INVALID_ENTRY;
+	freeEntries.push_back(id);
+	return true;
+}
+
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+/**
+ * Sets the buffer read by the per-instance ATTRIB_DRAWID attribute (one unsigned int per draw).
+ * @param vbo buffer ID
+ */
+void MeshPool::setDrawIds(unsigned int vbo)
+{
+	drawIdVbo = vbo;
+	setAttributes();
+}
+
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+/**
+ * Sets how many consecutive instances read the same draw ID, e.g. 2 when each draw is instanced once per eye.
+ * @param divisor instances per draw ID
+ */
+void MeshPool::setDrawIdDivisor(unsigned int divisor)
+{
+	if (divisor == drawIdDivisor || divisor == 0)
+		return;
+	drawIdDivisor = divisor;
+	if (drawIdVbo)
+		setAttributes();
+}
+
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+/**
+ * Binds the pool's VAO.
+ */
+void MeshPool::render()
+{
+	glBindVertexArray(vao);
+}
+
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+/**
+ * Grows the buffers to hold at least the given number of vertices and indices, keeping their content.
+ * @param vertices required vertices
+ * @param indices required indices
+ */
+void MeshPool::reserve(unsigned int vertices, unsigned int indices)
+{
+	if (vertices <= vertexCapacity && indices <= indexCapacity)
+		return;
+
+	// Grow geometrically, meshes are added one at a time while loading:
+	struct Storage { unsigned int *glId; unsigned int *capacity; unsigned int required; unsigned int used; unsigned int size; };
+	Storage storage[] = {
+		{ &vbo, &vertexCapacity, vertices, vertexCount, VERTEX_FLOATS * sizeof(float) },
+		{ &ibo, &indexCapacity, indices, indexCount, sizeof(unsigned int) },
+	};
+	for (Storage &s : storage)
+	{
+		if (s.required <= *s.capacity)
+			continue;
+
+		unsigned int capacity = glm::max(glm::max(s.required, *s.capacity * 2), 1024u);
+		unsigned int glId;
+		glGenBuffers(1, &glId);
+		glBindBuffer(GL_COPY_WRITE_BUFFER, glId);
+		glBufferData(GL_COPY_WRITE_BUFFER, capacity * s.size, nullptr, GL_STATIC_DRAW);
+		if (s.used)
+		{
+			glBindBuffer(GL_COPY_READ_BUFFER, *s.glId);
+			glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, 0, s.used * s.size);
+			glBindBuffer(GL_COPY_READ_BUFFER, 0);
+		}
+		glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+		glDeleteBuffers(1, s.glId);
+		*s.glId = glId;
+		*s.capacity = capacity;
+	}
+
+	setAttributes();
+}
+
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+/**
+ * Takes "count" elements from the first free range large enough.
+ * @param ranges free ranges, sorted
+ * @param count required elements
+ * @return the first element taken, or INVALID_ENTRY if no range is large enough
+ */
+unsigned int MeshPool::take(vector<Range> &ranges, unsigned int count)
+{
+	if (count == 0)
+		return INVALID_ENTRY;
+	for (size_t c = 0; c < ranges.size(); c++)
+		if (ranges[c].count >= count)
+		{
+			unsigned int first = ranges[c].first;
+			ranges[c].first += count;
+			ranges[c].count -= count;
+			if (ranges[c].count == 0)
+				ranges.erase(ranges.begin() + c);
+			return first;
+		}
+	return INVALID_ENTRY;
+}
+
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+/**
+ * Gives back a range, merged with its free neighbours. A range reaching the end of the used elements shortens them instead.
+ * @param ranges free ranges, sorted
+ * @param first first element of the range
+ * @param count elements in the range
+ * @param used elements up to the end of the last one in use
+ */
+void MeshPool::release(vector<Range> &ranges, unsigned int first, unsigned int count, unsigned int &used)
+{
+	if (count == 0)
+		return;
+
+	size_t c = 0;
+	while (c < ranges.size() && ranges[c].first < first)
+		c++;
+	if (c > 0 && ranges[c - 1].first + ranges[c - 1].count == first)
+	{
+		c--;
+		ranges[c].count += count;
+	}
+	else
+		ranges.insert(ranges.begin() + c, { first, count });
+	if (c + 1 < ranges.size() && ranges[c].first + ranges[c].count == ranges[c + 1].first)
+	{
+		ranges[c].count += ranges[c + 1].count;
+		ranges.erase(ranges.begin() + c + 1);
+	}
+
+	// The last range is not a hole:
+	if (ranges.back().first + ranges.back().count == used)
+	{
+		used = ranges.back().first;
+		ranges.pop_back();
+	}
+}
+
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+/**
+ * Points the VAO to the current buffers.
+ */
+void MeshPool::setAttributes()
+{
+	glBindVertexArray(vao);
+
+	glBindBuffer(GL_ARRAY_BUFFER, vbo);
+	glVertexAttribPointer(ATTRIB_POSITION, 3, GL_FLOAT, GL_FALSE, VERTEX_FLOATS * sizeof(float), nullptr);
+	glVertexAttribPointer(ATTRIB_NORMAL, 3, GL_FLOAT, GL_FALSE, VERTEX_FLOATS * sizeof(float), (void *)(3 * sizeof(float)));
+	glVertexAttribPointer(ATTRIB_TEXCOORD, 2, GL_FLOAT, GL_FALSE, VERTEX_FLOATS * sizeof(float), (void *)(6 * sizeof(float)));
+	glEnableVertexAttribArray(ATTRIB_POSITION);
+	glEnableVertexAttribArray(ATTRIB_NORMAL);
+	glEnableVertexAttribArray(ATTRIB_TEXCOORD);
+
+	if (drawIdVbo)
+	{
+		glBindBuffer(GL_ARRAY_BUFFER, drawIdVbo);
+		glVertexAttribIPointer(ATTRIB_DRAWID, 1, GL_UNSIGNED_INT, 0, nullptr);
+		glVertexAttribDivisor(ATTRIB_DRAWID, drawIdDivisor);
+		glEnableVertexAttribArray(ATTRIB_DRAWID);
+	}
+
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ibo);
+	glBindVertexArray(0);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
@@ -0,0 +1,99 @@
+#pragma once
+
+/**
+* Supsi-GE, shared geometry class
+* A MeshPool stores the geometry of every loaded mesh in a single interleaved vertex buffer
+* (position, normal, texture coordinates) and a single index buffer, behind one VAO.
+* Each mesh is an entry addressed by its first index and base vertex, so that any set of meshes
+* can be drawn with one glMultiDrawElementsIndirect() call (see IndirectBatch.h).
+* Both buffers grow geometrically as meshes are added. A removed mesh's vertex and index ranges go on free lists
+* (sorted, adjacent ranges merged) and are reused first-fit by the next meshes, so that unloading and reloading scenes
+* does not keep growing the buffers; the buffers themselves are never shrunk.
+*/
+class LIB_API MeshPool {
+	//////////
+public: //
+//////////
+
+	/**
+	@struct Entry
+	Location of a mesh in the pool, in the format of the indirect draw commands
+	*/
+	struct Entry
+	{
+		unsigned int firstIndex;
+		unsigned int indexCount;
+		unsigned int baseVertex;
+		unsigned int vertexCount;			///< Not part of the commands, needed to free the vertices
+	};
+
+	// Enumerations:
+	enum : unsigned int ///< Vertex attributes, shared with the shaders
+	{
+		ATTRIB_POSITION = 0,
+		ATTRIB_NORMAL,
+		ATTRIB_TEXCOORD,
+		ATTRIB_DRAWID,						///< Per-instance, read through the base instance of each command
+
+		INVALID_ENTRY = 0xFFFFFFFF,
+	};
+
+	// Const/dest:
+	MeshPool();
+	~MeshPool();
+
+	// Get/set:
+	inline unsigned int getEntryCount() { return (unsigned int)(entries.size() - freeEntries.size()); }
+	inline unsigned int getVertexCount() { return vertexCount; }
+	inline unsigned int getIndexCount() { return indexCount; }
+	inline unsigned int getVertexCapacity() { return vertexCapacity; }
+	inline unsigned int getIndexCapacity() { return indexCapacity; }
+	inline unsigned int getVao() { return vao; }
+	inline const Entry &getEntry(unsigned int id) { return entries[id]; }
+
+	// Management:
+	unsigned int add(const float *coordinates, const float *normals, const float *textureCoordinates, unsigned int nVertices, const unsigned int *faces, unsigned int nFaces);
+	bool remove(unsigned int id);
+	void setDrawIds(unsigned int vbo);
+	void setDrawIdDivisor(unsigned int divisor);
+
+	// Rendering:
+	void render();
+
+
+	///////////
+private: //
+///////////
+
+	/**
+	@struct Range
+	A free range of vertices or indices
+	*/
+	struct Range
+	{
+		unsigned int first;
+		unsigned int count;
+	};
+
+	void reserve(unsigned int vertices, unsigned int indices);
+	void setAttributes();
+	static unsigned int take(vector<Range> &ranges, unsigned int count);
+	static void release(vector<Range> &ranges, unsigned int first, unsigned int count, unsigned int &used);
+
+	// Generic data:
+	vector<Entry> entries;
+	vector<unsigned int> freeEntries;		///< IDs of the removed entries, reused by add()
+	vector<Range> freeVertices;				///< Holes below vertexCount, sorted
+	vector<Range> freeIndices;				///< Holes below indexCount, sorted
+	unsigned int vertexCount;				///< Vertices up to the end of the last one in use, holes included
+	unsigned int vertexCapacity;			///< Vertices allocated in video memory
+	unsigned int indexCount;				///< Indices up to the end of the last one in use, holes included
+	unsigned int indexCapacity;				///< Indices allocated in video memory
+
+	// OGL stuff:
+	unsigned int vao;
+	unsigned int vbo;
+	unsigned int ibo;
+	unsigned int drawIdVbo;
+	unsigned int drawIdDivisor;				///< Instances sharing a draw ID, 2 for instanced stereo
+};
@@ -0,0 +1,113 @@
+#include "Engine.h"
+
+#include <deque>
+#include <shared_mutex>
+#include <unordered_map>
+
+
+//the table, built on first use so that static objects can be named too
+struct NameTableData
+{
+	deque<string> names;						//deque: references stay valid when it grows
+	vector<unsigned int> hashes;
+	unordered_multimap<unsigned int, unsigned int> lookup;		//hash -> index
+	std::shared_mutex mutex;
+
+	NameTableData()
+	{
+		names.push_back("");
+		hashes.push_back(NameTable::hash(""));
+		lookup.emplace(hashes[0], 0);
+	}
+};
+
+static NameTableData &table()
+{
+	static NameTableData t;
+	return t;
+}
+
+
+unsigned int LIB_API NameTable::hash(const string &name)
+{
+	unsigned int h = 2166136261u;
+	for (unsigned char c : name)
+	{
+		h ^= c;
+		h *= 16777619u;
+	}
+	return h;
+}
+
+//with the lock held
+static unsigned int lookup(NameTableData &t, const string &name, unsigned int h)
+{
+	auto range = t.lookup.equal_range(h);
+	for (auto it = range.first; it != range.second; ++it)
+		if (t.names[it->second] == name)
+			return it->second;
+	return NameTable::NOT_FOUND;
+}
+
+unsigned int LIB_API NameTable::find(const string &name)
+{
+	NameTableData &t = table();
+	unsigned int h = hash(name);
+	std::shared_lock<std::shared_mutex> lock(t.mutex);
+	return lookup(t, name, h);
+}
+
+unsigned int LIB_API NameTable::intern(const string &name)
+{
+	NameTableData &t = table();
+	unsigned int h = hash(name);
+	{
+		std::shared_lock<std::shared_mutex> lock(t.mutex);
+		unsigned int id = lookup(t, name, h);
+		if (id != NOT_FOUND)
+			return id;
+	}
+
+	//another thread may have added it meanwhile
+	std::unique_lock<std::shared_mutex> lock(t.mutex);
+	unsigned int id = lookup(t, name, h);
+	if (id != NOT_FOUND)
+		return id;
+	id = (unsigned int)t.names.size();
+	t.names.push_back(name);
+	t.hashes.push_back(h);
+	t.lookup.emplace(t.hashes[id], id);
+	return id;
+}
+
+const string LIB_API & NameTable::get(unsigned int id)
+{
+	NameTableData &t = table();
+	std::shared_lock<std::shared_mutex> lock(t.mutex);
+	return id < t.names.size() ? t.names[id] : t.names[0];
+}
+
+unsigned int LIB_API NameTable::getHash(unsigned int id)
+{
+	NameTableData &t = table();
+	std::shared_lock<std::shared_mutex> lock(t.mutex);
+	return id < t.hashes.size() ? t.hashes[id] : t.hashes[0];
+}
+
+unsigned int LIB_API NameTable::getCount()
+{
+	std::shared_lock<std::shared_mutex> lock(table().mutex);
+	return (unsigned int)table().names.size();
+}
+
+size_t LIB_API NameTable::getMemory()
+{
+	NameTableData &t = table();
+	std::shared_lock<std::shared_mutex> lock(t.mutex);
+	size_t memory = t.hashes.capacity() * sizeof(unsigned int);
+	for (const string &name : t.names)
+		memory += sizeof(string) + (name.capacity() > 15 ? name.capacity() + 1 : 0);
+	//one node and one bucket per entry, roughly
+	memory += t.lookup.size() * (sizeof(pair<unsigned int, unsigned int>) + 2 * sizeof(void *)) + t.lookup.bucket_count() * sizeof(void *);
+	return memory;
+}
@@ -0,0 +1,55 @@
+#pragma once
+
+/**
+* Supsi-GE, interned names class
+* Every distinct name used by the scene objects is stored once in a global string table, objects only keep its
+* index (see Object.h). Names are compared by index and looked up by their 32 bit FNV-1a hash.
+* Index 0 is the empty string. Names are never removed, references returned by get() stay valid.
+* The table is meant to be filled by the loading thread, but nodes can be renamed on the simulation thread while
+* other threads look names up (see Registry.h): a readers-writer lock guards it.
+*/
+class LIB_API NameTable
+{
+public:
+	/**
+	Returns the index of a name, adding it to the table the first time
+	@param name The name
+	*/
+	static unsigned int intern(const string &name);
+
+	/**
+	Returns the index of a name, or NOT_FOUND if it was never interned
+	@param name The name
+	*/
+	static unsigned int find(const string &name);
+
+	/**
+	Returns the name at an index, the empty string for invalid ones
+	@param id The index, as returned by intern()
+	*/
+	static const string &get(unsigned int id);
+
+	/**
+	Returns the hash of the name at an index
+	@param id The index, as returned by intern()
+	*/
+	static unsigned int getHash(unsigned int id);
+
+	/**
+	Returns the number of names in the table, including the empty one
+	*/
+	static unsigned int getCount();
+
+	/**
+	Returns the memory used by the table, in bytes
+	*/
+	static size_t getMemory();
+
+	/**
+	Hashes a string with FNV-1a
+	@param name The string
+	*/
+	static unsigned int hash(const string &name);
+
+	static const unsigned int NOT_FOUND = 0xFFFFFFFF;
+};
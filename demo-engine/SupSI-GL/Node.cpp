@@ -1,15 +1,32 @@
 #include "Engine.h"
-#include "GL/freeglut.h"
 
 
+std::atomic<unsigned int> Node::structureVersion{ 0 };
+std::atomic<unsigned long long> Node::worldEpoch{ 0 };
+
 LIB_API Node::Node() : Object()
 {
+	setKind(KIND_NODE);
 	parent = nullptr;
+	childIndex = 0;
+	registry = nullptr;
+	worldDirty = true;
+	inverseDirty = true;
+	movedVersion = 0;
 }
 
 
 LIB_API Node::~Node()
 {
+	if (registry != nullptr)
+	{
+		if (registry->getRoot() == this)
+			registry->setRoot(nullptr);
+		else
+			registry->remove(this);
+	}
+	detach();
+	deleteChildren();
 }
 
 Node LIB_API * Node::getParent()
@@ -17,29 +34,73 @@ Node LIB_API * Node::getParent()
 	return parent;
 }
 
+//swap-remove from the parent's children, the moved sibling takes this node's index
+void Node::detach()
+{
+	if (parent == nullptr)
+		return;
+	Node *last = parent->children.back();
+	parent->children[childIndex] = last;
+	last->childIndex = childIndex;
+	parent->children.pop_back();
+	parent = nullptr;
+	structureVersion++;
+}
+
 void LIB_API Node::setParent(Node *parent)
 {
-	if (parent != nullptr) {
-		for (int i = 0; i < parent->children.size(); i++)
-		{
-			if (parent->children.at(i)->getId() == this->getId())
-			{
-				parent->children.erase(parent->children.begin() + i);
-			}
-		}
-	}
+	detach();
 	this->parent = parent;
-	parent->children.push_back(this);
+	if (parent != nullptr)
+	{
+		childIndex = (unsigned int)parent->children.size();
+		parent->children.push_back(this);
+	}
+	structureVersion++;
+	moved();
+	updateRegistry();
+}
+
+//the root of a registry stays in it, the other nodes follow their parent
+void Node::updateRegistry()
+{
+	if (registry != nullptr && registry->getRoot() == this)
+		return;
+	Registry *joined = parent != nullptr ? parent->registry : nullptr;
+	if (joined == registry)
+		return;
+	if (registry != nullptr)
+		registry->remove(this);
+	if (joined != nullptr)
+		joined->add(this);
+}
+
+void Node::identityChanged(int previousId, unsigned int previousName)
+{
+	if (registry != nullptr)
+		registry->update(this, previousId, previousName);
 }
 
-vector<Node*> LIB_API Node::getChildren()
+const vector<Node*> LIB_API & Node::getChildren()
 {
 	return children;
 }
 
 void  LIB_API Node::deleteChildren()
 {
+	for (Node *child : children)
+	{
+		child->parent = nullptr;
+		child->moved();
+		child->updateRegistry();
+	}
 	this->children.clear();
+	structureVersion++;
+}
+
+unsigned int LIB_API Node::getStructureVersion()
+{
+	return structureVersion;
 }
 
 glm::mat4 LIB_API Node::getPosMatrix()
@@ -50,6 +111,29 @@ glm::mat4 LIB_API Node::getPosMatrix()
 void LIB_API Node::setPosMatrix(glm::mat4 posMatrix)
 {
 	this->posMatrix=posMatrix;
+	moved();
+}
+
+//marks the subtree as moved, the descendants of a dirty node are dirty already
+void Node::invalidate()
+{
+	if (worldDirty)
+		return;
+	worldDirty = true;
+	inverseDirty = true;
+	for (Node *child : children)
+		child->invalidate();
+}
+
+void Node::moved()
+{
+	movedVersion = ++worldEpoch;
+	invalidate();
+}
+
+Transform LIB_API * Node::getTransform()
+{
+	return &transform;
 }
 
 void LIB_API Node::appendChild(Node *child)
@@ -74,18 +158,45 @@ Node LIB_API * Node::search(int id)
 	return nullptr;
 }
 
-//return the final position matrix (it applies all parents transformations)
-glm::mat4 LIB_API Node::getFinal()
+//return the final position matrix (it applies all parents transformations), recomputed only when dirty
+const glm::mat4 LIB_API & Node::getFinal()
 {
-	if (parent == nullptr)
-		return posMatrix;
-	return parent->getFinal() * posMatrix;
+	if (worldDirty)
+	{
+		world = parent == nullptr ? posMatrix : parent->getFinal() * posMatrix;
+		worldDirty = false;
+	}
+	return world;
+}
+
+//latest change of the node or of its parents
+unsigned long long LIB_API Node::getWorldVersion()
+{
+	unsigned long long version = movedVersion;
+	for (Node *node = parent; node != nullptr; node = node->parent)
+		version = glm::max(version, node->movedVersion);
+	return version;
+}
+
+const glm::mat4 LIB_API & Node::getFinalInverse()
+{
+	if (inverseDirty)
+	{
+		worldInverse = glm::inverse(getFinal());
+		inverseDirty = false;
+	}
+	return worldInverse;
 }
 
 void LIB_API Node::render()
 {
 }
 
+unsigned int LIB_API Node::getShaderFeatures()
+{
+	return 0;
+}
+
 string LIB_API Node::getType()
 {
 	return "node";
@@ -23,12 +23,83 @@ private:
 	*/
 	vector<Node*> children;
 
+	/**
+	@var childIndex
+	Position of the Node in its parent's children list, so that it can be removed without searching it
+	*/
+	unsigned int childIndex;
+
+	/**
+	Removes the Node from its parent's children list, moving the last child in its place
+	*/
+	void detach();
+
+	/**
+	@var registry
+	The Registry indexing the Node (see Registry.h): the one of its parent, or the one it is the root of.
+	nullptr when the Node is not indexed.
+	*/
+	class Registry *registry;
+	friend class Registry;
+
+	/**
+	Moves the Node and its subtree to the Registry of its new parent, if it is not the root of its own
+	*/
+	void updateRegistry();
+
+	/**
+	Keeps the Registry of the Node up to date, see Object::identityChanged()
+	*/
+	void identityChanged(int previousId, unsigned int previousName);
+
 	/**
 	@var posMatrix
 	The Node's positioning matrix relative to the parent
 	*/
 	glm::mat4 posMatrix;
+
+	/**
+	@var world
+	Cache of the Node's final matrix and of its inverse, valid when the dirty flags are cleared.
+	A dirty Node only has dirty descendants, so invalidating stops at the first one that is already dirty.
+	*/
+	glm::mat4 world;
+	glm::mat4 worldInverse;
+	bool worldDirty;
+	bool inverseDirty;
+
+	/**
+	@var movedVersion
+	Value of worldEpoch when setPosMatrix() or setParent() last changed the Node. The version of the final matrix is
+	the latest one of the Node and of its parents, so that moving a Node does not have to visit its subtree
+	*/
+	unsigned long long movedVersion;
+	static std::atomic<unsigned long long> worldEpoch;
+
+	/**
+	Marks the final matrix of the Node and of its whole subtree as stale
+	*/
+	void invalidate();
+
+	/**
+	Takes a new world version and invalidates the subtree, after the Node's own matrix or parent changed
+	*/
+	void moved();
+
+	/**
+	@var transform
+	Class and normal matrix of the Node's last world matrix (see Transform.h)
+	*/
+	Transform transform;
+
+	/**
+	@var structureVersion
+	Bumped whenever a Node is reparented, loses its children or is destroyed. Atomic: the simulation thread changes
+	the tree while other threads check whether their flattened copies are still valid.
+	*/
+	static std::atomic<unsigned int> structureVersion;
 public:
+	static const Kind KIND = KIND_NODE;		///< See as()
 
 	/**
 	Constructor
@@ -43,7 +114,16 @@ public:
 	virtual ~Node();
 
 	/**
-	Returns the child node with the specified id with a recursive search
+	Checked downcast without RTTI: returns the node as a T if it is exactly a T (T::KIND), nullptr otherwise
+	*/
+	template <class T> T* as()
+	{
+		return getKind() == T::KIND ? static_cast<T*>(this) : nullptr;
+	}
+
+	/**
+	Returns the child node with the specified id with a recursive search.
+	Use a Registry (see Registry.h) for repeated lookups.
 	@param id The identifier to be searched
 	*/
 	Node* search(int id);
@@ -55,8 +135,9 @@ public:
 	void appendChild(Node *child);
 
 	/**
-	Set the previous Node in the graph to "parent"
-	@param parent The new parent Node
+	Set the previous Node in the graph to "parent", in constant time. The Node is appended to the new parent's
+	children and its place in the old parent's list is taken by the last one of its siblings.
+	@param parent The new parent Node, nullptr to detach the Node
 	*/
 	void setParent(Node *parent);
 
@@ -66,12 +147,12 @@ public:
 	Node* getParent();
 
 	/**
-	Returns the children list
+	Returns the children list, without copying it
 	*/
-	vector<Node*> getChildren();
+	const vector<Node*> &getChildren();
 
 	/**
-	Clears the children list
+	Clears the children list, the children are left without a parent
 	*/
 	void deleteChildren();
 
@@ -81,20 +162,49 @@ public:
 	glm::mat4 getPosMatrix();
 
 	/**
-	Returns the Node's final positioning matrix in screen coordinates (as seen by a camera)
+	Returns the Node's final positioning matrix in world coordinates. It is cached: only the Nodes moved since
+	the last call (this one, or one of its parents) are recomputed.
+	*/
+	const glm::mat4 &getFinal();
+
+	/**
+	Returns the inverse of the final positioning matrix, cached as well
 	*/
-	glm::mat4 getFinal();
+	const glm::mat4 &getFinalInverse();
+
+	/**
+	Returns a counter that changes whenever the final matrix changes, because of setPosMatrix() or setParent()
+	on this Node or on one of its parents, also when the cached matrix is already stale. Walks up to the root.
+	*/
+	unsigned long long getWorldVersion();
 
 	/**
 	Set the Node's positioning matrix
 	*/
 	void setPosMatrix(glm::mat4 posMatrix);
 
+	/**
+	Returns the cache of the Node's world matrix, updated when the Node is added to a List
+	*/
+	Transform* getTransform();
+
+	/**
+	Returns a counter that changes whenever the shape of any tree changes, so that flattened copies
+	of the scene graph (see Hierarchy.h) know when they must be rebuilt
+	*/
+	static unsigned int getStructureVersion();
+
 	/**
 	@see Object.h
 	*/
 	void render();
 
+	/**
+	Returns the shader features (ShaderCache::FEATURE_* bits) needed to render the node.
+	Plain nodes draw nothing and need none.
+	*/
+	virtual unsigned int getShaderFeatures();
+
 	void traverse(const std::string & tab = "");
 	/**
 	Returns "node"
@@ -1,7 +1,7 @@
 #include "Engine.h"
 
 
-int Object::currId = 0;
+std::atomic<int> Object::currId{ 0 };
 int Object::getNextId()
 {
 	return currId++;
@@ -16,19 +16,42 @@ LIB_API Object::~Object()
 {
 }
 
+Object::Kind LIB_API Object::getKind()
+{
+	return kind;
+}
+void Object::setKind(Kind kind)
+{
+	this->kind = kind;
+}
+void Object::identityChanged(int, unsigned int)
+{
+}
 int LIB_API Object::getId()
 {
 	return id;
 }
-string LIB_API Object::getName()
+const string LIB_API & Object::getName()
+{
+	return NameTable::get(name);
+}
+unsigned int LIB_API Object::getNameId()
 {
 	return name;
 }
+unsigned int LIB_API Object::getNameHash()
+{
+	return NameTable::getHash(name);
+}
 void LIB_API Object::setId(int id)
 {
+	int previous = this->id;
 	this->id = id;
+	identityChanged(previous, name);
 }
-void LIB_API Object::setName(string name)
+void LIB_API Object::setName(const string &name)
 {
-	this->name = name;
+	unsigned int previous = this->name;
+	this->name = NameTable::intern(name);
+	identityChanged(id, previous);
 }
\ No newline at end of file
@@ -6,12 +6,33 @@
 * across the class structure.
 * The methods render() and getType() need to be implemented by the children, due to
 * them being virtual (not implemented)
+* getType() builds a string: code running every frame identifies the objects by their Kind instead,
+* a one byte tag set by the constructors (see Node::as())
 *
 * @authors D.Nasi, J.Petralli, D.Calabria
 */
 
 class LIB_API Object
 {
+public:
+	/**
+	@enum Kind
+	Concrete type of an object, one per subclass
+	*/
+	enum Kind : unsigned char
+	{
+		KIND_OBJECT = 0,
+		KIND_NODE,
+		KIND_MESH,
+		KIND_LIGHT,
+		KIND_CAMERA,
+		KIND_MATERIAL,
+		KIND_TEXTURE,
+		KIND_LIST,
+		KIND_SHADER,
+		KIND_PROGRAM,
+	};
+
 private:
 	/**
 	@var id
@@ -21,21 +42,40 @@ private:
 
 	/**
 	@var name
-	The object's name
+	The object's name, as an index in the NameTable (see NameTable.h)
+	*/
+	unsigned int name = 0;
+
+	/**
+	@var kind
+	The object's concrete type
 	*/
-	string name;
+	Kind kind = KIND_OBJECT;
 
 	/**
 	@static @var currId
 	Global variable used during ID generation
 	*/
-	static int currId;
+	static std::atomic<int> currId;
 
 	/**
 	@static Method
 	Used during construction to generate the object's ID
 	*/
 	static int getNextId();
+
+protected:
+	/**
+	Sets the object's concrete type, called by the constructor of every subclass
+	*/
+	void setKind(Kind kind);
+
+	/**
+	Called by setId() and setName() with the previous values, so that the indices holding the object
+	(see Registry.h) can follow. Does nothing by default.
+	*/
+	virtual void identityChanged(int previousId, unsigned int previousName);
+
 public:
 
 	/**
@@ -49,6 +89,11 @@ public:
 	*/
 	virtual ~Object()=0;
 
+	/**
+	Returns the object's concrete type, without building a string like getType()
+	*/
+	Kind getKind();
+
 	/**
 	Returns an object's ID
 	*/
@@ -57,7 +102,17 @@ public:
 	/**
 	Returns the object's name
 	*/
-	string getName();
+	const string &getName();
+
+	/**
+	Returns the index of the object's name in the NameTable
+	*/
+	unsigned int getNameId();
+
+	/**
+	Returns the hash of the object's name, for quick comparisons
+	*/
+	unsigned int getNameHash();
 
 	/**
 	Set an object's ID
@@ -69,7 +124,7 @@ public:
 	Set an object's name
 	@param name the new name
 	*/
-	void setName(string name);
+	void setName(const string &name);
 	
 	/**
 	Specifies how the object has to be rendered.
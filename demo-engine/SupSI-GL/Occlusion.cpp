@@ -0,0 +1,370 @@
+#include "Engine.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <chrono>
+
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#define OCCLUSION_SSE
+#include <xmmintrin.h>
+#endif
+
+#define FULL_MASK 0xFFFFFFFFu
+
+
+//in front of the near plane of the view: OpenGL clips z against -w
+static inline bool inFront(const glm::vec4 &clip)
+{
+	return clip.z >= -clip.w && clip.w > 0.0f;
+}
+
+
+LIB_API Occlusion::Occlusion()
+{
+}
+
+void LIB_API Occlusion::begin(const glm::mat4 *viewProj, unsigned int views)
+{
+	this->views = glm::min(views, MAX_VIEWS);
+	for (unsigned int v = 0; v < this->views; v++)
+		this->viewProj[v] = viewProj[v];
+
+	//center of the first view's near plane, close enough to the eye to rank the occluders
+	glm::vec4 e = glm::inverse(viewProj[0]) * glm::vec4(0.0f, 0.0f, -1.0f, 1.0f);
+	eye = glm::vec3(e) / e.w;
+
+	occluders.clear();
+	Tile empty = { FLT_MAX, 0.0f, 0 };
+	tiles.assign(this->views * TILES_X * TILES_Y, empty);
+	depth.assign(this->views * TILES_X * TILES_Y, FLT_MAX);
+	rasterized = 0;
+	tested = 0;
+	occluded = 0;
+}
+
+void LIB_API Occlusion::addOccluder(const glm::mat4 &model, float radius, const float *positions, unsigned int vertices, const unsigned int *indices, unsigned int triangles)
+{
+	if (triangles == 0 || radius <= 0.0f)
+		return;
+
+	float scale = glm::max(glm::length(glm::vec3(model[0])), glm::max(glm::length(glm::vec3(model[1])), glm::length(glm::vec3(model[2]))));
+	float r = radius * scale;
+	Occluder o;
+	o.model = model;
+	o.priority = r / glm::max(glm::distance(glm::vec3(model[3]), eye), r);
+	o.order = (unsigned int)occluders.size();
+	o.positions = positions;
+	o.vertices = vertices;
+	o.indices = indices;
+	o.triangles = triangles;
+	o.first = 0;
+	occluders.push_back(o);
+}
+
+void LIB_API Occlusion::render()
+{
+	auto start = std::chrono::high_resolution_clock::now();
+
+	//largest first: equal sizes fall back to the submission index, unique per occluder, so the budget below always cuts
+	//the same occluders for the same scene, frame after frame
+	std::sort(occluders.begin(), occluders.end(), [](const Occluder &a, const Occluder &b) {
+		return a.priority > b.priority || (a.priority == b.priority && a.order < b.order);
+	});
+	if (occluders.size() > MAX_OCCLUDERS)
+		occluders.resize(MAX_OCCLUDERS);
+
+	//triangle budget: the occluder reaching it is cut, the smaller ones are dropped
+	triangleCount = 0;
+	unsigned int used = 0;
+	while (used < occluders.size() && triangleCount < MAX_TRIANGLES)
+	{
+		Occluder &o = occluders[used++];
+		o.first = triangleCount;
+		o.triangles = glm::min(o.triangles, MAX_TRIANGLES - triangleCount);
+		triangleCount += o.triangles;
+	}
+	occluders.resize(used);
+	triangles.resize(views * triangleCount);
+	if (screen.size() < occluders.size())
+		screen.resize(occluders.size());
+
+	//projection per occluder, then rasterization per band of tiles
+	unsigned int count = (unsigned int)occluders.size();
+	if (jobs != nullptr && count > 1)
+		jobs->parallelFor("occluders", count, 1, [this](unsigned int begin, unsigned int end) { transform(begin, end); });
+	else
+		transform(0, count);
+	unsigned int bands = glm::min(getThreads(), TILES_Y);
+	if (bands > 1)
+		jobs->parallelFor("occlusion", bands, 1, [this, bands](unsigned int begin, unsigned int end)
+		{
+			rasterize(TILES_Y * begin / bands, TILES_Y * end / bands);
+		});
+	else
+		rasterize(0, TILES_Y);
+
+	rasterized = 0;
+	for (const Triangle &t : triangles)
+		if (t.z >= 0.0f)
+			rasterized++;
+	for (unsigned int c = 0; c < tiles.size(); c++)
+		depth[c] = tiles[c].zMax0;
+
+	cullTime += std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::high_resolution_clock::now() - start).count();
+}
+
+void LIB_API Occlusion::transform(unsigned int begin, unsigned int end)
+{
+	for (unsigned int o = begin; o < end; o++)
+	{
+		const Occluder &occluder = occluders[o];
+		vector<glm::vec3> &vertices = screen[o];
+		vertices.resize(occluder.vertices);
+		for (unsigned int v = 0; v < views; v++)
+		{
+			//viewport transform folded into the matrix
+			glm::mat4 viewport = glm::scale(glm::translate(glm::mat4(1.0f), glm::vec3(WIDTH * 0.5f, HEIGHT * 0.5f, 0.0f)), glm::vec3(WIDTH * 0.5f, HEIGHT * 0.5f, 1.0f));
+			glm::mat4 m = viewport * viewProj[v] * occluder.model;
+			for (unsigned int c = 0; c < occluder.vertices; c++)
+			{
+				const float *p = occluder.positions + 3 * c;
+				glm::vec4 clip = m[0] * p[0] + m[1] * p[1] + m[2] * p[2] + m[3];
+				if (!inFront(clip))
+					vertices[c] = glm::vec3(0.0f, 0.0f, -1.0f);
+				else
+					vertices[c] = glm::vec3(clip.x / clip.w, clip.y / clip.w, clip.w);
+			}
+
+			Triangle *out = &triangles[v * triangleCount + occluder.first];
+			for (unsigned int c = 0; c < occluder.triangles; c++)
+			{
+				Triangle &t = out[c];
+				t.z = 0.0f;
+				for (int k = 0; k < 3; k++)
+				{
+					const glm::vec3 &p = vertices[occluder.indices[3 * c + k]];
+					if (p.z < 0.0f)
+					{
+						//crossing the near plane: not clipped, simply not used as an occluder
+						t.z = -1.0f;
+						break;
+					}
+					t.x[k] = p.x;
+					t.y[k] = p.y;
+					t.z = glm::max(t.z, p.z);
+				}
+
+				//back faces
+				if (t.z >= 0.0f && (t.x[1] - t.x[0]) * (t.y[2] - t.y[0]) - (t.x[2] - t.x[0]) * (t.y[1] - t.y[0]) <= 0.0f)
+					t.z = -1.0f;
+			}
+		}
+	}
+}
+
+void LIB_API Occlusion::rasterize(unsigned int rowBegin, unsigned int rowEnd)
+{
+	for (unsigned int v = 0; v < views; v++)
+	{
+		Tile *view = &tiles[v * TILES_X * TILES_Y];
+		const Triangle *first = &triangles[v * triangleCount];
+		for (const Triangle *t = first; t < first + triangleCount; t++)
+		{
+			if (t->z < 0.0f)
+				continue;
+
+			//tiles overlapped by the triangle's bounding box, within this band
+			float minX = glm::min(t->x[0], glm::min(t->x[1], t->x[2]));
+			float maxX = glm::max(t->x[0], glm::max(t->x[1], t->x[2]));
+			float minY = glm::min(t->y[0], glm::min(t->y[1], t->y[2]));
+			float maxY = glm::max(t->y[0], glm::max(t->y[1], t->y[2]));
+			if (maxX < 0.0f || maxY < 0.0f || minX >= (float)WIDTH || minY >= (float)HEIGHT)
+				continue;
+			unsigned int tx0 = (unsigned int)glm::max(minX, 0.0f) / TILE_W;
+			unsigned int tx1 = glm::min((unsigned int)maxX / TILE_W, TILES_X - 1);
+			unsigned int ty0 = glm::max((unsigned int)glm::max(minY, 0.0f) / TILE_H, rowBegin);
+			unsigned int ty1 = glm::min(glm::min((unsigned int)maxY / TILE_H, TILES_Y - 1), rowEnd - 1);
+
+			for (unsigned int ty = ty0; ty <= ty1 && ty < rowEnd; ty++)
+				for (unsigned int tx = tx0; tx <= tx1; tx++)
+				{
+					Tile &tile = view[tx + ty * TILES_X];
+					if (t->z >= tile.zMax0)
+						continue;
+					unsigned int mask = coverage(*t, tx, ty);
+					if (mask == 0)
+						continue;
+
+					//drop the working layer when it is closer to the reference layer than to the new triangle
+					if (tile.mask && tile.zMax1 - t->z > tile.zMax0 - tile.zMax1)
+						tile.mask = 0;
+					tile.zMax1 = tile.mask ? glm::max(tile.zMax1, t->z) : t->z;
+					tile.mask |= mask;
+
+					//fully covered: the working layer becomes the reference
+					if (tile.mask == FULL_MASK)
+					{
+						tile.zMax0 = tile.zMax1;
+						tile.mask = 0;
+					}
+				}
+		}
+	}
+}
+
+unsigned int LIB_API Occlusion::coverage(const Triangle &t, unsigned int tileX, unsigned int tileY)
+{
+	//edge functions, positive inside a counter-clockwise triangle
+	//pixels exactly on an edge belong to one of the two triangles sharing it, picked by the edge direction
+	float a[3], b[3], c[3];
+	bool inclusive[3];
+	for (int k = 0; k < 3; k++)
+	{
+		int n = (k + 1) % 3;
+		a[k] = t.y[k] - t.y[n];
+		b[k] = t.x[n] - t.x[k];
+		c[k] = t.x[k] * t.y[n] - t.x[n] * t.y[k];
+		inclusive[k] = a[k] > 0.0f || (a[k] == 0.0f && b[k] > 0.0f);
+	}
+
+	unsigned int mask = 0;
+	float x0 = (float)(tileX * TILE_W) + 0.5f;
+	float y0 = (float)(tileY * TILE_H) + 0.5f;
+#ifdef OCCLUSION_SSE
+	__m128 zero = _mm_setzero_ps();
+	__m128 colLo = _mm_add_ps(_mm_set1_ps(x0), _mm_set_ps(3.0f, 2.0f, 1.0f, 0.0f));
+	__m128 colHi = _mm_add_ps(colLo, _mm_set1_ps(4.0f));
+	for (unsigned int j = 0; j < TILE_H; j++)
+	{
+		float y = y0 + j;
+		__m128 inLo = _mm_cmpeq_ps(zero, zero);
+		__m128 inHi = inLo;
+		for (int k = 0; k < 3; k++)
+		{
+			__m128 ak = _mm_set1_ps(a[k]);
+			__m128 row = _mm_set1_ps(b[k] * y + c[k]);
+			__m128 eLo = _mm_add_ps(_mm_mul_ps(ak, colLo), row);
+			__m128 eHi = _mm_add_ps(_mm_mul_ps(ak, colHi), row);
+			inLo = _mm_and_ps(inLo, inclusive[k] ? _mm_cmpge_ps(eLo, zero) : _mm_cmpgt_ps(eLo, zero));
+			inHi = _mm_and_ps(inHi, inclusive[k] ? _mm_cmpge_ps(eHi, zero) : _mm_cmpgt_ps(eHi, zero));
+		}
+		mask |= (unsigned int)(_mm_movemask_ps(inLo) | (_mm_movemask_ps(inHi) << 4)) << (j * TILE_W);
+	}
+#else
+	for (unsigned int j = 0; j < TILE_H; j++)
+		for (unsigned int i = 0; i < TILE_W; i++)
+		{
+			float x = x0 + i;
+			float y = y0 + j;
+			bool inside = true;
+			for (int k = 0; k < 3; k++)
+			{
+				float e = a[k] * x + (b[k] * y + c[k]);
+				inside &= inclusive[k] ? e >= 0.0f : e > 0.0f;
+			}
+			mask |= (inside ? 1u : 0u) << (i + j * TILE_W);
+		}
+#endif
+	return mask;
+}
+
+bool LIB_API Occlusion::test(unsigned int view, const glm::mat4 &model, const glm::vec3 &boxMin, const glm::vec3 &boxMax)
+{
+	if (view >= views)
+		return true;
+	auto start = std::chrono::high_resolution_clock::now();
+	tested++;
+
+	//screen rectangle and nearest depth of the box
+	glm::mat4 m = viewProj[view] * model;
+	float minX = FLT_MAX, minY = FLT_MAX, maxX = -FLT_MAX, maxY = -FLT_MAX;
+	float zNear = FLT_MAX;
+	bool visible = false;
+	for (int corner = 0; corner < 8 && !visible; corner++)
+	{
+		glm::vec4 clip = m * glm::vec4((corner & 1) ? boxMax.x : boxMin.x, (corner & 2) ? boxMax.y : boxMin.y, (corner & 4) ? boxMax.z : boxMin.z, 1.0f);
+		if (!inFront(clip))
+		{
+			visible = true;
+			break;
+		}
+		float x = (clip.x / clip.w * 0.5f + 0.5f) * WIDTH;
+		float y = (clip.y / clip.w * 0.5f + 0.5f) * HEIGHT;
+		minX = glm::min(minX, x);
+		maxX = glm::max(maxX, x);
+		minY = glm::min(minY, y);
+		maxY = glm::max(maxY, y);
+		zNear = glm::min(zNear, clip.w);
+	}
+
+	//outside the screen: left to the frustum culling
+	if (!visible && (maxX < 0.0f || maxY < 0.0f || minX >= (float)WIDTH || minY >= (float)HEIGHT))
+		visible = true;
+
+	if (!visible)
+	{
+		unsigned int tx0 = (unsigned int)glm::max(minX, 0.0f) / TILE_W;
+		unsigned int tx1 = glm::min((unsigned int)maxX / TILE_W, TILES_X - 1);
+		unsigned int ty0 = (unsigned int)glm::max(minY, 0.0f) / TILE_H;
+		unsigned int ty1 = glm::min((unsigned int)maxY / TILE_H, TILES_Y - 1);
+		for (unsigned int ty = ty0; ty <= ty1 && !visible; ty++)
+		{
+			const float *row = &depth[(view * TILES_Y + ty) * TILES_X];
+			unsigned int tx = tx0;
+#ifdef OCCLUSION_SSE
+			__m128 z = _mm_set1_ps(zNear);
+			for (; tx + 3 <= tx1 && !visible; tx += 4)
+				visible = _mm_movemask_ps(_mm_cmple_ps(z, _mm_loadu_ps(row + tx))) != 0;
+#endif
+			for (; tx <= tx1 && !visible; tx++)
+				visible = zNear <= row[tx];
+		}
+	}
+
+	if (!visible)
+		occluded++;
+	cullTime += std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::high_resolution_clock::now() - start).count();
+	return visible;
+}
+
+const float LIB_API * Occlusion::getDepth(unsigned int view)
+{
+	return &depth[view * TILES_X * TILES_Y];
+}
+
+void LIB_API Occlusion::setJobSystem(JobSystem *jobs)
+{
+	this->jobs = jobs;
+}
+
+unsigned int LIB_API Occlusion::getThreads()
+{
+	return jobs != nullptr ? jobs->getThreads() : 1;
+}
+
+unsigned int LIB_API Occlusion::getOccluders()
+{
+	return (unsigned int)occluders.size();
+}
+
+unsigned int LIB_API Occlusion::getTriangles()
+{
+	return rasterized;
+}
+
+unsigned int LIB_API Occlusion::getTested()
+{
+	return tested;
+}
+
+unsigned int LIB_API Occlusion::getOccluded()
+{
+	return occluded;
+}
+
+long long LIB_API Occlusion::getCullTime()
+{
+	long long time = cullTime;
+	cullTime = 0;
+	return time;
+}
@@ -0,0 +1,182 @@
+#pragma once
+
+/**
+* Supsi-GE, software occlusion culling class
+* The largest meshes of the frame (the occluders) are rasterized on the CPU into a low resolution depth buffer,
+* one per view, and the bounding boxes of the other meshes are tested against it before submission.
+*
+* The buffer is made of TILE_W * TILE_H pixel tiles. Following the masked occlusion culling approach, a tile does not
+* store per-pixel depths but a coverage mask and two depth layers: "zMax0", the farthest depth of occluders covering the
+* whole tile, and "zMax1", the farthest depth of the occluders covering the pixels of the mask. When the mask gets full, the
+* working layer becomes the new reference. Coverage is computed four pixels at a time with SSE.
+* Depths are view distances (clip w): a box is hidden when its nearest corner is behind zMax0 on every tile it overlaps.
+* Triangles crossing the near plane of the view are not clipped, simply not rasterized.
+*
+* The occluders are ranked by projected size and rasterized largest first, within a triangle budget: the one reaching it
+* only contributes its first triangles, the next ones are dropped. Fewer triangles only hide less.
+* With a JobSystem (see setJobSystem()), the occluders are projected as jobs, and rasterization is split in horizontal
+* bands of tiles, one job per band: every job walks all the triangles in the same order and only writes its own band,
+* so the result does not depend on the number of threads or on their scheduling.
+* The class does not touch OpenGL.
+*/
+class LIB_API Occlusion
+{
+public:
+	static const unsigned int WIDTH = 256;							///< Depth buffer resolution
+	static const unsigned int HEIGHT = 128;
+	static const unsigned int TILE_W = 8;
+	static const unsigned int TILE_H = 4;
+	static const unsigned int TILES_X = WIDTH / TILE_W;
+	static const unsigned int TILES_Y = HEIGHT / TILE_H;
+	static const unsigned int MAX_VIEWS = 8;
+	static const unsigned int MAX_OCCLUDERS = 32;					///< Occluders rasterized per frame, largest first
+	static const unsigned int MAX_TRIANGLES = 16384;				///< Occluder triangles rasterized per frame and view
+
+	/**
+	Constructor
+	*/
+	Occlusion();
+
+	/**
+	Starts a new frame: clears the depth buffers and the occluders
+	@param viewProj The projection * view matrix of each view
+	@param views Number of views, at most MAX_VIEWS
+	*/
+	void begin(const glm::mat4 *viewProj, unsigned int views);
+
+	/**
+	Proposes an occluder. Only the MAX_OCCLUDERS largest ones (radius over distance from the first view) are rasterized,
+	up to MAX_TRIANGLES triangles in total.
+	The geometry is not copied and must stay valid until render().
+	@param model World matrix of the occluder
+	@param radius Radius of its bounding sphere, centered on its origin
+	@param positions 3 floats per vertex
+	@param vertices Number of vertices
+	@param indices 3 vertex indices per triangle, counter-clockwise
+	@param triangles Number of triangles
+	*/
+	void addOccluder(const glm::mat4 &model, float radius, const float *positions, unsigned int vertices, const unsigned int *indices, unsigned int triangles);
+
+	/**
+	Rasterizes the occluders into the depth buffers
+	*/
+	void render();
+
+	/**
+	Tests a bounding box against the depth buffer of a view
+	@param view The view index
+	@param model World matrix of the box
+	@param boxMin Minimum corner of the local box
+	@param boxMax Maximum corner of the local box
+	@return false if the box is hidden by the occluders, true otherwise
+	*/
+	bool test(unsigned int view, const glm::mat4 &model, const glm::vec3 &boxMin, const glm::vec3 &boxMax);
+
+	/**
+	Returns the reference depth (zMax0) of every tile of a view, TILES_X * TILES_Y values, row by row from the bottom
+	*/
+	const float* getDepth(unsigned int view);
+
+	/**
+	Runs the projection and the rasterization on the threads of a job system, nullptr to run them on the calling thread only
+	*/
+	void setJobSystem(JobSystem *jobs);
+
+	/**
+	Returns the number of threads rasterizing
+	*/
+	unsigned int getThreads();
+
+	/**
+	Returns the number of occluders rasterized by the last render()
+	*/
+	unsigned int getOccluders();
+
+	/**
+	Returns the number of triangles rasterized by the last render() (all views), after back-face and near-plane rejection
+	*/
+	unsigned int getTriangles();
+
+	/**
+	Returns the number of boxes tested and hidden since the last begin()
+	*/
+	unsigned int getTested();
+	unsigned int getOccluded();
+
+	/**
+	Returns the time spent in render() and test() since the last getCullTime() call, in microseconds
+	*/
+	long long getCullTime();
+
+private:
+	/**
+	@struct Occluder
+	An occluder proposed for the frame
+	*/
+	struct Occluder
+	{
+		glm::mat4 model;
+		float priority;
+		unsigned int order;			///< Submission order, breaks the priority ties
+		const float *positions;
+		unsigned int vertices;
+		const unsigned int *indices;
+		unsigned int triangles;		///< Rasterized, within the budget
+		unsigned int first;			///< First screen triangle
+	};
+
+	/**
+	@struct Triangle
+	A screen-space triangle: pixel coordinates and farthest vertex depth (negative when rejected)
+	*/
+	struct Triangle
+	{
+		float x[3];
+		float y[3];
+		float z;
+	};
+
+	/**
+	@struct Tile
+	Masked depth of a tile
+	*/
+	struct Tile
+	{
+		float zMax0;
+		float zMax1;
+		unsigned int mask;
+	};
+
+	/**
+	Projects the triangles of the occluders [begin, end)
+	Vertices are projected once into the occluder's "screen" buffer, then gathered by the triangles.
+	*/
+	void transform(unsigned int begin, unsigned int end);
+
+	/**
+	Rasterizes all the triangles into the tile rows [rowBegin, rowEnd) of every view
+	*/
+	void rasterize(unsigned int rowBegin, unsigned int rowEnd);
+
+	/**
+	Coverage mask of a triangle over a tile, bit (x + y * TILE_W) for pixel (x, y)
+	*/
+	static unsigned int coverage(const Triangle &t, unsigned int tileX, unsigned int tileY);
+
+	JobSystem *jobs = nullptr;
+	unsigned int views = 0;
+	glm::mat4 viewProj[MAX_VIEWS];
+	glm::vec3 eye;
+
+	vector<Occluder> occluders;
+	vector<vector<glm::vec3>> screen;	///< Per-occluder projected vertices: pixel coordinates and depth, negative when too near
+	vector<Triangle> triangles;			///< Views one after the other
+	unsigned int triangleCount = 0;		///< Screen triangles per view
+	vector<Tile> tiles;					///< TILES_X * TILES_Y per view
+	vector<float> depth;				///< Copy of zMax0, for the SIMD box test and getDepth()
+
+	unsigned int rasterized = 0;
+	unsigned int tested = 0;
+	unsigned int occluded = 0;
+	long long cullTime = 0;
+};
@@ -5,7 +5,9 @@
 //Constructor
 OpenGLRenderer::OpenGLRenderer()
 {
-    depthbuffer = 0;
+    stereoArray = false;
+    multiview = false;
+    depthSwapchains = false;
 }
 
 //Destructor
@@ -69,9 +71,70 @@ void *OpenGLRenderer::getGraphicsBinding(XrInstance &xrInstance, XrSystemId &xrS
 
 }
 
+//both eyes go to the layers of a single array swapchain, rendered in one pass
+bool OpenGLRenderer::enableStereoArray(bool multiview)
+{
+    this->stereoArray = true;
+    this->multiview = multiview;
+    return true;
+}
+
+//depth submitted to the runtime (XR_KHR_composition_layer_depth), for reprojection
+bool OpenGLRenderer::enableDepthSwapchains()
+{
+    depthSwapchains = true;
+    return true;
+}
+
+bool OpenGLRenderer::initDepthSwapchain(XrSession &xrSession, XrSwapchainCreateInfo swapchainCreateInfo, Swapchain &swapchain)
+{
+    // pick the first depth format the runtime supports, in order of preference
+    unsigned int formatCount = 0;
+    xrEnumerateSwapchainFormats(xrSession, 0, &formatCount, nullptr);
+    std::vector<int64_t> formats(formatCount);
+    xrEnumerateSwapchainFormats(xrSession, formatCount, &formatCount, formats.data());
+
+    const int64_t depthFormats[] = { GL_DEPTH_COMPONENT24, GL_DEPTH_COMPONENT32F, GL_DEPTH24_STENCIL8, GL_DEPTH_COMPONENT16 };
+    swapchainCreateInfo.format = 0;
+    for (int64_t depthFormat : depthFormats)
+        for (int64_t format : formats)
+            if (format == depthFormat && swapchainCreateInfo.format == 0)
+                swapchainCreateInfo.format = format;
+    if (swapchainCreateInfo.format == 0)
+    {
+        std::cout << "[ERROR] No depth swapchain format supported!" << std::endl;
+        return false;
+    }
+
+    swapchainCreateInfo.usageFlags = XR_SWAPCHAIN_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT;
+    XrResult res = xrCreateSwapchain(xrSession, &swapchainCreateInfo, &swapchain.depthHandle);
+    if (!XR_SUCCEEDED(res))
+    {
+        std::cout << "[ERROR] Depth swapchain creation failed!" << std::endl;
+        swapchain.depthHandle = XR_NULL_HANDLE;
+        return false;
+    }
+
+    unsigned int length = 0;
+    xrEnumerateSwapchainImages(swapchain.depthHandle, 0, &length, nullptr);
+    swapchain.depthImages = std::vector<XrSwapchainImageOpenGLKHR>(length, {XR_TYPE_SWAPCHAIN_IMAGE_OPENGL_KHR});
+    res = xrEnumerateSwapchainImages(swapchain.depthHandle, length, &length,
+        (XrSwapchainImageBaseHeader*)swapchain.depthImages.data());
+    if (!XR_SUCCEEDED(res))
+    {
+        std::cout << "[ERROR] Failed to enumerate depth swapchain images!" << std::endl;
+        xrDestroySwapchain(swapchain.depthHandle);
+        swapchain.depthHandle = XR_NULL_HANDLE;
+        swapchain.depthImages.clear();
+        return false;
+    }
+    return true;
+}
+
 bool OpenGLRenderer::initSwapchains(XrSession &xrSession, std::vector<XrViewConfigurationView> &views)
 {
-    unsigned long view_count = views.size();
+    // stereo array: a single swapchain with one layer per view, sized after the first view
+    unsigned long view_count = stereoArray ? 1 : views.size();
     swapchains = std::vector<Swapchain>(view_count);
 
     unsigned int *swapchainLength = new unsigned int(view_count);
@@ -89,7 +152,7 @@ bool OpenGLRenderer::initSwapchains(XrSession &xrSession, std::vector<XrViewConf
         swapchainCreateInfo.width			= view.recommendedImageRectWidth;
         swapchainCreateInfo.height			= view.recommendedImageRectHeight;
         swapchainCreateInfo.faceCount		= 1;
-        swapchainCreateInfo.arraySize		= 1;
+        swapchainCreateInfo.arraySize		= stereoArray ? views.size() : 1;
         swapchainCreateInfo.mipCount		= 1;
         swapchainCreateInfo.next			= nullptr;
 
@@ -116,6 +179,20 @@ bool OpenGLRenderer::initSwapchains(XrSession &xrSession, std::vector<XrViewConf
             std::cout << "[ERROR] Failed to enumerate swapchain images!" << std::endl;
             return false;
         }
+
+        // same size and layers as the color swapchain
+        // without one, all the views go back to our own depth buffers (see initPlatformResources): depth layers are optional
+        swapchains[i].depthHandle = XR_NULL_HANDLE;
+        if (depthSwapchains && !initDepthSwapchain(xrSession, swapchainCreateInfo, swapchains[i]))
+        {
+            std::cout << "[WARNING] Depth swapchains disabled, depth layers will not be submitted" << std::endl;
+            depthSwapchains = false;
+            for (int j = 0; j < i; j++) {
+                xrDestroySwapchain(swapchains[j].depthHandle);
+                swapchains[j].depthHandle = XR_NULL_HANDLE;
+                swapchains[j].depthImages.clear();
+            }
+        }
     }
     delete swapchainLength;
 
@@ -134,23 +211,94 @@ bool OpenGLRenderer::initPlatformResources(int width, int height)
         glGenFramebuffers(swapchains[i].surfaceImages.size(), swapchains[i].framebuffers.data());
     }
 
-    // create one depth buffer needed for OpenGL's depth testing.
-    // currently only one buffer is used but each fbo should have its own
-    glGenTextures(1, &depthbuffer);
-    glBindTexture(GL_TEXTURE_2D, depthbuffer);
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_DEPTH_COMPONENT24,
-                 sizeX, sizeY, 0, GL_DEPTH_COMPONENT, GL_UNSIGNED_INT, 0);
+    // without depth swapchains, one depth buffer per color image: images (and eyes) do not wait for each other
+    for (int i = 0; i < swapchains.size(); i++) {
+        if (swapchains[i].depthHandle != XR_NULL_HANDLE)
+            continue;
+        swapchains[i].depthbuffers = std::vector<GLuint>(swapchains[i].surfaceImages.size());
+        glGenTextures(swapchains[i].depthbuffers.size(), swapchains[i].depthbuffers.data());
+        for (GLuint depthbuffer : swapchains[i].depthbuffers) {
+            if (stereoArray)
+            {
+                // one layer per eye, like the color swapchain
+                glBindTexture(GL_TEXTURE_2D_ARRAY, depthbuffer);
+                glTexImage3D(GL_TEXTURE_2D_ARRAY, 0, GL_DEPTH_COMPONENT24,
+                             sizeX, sizeY, 2, 0, GL_DEPTH_COMPONENT, GL_UNSIGNED_INT, 0);
+                glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+                continue;
+            }
+            glBindTexture(GL_TEXTURE_2D, depthbuffer);
+            glTexImage2D(GL_TEXTURE_2D, 0, GL_DEPTH_COMPONENT24,
+                         sizeX, sizeY, 0, GL_DEPTH_COMPONENT, GL_UNSIGNED_INT, 0);
+            glBindTexture(GL_TEXTURE_2D, 0);
+        }
+    }
 
     return true;
 }
 
 XrSwapchain OpenGLRenderer::getSwapchain(int eye)
 {
-    return swapchains[eye].handle;
+    return swapchains[stereoArray ? 0 : eye].handle;
+}
+
+XrSwapchain OpenGLRenderer::getDepthSwapchain(int eye)
+{
+    return swapchains[stereoArray ? 0 : eye].depthHandle;
 }
 
 bool OpenGLRenderer::beginEyeFrame(int eye, int textureIndex)
 {
+    return beginEyeFrame(eye, textureIndex, -1);
+}
+
+bool OpenGLRenderer::beginEyeFrame(int eye, int textureIndex, int depthIndex)
+{
+    Swapchain &swapchain = swapchains[stereoArray ? 0 : eye];
+
+    //with depth swapchains there are no depth buffers of our own: the depth image is required
+    unsigned int depthbuffer;
+    if (swapchain.depthHandle != XR_NULL_HANDLE)
+    {
+        if (depthIndex < 0 || depthIndex >= (int)swapchain.depthImages.size())
+        {
+            std::cout << "[ERROR] Invalid depth swapchain image index!" << std::endl;
+            return false;
+        }
+        depthbuffer = swapchain.depthImages[depthIndex].image;
+    }
+    else
+    {
+        if (textureIndex < 0 || textureIndex >= (int)swapchain.depthbuffers.size())
+        {
+            std::cout << "[ERROR] Invalid swapchain image index!" << std::endl;
+            return false;
+        }
+        depthbuffer = swapchain.depthbuffers[textureIndex];
+    }
+
+    if (stereoArray)
+    {
+        unsigned int textureXR = swapchains[0].surfaceImages[textureIndex].image;
+        unsigned int fboXR = swapchains[0].framebuffers[textureIndex];
+
+        //all the layers at once: as multiview views, or layered for gl_Layer
+        glBindFramebuffer(GL_DRAW_FRAMEBUFFER, fboXR);
+        if (multiview)
+        {
+            glFramebufferTextureMultiviewOVR(GL_DRAW_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, textureXR, 0, 0, 2);
+            glFramebufferTextureMultiviewOVR(GL_DRAW_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, depthbuffer, 0, 0, 2);
+        }
+        else
+        {
+            glFramebufferTexture(GL_DRAW_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, textureXR, 0);
+            glFramebufferTexture(GL_DRAW_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, depthbuffer, 0);
+        }
+
+        glViewport(0, 0, sizeX, sizeY);
+        return true;
+    }
+
     //get fbo and texture ids
     unsigned int textureXR = swapchains[eye].surfaceImages[textureIndex].image;
     unsigned int fboXR = swapchains[eye].framebuffers[textureIndex];
@@ -175,15 +323,94 @@ bool OpenGLRenderer::endEyeFrame(int eye, int textureIndex)
     return true;
 }
 
-bool OpenGLRenderer::free()
+int OpenGLRenderer::initQuadSwapchain(XrSession &xrSession, int width, int height)
+{
+    Swapchain swapchain;
+    swapchain.width = width;
+    swapchain.height = height;
+    swapchain.depthHandle = XR_NULL_HANDLE;
+
+    // same format as the eyes, a single sample: the compositor filters it anyway
+    XrSwapchainCreateInfo swapchainCreateInfo;
+    swapchainCreateInfo.type			= XR_TYPE_SWAPCHAIN_CREATE_INFO;
+    swapchainCreateInfo.usageFlags		= XR_SWAPCHAIN_USAGE_SAMPLED_BIT |
+                                                XR_SWAPCHAIN_USAGE_COLOR_ATTACHMENT_BIT;
+    swapchainCreateInfo.createFlags		= 0;
+    swapchainCreateInfo.format			= GL_RGBA8_EXT;
+    swapchainCreateInfo.sampleCount		= 1;
+    swapchainCreateInfo.width			= width;
+    swapchainCreateInfo.height			= height;
+    swapchainCreateInfo.faceCount		= 1;
+    swapchainCreateInfo.arraySize		= 1;
+    swapchainCreateInfo.mipCount		= 1;
+    swapchainCreateInfo.next			= nullptr;
+    XrResult res = xrCreateSwapchain(xrSession, &swapchainCreateInfo, &swapchain.handle);
+    if (!XR_SUCCEEDED(res))
+    {
+        std::cout << "[ERROR] Quad swapchain creation failed!" << std::endl;
+        return -1;
+    }
+
+    uint32_t length = 0;
+    xrEnumerateSwapchainImages(swapchain.handle, 0, &length, nullptr);
+    swapchain.surfaceImages = std::vector<XrSwapchainImageOpenGLKHR>(length, {XR_TYPE_SWAPCHAIN_IMAGE_OPENGL_KHR});
+    res = xrEnumerateSwapchainImages(swapchain.handle, length, &length,
+        (XrSwapchainImageBaseHeader*)swapchain.surfaceImages.data());
+    if (!XR_SUCCEEDED(res))
+    {
+        std::cout << "[ERROR] Failed to enumerate quad swapchain images!" << std::endl;
+        xrDestroySwapchain(swapchain.handle);
+        return -1;
+    }
+
+    //one framebuffer per image, with the image already attached
+    swapchain.framebuffers = std::vector<GLuint>(length);
+    glGenFramebuffers(length, swapchain.framebuffers.data());
+    for (uint32_t i = 0; i < length; i++) {
+        glBindFramebuffer(GL_DRAW_FRAMEBUFFER, swapchain.framebuffers[i]);
+        glFramebufferTexture2D(GL_DRAW_FRAMEBUFFER, GL_COLOR_ATTACHMENT0,
+                               GL_TEXTURE_2D, swapchain.surfaceImages[i].image, 0);
+    }
+    glBindFramebuffer(GL_DRAW_FRAMEBUFFER, 0);
+
+    quadSwapchains.push_back(swapchain);
+    return (int)quadSwapchains.size() - 1;
+}
+
+bool OpenGLRenderer::beginQuadFrame(int quad, int textureIndex)
 {
-    if(depthbuffer)
-        glDeleteFramebuffers(1, &depthbuffer);
+    Swapchain &swapchain = quadSwapchains[quad];
+    glBindFramebuffer(GL_DRAW_FRAMEBUFFER, swapchain.framebuffers[textureIndex]);
+    glViewport(0, 0, swapchain.width, swapchain.height);
+    return true;
+}
 
+bool OpenGLRenderer::endQuadFrame(int /*quad*/, int /*textureIndex*/)
+{
+    //bind default framebuffer
+    glBindFramebuffer(GL_DRAW_FRAMEBUFFER, 0);
+    return true;
+}
+
+XrSwapchain OpenGLRenderer::getQuadSwapchain(int quad)
+{
+    if (quad < 0 || quad >= (int)quadSwapchains.size())
+        return XR_NULL_HANDLE;
+    return quadSwapchains[quad].handle;
+}
+
+bool OpenGLRenderer::free()
+{
     if(swapchains.size() > 0) {
         for (int i = 0; i < swapchains.size(); i++) {
             // destroy each swapchain created by OpenXR
             xrDestroySwapchain(swapchains[i].handle);
+            if (swapchains[i].depthHandle != XR_NULL_HANDLE)
+                xrDestroySwapchain(swapchains[i].depthHandle);
+
+            // destroy our own depth buffers
+            if (!swapchains[i].depthbuffers.empty())
+                glDeleteTextures(swapchains[i].depthbuffers.size(), swapchains[i].depthbuffers.data());
 
             // destroy each framebuffer
             glDeleteFramebuffers(swapchains[i].framebuffers.size(), swapchains[i].framebuffers.data());
@@ -196,4 +423,12 @@ bool OpenGLRenderer::free()
 
 		swapchains.clear();
     }
+
+    // quad layers: swapchain and framebuffers only, the images belong to the runtime
+    for (Swapchain &swapchain : quadSwapchains) {
+        xrDestroySwapchain(swapchain.handle);
+        glDeleteFramebuffers(swapchain.framebuffers.size(), swapchain.framebuffers.data());
+    }
+    quadSwapchains.clear();
+    return true;
 }
@@ -33,12 +33,21 @@ public:
     bool free();
 
     bool beginEyeFrame(int eye, int textureIndex);
+    bool beginEyeFrame(int eye, int textureIndex, int depthIndex);
     bool endEyeFrame(int eye, int textureIndex);
 
     void* getGraphicsBinding(XrInstance &xrInstance, XrSystemId &xrSystem);
     bool initSwapchains(XrSession &xrSession, std::vector<XrViewConfigurationView> &views);
+    bool enableStereoArray(bool multiview);
+    bool enableDepthSwapchains();
 
     XrSwapchain getSwapchain(int eye);
+    XrSwapchain getDepthSwapchain(int eye);
+
+    int initQuadSwapchain(XrSession &xrSession, int width, int height);
+    bool beginQuadFrame(int quad, int textureIndex);
+    bool endQuadFrame(int quad, int textureIndex);
+    XrSwapchain getQuadSwapchain(int quad);
 
 private:
     struct Swapchain {
@@ -47,10 +56,29 @@ private:
         int32_t									height;
         std::vector<XrSwapchainImageOpenGLKHR>	surfaceImages;
         std::vector<unsigned int>               framebuffers;
+
+        // depth: images of a depth swapchain submitted to the runtime, or our own textures, one per color image
+        XrSwapchain                             depthHandle;
+        std::vector<XrSwapchainImageOpenGLKHR>  depthImages;
+        std::vector<unsigned int>               depthbuffers;
     };
 
+    /**
+     * @brief creates the depth swapchain of a color swapchain, in the first depth format supported by the runtime
+     * @return TF, on failure the swapchain is left without depth swapchain
+     */
+    bool initDepthSwapchain(XrSession &xrSession, XrSwapchainCreateInfo swapchainCreateInfo, Swapchain &swapchain);
+
     std::vector<Swapchain> swapchains;
     int sizeX, sizeY;
 
-    unsigned int depthbuffer;
+    // swapchains of the quad layers, color only, each with its own size
+    std::vector<Swapchain> quadSwapchains;
+
+    // single swapchain with one layer per eye (see enableStereoArray)
+    bool stereoArray;
+    bool multiview;
+
+    // depth swapchains next to the color ones (see enableDepthSwapchains)
+    bool depthSwapchains;
 };
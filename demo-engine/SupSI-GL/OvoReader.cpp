@@ -35,9 +35,10 @@ void createHierarchy(Node* n, int children)
 /**
  * Read a OVO file and returns the node root of node containing OVO file's data
  * @param  name the filename of the OVO file
+ * @param  registry the registry indexing the scene, can be nullptr
  * @return a list of node containing the scene elements
  */
-Node* OvoReader::readOVOfile(const char * name)
+Node* OvoReader::readOVOfile(const char * name, Registry * registry)
 {
 
 	stackNode = {};
@@ -105,7 +106,7 @@ Node* OvoReader::readOVOfile(const char * name)
 			strcpy(targetName, data + position);
 			f << "   Target node . :  " << targetName << endl;
 			position += (unsigned int)strlen(targetName) + 1;
-			Node* node = new Node();
+			Node* node = Engine::getInstance().createNode();
 			node->setName(nodeName);
 			node->setPosMatrix(matrix);
 			createHierarchy(node,children);
@@ -435,10 +436,11 @@ Node* OvoReader::readOVOfile(const char * name)
 					break;
 				}
 			}
-			Mesh *mesh = new Mesh();
+			Mesh *mesh = Engine::getInstance().createMesh();
 			mesh->setName(meshName);
 			mesh->setPosMatrix(matrix);
 			mesh->setMaterial(material);
+			mesh->setBounds(radius, bBoxMin, bBoxMax);
 			mesh->fillData(coordinatesArray, textureCoordinatesArray, normalsArray, vertices, facesArray, faces);
 			createHierarchy(mesh, children);
 		}
@@ -519,7 +521,7 @@ Node* OvoReader::readOVOfile(const char * name)
 			memcpy(&isVolumetric, data + position, sizeof(unsigned char));
 			f << "   Volumetric  . :  " << (int)isVolumetric << endl;
 			position += sizeof(unsigned char);
-			Light *light = new Light();
+			Light *light = Engine::getInstance().createLight();
 			light->setName(lightName);
 			switch ((OvLight::Subtype) subtype)
 			{
@@ -541,6 +543,7 @@ Node* OvoReader::readOVOfile(const char * name)
 			light->setColor(glm::vec4(color.r, color.g, color.b, 1.0f));
 			light->setDirection(glm::vec4(direction.r, direction.g, direction.b, 1.0f));
 			light->setCutoff(cutoff);
+			light->setRadius(radius);
 			createHierarchy(light, children);
 		}
 		break;
@@ -601,6 +604,8 @@ Node* OvoReader::readOVOfile(const char * name)
 	fclose(dat);
 	cout << "\nFile parsed" << endl;
 
+	if (registry != nullptr)
+		registry->setRoot(root);
 	return root;
 }
 
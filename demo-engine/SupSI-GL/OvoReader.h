@@ -143,7 +143,8 @@ public:
 	Opens and reads the "name" OVO file,
 	returning the scene graph's root node and its childrens.
 	@param name The file's name
+	@param registry Indexes the nodes of the scene by id and by name (see Registry.h), nullptr if not needed
 	*/
-	Node* readOVOfile(const char * name);
+	Node* readOVOfile(const char * name, Registry * registry = nullptr);
 private:
 };
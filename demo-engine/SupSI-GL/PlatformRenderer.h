@@ -48,6 +48,24 @@ public:
 	 * @return TF
 	 */
 	virtual bool initSwapchains(XrSession &xrSession, std::vector<XrViewConfigurationView> &views) = 0;
+
+
+	/**
+	 * @brief requests a single swapchain with one array layer per eye, for single-pass stereo rendering.
+	 * Must be called before initSwapchains(). Renderers without support keep one swapchain per eye.
+	 * @param multiview true to attach the layers as OVR_multiview views, false as a layered framebuffer
+	 * @return true if supported
+	 */
+	virtual bool enableStereoArray(bool /*multiview*/) { return false; }
+
+
+	/**
+	 * @brief requests a depth swapchain next to each color swapchain, for XR_KHR_composition_layer_depth.
+	 * Must be called before initSwapchains(). Renderers without support keep their own depth buffers,
+	 * so do the others when the runtime offers no depth format they can use (getDepthSwapchain() stays XR_NULL_HANDLE).
+	 * @return true if supported
+	 */
+	virtual bool enableDepthSwapchains() { return false; }
 	
 
 	/**
@@ -68,6 +86,16 @@ public:
 	virtual bool beginEyeFrame(int eye, int textureIndex) = 0;
 
 
+	/**
+	 * @brief prepares platform-specific render on swapchain, with the depth swapchain image acquired for the frame.
+	 * @param eye left or right eye
+	 * @param textureIndex swapchain image index
+	 * @param depthIndex depth swapchain image index (see enableDepthSwapchains()), -1 without: fails if the renderer has depth swapchains
+	 * @return TF
+	 */
+	virtual bool beginEyeFrame(int eye, int textureIndex, int /*depthIndex*/) { return beginEyeFrame(eye, textureIndex); }
+
+
 	/**
 	 * @brief completes platform-specific render on swapchain.
 	 * @param eye left or right eye
@@ -83,4 +111,49 @@ public:
 	 * @return XrSwapchain
 	 */
 	virtual XrSwapchain getSwapchain(int eye) = 0;
+
+
+	/**
+	 * @brief returns the depth XrSwapchain, XR_NULL_HANDLE without depth swapchains.
+	 * @param eye left or right eye
+	 * @return XrSwapchain
+	 */
+	virtual XrSwapchain getDepthSwapchain(int /*eye*/) { return XR_NULL_HANDLE; }
+
+
+	/**
+	 * @brief creates the swapchain of a quad layer, color only, with the resources to render into its images.
+	 * Renderers without support return -1.
+	 * @param xrSession OpenXR session
+	 * @param width image width
+	 * @param height image height
+	 * @return the index of the quad swapchain, -1 on failure
+	 */
+	virtual int initQuadSwapchain(XrSession &/*xrSession*/, int /*width*/, int /*height*/) { return -1; }
+
+
+	/**
+	 * @brief prepares platform-specific render on a quad swapchain.
+	 * @param quad quad swapchain index (see initQuadSwapchain())
+	 * @param textureIndex swapchain image index
+	 * @return TF
+	 */
+	virtual bool beginQuadFrame(int /*quad*/, int /*textureIndex*/) { return false; }
+
+
+	/**
+	 * @brief completes platform-specific render on a quad swapchain.
+	 * @param quad quad swapchain index
+	 * @param textureIndex swapchain image index
+	 * @return TF
+	 */
+	virtual bool endQuadFrame(int /*quad*/, int /*textureIndex*/) { return false; }
+
+
+	/**
+	 * @brief returns the XrSwapchain of a quad layer.
+	 * @param quad quad swapchain index
+	 * @return XrSwapchain
+	 */
+	virtual XrSwapchain getQuadSwapchain(int /*quad*/) { return XR_NULL_HANDLE; }
 };
@@ -0,0 +1,139 @@
+#pragma once
+
+/**
+* Supsi-GE, typed object pool class
+* Objects of one type are stored in chunks of CHUNK_SIZE slots. Chunks are allocated when needed and never moved,
+* so pointers stay valid for the whole life of an object, and objects created one after the other are contiguous
+* in memory instead of scattered over the heap.
+* A handle is the slot index (low 24 bits) plus a generation counter (high 8 bits) that is bumped whenever the slot
+* is freed: get() returns nullptr for a handle to a destroyed object instead of the object now using its slot.
+* A slot whose generation would wrap around is retired instead of reused, so that no handle is ever valid twice.
+* Freed slots are reused first, forEach() walks the live objects in slot order, i.e. in creation order as long as
+* nothing was destroyed.
+*/
+template <class T, unsigned int CHUNK_SIZE = 1024>
+class Pool {
+	//////////
+public: //
+//////////
+
+	// Constants:
+	typedef unsigned int Handle;
+	static const Handle INVALID_HANDLE = 0xFFFFFFFF;
+	static const unsigned int MAX_SLOTS = 1 << 24;
+
+	// Const/dest:
+	Pool() : count{ 0 } {}
+	~Pool() { clear(); }
+	Pool(const Pool &) = delete;
+	Pool &operator=(const Pool &) = delete;
+
+	// Get/set:
+	inline unsigned int getCount() { return count; }
+	inline unsigned int getCapacity() { return (unsigned int)chunks.size() * CHUNK_SIZE; }
+	inline size_t getMemory() { return chunks.size() * sizeof(Chunk) + generation.capacity() + alive.capacity() + freeSlots.capacity() * sizeof(unsigned int); }
+
+	T *get(Handle handle)
+	{
+		unsigned int slot = handle & (MAX_SLOTS - 1);
+		if (handle == INVALID_HANDLE || slot >= alive.size() || !alive[slot] || generation[slot] != (handle >> 24))
+			return nullptr;
+		return at(slot);
+	}
+
+	Handle getHandle(const T *object)
+	{
+		for (unsigned int c = 0; c < chunks.size(); c++)
+		{
+			const T *first = reinterpret_cast<const T *>(chunks[c]->data);
+			if (object >= first && object < first + CHUNK_SIZE)
+			{
+				unsigned int slot = c * CHUNK_SIZE + (unsigned int)(object - first);
+				return alive[slot] ? makeHandle(slot) : INVALID_HANDLE;
+			}
+		}
+		return INVALID_HANDLE;
+	}
+
+	// Management:
+	Handle create()
+	{
+		unsigned int slot;
+		if (!freeSlots.empty())
+		{
+			slot = freeSlots.back();
+			freeSlots.pop_back();
+		}
+		else
+		{
+			slot = (unsigned int)alive.size();
+			if (slot >= MAX_SLOTS - 1)		// The last one would collide with INVALID_HANDLE
+				return INVALID_HANDLE;
+			if (slot == getCapacity())
+				chunks.push_back(new Chunk);
+			alive.push_back(0);
+			generation.push_back(0);
+		}
+		new (at(slot)) T();
+		alive[slot] = 1;
+		count++;
+		return makeHandle(slot);
+	}
+
+	bool destroy(Handle handle)
+	{
+		T *object = get(handle);
+		if (object == nullptr)
+			return false;
+		unsigned int slot = handle & (MAX_SLOTS - 1);
+		object->~T();
+		alive[slot] = 0;
+		if (++generation[slot] != 0)		// Retired once the generation wraps around
+			freeSlots.push_back(slot);
+		count--;
+		return true;
+	}
+
+	void clear()
+	{
+		for (unsigned int slot = 0; slot < alive.size(); slot++)
+			if (alive[slot])
+				at(slot)->~T();
+		for (Chunk *chunk : chunks)
+			delete chunk;
+		chunks.clear();
+		alive.clear();
+		generation.clear();
+		freeSlots.clear();
+		count = 0;
+	}
+
+	template <class F>
+	void forEach(F f)
+	{
+		for (unsigned int slot = 0; slot < alive.size(); slot++)
+			if (alive[slot])
+				f(*at(slot));
+	}
+
+
+	///////////
+private: //
+///////////
+
+	struct Chunk
+	{
+		alignas(T) unsigned char data[sizeof(T) * CHUNK_SIZE];
+	};
+
+	// Internal methods:
+	inline T *at(unsigned int slot) { return reinterpret_cast<T *>(chunks[slot / CHUNK_SIZE]->data) + slot % CHUNK_SIZE; }
+	inline Handle makeHandle(unsigned int slot) { return slot | ((Handle)generation[slot] << 24); }
+
+	// Generic data:
+	vector<Chunk *> chunks;
+	vector<unsigned char> generation;		///< Per slot, bumped by destroy()
+	vector<unsigned char> alive;			///< Per slot, 1 if holding an object
+	vector<unsigned int> freeSlots;			///< Destroyed slots, reused first, without the retired ones
+	unsigned int count;						///< Live objects
+};
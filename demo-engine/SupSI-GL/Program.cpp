@@ -7,7 +7,19 @@
 LIB_API Program::Program(Shader * ver_Shader, Shader * frag_Shader)
 	: m_vertex{ver_Shader}
 	, m_fragment{frag_Shader}
+	, m_compute{nullptr}
+	, m_glId{0}
 {
+	setKind(KIND_PROGRAM);
+}
+
+LIB_API Program::Program(Shader * comp_Shader)
+	: m_vertex{nullptr}
+	, m_fragment{nullptr}
+	, m_compute{comp_Shader}
+	, m_glId{0}
+{
+	setKind(KIND_PROGRAM);
 }
 
 bool LIB_API Program::build()
@@ -22,6 +34,11 @@ bool LIB_API Program::build()
 		std::cout << " [ERROR] Invalid fragment shader passed" << std::endl;
 		return false;
 	}
+	if (m_compute && m_compute->shaderType() != Shader::TYPE_COMPUTE)
+	{
+		std::cout << "[ERROR] Invalid compute shader passed" << std::endl;
+		return false;
+	}
 
 	// Delete if already used:
 	if (m_glId)
@@ -51,6 +68,10 @@ bool LIB_API Program::build()
 	if (m_fragment)
 		glAttachShader(m_glId, m_fragment->getGlId());
 
+	// Bind compute shader:
+	if (m_compute)
+		glAttachShader(m_glId, m_compute->getGlId());
+
 	// Link program:
 	glLinkProgram(m_glId);
 	//this->m_type = Shader::TYPE_PROGRAM;
@@ -24,8 +24,19 @@ enum Location : int
 	PROJECTION_MATRIX,
 	MODLVIEW_MATRIX,
 	NORMAL_MATRIX,
+	MODEL_MATRIX,
 
 	COLOR,
+
+	CULL_VIEW_PROJECTION,
+	CULL_FIRST,
+	CULL_COUNT,
+	CULL_PHASE,
+	CULL_WIDTH,
+	CULL_HEIGHT,
+
+	SOURCE_WIDTH,
+	SOURCE_HEIGHT,
 };
 
 
@@ -35,6 +46,7 @@ class LIB_API Program
 
 public:
 	Program(Shader* ver_Shader, Shader* frag_Shader);
+	Program(Shader* comp_Shader);
 
 	bool build();
 	void render();
@@ -64,6 +76,7 @@ public:
 private:
 	Shader* m_vertex;
 	Shader* m_fragment;
+	Shader* m_compute;
 	std::map<Location, int> m_map;
 	std::map<Location, std::string> m_strings;
 	unsigned int m_glId;
@@ -0,0 +1,144 @@
+#include "Engine.h"
+
+#include <algorithm>
+
+
+LIB_API Registry::Registry(Node *root)
+{
+	setRoot(root);
+}
+
+LIB_API Registry::~Registry()
+{
+	setRoot(nullptr);
+}
+
+void LIB_API Registry::setRoot(Node *root)
+{
+	if (root != nullptr && root->registry != nullptr && root->registry != this)
+	{
+		std::cout << "[ERROR] Node " << root->getId() << " is indexed by another registry" << std::endl;
+		return;
+	}
+
+	std::lock_guard<std::mutex> lock(mutex);
+	if (this->root != nullptr)
+		removeSubtree(this->root);
+	this->root = root;
+	if (root == nullptr)
+		return;
+	builds++;
+	addSubtree(root);
+}
+
+Node LIB_API * Registry::getRoot()
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	return root;
+}
+
+void Registry::add(Node *node)
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	addSubtree(node);
+}
+
+void Registry::remove(Node *node)
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	removeSubtree(node);
+}
+
+//depth first, with an explicit stack for deep scenes
+void Registry::addSubtree(Node *node)
+{
+	stack.clear();
+	stack.push_back(node);
+	while (!stack.empty())
+	{
+		Node *n = stack.back();
+		stack.pop_back();
+		if (n->registry != nullptr && n->registry != this)
+			continue;
+		n->registry = this;
+		insert(n);
+		for (Node *child : n->getChildren())
+			stack.push_back(child);
+	}
+}
+
+void Registry::removeSubtree(Node *node)
+{
+	stack.clear();
+	stack.push_back(node);
+	while (!stack.empty())
+	{
+		Node *n = stack.back();
+		stack.pop_back();
+		if (n->registry != this)
+			continue;
+		n->registry = nullptr;
+		erase(n, n->getId(), n->getNameId());
+		for (Node *child : n->getChildren())
+			stack.push_back(child);
+	}
+}
+
+void Registry::update(Node *node, int previousId, unsigned int previousName)
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	erase(node, previousId, previousName);
+	insert(node);
+}
+
+void Registry::insert(Node *node)
+{
+	byId.emplace(node->getId(), node);
+	vector<Node*> &named = byName[node->getNameId()];
+	named.insert(std::lower_bound(named.begin(), named.end(), node, [](Node *a, Node *b) { return a->getId() < b->getId(); }), node);
+}
+
+void Registry::erase(Node *node, int id, unsigned int name)
+{
+	auto it = byId.find(id);
+	if (it != byId.end() && it->second == node)
+		byId.erase(it);
+
+	auto named = byName.find(name);
+	if (named == byName.end())
+		return;
+	auto at = std::find(named->second.begin(), named->second.end(), node);
+	if (at != named->second.end())
+		named->second.erase(at);
+	if (named->second.empty())
+		byName.erase(named);
+}
+
+Node LIB_API * Registry::find(int id)
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	auto it = byId.find(id);
+	return it != byId.end() ? it->second : nullptr;
+}
+
+Node LIB_API * Registry::find(const string &name)
+{
+	unsigned int nameId = NameTable::find(name);
+	if (nameId == NameTable::NOT_FOUND)
+		return nullptr;
+	std::lock_guard<std::mutex> lock(mutex);
+	auto it = byName.find(nameId);
+	return it != byName.end() ? it->second.front() : nullptr;
+}
+
+unsigned int LIB_API Registry::getCount()
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	return (unsigned int)byId.size();
+}
+
+unsigned int LIB_API Registry::getBuilds()
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	return builds;
+}
@@ -0,0 +1,100 @@
+#pragma once
+
+/**
+* Supsi-GE, scene registry class
+* Indexes the nodes of a scene (the subtree of a root node) by id and by name, so that lookups are a hash map access
+* instead of a recursive search of the tree (Node::search()). Names are indexed by their NameTable index:
+* when several nodes share a name, the one with the lowest id (created first) is returned.
+* The index is kept up to date as the scene changes: a node attached to the scene (Node::setParent()) joins it
+* with its subtree, a detached or destroyed one leaves it, a renamed one moves to its new name. Each edit costs
+* the size of the moved subtree, moving nodes within the scene costs nothing. A node is indexed by one registry
+* at most, and the index must be changed on the thread that owns the scene (see Engine::startSimulation()).
+* Lookups can come from any other thread meanwhile: a mutex guards the index.
+* The class does not touch OpenGL.
+*/
+class LIB_API Registry
+{
+public:
+	/**
+	Constructor
+	@param root Root node of the scene, nullptr for an empty registry
+	*/
+	Registry(Node *root = nullptr);
+
+	/**
+	Destructor, the nodes are no longer indexed
+	*/
+	~Registry();
+
+	Registry(const Registry &) = delete;
+	Registry &operator=(const Registry &) = delete;
+
+	/**
+	Sets the root node of the scene and indexes its whole subtree, nullptr to empty the registry.
+	The root must not be indexed by another registry.
+	*/
+	void setRoot(Node *root);
+
+	/**
+	Returns the root node of the scene
+	*/
+	Node* getRoot();
+
+	/**
+	Returns the node with an id, nullptr if it is not in the scene
+	@param id The identifier, see Object::getId()
+	*/
+	Node* find(int id);
+
+	/**
+	Returns the node with a name and the lowest id, nullptr if there is none in the scene
+	@param name The name
+	*/
+	Node* find(const string &name);
+
+	/**
+	Returns the number of nodes in the scene
+	*/
+	unsigned int getCount();
+
+	/**
+	Returns how many times a whole scene has been indexed by setRoot(), for the stats
+	*/
+	unsigned int getBuilds();
+
+private:
+	friend class Node;
+
+	/**
+	Indexes a node and its subtree, called when it is attached to the scene
+	*/
+	void add(Node *node);
+
+	/**
+	Removes a node and its subtree from the index, called when it is detached from the scene or destroyed.
+	The subtrees of the roots of other registries are left alone by both.
+	*/
+	void remove(Node *node);
+
+	/**
+	Moves a node to its new id and name
+	*/
+	void update(Node *node, int previousId, unsigned int previousName);
+
+	/**
+	add() and remove(), with the mutex already held
+	*/
+	void addSubtree(Node *node);
+	void removeSubtree(Node *node);
+
+	void insert(Node *node);
+	void erase(Node *node, int id, unsigned int name);
+
+	std::mutex mutex;
+	Node *root = nullptr;
+	unsigned int builds = 0;
+
+	unordered_map<int, Node*> byId;
+	unordered_map<unsigned int, vector<Node*>> byName;	///< NameTable index -> nodes, sorted by id
+	vector<Node*> stack;								///< Scratch for add() and remove()
+};
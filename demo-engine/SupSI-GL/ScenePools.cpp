@@ -0,0 +1,93 @@
+#include "Engine.h"
+
+
+Node LIB_API * ScenePools::createNode()
+{
+	return nodePool.get(nodePool.create());
+}
+
+Mesh LIB_API * ScenePools::createMesh()
+{
+	return meshPool.get(meshPool.create());
+}
+
+Light LIB_API * ScenePools::createLight()
+{
+	return lightPool.get(lightPool.create());
+}
+
+Camera LIB_API * ScenePools::createCamera()
+{
+	return cameraPool.get(cameraPool.create());
+}
+
+bool LIB_API ScenePools::destroy(Node *node)
+{
+	//rejected before the tree is touched
+	if (node == nullptr || !owns(node))
+		return false;
+	node->setParent(nullptr);
+
+	//breadth first, then destroyed backwards: the children go before their parent
+	subtree.clear();
+	subtree.push_back(node);
+	for (size_t i = 0; i < subtree.size(); i++)
+		for (Node *child : subtree[i]->getChildren())
+			subtree.push_back(child);
+
+	for (size_t i = subtree.size(); i > 0; i--)
+	{
+		Node *n = subtree[i - 1];
+		if (!destroyOne(n))
+			n->setParent(nullptr);
+	}
+	subtree.clear();
+	return true;
+}
+
+bool ScenePools::owns(Node *node)
+{
+	switch (node->getKind())
+	{
+	case Object::KIND_NODE:
+		return nodePool.getHandle(node) != Pool<Node>::INVALID_HANDLE;
+	case Object::KIND_MESH:
+		return meshPool.getHandle(node->as<Mesh>()) != Pool<Mesh>::INVALID_HANDLE;
+	case Object::KIND_LIGHT:
+		return lightPool.getHandle(node->as<Light>()) != Pool<Light>::INVALID_HANDLE;
+	case Object::KIND_CAMERA:
+		return cameraPool.getHandle(node->as<Camera>()) != Pool<Camera>::INVALID_HANDLE;
+	default:
+		return false;
+	}
+}
+
+bool ScenePools::destroyOne(Node *node)
+{
+	switch (node->getKind())
+	{
+	case Object::KIND_NODE:
+		return nodePool.destroy(nodePool.getHandle(node));
+	case Object::KIND_MESH:
+		return meshPool.destroy(meshPool.getHandle(node->as<Mesh>()));
+	case Object::KIND_LIGHT:
+		return lightPool.destroy(lightPool.getHandle(node->as<Light>()));
+	case Object::KIND_CAMERA:
+		return cameraPool.destroy(cameraPool.getHandle(node->as<Camera>()));
+	default:
+		return false;
+	}
+}
+
+void LIB_API ScenePools::clear()
+{
+	nodePool.clear();
+	meshPool.clear();
+	lightPool.clear();
+	cameraPool.clear();
+}
+
+unsigned int LIB_API ScenePools::getCount()
+{
+	return nodePool.getCount() + meshPool.getCount() + lightPool.getCount() + cameraPool.getCount();
+}
@@ -0,0 +1,55 @@
+#pragma once
+
+/**
+* Supsi-GE, scene node pools class
+* Stores the scene nodes created by the engine, one Pool (see Pool.h) per type, so that nodes of the same type are
+* contiguous in memory. destroy() releases a whole subtree: its nodes are detached, leave their registry
+* (see Registry.h) and their slots are reused by the next nodes of the same type.
+* The class does not touch OpenGL, but meshes release their buffers when destroyed.
+*/
+class LIB_API ScenePools
+{
+public:
+	/**
+	Creates a node of a type
+	*/
+	Node* createNode();
+	Mesh* createMesh();
+	Light* createLight();
+	Camera* createCamera();
+
+	/**
+	Destroys a node and its whole subtree, children first. Nodes of the subtree that were not created by the pools
+	are detached and left alive.
+	@param node The root of the subtree, detached from its parent
+	@return false, with the tree left untouched, if "node" itself was not created by the pools
+	*/
+	bool destroy(Node *node);
+
+	/**
+	Destroys every node
+	*/
+	void clear();
+
+	/**
+	Returns the number of live nodes, of all types
+	*/
+	unsigned int getCount();
+
+private:
+	/**
+	Returns true if "node" was created by the pools and is alive
+	*/
+	bool owns(Node *node);
+
+	/**
+	Destroys a single node, already without children
+	*/
+	bool destroyOne(Node *node);
+
+	Pool<Node> nodePool;
+	Pool<Mesh> meshPool;
+	Pool<Light> lightPool;
+	Pool<Camera> cameraPool;
+	vector<Node*> subtree;		///< Scratch for destroy()
+};
@@ -0,0 +1,370 @@
+#include "Engine.h"
+
+// Glew (include it before GL.h):
+#include <GL/glew.h>
+
+// C/C++:
+#include <iostream>
+
+
+// Number of global lights handled by each bucket:
+static const unsigned int bucketSize[] = { 0, 1, 2, 4, 8 };
+
+
+ShaderCache::ShaderCache(const char *vertexSource, const char *fragmentSource)
+	: vertexSource{ vertexSource }
+	, fragmentSource{ fragmentSource }
+	, current{ nullptr }
+	, currentKey{ ~0u }
+	, profiling{ false }
+	, measuring{ false }
+	, counting{ false }
+	, counterBuffer{ 0 }
+{
+}
+
+ShaderCache::~ShaderCache()
+{
+	end();
+	collect(true);
+	for (unsigned int query : freeQueries)
+		glDeleteQueries(1, &query);
+	if (counterBuffer)
+		glDeleteBuffers(1, &counterBuffer);
+
+	for (auto &v : variants)
+	{
+		delete v.second.program;
+		delete v.second.fs;
+		delete v.second.vs;
+	}
+}
+
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+/**
+ * Returns the light part of a variant key for a frame.
+ * @param globalLights number of lights reaching the whole scene (see Clusters::getGlobalLights())
+ * @param totalLights number of lights of the frame
+ * @return bucket bits, plus FEATURE_DIRECTIONAL_ONLY when no light needs the clusters
+ */
+unsigned int ShaderCache::getLightKey(unsigned int globalLights, unsigned int totalLights)
+{
+	unsigned int bucket = BUCKET_DYNAMIC;
+	for (unsigned int c = BUCKET_0; c < BUCKET_DYNAMIC; c++)
+		if (globalLights <= bucketSize[c])
+		{
+			bucket = c;
+			break;
+		}
+
+	unsigned int key = bucket << BUCKET_SHIFT;
+	if (globalLights == totalLights)
+		key |= FEATURE_DIRECTIONAL_ONLY;
+	return key;
+}
+
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+/**
+ * Builds the preamble of a variant: GLSL version, feature #defines and the unrolled global light loop.
+ * The SHADE_GLOBAL_LIGHTS macro only checks the light count for the lights the bucket may lack.
+ * @param key variant key
+ * @return the text to prepend to both sources
+ */
+std::string ShaderCache::getDefines(unsigned int key)
+{
+	std::string defines = "#version 440 core\n";
+	if (key & FEATURE_TEXTURED)
+		defines += "#define TEXTURED\n";
+	if (key & FEATURE_DIRECTIONAL_ONLY)
+		defines += "#define DIRECTIONAL_ONLY\n";
+	if (key & FEATURE_SKINNED)
+		defines += "#define SKINNED\n";
+	if (key & FEATURE_INDIRECT)
+		defines += "#define INDIRECT\n";
+	if (key & FEATURE_DEPTH_ONLY)
+		defines += "#define DEPTH_ONLY\n";
+	if (key & FEATURE_COUNT_FRAGMENTS)
+		defines += "#define COUNT_FRAGMENTS\n";
+	if (key & FEATURE_NORMAL_MATRIX)
+		defines += "#define NORMAL_MATRIX\n";
+	if (key & FEATURE_MULTIVIEW)
+		defines += "#define STEREO\n#define MULTIVIEW\n";
+	if (key & FEATURE_INSTANCED_STEREO)
+		defines += "#define STEREO\n#define INSTANCED_STEREO\n";
+
+	unsigned int bucket = (key & BUCKET_MASK) >> BUCKET_SHIFT;
+	defines += "#define SHADE_GLOBAL_LIGHTS";
+	if (bucket >= BUCKET_DYNAMIC)
+		defines += " for (uint i = 0u; i < lightInfo.x; i++) fragColor += shade(lights[i]);";
+	else
+		for (unsigned int c = 0; c < bucketSize[bucket]; c++)
+		{
+			// Lights below the previous bucket's size are always there:
+			if (c > bucketSize[bucket - 1])
+				defines += " if (lightInfo.x > " + std::to_string(c) + "u)";
+			defines += " fragColor += shade(lights[" + std::to_string(c) + "]);";
+		}
+	defines += "\n";
+	return defines;
+}
+
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+/**
+ * Registers a uniform to bind in every variant, including the already compiled ones.
+ * @param location engine location
+ * @param name uniform name in the sources
+ */
+void ShaderCache::bindLocation(Location location, const std::string &name)
+{
+	locations[location] = name;
+	for (auto &v : variants)
+		if (glGetUniformLocation(v.second.program->getGlId(), name.c_str()) != -1)
+			v.second.program->bindLocation(location, name);
+}
+
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+/**
+ * Returns a variant, compiling it if needed.
+ * @param key variant key
+ * @return the variant's program, nullptr if it does not compile
+ */
+Program *ShaderCache::getVariant(unsigned int key)
+{
+	auto it = variants.find(key);
+	if (it != variants.end())
+		return it->second.program;
+
+	// Depth-only variants have no fragment shader:
+	std::string defines = getDefines(key);
+	Variant v = {};
+	v.vs = new Shader();
+	v.fs = (key & FEATURE_DEPTH_ONLY) ? nullptr : new Shader();
+	v.program = new Program{ v.vs, v.fs };
+	if (!v.vs->loadFromMemory(Shader::TYPE_VERTEX, (char *)(defines + vertexSource).c_str())
+		|| (v.fs && !v.fs->loadFromMemory(Shader::TYPE_FRAGMENT, (char *)(defines + fragmentSource).c_str()))
+		|| !v.program->build())
+	{
+		std::cout << "[ERROR] Unable to build shader variant " << key << std::endl;
+		delete v.program;
+		delete v.fs;
+		delete v.vs;
+		return nullptr;
+	}
+
+	// Bind params (the program must be in use), some variants do not declare all of them:
+	v.program->render();
+	for (auto &l : locations)
+		if (glGetUniformLocation(v.program->getGlId(), l.second.c_str()) != -1)
+			v.program->bindLocation(l.first, l.second);
+	if (current)
+		current->render();
+
+	variants[key] = v;
+	return v.program;
+}
+
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+/**
+ * Makes a variant the current program. Nothing is done if it is already current.
+ * @param key variant key
+ * @return the current program
+ */
+Program *ShaderCache::render(unsigned int key)
+{
+	if (counting && !(key & FEATURE_DEPTH_ONLY))
+		key |= FEATURE_COUNT_FRAGMENTS;
+	if (key == currentKey && current)
+		return current;
+
+	Program *program = getVariant(key);
+	if (program == nullptr)
+		return current;
+
+	end();
+	program->render();
+	current = program;
+	currentKey = key;
+	begin(key);
+	return current;
+}
+
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+/**
+ * Ends the current pass: closes the running measurement, and forces the next render() to rebind.
+ */
+void ShaderCache::finish()
+{
+	end();
+	currentKey = ~0u;
+}
+
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+/**
+ * Enables or disables the per-variant measurements.
+ * @param enable true to measure
+ */
+void ShaderCache::setProfiling(bool enable)
+{
+	if (!enable)
+		end();
+	profiling = enable;
+}
+
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+/**
+ * Enables or disables the counting of the shaded fragments. While enabled, render() picks the
+ * FEATURE_COUNT_FRAGMENTS variants, which increment an atomic counter bound at binding 0.
+ * @param enable true to count
+ */
+void ShaderCache::setCounting(bool enable)
+{
+	if (enable && counterBuffer == 0)
+	{
+		unsigned int zero = 0;
+		glGenBuffers(1, &counterBuffer);
+		glBindBuffer(GL_ATOMIC_COUNTER_BUFFER, counterBuffer);
+		glBufferData(GL_ATOMIC_COUNTER_BUFFER, sizeof(unsigned int), &zero, GL_DYNAMIC_COPY);
+		glBindBuffer(GL_ATOMIC_COUNTER_BUFFER, 0);
+	}
+	if (enable)
+		glBindBufferBase(GL_ATOMIC_COUNTER_BUFFER, 0, counterBuffer);
+	counting = enable;
+	currentKey = ~0u;
+}
+
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+/**
+ * Reads and resets the number of fragments shaded since the last call. Waits for the GPU.
+ * @return the number of fragments, 0 when not counting
+ */
+unsigned long long ShaderCache::collectFragmentCount()
+{
+	if (counterBuffer == 0)
+		return 0;
+
+	unsigned int count = 0;
+	unsigned int zero = 0;
+	glMemoryBarrier(GL_BUFFER_UPDATE_BARRIER_BIT);
+	glBindBuffer(GL_ATOMIC_COUNTER_BUFFER, counterBuffer);
+	glGetBufferSubData(GL_ATOMIC_COUNTER_BUFFER, 0, sizeof(unsigned int), &count);
+	glBufferSubData(GL_ATOMIC_COUNTER_BUFFER, 0, sizeof(unsigned int), &zero);
+	glBindBuffer(GL_ATOMIC_COUNTER_BUFFER, 0);
+	return count;
+}
+
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+/**
+ * Prints the measurements of every variant since the last call, then resets them.
+ */
+void ShaderCache::printStats()
+{
+	collect(false);
+	for (auto &v : variants)
+	{
+		Variant &s = v.second;
+		std::cout << "   variant " << v.first << ": " << s.passes << " passes";
+		if (profiling)
+		{
+			std::cout << ", " << s.gpuTime / 1000 << " us gpu";
+			if (s.fragments)
+				std::cout << ", " << s.fragments << " fragments, " << (double)s.gpuTime / s.fragments << " ns/fragment";
+		}
+		std::cout << std::endl;
+		s.passes = 0;
+		s.gpuTime = 0;
+		s.fragments = 0;
+	}
+}
+
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+/**
+ * Starts measuring the draws of a variant.
+ * @param key variant key
+ */
+void ShaderCache::begin(unsigned int key)
+{
+	variants[key].passes++;
+	if (!profiling)
+		return;
+
+	collect(false);
+	Measure m;
+	m.key = key;
+	for (unsigned int *query : { &m.timeQuery, &m.fragmentQuery })
+	{
+		if (freeQueries.empty())
+			glGenQueries(1, query);
+		else
+		{
+			*query = freeQueries.back();
+			freeQueries.pop_back();
+		}
+	}
+
+	glBeginQuery(GL_TIME_ELAPSED, m.timeQuery);
+	if (GLEW_ARB_pipeline_statistics_query)
+		glBeginQuery(GL_FRAGMENT_SHADER_INVOCATIONS_ARB, m.fragmentQuery);
+	pending.push_back(m);
+	measuring = true;
+}
+
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+/**
+ * Stops the running measurement, its results are read later by collect().
+ */
+void ShaderCache::end()
+{
+	if (!measuring)
+		return;
+
+	glEndQuery(GL_TIME_ELAPSED);
+	if (GLEW_ARB_pipeline_statistics_query)
+		glEndQuery(GL_FRAGMENT_SHADER_INVOCATIONS_ARB);
+	measuring = false;
+}
+
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+/**
+ * Accumulates the results of the finished measurements and recycles their queries.
+ * @param wait true to wait for all of them, false to only read the available ones
+ */
+void ShaderCache::collect(bool wait)
+{
+	unsigned int count = (unsigned int)pending.size() - (measuring ? 1 : 0);
+	unsigned int done = 0;
+	for (; done < count; done++)
+	{
+		Measure &m = pending[done];
+		GLint available = GL_TRUE;
+		if (!wait)
+			glGetQueryObjectiv(m.timeQuery, GL_QUERY_RESULT_AVAILABLE, &available);
+		if (!available)
+			break;
+
+		Variant &v = variants[m.key];
+		GLuint64 result = 0;
+		glGetQueryObjectui64v(m.timeQuery, GL_QUERY_RESULT, &result);
+		v.gpuTime += result;
+		if (GLEW_ARB_pipeline_statistics_query)
+		{
+			glGetQueryObjectui64v(m.fragmentQuery, GL_QUERY_RESULT, &result);
+			v.fragments += result;
+		}
+		freeQueries.push_back(m.timeQuery);
+		freeQueries.push_back(m.fragmentQuery);
+	}
+	pending.erase(pending.begin(), pending.begin() + done);
+}
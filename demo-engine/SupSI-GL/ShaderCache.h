@@ -0,0 +1,131 @@
+#pragma once
+
+#include <map>
+
+/**
+* Supsi-GE, shader permutation cache
+* Instead of a single uber-shader, the engine renders with specialized variants of the same
+* vertex/fragment sources. A variant is identified by a key made of feature bits (texturing,
+* directional-only lighting, skinning) and a bucket of the number of global lights: the key is turned
+* into #defines prepended to the sources, and the global light loop is unrolled up to the bucket size.
+* Variants are compiled on first use, so only the combinations actually needed by the scene are built.
+* Depth-only variants (FEATURE_DEPTH_ONLY) have no fragment shader at all and are used by the depth pre-pass.
+*
+* When profiling is enabled, the GPU time and the number of fragment shader invocations spent
+* in every variant are measured with timer and pipeline statistics queries (see printStats()).
+* When counting is enabled, every shaded fragment also increments an atomic counter, to measure overdraw.
+*/
+class LIB_API ShaderCache {
+	//////////
+public: //
+//////////
+
+	// Enumerations:
+	enum : unsigned int ///< Feature bits of a variant key
+	{
+		FEATURE_TEXTURED = 1 << 0,				///< Samples the material's texture
+		FEATURE_DIRECTIONAL_ONLY = 1 << 1,		///< Only global lights, the cluster lookup is skipped
+		FEATURE_SKINNED = 1 << 2,				///< Reserved for skinned meshes, not produced by OvoReader yet
+		FEATURE_INDIRECT = 1 << 3,				///< Model matrix and material read from the draw buffer (see IndirectBatch.h)
+		FEATURE_DEPTH_ONLY = 1 << 7,			///< Position only, no fragment shader (above the bucket bits)
+		FEATURE_COUNT_FRAGMENTS = 1 << 8,		///< Counts the shaded fragments, added by render() while counting
+		FEATURE_MULTIVIEW = 1 << 9,				///< Both eyes in one pass, eye picked by gl_ViewID_OVR (see Ubo::BINDING_STEREO)
+		FEATURE_INSTANCED_STEREO = 1 << 10,		///< Both eyes in one pass, two instances per draw writing gl_Layer
+		FEATURE_NORMAL_MATRIX = 1 << 11,		///< Non-uniformly scaled model, normals use the cached normal matrix (see Transform.h)
+	};
+
+	enum : unsigned int ///< Buckets of global lights, stored in the key above the first four feature bits
+	{
+		BUCKET_0 = 0,
+		BUCKET_1,
+		BUCKET_2,
+		BUCKET_4,
+		BUCKET_8,
+		BUCKET_DYNAMIC,							///< More than 8 global lights, loop on the count found in the frame block
+
+		BUCKET_SHIFT = 4,
+		BUCKET_MASK = 7 << BUCKET_SHIFT,
+	};
+
+	// Const/dest:
+	ShaderCache(const char *vertexSource, const char *fragmentSource);
+	~ShaderCache();
+
+	// Get/set:
+	inline Program *getCurrent() { return current; }
+	inline unsigned int getCurrentKey() { return currentKey; }
+	inline unsigned int getVariantCount() { return (unsigned int)variants.size(); }
+	inline bool isProfiling() { return profiling; }
+	void setProfiling(bool enable);
+	inline bool isCounting() { return counting; }
+	void setCounting(bool enable);
+	unsigned long long collectFragmentCount();
+
+	// Keys:
+	static unsigned int getLightKey(unsigned int globalLights, unsigned int totalLights);
+	static std::string getDefines(unsigned int key);
+
+	// Management:
+	void bindLocation(Location location, const std::string &name);
+	Program *getVariant(unsigned int key);
+
+	// Rendering:
+	Program *render(unsigned int key);
+	void finish();
+	void printStats();
+
+
+	///////////
+private: //
+///////////
+
+	/**
+	@struct Variant
+	A compiled permutation and its measurements since the last printStats()
+	*/
+	struct Variant
+	{
+		Shader *vs;
+		Shader *fs;
+		Program *program;
+
+		unsigned int passes;				///< Number of times the variant has been bound
+		unsigned long long gpuTime;			///< Nanoseconds
+		unsigned long long fragments;		///< Fragment shader invocations
+	};
+
+	/**
+	@struct Measure
+	Pair of queries waiting for their results
+	*/
+	struct Measure
+	{
+		unsigned int key;
+		unsigned int timeQuery;
+		unsigned int fragmentQuery;
+	};
+
+	void begin(unsigned int key);
+	void end();
+	void collect(bool wait);
+
+	// Sources:
+	std::string vertexSource;
+	std::string fragmentSource;
+	std::map<Location, std::string> locations;	///< Uniforms bound in every variant
+
+	// Variants:
+	std::map<unsigned int, Variant> variants;
+	Program *current;
+	unsigned int currentKey;
+
+	// Profiling:
+	bool profiling;
+	bool measuring;
+	std::vector<Measure> pending;
+	std::vector<unsigned int> freeQueries;
+
+	// Overdraw:
+	bool counting;
+	unsigned int counterBuffer;				///< Atomic counter of the shaded fragments, binding 0
+};
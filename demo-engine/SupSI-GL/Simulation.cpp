@@ -0,0 +1,259 @@
+#include "Engine.h"
+
+#include <algorithm>
+#include <chrono>
+#include <mutex>
+#include <thread>
+
+
+void LIB_API Snapshot::capture(Hierarchy &hierarchy, Camera *camera)
+{
+	unsigned int count = hierarchy.getCount();
+	nodes.resize(count);
+	world.resize(count);
+	ends.resize(count);
+	const glm::mat4 *matrices = hierarchy.getWorld();
+	lights.clear();
+	cameras.clear();
+	for (unsigned int i = 0; i < count; i++)
+	{
+		nodes[i] = hierarchy.getNode(i);
+		world[i] = matrices[i];
+		ends[i] = hierarchy.getSubtreeEnd(i);
+		Camera *treeCamera = nodes[i]->as<Camera>();
+		if (treeCamera != nullptr)
+			cameras.push_back({ treeCamera, world[i], glm::inverse(world[i]), treeCamera->getProjMatrix() });
+		Light *light = nodes[i]->as<Light>();
+		if (light != nullptr)
+		{
+			LightState state;
+			state.light = light;
+			state.index = i;
+			state.priority = light->getPriority();
+			state.on = light->loadToData(state.data, world[i]);
+			lights.push_back(state);
+		}
+	}
+
+	//same order as List::addNode(): highest priority first, oldest first
+	std::sort(lights.begin(), lights.end(), [](const LightState &a, const LightState &b) {
+		return a.priority > b.priority || (a.priority == b.priority && a.index < b.index);
+	});
+
+	//the active camera does not need to be in the tree
+	this->camera = camera;
+	if (camera != nullptr && findCamera(camera) == nullptr)
+		cameras.push_back({ camera, camera->getFinal(), camera->getFinalInverse(), camera->getProjMatrix() });
+}
+
+unsigned int LIB_API Snapshot::getCount() const
+{
+	return (unsigned int)nodes.size();
+}
+
+Node LIB_API * Snapshot::getNode(unsigned int index) const
+{
+	return nodes[index];
+}
+
+const glm::mat4 LIB_API & Snapshot::getWorld(unsigned int index) const
+{
+	return world[index];
+}
+
+unsigned int LIB_API Snapshot::find(const Node *node) const
+{
+	for (unsigned int i = 0; i < nodes.size(); i++)
+		if (nodes[i] == node)
+			return i;
+	return NOT_FOUND;
+}
+
+unsigned int LIB_API Snapshot::getSubtreeEnd(unsigned int index) const
+{
+	return ends[index];
+}
+
+unsigned int LIB_API Snapshot::getLightCount() const
+{
+	return (unsigned int)lights.size();
+}
+
+const Snapshot::LightState LIB_API & Snapshot::getLight(unsigned int index) const
+{
+	return lights[index];
+}
+
+Camera LIB_API * Snapshot::getCamera() const
+{
+	return camera;
+}
+
+unsigned int LIB_API Snapshot::getCameraCount() const
+{
+	return (unsigned int)cameras.size();
+}
+
+const Snapshot::CameraState LIB_API & Snapshot::getCameraState(unsigned int index) const
+{
+	return cameras[index];
+}
+
+const Snapshot::CameraState LIB_API * Snapshot::findCamera(const Camera *camera) const
+{
+	for (const CameraState &state : cameras)
+		if (state.camera == camera)
+			return &state;
+	return nullptr;
+}
+
+Node LIB_API * Snapshot::getRoot() const
+{
+	return nodes.empty() ? nullptr : nodes[0];
+}
+
+unsigned long long LIB_API Snapshot::getStep() const
+{
+	return step;
+}
+
+double LIB_API Snapshot::getTime() const
+{
+	return time;
+}
+
+
+//triple buffer state: index of the latest published snapshot, plus FRESH until the reader takes it
+#define SNAPSHOT_INDEX 3u
+#define SNAPSHOT_FRESH 4u
+
+struct Simulation::Data
+{
+	Snapshot snapshots[3];
+	std::atomic<unsigned int> latest{ 0 };
+	unsigned int writing = 1;				//simulation thread only
+	unsigned int reading = 2;				//render thread only
+	bool published = false;					//render thread only, true after the first snapshot
+
+	std::thread thread;
+	std::atomic<bool> running{ false };
+	std::atomic<Camera*> camera{ nullptr };
+	Node *root = nullptr;
+	Update update;
+	double rate = 90.0;
+	Hierarchy hierarchy;
+
+	std::mutex eventMutex;
+	vector<std::function<void()>> events;	//posted, guarded by eventMutex
+	vector<std::function<void()>> pending;	//being run, simulation thread only
+
+	std::atomic<unsigned int> steps{ 0 };
+	std::atomic<long long> updateTime{ 0 };
+};
+
+
+LIB_API Simulation::Simulation()
+{
+	data = new Data();
+}
+
+LIB_API Simulation::~Simulation()
+{
+	stop();
+	delete data;
+}
+
+void LIB_API Simulation::start(Node *root, const Update &update, double rate)
+{
+	stop();
+	data->root = root;
+	data->update = update;
+	data->rate = glm::max(rate, 1.0);
+	data->running = true;
+	data->thread = std::thread(&Simulation::run, this);
+}
+
+void LIB_API Simulation::stop()
+{
+	data->running = false;
+	if (data->thread.joinable())
+		data->thread.join();
+}
+
+bool LIB_API Simulation::isRunning()
+{
+	return data->running;
+}
+
+void LIB_API Simulation::post(const std::function<void()> &event)
+{
+	std::lock_guard<std::mutex> lock(data->eventMutex);
+	data->events.push_back(event);
+}
+
+void LIB_API Simulation::setCamera(Camera *camera)
+{
+	data->camera = camera;
+}
+
+const Snapshot LIB_API * Simulation::acquire()
+{
+	//take the latest snapshot if it is newer than ours, leaving ours for the writer
+	if (data->latest & SNAPSHOT_FRESH)
+	{
+		data->reading = data->latest.exchange(data->reading) & SNAPSHOT_INDEX;
+		data->published = true;
+	}
+	return data->published ? &data->snapshots[data->reading] : nullptr;
+}
+
+void Simulation::run()
+{
+	auto period = std::chrono::duration_cast<std::chrono::high_resolution_clock::duration>(std::chrono::duration<double>(1.0 / data->rate));
+	auto begin = std::chrono::high_resolution_clock::now();
+	auto previous = begin;
+	unsigned long long step = 0;
+	while (data->running)
+	{
+		auto start = std::chrono::high_resolution_clock::now();
+		double dt = std::chrono::duration<double>(start - previous).count();
+		previous = start;
+
+		//input events first, then the application
+		{
+			std::lock_guard<std::mutex> lock(data->eventMutex);
+			data->pending.swap(data->events);
+		}
+		for (std::function<void()> &event : data->pending)
+			event();
+		data->pending.clear();
+		if (data->update)
+			data->update(dt);
+
+		//capture and publish
+		Node *root = data->root;
+		if (!data->hierarchy.isBuilt(root))
+			data->hierarchy.build(root);
+		data->hierarchy.update(root->getParent() == nullptr ? glm::mat4(1.0f) : root->getParent()->getFinal());
+		Snapshot &snapshot = data->snapshots[data->writing];
+		snapshot.capture(data->hierarchy, data->camera);
+		snapshot.step = ++step;
+		snapshot.time = std::chrono::duration<double>(start - begin).count();
+		data->writing = data->latest.exchange(data->writing | SNAPSHOT_FRESH) & SNAPSHOT_INDEX;
+
+		auto end = std::chrono::high_resolution_clock::now();
+		data->steps++;
+		data->updateTime += std::chrono::duration_cast<std::chrono::microseconds>(end - start).count();
+		std::this_thread::sleep_until(start + period);
+	}
+}
+
+unsigned int LIB_API Simulation::getSteps()
+{
+	return data->steps.exchange(0);
+}
+
+long long LIB_API Simulation::getUpdateTime()
+{
+	return data->updateTime.exchange(0);
+}
@@ -0,0 +1,186 @@
+#pragma once
+
+/**
+* Supsi-GE, scene snapshot class
+* Everything the render thread needs from the scene graph for one frame, copied at once by the simulation thread:
+* the world matrix of every node (which, with the immutable mesh bounds, is also the input of the culling stages),
+* the state of the lights and the matrices of the cameras: every camera of the tree, plus the active one if it is not
+* part of it, so that the render thread never reads a Node while the simulation runs.
+* Nodes are in depth-first order, lights are sorted as List::addNode() sorts them (highest priority first, then in
+* depth-first order), so that List::loadLights() can take them by position.
+* After the first captures the buffers are reused: capturing does not allocate.
+*/
+class LIB_API Snapshot
+{
+public:
+	static const unsigned int NOT_FOUND = 0xFFFFFFFF;	///< Returned by find() for nodes outside the snapshot
+
+	/**
+	@struct LightState
+	A light of the snapshot and its shader data, "on" false when the light is off
+	*/
+	struct LightState
+	{
+		Light *light;
+		unsigned int index;		///< Position of the node in the snapshot
+		int priority;
+		bool on;
+		LightData data;
+	};
+
+	/**
+	@struct CameraState
+	A camera of the snapshot: its final matrix, its inverse (the view matrix) and its projection
+	*/
+	struct CameraState
+	{
+		Camera *camera;
+		glm::mat4 world;
+		glm::mat4 view;
+		glm::mat4 projection;
+	};
+
+	/**
+	Copies the world matrices of an updated hierarchy, the lights and the camera
+	@param hierarchy The hierarchy, already updated
+	@param camera The camera the frame is rendered from, nullptr for none
+	*/
+	void capture(Hierarchy &hierarchy, Camera *camera);
+
+	unsigned int getCount() const;
+	Node* getNode(unsigned int index) const;
+	const glm::mat4 &getWorld(unsigned int index) const;
+
+	/**
+	Returns the index of a node, NOT_FOUND if it was not captured
+	*/
+	unsigned int find(const Node *node) const;
+
+	/**
+	Returns the index following the last node of a node's subtree, see Hierarchy::getSubtreeEnd()
+	*/
+	unsigned int getSubtreeEnd(unsigned int index) const;
+
+	unsigned int getLightCount() const;
+	const LightState &getLight(unsigned int index) const;
+
+	/**
+	Returns the active camera as of the capture
+	*/
+	Camera* getCamera() const;
+
+	/**
+	Returns the captured cameras
+	*/
+	unsigned int getCameraCount() const;
+	const CameraState &getCameraState(unsigned int index) const;
+
+	/**
+	Returns the state of a camera, nullptr if it was not captured (a camera outside the tree, before it became the
+	active one)
+	*/
+	const CameraState* findCamera(const Camera *camera) const;
+
+	/**
+	Returns the root node the snapshot was captured from
+	*/
+	Node* getRoot() const;
+
+	/**
+	Returns the number of the simulation step that produced the snapshot, starting from 1, and its time in seconds
+	*/
+	unsigned long long getStep() const;
+	double getTime() const;
+
+private:
+	friend class Simulation;
+
+	vector<Node*> nodes;
+	vector<glm::mat4> world;
+	vector<unsigned int> ends;
+	vector<LightState> lights;
+	vector<CameraState> cameras;
+	Camera *camera = nullptr;
+	unsigned long long step = 0;
+	double time = 0.0;
+};
+
+
+/**
+* Supsi-GE, simulation thread class
+* Runs the application's updates on their own thread, at a fixed rate, so that a slow update does not delay the
+* render thread. After each update the scene is captured into a Snapshot and published; the render thread always
+* takes the latest complete one, without waiting: there are three snapshots, one being written, one being read and
+* the latest published one, swapped atomically.
+* While the simulation runs it owns the scene graph: changes coming from other threads (input events) must be posted
+* with post(), which runs them on the simulation thread before the next update.
+* The class does not touch OpenGL.
+*/
+class LIB_API Simulation
+{
+public:
+	/**
+	Update callback, called with the time since the previous update in seconds
+	*/
+	typedef std::function<void(double)> Update;
+
+	Simulation();
+
+	/**
+	Destructor, stops the thread
+	*/
+	~Simulation();
+
+	/**
+	Starts the simulation thread
+	@param root The scene to update and capture
+	@param update The application's update, can be empty
+	@param rate Updates per second
+	*/
+	void start(Node *root, const Update &update, double rate);
+
+	/**
+	Stops the simulation thread, after the current update
+	*/
+	void stop();
+
+	/**
+	Returns true if the simulation thread is running
+	*/
+	bool isRunning();
+
+	/**
+	Runs a function on the simulation thread, before the next update. Thread safe.
+	*/
+	void post(const std::function<void()> &event);
+
+	/**
+	Sets the camera captured with the scene. Thread safe.
+	*/
+	void setCamera(Camera *camera);
+
+	/**
+	Returns the latest complete snapshot, nullptr before the first one. The snapshot stays valid and unchanged
+	until the next call. To be called by one thread only, the render thread.
+	*/
+	const Snapshot* acquire();
+
+	/**
+	Returns the number of updates since the last call
+	*/
+	unsigned int getSteps();
+
+	/**
+	Returns the time spent in the updates and the captures since the last call, in microseconds
+	*/
+	long long getUpdateTime();
+
+private:
+	/**
+	Main loop of the simulation thread
+	*/
+	void run();
+
+	struct Data;
+	Data *data;
+};
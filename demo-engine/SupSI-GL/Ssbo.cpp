@@ -0,0 +1,76 @@
+#include "Engine.h"
+
+// Glew (include it before GL.h):
+#include <GL/glew.h>
+
+// C/C++:
+#include <iostream>
+
+
+Ssbo::Ssbo()
+	: size{ 0 }
+	, capacity{ 0 }
+{
+	// Allocate OGL data:
+	glGenBuffers(1, &glId);
+}
+
+Ssbo::~Ssbo()
+{
+	glDeleteBuffers(1, &glId);
+}
+
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+/**
+ * Copies an array into video memory, reallocating the storage when it is too small.
+ * @param data pointer to the std430 data
+ * @param size size in bytes of the data
+ * @return true on success, false on fail
+ */
+bool Ssbo::update(const void *data, unsigned int size)
+{
+	// Safety net:
+	if (data == nullptr && size)
+	{
+		std::cout << "[ERROR] Invalid params" << std::endl;
+		return false;
+	}
+
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, glId);
+	if (size > capacity || capacity == 0)
+	{
+		// Grow geometrically to avoid a reallocation every time a light is added:
+		capacity = glm::max(glm::max(size, capacity * 2), 256u);
+		glBufferData(GL_SHADER_STORAGE_BUFFER, capacity, nullptr, GL_DYNAMIC_DRAW);
+	}
+	if (size)
+		glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, size, data);
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+	this->size = size;
+
+	// Done:
+	return true;
+}
+
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+/**
+ * Exposes the array to the shaders.
+ * @param binding one of the enumerated binding points of type Ssbo::BINDING_*
+ * @return true on success, false on fail
+ */
+bool Ssbo::render(unsigned int binding)
+{
+	// Safety net:
+	if (capacity == 0)
+	{
+		std::cout << "[ERROR] Empty storage buffer rendered" << std::endl;
+		return false;
+	}
+
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, binding, glId);
+
+	// Done:
+	return true;
+}
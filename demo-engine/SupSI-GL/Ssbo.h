@@ -0,0 +1,50 @@
+#pragma once
+
+/**
+* Supsi-GE, shader storage buffer management class
+* An Ssbo holds a variable-sized std430 array read by the shaders (e.g. the lights and the light clusters).
+* The buffer grows on demand and is bound to one of the fixed binding points declared by the shaders in Engine.cpp.
+*/
+class LIB_API Ssbo {
+	//////////
+public: //
+//////////
+
+	// Enumerations:
+	enum : unsigned int ///< Binding points, shared with the shaders
+	{
+		BINDING_LIGHTS = 0,
+		BINDING_CLUSTERS,
+		BINDING_LIGHT_INDICES,
+		BINDING_DRAWS,
+		BINDING_COMMANDS,
+		BINDING_CULL_FLAGS,
+	};
+
+	// Const/dest:
+	Ssbo();
+	~Ssbo();
+
+	// Get/set:
+	inline unsigned int getSize() { return size; }
+	inline unsigned int getCapacity() { return capacity; }
+	inline unsigned int getHandle() { return glId; }
+
+	// Management:
+	bool update(const void *data, unsigned int size);
+
+	// Rendering:
+	bool render(unsigned int binding);
+
+
+	///////////
+private: //
+///////////
+
+	// Generic data:
+	unsigned int size;					///< Size in bytes of the last upload
+	unsigned int capacity;				///< Size in bytes of the video memory storage
+
+	// OGL stuff:
+	unsigned int glId;					///< OpenGL ID
+};
@@ -9,6 +9,7 @@
 
 LIB_API Texture::Texture(string textureName) : Object()
 {
+	setKind(KIND_TEXTURE);
 	if (textureName.compare("[none]") == 0)
 	{
 		return;
@@ -0,0 +1,65 @@
+#include "Engine.h"
+
+#include <atomic>
+#include <cmath>
+
+//relative tolerance of the classification, loose enough for matrices accumulated through a hierarchy
+#define TRANSFORM_EPSILON 1e-4f
+
+
+//normal matrices computed since the last resetInversions()
+static std::atomic<unsigned int> inversions{ 0 };
+
+
+Transform::Kind LIB_API Transform::classify(const glm::mat4 &world)
+{
+	glm::vec3 x(world[0]), y(world[1]), z(world[2]);
+	float xx = glm::dot(x, x), yy = glm::dot(y, y), zz = glm::dot(z, z);
+
+	//orthogonal axes of the same length: a rotation times a uniform scale
+	float tolerance = TRANSFORM_EPSILON * glm::max(xx, glm::max(yy, zz));
+	if (fabsf(glm::dot(x, y)) > tolerance || fabsf(glm::dot(x, z)) > tolerance || fabsf(glm::dot(y, z)) > tolerance)
+		return GENERAL;
+	if (fabsf(xx - yy) > tolerance || fabsf(xx - zz) > tolerance)
+		return GENERAL;
+	if (fabsf(xx - 1.0f) > TRANSFORM_EPSILON)
+		return UNIFORM_SCALE;
+	return RIGID;
+}
+
+bool LIB_API Transform::update(const glm::mat4 &world)
+{
+	if (world == this->world)
+		return false;
+
+	this->world = world;
+	kind = classify(world);
+	if (kind == GENERAL)
+	{
+		normalMatrix = glm::inverseTranspose(glm::mat3(world));
+		inversions++;
+	}
+	else
+		normalMatrix = glm::mat3(world);
+	return true;
+}
+
+Transform::Kind LIB_API Transform::getKind()
+{
+	return kind;
+}
+
+const glm::mat3 LIB_API & Transform::getNormalMatrix()
+{
+	return normalMatrix;
+}
+
+unsigned int LIB_API Transform::getInversions()
+{
+	return inversions;
+}
+
+void LIB_API Transform::resetInversions()
+{
+	inversions = 0;
+}
@@ -0,0 +1,64 @@
+#pragma once
+
+/**
+* Supsi-GE, world transform cache
+* Normals must be transformed by the inverse transpose of the world matrix. When the matrix is rigid or uniformly
+* scaled, the inverse transpose is the matrix itself up to a scale factor, which the fragment shader removes when it
+* normalizes the normal: only "general" matrices (non-uniform scale, shear) need a real normal matrix.
+* A Transform classifies the world matrix of a node when it is updated, and keeps the normal matrix of general
+* matrices until the world matrix changes, so that the inverse is never computed per vertex nor per frame.
+* The class does not touch OpenGL.
+*/
+class LIB_API Transform
+{
+public:
+	/**
+	@enum Kind
+	Classes of world matrices, by the cost of their normal matrix
+	*/
+	enum Kind : unsigned int
+	{
+		RIGID = 0,			///< Rotation and translation only
+		UNIFORM_SCALE,		///< Same scale on every axis, possibly mirrored
+		GENERAL,			///< Non-uniform scale or shear, needs the inverse transpose
+	};
+
+	/**
+	Classifies a world matrix, ignoring its translation
+	@param world The matrix
+	*/
+	static Kind classify(const glm::mat4 &world);
+
+	/**
+	Sets the current world matrix. Nothing is recomputed when it did not change.
+	@param world The new world matrix
+	@return true if the matrix changed
+	*/
+	bool update(const glm::mat4 &world);
+
+	/**
+	Returns the class of the current world matrix
+	*/
+	Kind getKind();
+
+	/**
+	Returns the normal matrix: the inverse transpose of the world matrix for GENERAL ones,
+	the world matrix itself (up to a scale factor) otherwise
+	*/
+	const glm::mat3 &getNormalMatrix();
+
+	/**
+	Returns how many times the normal matrix has been recomputed, for the stats
+	*/
+	static unsigned int getInversions();
+
+	/**
+	Resets the counter returned by getInversions()
+	*/
+	static void resetInversions();
+
+private:
+	glm::mat4 world = glm::mat4(0.0f);	///< Never a valid world matrix, forces the first update
+	glm::mat3 normalMatrix = glm::mat3(1.0f);
+	Kind kind = RIGID;
+};
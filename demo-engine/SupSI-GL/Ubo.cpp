@@ -0,0 +1,77 @@
+#include "Engine.h"
+
+// Glew (include it before GL.h):
+#include <GL/glew.h>
+
+// C/C++:
+#include <iostream>
+
+
+Ubo::Ubo(unsigned int blockSize, unsigned int blockCount)
+	: blockSize{ blockSize }
+	, blockCount{ blockCount }
+{
+	// Consecutive blocks must start at a multiple of the offset alignment:
+	int alignment = 1;
+	glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &alignment);
+	stride = ((blockSize + alignment - 1) / alignment) * alignment;
+
+	// Allocate OGL data:
+	glGenBuffers(1, &glId);
+	glBindBuffer(GL_UNIFORM_BUFFER, glId);
+	glBufferData(GL_UNIFORM_BUFFER, stride * blockCount, nullptr, GL_DYNAMIC_DRAW);
+	glBindBuffer(GL_UNIFORM_BUFFER, 0);
+}
+
+Ubo::~Ubo()
+{
+	glDeleteBuffers(1, &glId);
+}
+
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+/**
+ * Copies a whole block into video memory.
+ * @param data pointer to blockSize bytes of std140 data
+ * @param block index of the block to overwrite
+ * @return true on success, false on fail
+ */
+bool Ubo::update(const void *data, unsigned int block)
+{
+	// Safety net:
+	if (data == nullptr || block >= blockCount)
+	{
+		std::cout << "[ERROR] Invalid params" << std::endl;
+		return false;
+	}
+
+	glBindBuffer(GL_UNIFORM_BUFFER, glId);
+	glBufferSubData(GL_UNIFORM_BUFFER, stride * block, blockSize, data);
+	glBindBuffer(GL_UNIFORM_BUFFER, 0);
+
+	// Done:
+	return true;
+}
+
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+/**
+ * Exposes a block to the shaders.
+ * @param binding one of the enumerated binding points of type Ubo::BINDING_*
+ * @param block index of the block to bind
+ * @return true on success, false on fail
+ */
+bool Ubo::render(unsigned int binding, unsigned int block)
+{
+	// Safety net:
+	if (block >= blockCount)
+	{
+		std::cout << "[ERROR] Invalid params" << std::endl;
+		return false;
+	}
+
+	glBindBufferRange(GL_UNIFORM_BUFFER, binding, glId, stride * block, blockSize);
+
+	// Done:
+	return true;
+}
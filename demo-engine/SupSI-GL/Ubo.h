@@ -0,0 +1,66 @@
+#pragma once
+
+/**
+* Supsi-GE, uniform buffer management class
+* A Ubo holds one or more std140 uniform blocks in a single OpenGL buffer.
+* Blocks are written once per frame and bound to the fixed binding points
+* declared by the shaders in Engine.cpp, so per-draw uploads are limited to the model matrix.
+* Lights, whose number is not bounded, are stored in shader storage buffers instead (see Ssbo.h).
+* When more than one block is stored (e.g. one per eye), each one starts at an offset
+* aligned to GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT.
+*/
+
+/**
+@struct FrameBlock
+std140 mirror of the "FrameData" shader block: camera and light cluster data for a single view
+*/
+struct FrameBlock
+{
+	glm::mat4 projection;
+	glm::mat4 view;
+	glm::vec4 eyePosition;		///< Camera position in world coordinates (w unused)
+	glm::uvec4 clusterGrid;		///< Number of clusters along x, y, z; w: first cluster of this view (see Clusters.h)
+	glm::vec4 clusterDepth;		///< Near plane, far plane, depth slice scale and bias
+	glm::uvec4 lightInfo;		///< x: number of global lights, y: total number of lights
+};
+
+class LIB_API Ubo {
+	//////////
+public: //
+//////////
+
+	// Enumerations:
+	enum : unsigned int ///< Binding points, shared with the shaders
+	{
+		BINDING_FRAME = 0,
+		BINDING_STEREO,					///< Both eyes' FrameBlocks back to back, for single-pass stereo
+	};
+
+	// Const/dest:
+	Ubo(unsigned int blockSize, unsigned int blockCount = 1);
+	~Ubo();
+
+	// Get/set:
+	inline unsigned int getBlockSize() { return blockSize; }
+	inline unsigned int getBlockCount() { return blockCount; }
+	inline unsigned int getHandle() { return glId; }
+
+	// Management:
+	bool update(const void *data, unsigned int block = 0);
+
+	// Rendering:
+	bool render(unsigned int binding, unsigned int block = 0);
+
+
+	///////////
+private: //
+///////////
+
+	// Generic data:
+	unsigned int blockSize;				///< Size in bytes of a single block
+	unsigned int blockCount;			///< Number of blocks stored
+	unsigned int stride;				///< Distance in bytes between two consecutive blocks
+
+	// OGL stuff:
+	unsigned int glId;					///< OpenGL ID
+};
@@ -11,7 +11,17 @@ OvXR::OvXR(const std::string & app_name)
 	, xrInstance{ XR_NULL_HANDLE }
 	, xrSession{ XR_NULL_HANDLE }
 	, sessionRunning{ false }
+	, stereoArray{ false }
+	, depthLayers{ false }
+	, depthNear{ 0.1f }
+	, depthFar{ 1000.f }
+	, renderScale{ 1.f }
+	, maxRenderScale{ 1.f }
+	, swapchainWidth{ 0 }
+	, swapchainHeight{ 0 }
 	, graphicsBinding { nullptr }
+	, xrViewSpace{ XR_NULL_HANDLE }
+	, xrPredictedDisplayPeriod{ 0 }
 {
 	// initialize the specif class / rendering layer based on the platform we are on
 #ifdef _WINDOWS
@@ -36,6 +46,18 @@ bool OvXR::init()
 	std::string ext = platformRenderer->getRenderExtensionName();
 	extensionsToEnable.push_back(ext.c_str());
 
+	// when the runtime supports it, the depth is submitted too, for positional reprojection of missed frames
+	uint32_t extensionCount = 0;
+	xrEnumerateInstanceExtensionProperties(nullptr, 0, &extensionCount, nullptr);
+	std::vector<XrExtensionProperties> extensions(extensionCount, { XR_TYPE_EXTENSION_PROPERTIES });
+	xrEnumerateInstanceExtensionProperties(nullptr, extensionCount, &extensionCount, extensions.data());
+	depthLayers = false;
+	for (XrExtensionProperties &extension : extensions)
+		if (strcmp(extension.extensionName, XR_KHR_COMPOSITION_LAYER_DEPTH_EXTENSION_NAME) == 0)
+			depthLayers = true;
+	if (depthLayers)
+		extensionsToEnable.push_back(XR_KHR_COMPOSITION_LAYER_DEPTH_EXTENSION_NAME);
+
 	// some informations that help runtimes recognize behavior inherent to classes of applications
 	XrApplicationInfo applicationInfo;
 	strcpy(applicationInfo.applicationName, appName.c_str()); // name of the application
@@ -266,17 +288,36 @@ bool OvXR::init()
 
 		delete[] swapchainFormats;
 	}
+	// depth swapchains are created with the color ones
+	if (depthLayers)
+		depthLayers = platformRenderer->enableDepthSwapchains();
+
+	// swapchains large enough for the largest render scale, within the runtime's limits
+	std::vector<XrViewConfigurationView> swapchainViews = configurationViews;
+	for (XrViewConfigurationView &view : swapchainViews)
+	{
+		view.recommendedImageRectWidth = glm::min((uint32_t)(view.recommendedImageRectWidth * maxRenderScale + 0.5f),
+			glm::max(view.maxImageRectWidth, view.recommendedImageRectWidth));
+		view.recommendedImageRectHeight = glm::min((uint32_t)(view.recommendedImageRectHeight * maxRenderScale + 0.5f),
+			glm::max(view.maxImageRectHeight, view.recommendedImageRectHeight));
+	}
+	swapchainWidth = swapchainViews[0].recommendedImageRectWidth;
+	swapchainHeight = swapchainViews[0].recommendedImageRectHeight;
+
 	// call to platform specific renderer for initialize swapchains
-	if (!platformRenderer->initSwapchains(xrSession, configurationViews))
+	if (!platformRenderer->initSwapchains(xrSession, swapchainViews))
 	{
 		std::cout << "[OvXR | ERROR] Swapchains cration failed" << std::endl;
 		return false;
 	}
 
+	// the renderer falls back to its own depth buffers when the runtime has no depth format it can use
+	if (depthLayers)
+		depthLayers = platformRenderer->getDepthSwapchain(EYE_LEFT) != XR_NULL_HANDLE;
+	std::cout << "[OvXR | INFO] Depth layers " << (depthLayers ? "submitted" : "not supported") << std::endl;
+
 	// call to platform specific renderer for initialize resources
-	if(!platformRenderer->initPlatformResources(
-		configurationViews[0].recommendedImageRectWidth,
-		configurationViews[0].recommendedImageRectHeight))
+	if(!platformRenderer->initPlatformResources(swapchainWidth, swapchainHeight))
 	{
 		std::cout << "[OvXR | ERROR] Platform resources initialization failed" << std::endl;
 		return false;
@@ -286,6 +327,86 @@ bool OvXR::init()
 	return true;
 }
 
+bool OvXR::enableStereoArray(bool multiview)
+{
+	// swapchains are created by init()
+	if (xrSession != XR_NULL_HANDLE)
+	{
+		std::cout << "[OvXR | ERROR] Stereo array must be enabled before init()" << std::endl;
+		return false;
+	}
+	stereoArray = platformRenderer->enableStereoArray(multiview);
+	return stereoArray;
+}
+
+bool OvXR::isStereoArray()
+{
+	return stereoArray;
+}
+
+bool OvXR::hasDepthLayers()
+{
+	return depthLayers;
+}
+
+void OvXR::setDepthRange(float nearZ, float farZ)
+{
+	depthNear = nearZ;
+	depthFar = farZ;
+}
+
+bool OvXR::setMaxRenderScale(float scale)
+{
+	// swapchains are created by init()
+	if (xrSession != XR_NULL_HANDLE)
+	{
+		std::cout << "[OvXR | ERROR] Largest render scale must be set before init()" << std::endl;
+		return false;
+	}
+	maxRenderScale = glm::max(scale, 0.01f);
+	renderScale = glm::min(renderScale, maxRenderScale);
+	return true;
+}
+
+void OvXR::setRenderScale(float scale)
+{
+	renderScale = glm::clamp(scale, 0.01f, maxRenderScale);
+}
+
+float OvXR::getRenderScale()
+{
+	return renderScale;
+}
+
+unsigned int OvXR::getRenderWidth()
+{
+	if (swapchainWidth == 0)
+		return getHmdIdealHorizRes();
+	return glm::clamp((unsigned int)(getHmdIdealHorizRes() * renderScale + 0.5f), 1u, swapchainWidth);
+}
+
+unsigned int OvXR::getRenderHeight()
+{
+	if (swapchainHeight == 0)
+		return getHmdIdealVertRes();
+	return glm::clamp((unsigned int)(getHmdIdealVertRes() * renderScale + 0.5f), 1u, swapchainHeight);
+}
+
+unsigned int OvXR::getSwapchainWidth()
+{
+	return swapchainWidth;
+}
+
+unsigned int OvXR::getSwapchainHeight()
+{
+	return swapchainHeight;
+}
+
+XrDuration OvXR::getPredictedDisplayPeriod()
+{
+	return xrPredictedDisplayPeriod;
+}
+
 bool OvXR::beginSession()
 {
 	// begin the session
@@ -308,6 +429,10 @@ bool OvXR::beginSession()
 	projectionLayer.viewCount = viewCount;
 	// views is const and can't be changed, has to be created new every time
 	projectionLayer.views = nullptr;
+	// the projection views and the layer list are refilled every frame, never reallocated
+	projectionViews.resize(viewCount);
+	depthInfos.resize(viewCount);
+	frameLayers.reserve(1);
 	return sessionRunning;
 }
 
@@ -331,13 +456,14 @@ bool OvXR::endSession()
 
 bool OvXR::beginFrame()
 {
-	// perform an event polling
-	// initialize an event buffer to hold the event output
-	XrEventDataBuffer runtimeEvent;
-	runtimeEvent.type = XR_TYPE_EVENT_DATA_BUFFER;
-	runtimeEvent.next = nullptr;
-
 	XrFrameState frameState;
+	if (!waitFrame(frameState))
+		return false;
+	return beginFrame(frameState);
+}
+
+bool OvXR::waitFrame(XrFrameState &frameState)
+{
 	frameState.type = XR_TYPE_FRAME_STATE;
 	frameState.next = nullptr;
 
@@ -345,13 +471,23 @@ bool OvXR::beginFrame()
 	frameWaitInfo.type = XR_TYPE_FRAME_WAIT_INFO;
 	frameWaitInfo.next = nullptr;
 
-	// Wait for a new frame
+	// Wait for a new frame, only the session is used here: safe on a thread of its own
 	XrResult res = xrWaitFrame(xrSession, &frameWaitInfo, &frameState);
 	if (!XR_SUCCEEDED(res))
 	{
 		std::cout << "[OvXR | ERROR] xrWaitFrame failed!" << std::endl;
 		return false;
 	}
+	return true;
+}
+
+bool OvXR::beginFrame(const XrFrameState &frameState)
+{
+	// perform an event polling
+	// initialize an event buffer to hold the event output
+	XrEventDataBuffer runtimeEvent;
+	runtimeEvent.type = XR_TYPE_EVENT_DATA_BUFFER;
+	runtimeEvent.next = nullptr;
 
 	// Handle runtime Events
 	// we do this right after xrWaitFrame() so we can go idle or
@@ -387,7 +523,7 @@ bool OvXR::beginFrame()
 	unsigned int viewCountOutput;
 	// retrieve the viewer pose and projection parameters needed to render each view
 	// for use in a composition projection layer
-	res = xrLocateViews(xrSession, &viewLocateInfo, &viewState,
+	XrResult res = xrLocateViews(xrSession, &viewLocateInfo, &viewState,
 		viewCount, &viewCountOutput, views.data());
 	if (!XR_SUCCEEDED(res))
 	{
@@ -407,7 +543,7 @@ bool OvXR::beginFrame()
 	}
 	// setting up component for the (immediately after frame is built) submission
 	xrPredicedDisplayTime = frameState.predictedDisplayTime;
-	projectionViews = std::vector<XrCompositionLayerProjectionView>(viewCount);
+	xrPredictedDisplayPeriod = frameState.predictedDisplayPeriod;
 	return true;
 }
 
@@ -415,14 +551,15 @@ bool OvXR::endFrame()
 {
 	// set the array of type XrCompositionLayerProjectionView containing each projection layer view
 	projectionLayer.views = projectionViews.data();
-	std::vector<XrCompositionLayerBaseHeader*> projectionlayers;
-	projectionlayers.push_back(reinterpret_cast<XrCompositionLayerBaseHeader*>(&projectionLayer));
+
+	// back to front: the quad layers in their order, the projection layer at order 0
+	composeLayers(quadLayers, quadOrder, projectionLayer, frameLayers);
 
 	XrFrameEndInfo frameEndInfo;
 	frameEndInfo.type					= XR_TYPE_FRAME_END_INFO;
 	frameEndInfo.displayTime			= xrPredicedDisplayTime;
-	frameEndInfo.layerCount				= (uint32_t)projectionlayers.size(); // the number of composition layers in this frame
-	frameEndInfo.layers					= projectionlayers.data();
+	frameEndInfo.layerCount				= (uint32_t)frameLayers.size(); // the number of composition layers in this frame
+	frameEndInfo.layers					= frameLayers.data();
 	frameEndInfo.environmentBlendMode	= XR_ENVIRONMENT_BLEND_MODE_OPAQUE;
 	frameEndInfo.next = nullptr;
 	// submit frame
@@ -435,23 +572,15 @@ bool OvXR::endFrame()
 	return true;
 }
 
-bool OvXR::lockSwapchain(OvEye eye)
+bool OvXR::acquireImage(XrSwapchain swapchain, unsigned int &index)
 {
-	// acquire the swapchain, delegate this to platform specific render
-	XrSwapchain swapchain = platformRenderer->getSwapchain(eye);
-	if (swapchain == XR_NULL_HANDLE) 
-	{
-		std::cout << "[OvXR | ERROR] PlafformRenderer returned an invalid XrSwapchain!" << std::endl;
-		return false;
-	}
-
 	// acquire the swapchain image
 	XrSwapchainImageAcquireInfo swapchainImageAcquireInfo;
 	swapchainImageAcquireInfo.type = XR_TYPE_SWAPCHAIN_IMAGE_ACQUIRE_INFO;
 	swapchainImageAcquireInfo.next = nullptr;
 	// swapchain is the swapchain from which to acquire an image
-	// textureIndex is a pointer to the image index that was acquired
-	XrResult res = xrAcquireSwapchainImage(swapchain, &swapchainImageAcquireInfo, &textureIndex);
+	// index is a pointer to the image index that was acquired
+	XrResult res = xrAcquireSwapchainImage(swapchain, &swapchainImageAcquireInfo, &index);
 	if (!XR_SUCCEEDED(res))
 	{
 		std::cout << "[OvXR | ERROR] xrAcquireSwapchainImage failed!" << std::endl;
@@ -471,23 +600,85 @@ bool OvXR::lockSwapchain(OvEye eye)
 		std::cout << "[OvXR | ERROR] Failed to wait for swapchain image!" << std::endl;
 		return false;
 	}
+	return true;
+}
+
+bool OvXR::releaseImage(XrSwapchain swapchain)
+{
+	XrSwapchainImageReleaseInfo swapchainImageReleaseInfo;
+	swapchainImageReleaseInfo.type = XR_TYPE_SWAPCHAIN_IMAGE_RELEASE_INFO;
+	swapchainImageReleaseInfo.next = nullptr;
+	XrResult res = xrReleaseSwapchainImage(swapchain, &swapchainImageReleaseInfo);
+	if (!XR_SUCCEEDED(res))
+	{
+		std::cout << "[OvXR | ERROR] Failed to release swapchain image!" << std::endl;
+		return false;
+	}
+	return true;
+}
+
+void OvXR::setProjectionView(OvEye eye, XrSwapchain swapchain, unsigned int arrayIndex)
+{
+	// depth of the same view and rectangle, chained to the projection view
+	const void *next = nullptr;
+	if (depthLayers)
+	{
+		depthInfos[eye].type = XR_TYPE_COMPOSITION_LAYER_DEPTH_INFO_KHR;
+		depthInfos[eye].next = nullptr;
+		depthInfos[eye].subImage.swapchain = platformRenderer->getDepthSwapchain(eye);
+		depthInfos[eye].subImage.imageArrayIndex = arrayIndex;
+		depthInfos[eye].subImage.imageRect.offset.x = 0;
+		depthInfos[eye].subImage.imageRect.offset.y = 0;
+		depthInfos[eye].subImage.imageRect.extent.width = getRenderWidth();
+		depthInfos[eye].subImage.imageRect.extent.height = getRenderHeight();
+		depthInfos[eye].minDepth = 0.0f;
+		depthInfos[eye].maxDepth = 1.0f;
+		depthInfos[eye].nearZ = depthNear;
+		depthInfos[eye].farZ = depthFar;
+		next = &depthInfos[eye];
+	}
 
 	// setting up the projection composition layer
 	projectionViews[eye].type = XR_TYPE_COMPOSITION_LAYER_PROJECTION_VIEW;
-	projectionViews[eye].next = nullptr;
+	projectionViews[eye].next = next;
 	projectionViews[eye].pose = views[eye].pose; // location and orientation of this projection element
 	projectionViews[eye].fov = views[eye].fov; // fov for this projection element
 	projectionViews[eye].subImage.swapchain = swapchain; // the image layer to use
-	projectionViews[eye].subImage.imageArrayIndex = 0;
+	projectionViews[eye].subImage.imageArrayIndex = arrayIndex;
 	projectionViews[eye].subImage.imageRect.offset.x = 0;
 	projectionViews[eye].subImage.imageRect.offset.y = 0;
-	projectionViews[eye].subImage.imageRect.extent.width = configurationViews[eye].recommendedImageRectWidth;
-	projectionViews[eye].subImage.imageRect.extent.height = configurationViews[eye].recommendedImageRectHeight;
+	// only the part rendered at the current scale (see setRenderScale())
+	projectionViews[eye].subImage.imageRect.extent.width = getRenderWidth();
+	projectionViews[eye].subImage.imageRect.extent.height = getRenderHeight();
+}
+
+bool OvXR::lockSwapchain(OvEye eye)
+{
+	// acquire the swapchain, delegate this to platform specific render
+	XrSwapchain swapchain = platformRenderer->getSwapchain(eye);
+	if (swapchain == XR_NULL_HANDLE) 
+	{
+		std::cout << "[OvXR | ERROR] PlafformRenderer returned an invalid XrSwapchain!" << std::endl;
+		return false;
+	}
+
+	// the images acquired so far must go back to their swapchains on failure, or the next lock could not acquire one
+	if (!acquireImage(swapchain, textureIndex))
+		return false;
+	if (depthLayers && !acquireImage(platformRenderer->getDepthSwapchain(eye), depthIndex))
+	{
+		releaseImage(swapchain);
+		return false;
+	}
+	setProjectionView(eye, swapchain, 0);
 
 	// prepares platform-specific render
-	if (!platformRenderer->beginEyeFrame(eye, textureIndex))
+	if (!platformRenderer->beginEyeFrame(eye, textureIndex, depthLayers ? (int)depthIndex : -1))
 	{
 		std::cout << "[OvXR | ERROR] Plafform-specific render setup failed!" << std::endl;
+		if (depthLayers)
+			releaseImage(platformRenderer->getDepthSwapchain(eye));
+		releaseImage(swapchain);
 		return false;
 	}
 	return true;
@@ -502,19 +693,215 @@ bool OvXR::unlockSwapchain(OvEye eye)
 		return false;
 	}
 
-	XrSwapchain swapchain = platformRenderer->getSwapchain(eye);
+	// ... and finally release the swapchain images
+	if (depthLayers && !releaseImage(platformRenderer->getDepthSwapchain(eye)))
+		return false;
+	return releaseImage(platformRenderer->getSwapchain(eye));
+}
 
-	XrSwapchainImageReleaseInfo swapchainImageReleaseInfo;
-	swapchainImageReleaseInfo.type = XR_TYPE_SWAPCHAIN_IMAGE_RELEASE_INFO;
-	swapchainImageReleaseInfo.next = nullptr;
-	// ... and finally release the swapchain image
-	XrResult res = xrReleaseSwapchainImage(swapchain, &swapchainImageReleaseInfo);
-	if (!XR_SUCCEEDED(res))
+bool OvXR::lockStereoSwapchain()
+{
+	if (!stereoArray)
 	{
-		std::cout << "[OvXR | ERROR] Failed to release swapchain image!" << std::endl;
+		std::cout << "[OvXR | ERROR] Stereo array not enabled!" << std::endl;
+		return false;
+	}
+
+	// a single swapchain, one layer per eye
+	XrSwapchain swapchain = platformRenderer->getSwapchain(EYE_LEFT);
+	if (swapchain == XR_NULL_HANDLE)
+	{
+		std::cout << "[OvXR | ERROR] PlafformRenderer returned an invalid XrSwapchain!" << std::endl;
+		return false;
+	}
+
+	// released again on failure, as in lockSwapchain()
+	if (!acquireImage(swapchain, textureIndex))
+		return false;
+	if (depthLayers && !acquireImage(platformRenderer->getDepthSwapchain(EYE_LEFT), depthIndex))
+	{
+		releaseImage(swapchain);
+		return false;
+	}
+	for (int i = 0; i < EYE_LAST; i++)
+		setProjectionView((OvEye)i, swapchain, i);
+
+	// prepares platform-specific render, all the layers at once
+	if (!platformRenderer->beginEyeFrame(EYE_LEFT, textureIndex, depthLayers ? (int)depthIndex : -1))
+	{
+		std::cout << "[OvXR | ERROR] Plafform-specific render setup failed!" << std::endl;
+		if (depthLayers)
+			releaseImage(platformRenderer->getDepthSwapchain(EYE_LEFT));
+		releaseImage(swapchain);
+		return false;
+	}
+	return true;
+}
+
+bool OvXR::unlockStereoSwapchain()
+{
+	// the array swapchain is the left eye's one
+	return unlockSwapchain(EYE_LEFT);
+}
+
+int OvXR::addQuadLayer(unsigned int width, unsigned int height, const XrPosef &pose, const XrExtent2Df &size, bool headLocked, int order)
+{
+	if (xrSession == XR_NULL_HANDLE)
+	{
+		std::cout << "[OvXR | ERROR] Quad layers need a session!" << std::endl;
+		return -1;
+	}
+
+	// the projection layer counts too
+	XrSystemProperties systemProperties;
+	systemProperties.type = XR_TYPE_SYSTEM_PROPERTIES;
+	systemProperties.next = NULL;
+	systemProperties.graphicsProperties = { 0 };
+	systemProperties.trackingProperties = { 0 };
+	if (!XR_SUCCEEDED(xrGetSystemProperties(xrInstance, xrSys, &systemProperties)))
+	{
+		std::cout << "[OvXR | ERROR] xrGetSystemProperties failed!" << std::endl;
+		return -1;
+	}
+	if (quadLayers.size() + 1 >= systemProperties.graphicsProperties.maxLayerCount)
+	{
+		std::cout << "[OvXR | ERROR] Too many composition layers (" << systemProperties.graphicsProperties.maxLayerCount << " at most)!" << std::endl;
+		return -1;
+	}
+
+	// head-locked layers are placed in the view space
+	if (headLocked && xrViewSpace == XR_NULL_HANDLE)
+	{
+		XrReferenceSpaceCreateInfo viewSpaceCreateInfo;
+		viewSpaceCreateInfo.type = XR_TYPE_REFERENCE_SPACE_CREATE_INFO;
+		viewSpaceCreateInfo.next = NULL;
+		viewSpaceCreateInfo.referenceSpaceType = XR_REFERENCE_SPACE_TYPE_VIEW;
+		viewSpaceCreateInfo.poseInReferenceSpace.orientation = { 0.f, 0.f, 0.f, 1.f };
+		viewSpaceCreateInfo.poseInReferenceSpace.position = { 0.f, 0.f, 0.f };
+		if (!XR_SUCCEEDED(xrCreateReferenceSpace(xrSession, &viewSpaceCreateInfo, &xrViewSpace)))
+		{
+			std::cout << "[OvXR | ERROR] View space creation failed!" << std::endl;
+			return -1;
+		}
+	}
+
+	// swapchain and framebuffers, delegate this to platform specific render
+	QuadLayer quadLayer;
+	quadLayer.swapchain = platformRenderer->initQuadSwapchain(xrSession, width, height);
+	if (quadLayer.swapchain < 0)
+	{
+		std::cout << "[OvXR | ERROR] PlafformRenderer could not create a quad swapchain!" << std::endl;
+		return -1;
+	}
+	quadLayer.order = order;
+	quadLayer.visible = true;
+	quadLayer.headLocked = headLocked;
+	quadLayer.rendered = false;
+	quadLayer.textureIndex = 0;
+
+	// the whole image, blended with its straight alpha, seen by both eyes
+	quadLayer.layer.type = XR_TYPE_COMPOSITION_LAYER_QUAD;
+	quadLayer.layer.next = nullptr;
+	quadLayer.layer.layerFlags = XR_COMPOSITION_LAYER_BLEND_TEXTURE_SOURCE_ALPHA_BIT | XR_COMPOSITION_LAYER_UNPREMULTIPLIED_ALPHA_BIT;
+	quadLayer.layer.space = headLocked ? xrViewSpace : xrSpace;
+	quadLayer.layer.eyeVisibility = XR_EYE_VISIBILITY_BOTH;
+	quadLayer.layer.subImage.swapchain = platformRenderer->getQuadSwapchain(quadLayer.swapchain);
+	quadLayer.layer.subImage.imageArrayIndex = 0;
+	quadLayer.layer.subImage.imageRect.offset.x = 0;
+	quadLayer.layer.subImage.imageRect.offset.y = 0;
+	quadLayer.layer.subImage.imageRect.extent.width = width;
+	quadLayer.layer.subImage.imageRect.extent.height = height;
+	quadLayer.layer.pose = pose;
+	quadLayer.layer.size = size;
+	quadLayers.push_back(quadLayer);
+
+	int quad = (int)quadLayers.size() - 1;
+	quadOrder.push_back(quad);
+	setQuadLayerOrder(quad, order);
+	// the layer list is refilled every frame, never reallocated
+	frameLayers.reserve(1 + quadLayers.size());
+
+	std::cout << "[OvXR | INFO] Quad layer " << quad << ": " << width << "x" << height << (headLocked ? ", head-locked" : "") << std::endl;
+	return quad;
+}
+
+bool OvXR::lockQuadLayer(int quad)
+{
+	if (!isQuadLayer(quad))
+		return false;
+
+	QuadLayer &quadLayer = quadLayers[quad];
+	if (!acquireImage(quadLayer.layer.subImage.swapchain, quadLayer.textureIndex))
+		return false;
+
+	// prepares platform-specific render
+	// the image must go back to the swapchain, or the next lock could not acquire one
+	if (!platformRenderer->beginQuadFrame(quadLayer.swapchain, quadLayer.textureIndex))
+	{
+		std::cout << "[OvXR | ERROR] Plafform-specific render setup failed!" << std::endl;
+		releaseImage(quadLayer.layer.subImage.swapchain);
 		return false;
 	}
+	return true;
+}
 
+bool OvXR::unlockQuadLayer(int quad)
+{
+	if (!isQuadLayer(quad))
+		return false;
+
+	QuadLayer &quadLayer = quadLayers[quad];
+	if (!platformRenderer->endQuadFrame(quadLayer.swapchain, quadLayer.textureIndex))
+	{
+		std::cout << "[OvXR | ERROR] Plafform-specific render finalization failed!" << std::endl;
+		return false;
+	}
+	if (!releaseImage(quadLayer.layer.subImage.swapchain))
+		return false;
+	quadLayer.rendered = true;
+	return true;
+}
+
+void OvXR::setQuadLayerPose(int quad, const XrPosef &pose)
+{
+	if (isQuadLayer(quad))
+		quadLayers[quad].layer.pose = pose;
+}
+
+void OvXR::setQuadLayerSize(int quad, const XrExtent2Df &size)
+{
+	if (isQuadLayer(quad))
+		quadLayers[quad].layer.size = size;
+}
+
+void OvXR::setQuadLayerVisible(int quad, bool visible)
+{
+	if (isQuadLayer(quad))
+		quadLayers[quad].visible = visible;
+}
+
+void OvXR::setQuadLayerOrder(int quad, int order)
+{
+	if (!isQuadLayer(quad))
+		return;
+
+	// sorted once here, endFrame() only walks the list
+	quadLayers[quad].order = order;
+	sortQuadLayers(quadLayers, quadOrder);
+}
+
+unsigned int OvXR::getNrOfQuadLayers()
+{
+	return (unsigned int)quadLayers.size();
+}
+
+bool OvXR::isQuadLayer(int quad)
+{
+	if (quad < 0 || quad >= (int)quadLayers.size())
+	{
+		std::cout << "[OvXR | ERROR] Invalid quad layer " << quad << "!" << std::endl;
+		return false;
+	}
 	return true;
 }
 
@@ -530,6 +917,14 @@ bool OvXR::free()
 		platformRenderer = nullptr;
 	}
 
+	// quad swapchains are gone with the platform resources
+	quadLayers.clear();
+	quadOrder.clear();
+	if (xrViewSpace != XR_NULL_HANDLE) {
+		xrDestroySpace(xrViewSpace);
+		xrViewSpace = XR_NULL_HANDLE;
+	}
+
 	// destroy space
 	if (xrSpace != XR_NULL_HANDLE) {
 		xrDestroySpace(xrSpace);
@@ -30,6 +30,7 @@
 #include <string>
 #include <sstream>
 #include <functional>
+#include <algorithm>
 
 #include "PlatformRenderer.h"
 #include <openxr/openxr.h>
@@ -79,6 +80,79 @@ public:
 	bool init();
 
 
+	/**
+	 * @brief Requests a single swapchain with one array layer per eye, rendered in one pass
+	 * with lockStereoSwapchain()/unlockStereoSwapchain(). Must be called before init().
+	 * @param multiview true to attach the layers as OVR_multiview views, false as a layered framebuffer
+	 * @return true if supported by the platform renderer
+	 */
+	bool enableStereoArray(bool multiview);
+
+
+	/**
+	 * @return true when both eyes share an array swapchain
+	 */
+	bool isStereoArray();
+
+
+	/**
+	 * @return true when the depth of the eyes is submitted with their color (XR_KHR_composition_layer_depth),
+	 * known after init()
+	 */
+	bool hasDepthLayers();
+
+
+	/**
+	 * @brief Sets the near and far planes of the projection the depth was rendered with, submitted with the depth layers
+	 * @param nearZ near plane distance
+	 * @param farZ far plane distance
+	 */
+	void setDepthRange(float nearZ, float farZ);
+
+
+	/**
+	 * @brief Sets the largest render scale, relative to the recommended resolution: the swapchains are created that
+	 * large, within the runtime's maximum. Must be called before init().
+	 * @param scale the largest scale, 1 by default
+	 * @return TF
+	 */
+	bool setMaxRenderScale(float scale);
+
+
+	/**
+	 * @brief Sets the render scale of the next frames: the eyes are rendered into the lower left part of the
+	 * swapchain images, getRenderWidth() x getRenderHeight() pixels, and only that part is submitted.
+	 * @param scale the scale relative to the recommended resolution, clamped to the largest one
+	 */
+	void setRenderScale(float scale);
+
+
+	/**
+	 * @return the current render scale
+	 */
+	float getRenderScale();
+
+
+	/**
+	 * @return the size of the eyes' viewport at the current render scale, in pixels
+	 */
+	unsigned int getRenderWidth();
+	unsigned int getRenderHeight();
+
+
+	/**
+	 * @return the size of the swapchain images, in pixels
+	 */
+	unsigned int getSwapchainWidth();
+	unsigned int getSwapchainHeight();
+
+
+	/**
+	 * @return the time between two displayed frames predicted by the last xrWaitFrame, in nanoseconds, 0 before the first frame
+	 */
+	XrDuration getPredictedDisplayPeriod();
+
+
 	/**
 	 * @brief Sets reference space of application
 	 * @param pose: reference pose
@@ -103,6 +177,23 @@ public:
 	bool beginFrame();
 
 
+	/**
+	 * @brief Waits until the runtime is ready for a new frame (xrWaitFrame). Can be called from a frame
+	 * pacing thread other than the rendering one, each call followed by a beginFrame(frameState).
+	 * @param frameState filled with the predicted display time of the frame
+	 * @return TF
+	 */
+	bool waitFrame(XrFrameState &frameState);
+
+
+	/**
+	 * @brief Begins a frame already waited with waitFrame(): polls events, updates view locations.
+	 * @param frameState the frame state returned by waitFrame()
+	 * @return TF
+	 */
+	bool beginFrame(const XrFrameState &frameState);
+
+
 	/**
 	 * @brief Acquire the image from the swapchain before graphics API strats rendering.
 	 * @param eye left or right eye
@@ -119,6 +210,127 @@ public:
 	bool unlockSwapchain(OvEye eye);
 
 
+	/**
+	 * @brief Acquire the array swapchain image, both eyes at once (see enableStereoArray()).
+	 * @return TF
+	 */
+	bool lockStereoSwapchain();
+
+
+	/**
+	 * @brief Releases the array swapchain image after that the application is done rendering both eyes.
+	 * @return TF
+	 */
+	bool unlockStereoSwapchain();
+
+
+	/**
+	 * @brief Adds a quad layer: a panel with a swapchain of its own, composited by the runtime every frame with the
+	 * last image rendered into it, so that static or slowly changing content (menus, HUDs) is only rendered when it
+	 * changes, with lockQuadLayer()/unlockQuadLayer(). Submitted once rendered. Must be called after init().
+	 * @param width image width in pixels
+	 * @param height image height in pixels
+	 * @param pose center of the panel, facing +Z, in the reference space (in the view space when headLocked)
+	 * @param size size of the panel in meters
+	 * @param headLocked true to keep the panel in front of the head, false to keep it in the world
+	 * @param order composition order: negative behind the projection layer, otherwise in front of it, higher on top
+	 * @return the index of the quad layer, -1 on failure
+	 */
+	int addQuadLayer(unsigned int width, unsigned int height, const XrPosef &pose, const XrExtent2Df &size, bool headLocked = false, int order = 1);
+
+
+	/**
+	 * @brief Acquires the image of a quad layer and binds it for rendering, color only, with straight alpha.
+	 * @param quad index of the quad layer
+	 * @return TF
+	 */
+	bool lockQuadLayer(int quad);
+
+
+	/**
+	 * @brief Releases the image of a quad layer: it is shown from the next endFrame() on, until the next one.
+	 * @param quad index of the quad layer
+	 * @return TF
+	 */
+	bool unlockQuadLayer(int quad);
+
+
+	/**
+	 * @brief Changes the placement of a quad layer, effective from the next endFrame(), without rendering it again.
+	 * @param quad index of the quad layer
+	 */
+	void setQuadLayerPose(int quad, const XrPosef &pose);
+	void setQuadLayerSize(int quad, const XrExtent2Df &size);
+	void setQuadLayerVisible(int quad, bool visible);
+	void setQuadLayerOrder(int quad, int order);
+
+
+	/**
+	 * @return the number of quad layers
+	 */
+	unsigned int getNrOfQuadLayers();
+
+
+	/**
+	 * Quad layer, submitted with its own swapchain
+	 */
+	struct QuadLayer
+	{
+		XrCompositionLayerQuad layer;
+		int swapchain;				// quad swapchain of the platform renderer
+		int order;
+		bool visible;
+		bool headLocked;
+		bool rendered;				// an image was released, there is something to show
+		unsigned int textureIndex;
+	};
+
+
+	/**
+	 * @brief Sorts the indices of the quad layers by order, equal orders keep their sequence.
+	 * @param quadLayers the quad layers
+	 * @param quadOrder their indices, sorted in place
+	 */
+	static void sortQuadLayers(const std::vector<QuadLayer> &quadLayers, std::vector<unsigned int> &quadOrder)
+	{
+		std::stable_sort(quadOrder.begin(), quadOrder.end(), [&quadLayers](unsigned int a, unsigned int b)
+		{
+			return quadLayers[a].order < quadLayers[b].order;
+		});
+	}
+
+
+	/**
+	 * @brief Lists the layers of a frame back to front: the quad layers in their order, the projection layer at
+	 * order 0, behind the quads of order 0. Hidden quads and quads never released are skipped.
+	 * @param quadLayers the quad layers
+	 * @param quadOrder their indices, see sortQuadLayers()
+	 * @param projectionLayer the projection layer
+	 * @param frameLayers the layers to submit, replaced
+	 */
+	static void composeLayers(std::vector<QuadLayer> &quadLayers, const std::vector<unsigned int> &quadOrder,
+		XrCompositionLayerProjection &projectionLayer, std::vector<XrCompositionLayerBaseHeader*> &frameLayers)
+	{
+		frameLayers.clear();
+		bool projection = false;
+		for (unsigned int quad : quadOrder)
+		{
+			QuadLayer &quadLayer = quadLayers[quad];
+			if (!projection && quadLayer.order >= 0)
+			{
+				frameLayers.push_back(reinterpret_cast<XrCompositionLayerBaseHeader*>(&projectionLayer));
+				projection = true;
+			}
+			// nothing to show before the first image is released
+			if (!quadLayer.visible || !quadLayer.rendered)
+				continue;
+			frameLayers.push_back(reinterpret_cast<XrCompositionLayerBaseHeader*>(&quadLayer.layer));
+		}
+		if (!projection)
+			frameLayers.push_back(reinterpret_cast<XrCompositionLayerBaseHeader*>(&projectionLayer));
+	}
+
+
 	/**
 	 * @brief Performs frame submission to the HMD
 	 * @return TF
@@ -217,8 +429,51 @@ public:
 	void setPlatformRenderer(PlatformRenderer * ext);
 
 private:
+	/**
+	 * @brief Acquires the next image of a swapchain and waits for it to be writable.
+	 * @param swapchain the swapchain
+	 * @return TF
+	 */
+	bool acquireImage(XrSwapchain swapchain, unsigned int &index);
+
+
+	/**
+	 * @brief Releases the image of a swapchain once rendered.
+	 * @param swapchain the swapchain
+	 * @return TF
+	 */
+	bool releaseImage(XrSwapchain swapchain);
+
+
+	/**
+	 * @brief Fills the projection layer view of an eye.
+	 * @param eye left or right eye
+	 * @param swapchain the swapchain the eye is rendered into
+	 * @param arrayIndex the swapchain layer of the eye (of the depth swapchain too)
+	 */
+	void setProjectionView(OvEye eye, XrSwapchain swapchain, unsigned int arrayIndex);
+
+
+	/**
+	 * @brief Checks the index of a quad layer.
+	 * @param quad index of the quad layer
+	 * @return TF
+	 */
+	bool isQuadLayer(int quad);
+
 	// Session running flag
 	bool sessionRunning;
+	// Single swapchain with one layer per eye
+	bool stereoArray;
+	// Depth swapchains submitted with the color ones, and the depth range
+	bool depthLayers;
+	float depthNear;
+	float depthFar;
+	// Render scale, its largest value and the size of the swapchains it fits in
+	float renderScale;
+	float maxRenderScale;
+	unsigned int swapchainWidth;
+	unsigned int swapchainHeight;
 	// Application name
     std::string appName;
 	// Platform-specific rendering implementation reference and graphics binding structure used during session creation
@@ -232,6 +487,8 @@ private:
 
 	// Reference Space
     XrSpace xrSpace;
+	// View space of the head-locked quad layers, created with the first one
+	XrSpace xrViewSpace;
 
 	// Views containing view pose view pose and projection state
     std::vector<XrView>views;
@@ -242,10 +499,19 @@ private:
     
 	// Frame submission pack
 	std::vector<XrCompositionLayerProjectionView> projectionViews;
+	// Depth of each projection view, chained to it when depthLayers is set
+	std::vector<XrCompositionLayerDepthInfoKHR> depthInfos;
 	// Planar projected images rendered from the eye point of each eye using a standard perspective projection.
 	XrCompositionLayerProjection projectionLayer;
+	// Quad layers, and their indices in composition order (stable for equal orders)
+	std::vector<QuadLayer> quadLayers;
+	std::vector<unsigned int> quadOrder;
+	// Layers submitted by endFrame()
+	std::vector<XrCompositionLayerBaseHeader*> frameLayers;
     XrTime xrPredicedDisplayTime;
+    XrDuration xrPredictedDisplayPeriod;
 	unsigned int textureIndex;
+	unsigned int depthIndex;
 	
 	// Collection of XrEvents callbacks
     std::map<XrStructureType, std::function<void(XrEventDataBuffer)>> eventCallbacks;
@@ -29,7 +29,9 @@
  */
 Shader::Shader() : type(TYPE_UNDEFINED),
 glId(0)
-{}
+{
+	setKind(KIND_SHADER);
+}
 
 
 /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -43,6 +45,7 @@ Shader::~Shader()
 		{
 		case TYPE_VERTEX:
 		case TYPE_FRAGMENT:
+		case TYPE_COMPUTE:
 			glDeleteShader(glId);
 			break;
 
@@ -111,6 +114,11 @@ bool Shader::loadFromMemory(int type, const char *data)
 		glKind = GL_FRAGMENT_SHADER;
 		break;
 
+		/////////////////////
+	case TYPE_COMPUTE: //
+		glKind = GL_COMPUTE_SHADER;
+		break;
+
 		///////////
 	default: //
 		std::cout << "[ERROR] Invalid kind" << std::endl;
@@ -123,6 +131,7 @@ bool Shader::loadFromMemory(int type, const char *data)
 		{
 		case TYPE_VERTEX:
 		case TYPE_FRAGMENT:
+		case TYPE_COMPUTE:
 			glDeleteShader(glId);
 			break;
 
@@ -35,6 +35,7 @@ public: //
 		TYPE_VERTEX,
 		TYPE_FRAGMENT,
 		TYPE_PROGRAM,
+		TYPE_COMPUTE,
 		TYPE_LAST
 	};
 
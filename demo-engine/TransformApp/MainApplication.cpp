@@ -87,6 +87,16 @@ void animation()
 	}
 }
 
+/**
+ * Update callback, called by the engine's simulation thread at a fixed rate
+ * @param dt seconds since the previous update
+ */
+void update(double dt)
+{
+    if (animate)
+        animation();
+}
+
 /**
  * Display callback  this is the main rendering routine
  */
@@ -111,8 +121,12 @@ void reshapeCallback(int width, int height)
     engine->setViewport(0, 0, width, height);
     sizeX = width;
     sizeY = height;
-    c->setAspect((float)width / (float)height);
-    c1->setAspect((float)width / (float)height);
+    //the cameras belong to the simulation thread, their projection is captured with the scene
+    float aspect = (float)width / (float)height;
+    engine->post([aspect]() {
+        c->setAspect(aspect);
+        c1->setAspect(aspect);
+    });
 }
 
 
@@ -123,30 +137,16 @@ void updateCamera()
 }
 
 /**
- * Keyboard callback  this callback is invoked each time a standard keyboard key is pressed.
+ * Scene part of the keyboard callback: camera moves, lights and the transformation.
+ * Runs on the simulation thread, that owns the scene (see keyboardCallback()).
  * @param  key the button that was pressed
- * @param mouseX mouse X coordinate
- * @param mouseY mouse Y coordinate
  */
-void keyboardCallback(unsigned char key, int mouseX, int mouseY)
+void sceneKeyboard(unsigned char key)
 {
     float tValue = 1.f;
 
     switch (key)
     {
-    //camera switch
-    case 'c':
-        if (cameraSwitch)
-        {
-            engine->setActiveCamera(c);
-            cameraSwitch = 0;
-        }
-        else
-        {
-            engine->setActiveCamera(c1);
-            cameraSwitch = 1;
-        }
-        break;
     //camera up
     case 'q':
         translationCamera *= glm::translate(glm::mat4(1.0f), glm::vec3(glm::vec4(0.0f, tValue, 0.0f, 1.0f) * glm::inverse(rotationCamera)));
@@ -177,10 +177,6 @@ void keyboardCallback(unsigned char key, int mouseX, int mouseY)
         translationCamera *= glm::translate(glm::mat4(1.0f), glm::vec3(glm::vec4(tValue, 0.0f, 0.0f, 1.0f) * glm::inverse(rotationCamera)));
         updateCamera();
         break;
-    //wireframe
-    case 'y':
-        engine->wireframeSwitch();
-        break;
 	case 'l':
 		dynamicLight->toggle();
 		break;
@@ -201,13 +197,68 @@ void keyboardCallback(unsigned char key, int mouseX, int mouseY)
 }
 
 /**
- * Special callback is invoked each time a special keyboard key is pressed. This callback is used to move
- * the camera (if movable). FreeGlut special key redefinition is necessary (e.g #define GLUT_KEY_LEFT 0x0064)
- * @param  key an integer representing a special key
+ * Keyboard callback  this callback is invoked each time a standard keyboard key is pressed.
+ * Engine settings are changed immediately, changes to the scene are posted to the simulation thread.
+ * @param  key the button that was pressed
  * @param mouseX mouse X coordinate
  * @param mouseY mouse Y coordinate
  */
-void specialCallback(int key, int mouseX, int mouseY)
+void keyboardCallback(unsigned char key, int mouseX, int mouseY)
+{
+    switch (key)
+    {
+    //camera switch
+    case 'c':
+        if (cameraSwitch)
+        {
+            engine->setActiveCamera(c);
+            cameraSwitch = 0;
+        }
+        else
+        {
+            engine->setActiveCamera(c1);
+            cameraSwitch = 1;
+        }
+        break;
+    //wireframe
+    case 'y':
+        engine->wireframeSwitch();
+        break;
+	//shader variants profiling
+	case 'p':
+		engine->profileShaders();
+		break;
+	//direct / multi-draw-indirect submission
+	case 'i':
+		engine->indirectSwitch();
+		break;
+	//gpu occlusion culling of the indirect path
+	case 'g':
+		engine->gpuCullingSwitch();
+		break;
+	//software occlusion culling
+	case 'o':
+		engine->occlusionSwitch();
+		break;
+	//depth ordering: unsorted, front to back, depth pre-pass
+	case 'z':
+		engine->depthModeSwitch();
+		break;
+	//overdraw benchmark of the depth modes
+	case 'b':
+		engine->benchmarkOverdraw();
+		break;
+    default:
+        engine->post([key]() { sceneKeyboard(key); });
+        break;
+    }
+}
+
+/**
+ * Rotates the camera, on the simulation thread (see specialCallback())
+ * @param  key an integer representing a special key
+ */
+void sceneSpecial(int key)
 {
     float rValue = 5.f;
 
@@ -234,6 +285,18 @@ void specialCallback(int key, int mouseX, int mouseY)
     updateCamera();
 }
 
+/**
+ * Special callback is invoked each time a special keyboard key is pressed. This callback is used to move
+ * the camera (if movable). FreeGlut special key redefinition is necessary (e.g #define GLUT_KEY_LEFT 0x0064)
+ * @param  key an integer representing a special key
+ * @param mouseX mouse X coordinate
+ * @param mouseY mouse Y coordinate
+ */
+void specialCallback(int key, int mouseX, int mouseY)
+{
+    engine->post([key]() { sceneSpecial(key); });
+}
+
 
 /**
  * Mouse wheel callback that implement a zoom function
@@ -268,6 +331,10 @@ void mouseMoved(int x, int y)
 int main(int argc, char *argv[])
 {
 	engine->init(argc, argv, "Transformer");
+	engine->setSinglePassStereo(true);
+	engine->setPipelinedFrames(true);
+	engine->setDynamicResolution(true, 0.6f, 1.0f);
+	//engine->setFoveatedRendering(true);	// Instead of single-pass stereo, the two do not combine
     engine->initOpenXR();
 /*
     XrQuaternionf quat;
@@ -292,13 +359,13 @@ int main(int argc, char *argv[])
 
 
     //Camera
-    c = new Camera();
+    c = engine->createCamera();
     c->setAspect(1.0);
     c->setFov(glm::radians(45.0f));
     c->setNearPlane(1.0);
     c->setFarPlane(1000.0);
     c->setPosMatrix(translationCamera);
-    c1 = new Camera();
+    c1 = engine->createCamera();
     c1->setAspect(1.0);
     c1->setFov(glm::radians(120.0f));
     c1->setNearPlane(1.0);
@@ -306,7 +373,7 @@ int main(int argc, char *argv[])
     c1->setPosMatrix(translationCamera);
 
 	//light
-	dynamicLight = new Light();
+	dynamicLight = engine->createLight();
 	dynamicLight->setPosMatrix(glm::mat4(1));
 	dynamicLight->setParent(c);
 	c->setParent(n);
@@ -319,8 +386,9 @@ int main(int argc, char *argv[])
     engine->mouseWheel(mouseWheel);
     engine->mouseMoved(mouseMoved);
 
-    //render
+    //render, while the scene is updated on its own thread
     engine->setActiveCamera(c);
+    engine->startSimulation(n, update);
     engine->startEventLoop();
 
 	return 0;
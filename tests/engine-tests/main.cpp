@@ -0,0 +1,2269 @@
+/**
+ * @file		main.cpp
+ * @brief	CPU-only tests of the SupSI-GL engine modules, no OpenGL context required
+ */
+
+
+ //////////////
+ // #INCLUDE //
+ //////////////
+
+// C/C++:
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <thread>
+
+// Engine:
+#include "Engine.h"
+
+// OpenXR (quad layer order only, no runtime needed):
+#include "oxr.h"
+
+// Tests:
+#include "stubs.h"
+
+#define  ASSERT_WITH_MESSAGE(res, msg)				\
+	if (!(res) ) {									\
+		std::cerr << msg << std::endl;				\
+		std::cerr << "TEST FAILED" << std::endl;	\
+		abort();									\
+    }
+
+
+// Unit quad in the XY plane, facing +Z (counter-clockwise):
+const float quadPositions[] = { -1.0f, -1.0f, 0.0f,   1.0f, -1.0f, 0.0f,   1.0f, 1.0f, 0.0f,   -1.0f, 1.0f, 0.0f };
+const unsigned int quadIndices[] = { 0, 1, 2,   0, 2, 3 };
+const unsigned int quadBackIndices[] = { 0, 2, 1,   0, 3, 2 };
+const float quadRadius = 1.5f;
+
+const glm::vec3 boxMin(-0.5f);
+const glm::vec3 boxMax(0.5f);
+
+// Camera at the origin looking down -Z, 2:1 like the depth buffer:
+glm::mat4 cameraViewProj(glm::vec3 eye = glm::vec3(0.0f))
+{
+	return glm::perspective(glm::radians(60.0f), 2.0f, 0.1f, 100.0f) * glm::lookAt(eye, eye + glm::vec3(0.0f, 0.0f, -1.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+}
+
+// Wall of half size "size" at distance "distance", centered on "x":
+glm::mat4 wall(float x, float distance, float size)
+{
+	return glm::scale(glm::translate(glm::mat4(1.0f), glm::vec3(x, 0.0f, -distance)), glm::vec3(size));
+}
+
+glm::mat4 box(float x, float distance)
+{
+	return glm::translate(glm::mat4(1.0f), glm::vec3(x, 0.0f, -distance));
+}
+
+// Deterministic random numbers in [0, 1):
+unsigned int seed = 12345;
+float rnd()
+{
+	seed = seed * 1664525u + 1013904223u;
+	return (seed >> 8) / 16777216.0f;
+}
+
+// Bumpy grid of "n" * "n" quads facing +Z:
+void buildGrid(unsigned int n, vector<float> &positions, vector<unsigned int> &indices)
+{
+	positions.clear();
+	indices.clear();
+	for (unsigned int y = 0; y <= n; y++)
+		for (unsigned int x = 0; x <= n; x++)
+		{
+			positions.push_back(2.0f * x / n - 1.0f);
+			positions.push_back(2.0f * y / n - 1.0f);
+			positions.push_back(0.2f * rnd() - 0.1f);
+		}
+	for (unsigned int y = 0; y < n; y++)
+		for (unsigned int x = 0; x < n; x++)
+		{
+			unsigned int v = x + y * (n + 1);
+			unsigned int quad[] = { v, v + 1, v + n + 2,   v, v + n + 2, v + n + 1 };
+			indices.insert(indices.end(), quad, quad + 6);
+		}
+}
+
+// Random occluders in front of the camera:
+void addGrids(Occlusion &occlusion, unsigned int count, const vector<float> &positions, const vector<unsigned int> &indices, vector<glm::mat4> &models)
+{
+	if (models.size() < count)
+	{
+		models.clear();
+		for (unsigned int c = 0; c < count; c++)
+		{
+			float distance = 5.0f + 30.0f * rnd();
+			glm::mat4 m = wall((rnd() - 0.5f) * distance * 2.0f, distance, 0.5f + 3.0f * rnd());
+			models.push_back(glm::rotate(m, rnd() - 0.5f, glm::vec3(0.0f, 1.0f, 0.0f)));
+		}
+	}
+	for (unsigned int c = 0; c < count; c++)
+		occlusion.addOccluder(models[c], quadRadius, positions.data(), (unsigned int)positions.size() / 3, indices.data(), (unsigned int)indices.size() / 3);
+}
+
+
+void testOcclusionWall()
+{
+	glm::mat4 viewProj = cameraViewProj();
+	Occlusion occlusion;
+
+	// Wall covering the whole screen at distance 10:
+	occlusion.begin(&viewProj, 1);
+	occlusion.addOccluder(wall(0.0f, 10.0f, 20.0f), quadRadius, quadPositions, 4, quadIndices, 2);
+	occlusion.render();
+	ASSERT_WITH_MESSAGE(occlusion.getOccluders() == 1, "the wall must be used as occluder")
+	ASSERT_WITH_MESSAGE(occlusion.getTriangles() == 2, "both wall triangles must be rasterized")
+
+	const float *depth = occlusion.getDepth(0);
+	for (unsigned int c = 0; c < Occlusion::TILES_X * Occlusion::TILES_Y; c++)
+		ASSERT_WITH_MESSAGE(fabsf(depth[c] - 10.0f) < 1e-3f, "every tile must be covered by the wall")
+
+	ASSERT_WITH_MESSAGE(!occlusion.test(0, box(0.0f, 20.0f), boxMin, boxMax), "a box behind the wall must be hidden")
+	ASSERT_WITH_MESSAGE(!occlusion.test(0, box(3.0f, 11.0f), boxMin, boxMax), "a box just behind the wall must be hidden")
+	ASSERT_WITH_MESSAGE(occlusion.test(0, box(0.0f, 5.0f), boxMin, boxMax), "a box in front of the wall must be visible")
+	ASSERT_WITH_MESSAGE(occlusion.test(0, box(0.0f, 10.0f), boxMin, boxMax), "a box crossing the wall must be visible")
+	ASSERT_WITH_MESSAGE(occlusion.getTested() == 4 && occlusion.getOccluded() == 2, "wrong test counters")
+
+	// Wall covering the left half of the screen only:
+	occlusion.begin(&viewProj, 1);
+	occlusion.addOccluder(wall(-20.0f, 10.0f, 20.0f), quadRadius, quadPositions, 4, quadIndices, 2);
+	occlusion.render();
+	ASSERT_WITH_MESSAGE(!occlusion.test(0, box(-8.0f, 20.0f), boxMin, boxMax), "a box behind the half wall must be hidden")
+	ASSERT_WITH_MESSAGE(occlusion.test(0, box(8.0f, 20.0f), boxMin, boxMax), "a box beside the half wall must be visible")
+	ASSERT_WITH_MESSAGE(occlusion.test(0, box(0.0f, 20.0f), boxMin, boxMax), "a box on the edge of the half wall must be visible")
+
+	// Back faces are not occluders:
+	occlusion.begin(&viewProj, 1);
+	occlusion.addOccluder(wall(0.0f, 10.0f, 20.0f), quadRadius, quadPositions, 4, quadBackIndices, 2);
+	occlusion.render();
+	ASSERT_WITH_MESSAGE(occlusion.getTriangles() == 0, "back faces must not be rasterized")
+	ASSERT_WITH_MESSAGE(occlusion.test(0, box(0.0f, 20.0f), boxMin, boxMax), "a box behind a back-facing wall must be visible")
+
+	// Stereo: the second view has no occluder in front of the box
+	glm::mat4 stereo[2] = { cameraViewProj(), cameraViewProj(glm::vec3(40.0f, 0.0f, 0.0f)) };
+	occlusion.begin(stereo, 2);
+	occlusion.addOccluder(wall(0.0f, 10.0f, 5.0f), quadRadius, quadPositions, 4, quadIndices, 2);
+	occlusion.render();
+	ASSERT_WITH_MESSAGE(!occlusion.test(0, box(0.0f, 20.0f), boxMin, boxMax), "the box must be hidden in the first view")
+	ASSERT_WITH_MESSAGE(occlusion.test(1, box(40.0f, 20.0f), boxMin, boxMax), "the box must be visible in the second view")
+}
+
+void testOcclusionNearPlane()
+{
+	glm::mat4 viewProj = cameraViewProj();
+	Occlusion occlusion;
+
+	// Floor going through the camera: crosses the near plane, not used as occluder
+	glm::mat4 floor = glm::rotate(glm::translate(glm::mat4(1.0f), glm::vec3(0.0f, -1.0f, 0.0f)), glm::radians(-90.0f), glm::vec3(1.0f, 0.0f, 0.0f));
+	occlusion.begin(&viewProj, 1);
+	occlusion.addOccluder(glm::scale(floor, glm::vec3(50.0f)), quadRadius, quadPositions, 4, quadIndices, 2);
+	occlusion.render();
+	ASSERT_WITH_MESSAGE(occlusion.getTriangles() == 0, "triangles crossing the near plane must not be rasterized")
+
+	// Wall between the camera and the near plane (0.1) of the projection: clipped on the GPU, so not an occluder
+	occlusion.begin(&viewProj, 1);
+	occlusion.addOccluder(wall(0.0f, 0.05f, 1.0f), quadRadius, quadPositions, 4, quadIndices, 2);
+	occlusion.render();
+	ASSERT_WITH_MESSAGE(occlusion.getTriangles() == 0, "triangles in front of the near plane must not be rasterized")
+	occlusion.begin(&viewProj, 1);
+	occlusion.addOccluder(wall(0.0f, 0.15f, 1.0f), quadRadius, quadPositions, 4, quadIndices, 2);
+	occlusion.render();
+	ASSERT_WITH_MESSAGE(occlusion.getTriangles() == 2, "triangles just behind the near plane must be rasterized")
+
+	// Boxes around the camera are always visible:
+	occlusion.begin(&viewProj, 1);
+	occlusion.addOccluder(wall(0.0f, 10.0f, 20.0f), quadRadius, quadPositions, 4, quadIndices, 2);
+	occlusion.render();
+	ASSERT_WITH_MESSAGE(occlusion.test(0, box(0.0f, 0.0f), boxMin, boxMax), "a box around the camera must be visible")
+	ASSERT_WITH_MESSAGE(occlusion.test(0, box(0.0f, -20.0f), boxMin, boxMax), "a box behind the camera is left to the frustum culling")
+}
+
+void testOcclusionBudget()
+{
+	glm::mat4 viewProj = cameraViewProj();
+	Occlusion occlusion;
+
+	occlusion.begin(&viewProj, 1);
+	for (unsigned int c = 0; c < Occlusion::MAX_OCCLUDERS + 8; c++)
+		occlusion.addOccluder(wall(0.0f, 50.0f - c, 1.0f), quadRadius, quadPositions, 4, quadIndices, 2);
+	occlusion.render();
+	ASSERT_WITH_MESSAGE(occlusion.getOccluders() == Occlusion::MAX_OCCLUDERS, "too many occluders rasterized")
+
+	// The nearest ones are kept:
+	ASSERT_WITH_MESSAGE(!occlusion.test(0, box(0.0f, 60.0f), glm::vec3(-0.1f), glm::vec3(0.1f)), "the nearest occluders must be rasterized")
+
+	// A flat grid over the triangle budget, covering the screen: only its first rows are rasterized, enough to hide the box
+	vector<float> positions;
+	vector<unsigned int> indices;
+	buildGrid(100, positions, indices);
+	for (unsigned int c = 2; c < positions.size(); c += 3)
+		positions[c] = 0.0f;
+	ASSERT_WITH_MESSAGE(indices.size() / 3 > Occlusion::MAX_TRIANGLES, "the grid must be over the budget")
+	occlusion.begin(&viewProj, 1);
+	occlusion.addOccluder(wall(0.0f, 30.0f, 1.0f), quadRadius, quadPositions, 4, quadIndices, 2);
+	occlusion.addOccluder(wall(0.0f, 10.0f, 20.0f), quadRadius, positions.data(), (unsigned int)positions.size() / 3, indices.data(), (unsigned int)indices.size() / 3);
+	occlusion.render();
+	ASSERT_WITH_MESSAGE(occlusion.getOccluders() == 1, "the largest occluder must use the whole budget")
+	ASSERT_WITH_MESSAGE(occlusion.getTriangles() == Occlusion::MAX_TRIANGLES, "the large occluder must be cut to the budget")
+	ASSERT_WITH_MESSAGE(!occlusion.test(0, box(0.0f, 20.0f), boxMin, boxMax), "a box behind the large occluder must be hidden")
+
+	// Meshes keep a CPU copy of their geometry for the occlusion only under a quarter of the budget:
+	engineStub = EngineStub();
+	for (unsigned int triangles : { Mesh::MAX_OCCLUDER_TRIANGLES, Mesh::MAX_OCCLUDER_TRIANGLES + 1 })
+	{
+		Mesh mesh;
+		mesh.fillData(new float[9](), new float[6](), new float[9](), 3, new unsigned int[3 * triangles](), triangles);
+		ASSERT_WITH_MESSAGE(mesh.isOccluder() == (triangles <= Mesh::MAX_OCCLUDER_TRIANGLES) && mesh.getOccluderTriangles() == (mesh.isOccluder() ? triangles : 0), "wrong occluder geometry copy")
+	}
+}
+
+void testOcclusionDeterminism()
+{
+	glm::mat4 viewProj[2] = { cameraViewProj(glm::vec3(-0.03f, 0.0f, 0.0f)), cameraViewProj(glm::vec3(0.03f, 0.0f, 0.0f)) };
+	vector<float> positions;
+	vector<unsigned int> indices;
+	vector<glm::mat4> models;
+	buildGrid(20, positions, indices);
+
+	JobSystem jobs(4);
+	Occlusion single;
+	Occlusion multi;
+	multi.setJobSystem(&jobs);
+	for (Occlusion *o : { &single, &multi })
+	{
+		o->begin(viewProj, 2);
+		addGrids(*o, Occlusion::MAX_OCCLUDERS + 8, positions, indices, models);
+		o->render();
+	}
+	ASSERT_WITH_MESSAGE(single.getTriangles() == multi.getTriangles(), "the rasterized triangles must not depend on the threads")
+	for (unsigned int v = 0; v < 2; v++)
+		ASSERT_WITH_MESSAGE(memcmp(single.getDepth(v), multi.getDepth(v), Occlusion::TILES_X * Occlusion::TILES_Y * sizeof(float)) == 0,
+			"the depth buffer must not depend on the threads")
+
+	for (unsigned int c = 0; c < 1000; c++)
+	{
+		glm::mat4 m = box((rnd() - 0.5f) * 60.0f, 5.0f + 40.0f * rnd());
+		for (unsigned int v = 0; v < 2; v++)
+			ASSERT_WITH_MESSAGE(single.test(v, m, boxMin, boxMax) == multi.test(v, m, boxMin, boxMax), "the box tests must not depend on the threads")
+	}
+	ASSERT_WITH_MESSAGE(single.getOccluded() > 0, "some boxes must be hidden")
+}
+
+void benchmarkOcclusion()
+{
+	glm::mat4 viewProj[2] = { cameraViewProj(glm::vec3(-0.03f, 0.0f, 0.0f)), cameraViewProj(glm::vec3(0.03f, 0.0f, 0.0f)) };
+	vector<float> positions;
+	vector<unsigned int> indices;
+	vector<glm::mat4> models;
+	buildGrid(40, positions, indices);
+
+	std::cout << "Occlusion benchmark (" << Occlusion::MAX_OCCLUDERS << " occluders of " << indices.size() / 3 << " triangles, budget of " << Occlusion::MAX_TRIANGLES
+		<< ", 2 views):" << std::endl;
+	unsigned int threads[] = { 1, 2, 4, 0 };
+	for (unsigned int t : threads)
+	{
+		JobSystem jobs(t);
+		Occlusion occlusion;
+		occlusion.setJobSystem(&jobs);
+		const int runs = 50;
+		unsigned long long triangles = 0;
+		auto start = std::chrono::high_resolution_clock::now();
+		for (int r = 0; r < runs; r++)
+		{
+			occlusion.begin(viewProj, 2);
+			addGrids(occlusion, Occlusion::MAX_OCCLUDERS, positions, indices, models);
+			occlusion.render();
+			triangles += occlusion.getTriangles();
+		}
+		double ms = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+		std::cout << "   " << occlusion.getThreads() << " threads: " << (unsigned long long)(triangles / ms) << " triangles/ms, "
+			<< ms / runs << " ms per frame" << std::endl;
+	}
+}
+
+
+void testTransformClassify()
+{
+	glm::mat4 rotation = glm::rotate(glm::translate(glm::mat4(1.0f), glm::vec3(1.0f, 2.0f, 3.0f)), 0.7f, glm::normalize(glm::vec3(1.0f, 1.0f, 0.0f)));
+	ASSERT_WITH_MESSAGE(Transform::classify(glm::mat4(1.0f)) == Transform::RIGID, "the identity is rigid")
+	ASSERT_WITH_MESSAGE(Transform::classify(rotation) == Transform::RIGID, "a rotation and translation is rigid")
+	ASSERT_WITH_MESSAGE(Transform::classify(glm::scale(rotation, glm::vec3(2.5f))) == Transform::UNIFORM_SCALE, "a uniform scale must be detected")
+	ASSERT_WITH_MESSAGE(Transform::classify(glm::scale(rotation, glm::vec3(-2.0f))) == Transform::UNIFORM_SCALE, "a mirrored uniform scale must be detected")
+	ASSERT_WITH_MESSAGE(Transform::classify(glm::scale(rotation, glm::vec3(1.0f, 2.0f, 1.0f))) == Transform::GENERAL, "a non-uniform scale is general")
+
+	// Rotating after a non-uniform scale shears the axes:
+	glm::mat4 shear = glm::scale(glm::mat4(1.0f), glm::vec3(1.0f, 3.0f, 1.0f)) * rotation;
+	ASSERT_WITH_MESSAGE(Transform::classify(shear) == Transform::GENERAL, "a shear is general")
+
+	// Accumulated through a hierarchy, rounding must not matter:
+	glm::mat4 world(1.0f);
+	for (int c = 0; c < 50; c++)
+		world = world * glm::rotate(glm::mat4(1.0f), 0.1f * c, glm::normalize(glm::vec3(c, 1.0f, 2.0f)));
+	ASSERT_WITH_MESSAGE(Transform::classify(world) == Transform::RIGID, "a chain of rotations is rigid")
+}
+
+void testTransformCache()
+{
+	Transform t;
+	glm::mat4 world = glm::scale(glm::translate(glm::mat4(1.0f), glm::vec3(0.0f, 1.0f, 0.0f)), glm::vec3(1.0f, 4.0f, 2.0f));
+	Transform::resetInversions();
+	ASSERT_WITH_MESSAGE(t.update(world), "the first update must be a change")
+	ASSERT_WITH_MESSAGE(t.getKind() == Transform::GENERAL, "wrong class")
+	ASSERT_WITH_MESSAGE(!t.update(world), "the same matrix must not be a change")
+	ASSERT_WITH_MESSAGE(Transform::getInversions() == 1, "the normal matrix must be computed once")
+
+	// Normals stay perpendicular to the transformed surface:
+	glm::vec3 tangent = glm::mat3(world) * glm::vec3(1.0f, -1.0f, 0.0f);
+	glm::vec3 normal = t.getNormalMatrix() * glm::vec3(1.0f, 1.0f, 0.0f);
+	ASSERT_WITH_MESSAGE(fabsf(glm::dot(tangent, normal)) < 1e-5f, "the normal matrix must keep normals perpendicular")
+
+	ASSERT_WITH_MESSAGE(t.update(glm::mat4(1.0f)), "a new matrix must be a change")
+	ASSERT_WITH_MESSAGE(t.getKind() == Transform::RIGID && Transform::getInversions() == 1, "rigid matrices need no inverse")
+}
+
+void benchmarkTransforms()
+{
+	// 10k meshes, one in ten non-uniformly scaled:
+	const unsigned int meshes = 10000;
+	vector<glm::mat4> worlds(meshes);
+	for (unsigned int c = 0; c < meshes; c++)
+	{
+		glm::vec3 scale = (c % 10) ? glm::vec3(1.0f + rnd()) : glm::vec3(1.0f + rnd(), 1.0f + rnd(), 1.0f + rnd());
+		worlds[c] = glm::scale(glm::rotate(glm::translate(glm::mat4(1.0f), glm::vec3(rnd(), rnd(), rnd()) * 100.0f), rnd() * 6.0f, glm::vec3(0.0f, 1.0f, 0.0f)), scale);
+	}
+
+	std::cout << "Normal matrix benchmark (" << meshes << " meshes, 2 eyes):" << std::endl;
+	const int runs = 100;
+	float sink = 0.0f;
+
+	// Inverse transpose of every mesh for every eye:
+	auto start = std::chrono::high_resolution_clock::now();
+	for (int r = 0; r < runs; r++)
+		for (int eye = 0; eye < 2; eye++)
+			for (const glm::mat4 &w : worlds)
+				sink += glm::inverseTranspose(w)[0][0];
+	double perEye = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count() / runs;
+
+	// Classified and cached, static scene:
+	vector<Transform> transforms(meshes);
+	for (unsigned int c = 0; c < meshes; c++)
+		transforms[c].update(worlds[c]);
+	start = std::chrono::high_resolution_clock::now();
+	for (int r = 0; r < runs; r++)
+		for (unsigned int c = 0; c < meshes; c++)
+		{
+			transforms[c].update(worlds[c]);
+			sink += transforms[c].getNormalMatrix()[0][0];
+		}
+	double cached = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count() / runs;
+
+	// Classified and cached, every mesh moving:
+	start = std::chrono::high_resolution_clock::now();
+	for (int r = 0; r < runs; r++)
+		for (unsigned int c = 0; c < meshes; c++)
+		{
+			worlds[c][3].x += 1.0f;
+			transforms[c].update(worlds[c]);
+			sink += transforms[c].getNormalMatrix()[0][0];
+		}
+	double moving = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count() / runs;
+
+	std::cout << "   inverse per draw and eye: " << perEye << " ms per frame" << std::endl;
+	std::cout << "   cached, static scene: " << cached << " ms per frame" << std::endl;
+	std::cout << "   cached, all moving: " << moving << " ms per frame" << (sink == 0.0f ? " " : "") << std::endl;
+}
+
+
+void testFrameGraphCulling()
+{
+	FrameGraph graph("culling");
+	vector<unsigned int> executed;
+	auto callback = [&executed](unsigned int pass) { executed.push_back(pass); };
+	unsigned int window = graph.importTexture("window", 64, 64, FrameGraph::FORMAT_RGBA8);
+	unsigned int color = graph.createTexture("color", 64, 64, FrameGraph::FORMAT_RGBA8);
+	unsigned int debug = graph.createTexture("debug", 64, 64, FrameGraph::FORMAT_RGBA8);
+	unsigned int unused = graph.createTexture("unused", 64, 64, FrameGraph::FORMAT_RGBA8);
+
+	unsigned int scene = graph.addPass("scene", callback);
+	graph.write(scene, color);
+	unsigned int overlay = graph.addPass("debug overlay", callback);
+	graph.read(overlay, color);
+	graph.write(overlay, debug);
+	unsigned int orphan = graph.addPass("orphan", callback);
+	graph.read(orphan, debug);
+	graph.write(orphan, unused);
+	unsigned int present = graph.addPass("present", callback);
+	graph.read(present, color);
+	graph.write(present, window);
+
+	ASSERT_WITH_MESSAGE(graph.compile(), "compilation failed")
+	ASSERT_WITH_MESSAGE(!graph.isCulled(scene) && !graph.isCulled(present), "passes leading to an imported target must survive")
+	ASSERT_WITH_MESSAGE(graph.isCulled(overlay) && graph.isCulled(orphan), "passes whose results are never read must be culled")
+	ASSERT_WITH_MESSAGE(graph.getTarget(debug) == FrameGraph::NONE && graph.getTarget(window) == FrameGraph::NONE, "culled and imported resources need no target")
+	ASSERT_WITH_MESSAGE(graph.getNrOfTargets() == 1, "one transient left")
+
+	graph.execute();
+	ASSERT_WITH_MESSAGE(executed.size() == 2 && executed[0] == scene && executed[1] == present, "passes must run in order, without the culled ones")
+
+	// Sampling a transient nobody wrote is an error:
+	FrameGraph broken("broken");
+	unsigned int missing = broken.createTexture("missing", 64, 64, FrameGraph::FORMAT_RGBA8);
+	unsigned int pass = broken.addPass("present", callback);
+	broken.read(pass, missing);
+	broken.write(pass, broken.importTexture("window", 64, 64, FrameGraph::FORMAT_RGBA8));
+	std::cout << "(expected error) ";
+	ASSERT_WITH_MESSAGE(!broken.compile() && !broken.execute(), "a read before write must fail")
+}
+
+void testFrameGraphAliasing()
+{
+	// The desktop configuration: two half-width eyes, composited into the window:
+	FrameGraph graph("desktop");
+	unsigned int window = graph.importTexture("window", 1024, 512, FrameGraph::FORMAT_RGBA8);
+	unsigned int color[2], depth[2];
+	for (int c = 0; c < 2; c++)
+	{
+		color[c] = graph.createTexture("color", 512, 512, FrameGraph::FORMAT_RGBA8);
+		depth[c] = graph.createTexture("depth", 512, 512, FrameGraph::FORMAT_DEPTH24);
+		unsigned int pass = graph.addPass("eye", nullptr);
+		graph.write(pass, color[c]);
+		graph.write(pass, depth[c]);
+	}
+	unsigned int composite = graph.addPass("composite", nullptr);
+	graph.read(composite, color[0]);
+	graph.read(composite, color[1]);
+	graph.write(composite, window);
+	ASSERT_WITH_MESSAGE(graph.compile(), "compilation failed")
+
+	// The depth buffers do not overlap, the colors do:
+	ASSERT_WITH_MESSAGE(graph.getTarget(depth[0]) == graph.getTarget(depth[1]), "depth buffers must be aliased")
+	ASSERT_WITH_MESSAGE(graph.getTarget(color[0]) != graph.getTarget(color[1]), "colors are both alive when composited")
+	ASSERT_WITH_MESSAGE(graph.getNrOfTargets() == 3, "wrong number of physical targets")
+	const unsigned long long eye = 512ull * 512 * 4;
+	ASSERT_WITH_MESSAGE(graph.getMemory() == 3 * eye && graph.getUnaliasedMemory() == 4 * eye, "wrong memory report")
+	ASSERT_WITH_MESSAGE(graph.getImportedMemory() == 1024ull * 512 * 4, "wrong imported memory")
+
+	// Different sizes or formats never share a target:
+	FrameGraph mixed("mixed");
+	unsigned int out = mixed.importTexture("window", 64, 64, FrameGraph::FORMAT_RGBA8);
+	unsigned int a = mixed.createTexture("a", 64, 64, FrameGraph::FORMAT_RGBA8);
+	unsigned int b = mixed.createTexture("b", 32, 32, FrameGraph::FORMAT_RGBA8);
+	unsigned int first = mixed.addPass("first", nullptr);
+	mixed.write(first, a);
+	unsigned int second = mixed.addPass("second", nullptr);
+	mixed.read(second, a);
+	mixed.write(second, b);
+	unsigned int third = mixed.addPass("third", nullptr);
+	mixed.read(third, b);
+	mixed.write(third, out);
+	ASSERT_WITH_MESSAGE(mixed.compile() && mixed.getNrOfTargets() == 2, "incompatible targets must not be aliased")
+}
+
+
+// Cluster of a view-space point, found as the fragment shader does from the frame block:
+unsigned int clusterOf(const FrameBlock &frame, const glm::vec3 &p)
+{
+	glm::vec4 clip = frame.projection * glm::vec4(p, 1.0f);
+	glm::vec2 ndc = glm::vec2(clip) / clip.w;
+	unsigned int x = (unsigned int)glm::clamp((ndc.x * 0.5f + 0.5f) * Clusters::GRID_X, 0.0f, Clusters::GRID_X - 1.0f);
+	unsigned int y = (unsigned int)glm::clamp((ndc.y * 0.5f + 0.5f) * Clusters::GRID_Y, 0.0f, Clusters::GRID_Y - 1.0f);
+	unsigned int z = (unsigned int)glm::clamp(logf(-p.z) * frame.clusterDepth.z - frame.clusterDepth.w, 0.0f, Clusters::GRID_Z - 1.0f);
+	return frame.clusterGrid.w + x + Clusters::GRID_X * (y + Clusters::GRID_Y * z);
+}
+
+void testCullingSimd()
+{
+	// Both paths, on bounds touching a plane exactly, just past it and across it. The identity matrix gives the
+	// unit planes x, y, z = +-1, so that the distances are exact:
+	Culling simd, scalar;
+	scalar.setSimd(false);
+	glm::mat4 identity(1.0f);
+	float past = nextafterf(1.25f, 2.0f);
+	struct { glm::vec3 position; float radius; float half; bool visible; } bounds[] = {
+		{ glm::vec3(-1.5f, 0.0f, 0.0f), 0.5f, 4.0f, true },						// sphere touching x = -1
+		{ glm::vec3(-1.5f, 0.0f, 0.0f), nextafterf(0.5f, 0.0f), 4.0f, false },	// sphere just outside
+		{ glm::vec3(0.0f, 1.0f, 0.0f), 0.1f, 0.1f, true },						// sphere and box across y = 1
+		{ glm::vec3(1.25f, 0.0f, 0.0f), 1.0f, 0.25f, true },					// box touching x = 1
+		{ glm::vec3(past, 0.0f, 0.0f), 1.0f, 0.25f, false },					// box just outside
+		{ glm::vec3(0.0f, 0.0f, -1.25f), 1.0f, 0.25f, true },					// box touching z = -1
+		{ glm::vec3(0.0f, 0.0f, -past), 1.0f, 0.25f, false },					// box just outside
+	};
+	for (auto &b : bounds)
+	{
+		glm::mat4 model = glm::translate(identity, b.position);
+		simd.add(model, b.radius, glm::vec3(-b.half), glm::vec3(b.half));
+		scalar.add(model, b.radius, glm::vec3(-b.half), glm::vec3(b.half));
+	}
+	simd.cull(&identity, 1);
+	scalar.cull(&identity, 1);
+	for (unsigned int c = 0; c < sizeof(bounds) / sizeof(bounds[0]); c++)
+	{
+		ASSERT_WITH_MESSAGE(simd.isVisible(c, 0) == bounds[c].visible, "wrong culling on a plane")
+		ASSERT_WITH_MESSAGE(scalar.isVisible(c, 0) == bounds[c].visible, "wrong scalar culling on a plane")
+	}
+
+	// Rotated and scaled boxes on the planes and around the stereo frustums, not a multiple of four:
+	glm::mat4 viewProj[2] = { cameraViewProj(glm::vec3(-0.03f, 0.0f, 0.0f)), cameraViewProj(glm::vec3(0.03f, 0.0f, 0.0f)) };
+	for (const glm::mat4 *views : { &identity, viewProj })
+	{
+		simd.clear();
+		scalar.clear();
+		for (int c = 0; c < 4001; c++)
+		{
+			glm::vec3 position = views == &identity ? glm::vec3((rnd() < 0.5f ? -1.0f : 1.0f) * (rnd() < 0.5f ? 1.0f : 0.5f + rnd()), rnd() * 3.0f - 1.5f, rnd() * 3.0f - 1.5f)
+				: glm::vec3(rnd() * 120.0f - 60.0f, rnd() * 80.0f - 40.0f, -110.0f * rnd());
+			glm::mat4 model = glm::rotate(glm::translate(identity, position), rnd() * 6.3f, glm::normalize(glm::vec3(rnd(), rnd(), rnd()) + 0.1f));
+			model = glm::scale(model, views == &identity ? glm::vec3(rnd(), rnd(), rnd()) : glm::vec3(1.0f + 5.0f * rnd()));
+			simd.add(model, 0.9f, boxMin, boxMax);
+			scalar.add(model, 0.9f, boxMin, boxMax);
+		}
+		unsigned int count = views == &identity ? 1 : 2;
+		simd.cull(views, count);
+		scalar.cull(views, count);
+		ASSERT_WITH_MESSAGE(simd.getCulled() == scalar.getCulled() && simd.getDrawn(0) == scalar.getDrawn(0) && simd.getDrawn(1) == scalar.getDrawn(1), "wrong scalar culling stats")
+		ASSERT_WITH_MESSAGE(simd.getCulled() > 0 && simd.getDrawn(0) > 0, "the bounds must be partly visible")
+		for (unsigned int c = 0; c < 4001; c++)
+			ASSERT_WITH_MESSAGE(simd.getViewMask(c) == scalar.getViewMask(c), "the scalar culling must match")
+	}
+}
+
+void testClusters()
+{
+	// Two global lights (directional, no radius) among local ones, and one local light behind the eyes:
+	vector<LightData> input(50);
+	for (unsigned int c = 0; c < input.size(); c++)
+	{
+		input[c].position = glm::vec4(rnd() * 20.0f - 10.0f, rnd() * 8.0f - 4.0f, -1.0f - rnd() * 30.0f, 1.0f);
+		input[c].range = glm::vec4(0.5f + rnd() * 4.0f);
+	}
+	input[7].position.w = 0.0f;
+	input[23].range.x = 0.0f;
+	input[31].position = glm::vec4(0.0f, 0.0f, 10.0f, 1.0f);
+	input[31].range.x = 2.0f;
+	Clusters clusters(2);
+	clusters.setLights(input.data(), (unsigned int)input.size());
+	const vector<LightData> &lights = clusters.getLights();
+	ASSERT_WITH_MESSAGE(clusters.getGlobalLights() == 2 && lights.size() == input.size(), "wrong global lights")
+	ASSERT_WITH_MESSAGE(lights[0].position == input[7].position && lights[1].position == input[23].position && lights[2].position == input[0].position, "global lights must come first, the others in order")
+
+	FrameBlock frames[2];
+	for (unsigned int v = 0; v < 2; v++)
+	{
+		frames[v].projection = glm::perspective(glm::radians(90.0f), 16.0f / 9.0f, 0.1f, 100.0f);
+		frames[v].view = glm::translate(glm::mat4(1.0f), glm::vec3(v ? -0.5f : 0.5f, 0.0f, 0.0f));
+		clusters.build(v, frames[v]);
+	}
+	ASSERT_WITH_MESSAGE(frames[1].clusterGrid.w == Clusters::COUNT && frames[0].lightInfo.x == 2 && frames[0].lightInfo.y == lights.size(), "wrong frame block")
+
+	// Every point inside a light's range, in the view, must find the light in its cluster:
+	const vector<glm::uvec2> &grid = clusters.getGrid();
+	const vector<unsigned int> &indices = clusters.getIndices();
+	auto listed = [&](unsigned int cluster, unsigned int light) {
+		for (unsigned int i = grid[cluster].x; i < grid[cluster].x + grid[cluster].y; i++)
+			if (indices[i] == light)
+				return true;
+		return false;
+	};
+	unsigned int tested = 0;
+	for (unsigned int v = 0; v < 2; v++)
+		for (unsigned int l = clusters.getGlobalLights(); l < lights.size(); l++)
+			for (int s = 0; s < 200; s++)
+			{
+				glm::vec3 direction = glm::normalize(glm::vec3(rnd(), rnd(), rnd()) * 2.0f - 1.0f + glm::vec3(1e-4f));
+				glm::vec3 world = glm::vec3(lights[l].position) + direction * rnd() * lights[l].range.x * 0.99f;
+				glm::vec3 p = glm::vec3(frames[v].view * glm::vec4(world, 1.0f));
+				glm::vec4 clip = frames[v].projection * glm::vec4(p, 1.0f);
+				if (-p.z < 0.1f || -p.z > 100.0f || glm::abs(clip.x) > clip.w || glm::abs(clip.y) > clip.w)
+					continue;
+				ASSERT_WITH_MESSAGE(listed(clusterOf(frames[v], p), l), "light " << l << " missing from the cluster of a point it reaches, view " << v)
+				tested++;
+			}
+	ASSERT_WITH_MESSAGE(tested > 10000, "too few points in the views")
+
+	// No cluster lists a global light, or the light behind the eyes:
+	for (unsigned int i : indices)
+		ASSERT_WITH_MESSAGE(i >= clusters.getGlobalLights() && lights[i].position.z < 0.0f, "wrong light in a cluster")
+	ASSERT_WITH_MESSAGE(clusters.getAssignments() == indices.size() && clusters.getOverflows() == 0, "wrong assignments")
+
+	// On a job system, slice by slice, the clusters must list the same lights in the same order:
+	vector<LightData> many(Clusters::JOB_LIGHTS * 6);
+	for (LightData &l : many)
+	{
+		l.position = glm::vec4(rnd() * 40.0f - 20.0f, rnd() * 8.0f - 4.0f, -rnd() * 40.0f, 1.0f);
+		l.range = glm::vec4(0.5f + rnd() * 4.0f);
+	}
+	JobSystem jobs(4);
+	Clusters serial(2), parallel(2);
+	parallel.setJobSystem(&jobs);
+	serial.setLights(many.data(), (unsigned int)many.size());
+	parallel.setLights(many.data(), (unsigned int)many.size());
+	for (unsigned int v = 0; v < 2; v++)
+	{
+		serial.build(v, frames[v]);
+		parallel.build(v, frames[v]);
+	}
+	ASSERT_WITH_MESSAGE(parallel.getGrid() == serial.getGrid() && parallel.getIndices() == serial.getIndices(), "the jobs must assign like a single thread")
+	ASSERT_WITH_MESSAGE(parallel.getAssignments() == serial.getAssignments() && parallel.getAssignments() > 0, "wrong assignments on the jobs")
+
+	// Full clusters drop the extra lights:
+	vector<LightData> crowd(Clusters::MAX_LIGHTS_PER_CLUSTER + 10);
+	for (LightData &l : crowd)
+	{
+		l.position = glm::vec4(0.0f, 0.0f, -5.0f, 1.0f);
+		l.range = glm::vec4(0.2f);
+	}
+	Clusters crowded;
+	crowded.setLights(crowd.data(), (unsigned int)crowd.size());
+	crowded.build(0, frames[0]);
+	ASSERT_WITH_MESSAGE(crowded.getOverflows() > 0, "full clusters must report overflows")
+	for (const glm::uvec2 &cluster : crowded.getGrid())
+		ASSERT_WITH_MESSAGE(cluster.y <= Clusters::MAX_LIGHTS_PER_CLUSTER, "a cluster holds too many lights")
+}
+
+void benchmarkClusters()
+{
+	// Lights of radius 3 scattered in a 40x8x40 volume in front of two eyes:
+	FrameBlock frames[2];
+	for (unsigned int v = 0; v < 2; v++)
+	{
+		frames[v].projection = glm::perspective(glm::radians(90.0f), 16.0f / 9.0f, 0.1f, 100.0f);
+		frames[v].view = glm::translate(glm::mat4(1.0f), glm::vec3(v ? -0.03f : 0.03f, 0.0f, 0.0f));
+	}
+	vector<LightData> lights(Clusters::MAX_LIGHTS);
+	for (LightData &l : lights)
+	{
+		l.position = glm::vec4(rnd() * 40.0f - 20.0f, rnd() * 8.0f - 4.0f, -rnd() * 40.0f, 1.0f);
+		l.range = glm::vec4(3.0f);
+	}
+
+	// One thread without a job system, then job systems of growing size (0: one thread per hardware thread):
+	const int runs = 50;
+	unsigned int threads[] = { 1, 2, 4, 0 };
+	std::cout << "Clusters benchmark (2 views, build time per frame over " << runs << " frames, "
+		<< std::thread::hardware_concurrency() << " hardware threads):" << std::endl;
+	for (unsigned int count = 8; count <= Clusters::MAX_LIGHTS; count *= 2)
+	{
+		unsigned int assignments = 0;
+		std::cout << "   " << count << " lights:";
+		for (unsigned int t : threads)
+		{
+			JobSystem jobs(t);
+			Clusters clusters(2);
+			clusters.setJobSystem(t == 1 ? nullptr : &jobs);
+			long long time = 0;
+			for (int r = 0; r < runs; r++)
+			{
+				clusters.setLights(lights.data(), count);
+				for (unsigned int v = 0; v < 2; v++)
+					clusters.build(v, frames[v]);
+				time += clusters.getBuildTime();
+			}
+			assignments = clusters.getAssignments();
+			std::cout << " " << time / runs << " us (" << jobs.getThreads() << " threads),";
+		}
+		std::cout << " " << assignments << " assignments" << std::endl;
+	}
+}
+
+void testFrameArena()
+{
+	FrameArena arena(1024, 3);
+	void *a = arena.allocate(3, 1);
+	void *b = arena.allocate(16, 16);
+	ASSERT_WITH_MESSAGE(((uintptr_t)b & 15) == 0, "allocations must be aligned")
+	ASSERT_WITH_MESSAGE((char *)b >= (char *)a + 3, "allocations must not overlap")
+
+	// A block is reused only after every frame in flight:
+	arena.nextFrame();
+	void *c = arena.allocate(3, 1);
+	arena.nextFrame();
+	arena.nextFrame();
+	ASSERT_WITH_MESSAGE(c != a && arena.allocate(3, 1) == a, "blocks must be recycled after 3 frames")
+
+	// Too large for the block: the heap takes over, then every block grows:
+	arena.allocate(4000, 16);
+	ASSERT_WITH_MESSAGE(arena.getOverflows() == 1, "an overflow must fall back to the heap")
+	for (int frame = 0; frame < 3; frame++)
+	{
+		arena.nextFrame();
+		ASSERT_WITH_MESSAGE(arena.getCapacity() >= 4000, "blocks must grow to the largest frame")
+	}
+
+	// STL adapter:
+	FrameVector<glm::mat4> matrices{ FrameAllocator<glm::mat4>(&arena) };
+	for (int c = 0; c < 100; c++)
+		matrices.push_back(glm::mat4((float)c));
+	ASSERT_WITH_MESSAGE(matrices[99][0][0] == 99.0f && ((uintptr_t)matrices.data() & (alignof(glm::mat4) - 1)) == 0, "wrong vector content")
+}
+
+void testSteadyStateFrame()
+{
+	// Engine::loadFrames() and both eye passes of the indirect path (2 variants, one group each per view), on the real
+	// List, IndirectBatch and ShaderCache, with the GL calls and the engine stubbed (see stubs.h):
+	FrameArena arena(4 * 1024);
+	Clusters clusters(2);
+	Culling culling;
+	JobSystem jobs(4);
+	culling.setJobSystem(&jobs);
+	Occlusion occlusion;
+	occlusion.setJobSystem(&jobs);
+	MeshPool pool;
+	IndirectBatch batch(&pool);
+	ShaderCache shaders("", "");
+	Ssbo lightSsbo, clusterSsbo, lightIndexSsbo;
+	engineStub = EngineStub();
+	engineStub.maxRenderLights = 40;
+	engineStub.frameArena = &arena;
+	engineStub.clusters = &clusters;
+	engineStub.culling = &culling;
+	engineStub.shaderCache = &shaders;
+	engineStub.meshPool = &pool;
+	engineStub.indirectBatch = &batch;
+	engineStub.indirect = true;
+
+	List list;
+	vector<Node *> nodes;
+	for (unsigned int c = 0; c < 40; c++)
+	{
+		Light *light = new Light();
+		light->setPriority(c % 3);
+		light->setRadius(2.0f + rnd() * 4.0f);
+		if (c % 8 == 0)
+		{
+			light->setW(0.0f);
+			light->setDirection(glm::vec3(0.0f, -1.0f, 0.0f));
+		}
+		list.addNode(light, glm::translate(glm::mat4(1.0f), glm::vec3(rnd() * 20.0f - 10.0f, rnd() * 4.0f, -rnd() * 20.0f)));
+		nodes.push_back(light);
+	}
+	for (unsigned int c = 0; c < 500; c++)
+	{
+		// Unit box, every third one stretched so that it needs the normal matrix variant:
+		float *coordinates = new float[8 * 3];
+		for (unsigned int v = 0; v < 8; v++)
+		{
+			coordinates[v * 3 + 0] = (v & 1) ? boxMax.x : boxMin.x;
+			coordinates[v * 3 + 1] = (v & 2) ? boxMax.y : boxMin.y;
+			coordinates[v * 3 + 2] = (v & 4) ? boxMax.z : boxMin.z;
+		}
+		const unsigned int boxIndices[] = { 0, 2, 1, 1, 2, 3,   4, 5, 6, 5, 7, 6,   0, 1, 4, 1, 5, 4,
+			2, 6, 3, 3, 6, 7,   0, 4, 2, 2, 4, 6,   1, 3, 5, 3, 7, 5 };
+		unsigned int *faces = new unsigned int[36];
+		memcpy(faces, boxIndices, sizeof(boxIndices));
+		Mesh *mesh = new Mesh();
+		mesh->fillData(coordinates, new float[8 * 2](), new float[8 * 3](), 8, faces, 12);
+		mesh->setBounds(0.9f, boxMin, boxMax);
+		glm::mat4 model = box(rnd() * 40.0f - 20.0f, rnd() * 60.0f);
+		if (c % 3 == 0)
+			model = glm::scale(model, glm::vec3(1.0f, 2.0f, 1.0f));
+		list.addNode(mesh, model);
+		nodes.push_back(mesh);
+	}
+
+	FrameBlock frames[2];
+	glm::mat4 viewProj[2];
+	unsigned int drawCalls = 0;
+	auto frame = [&]()
+	{
+		list.loadLights(clusters);
+		for (int c = 0; c < 2; c++)
+		{
+			frames[c].projection = glm::perspective(glm::radians(90.0f), 1.0f, 0.1f, 100.0f);
+			frames[c].view = glm::translate(glm::mat4(1.0f), glm::vec3(c ? -0.03f : 0.03f, 0.0f, 0.0f));
+			frames[c].eyePosition = glm::vec4(c ? 0.03f : -0.03f, 0.0f, 0.0f, 1.0f);
+			clusters.build(c, frames[c]);
+			viewProj[c] = frames[c].projection * frames[c].view;
+		}
+		list.sortQueue(false, glm::vec3(0.0f));
+		list.loadBounds(culling);
+		culling.cull(viewProj, 2);
+		occlusion.begin(viewProj, 2);
+		list.cullOccluded(occlusion, culling);
+		list.preparePacket(culling, clusters);
+		lightSsbo.update(clusters.getLights().data(), (unsigned int)(clusters.getLights().size() * sizeof(LightData)));
+		clusterSsbo.update(clusters.getGrid().data(), (unsigned int)(clusters.getGrid().size() * sizeof(glm::uvec2)));
+		lightIndexSsbo.update(clusters.getIndices().data(), (unsigned int)(clusters.getIndices().size() * sizeof(unsigned int)));
+		drawCalls = list.renderNodes(0) + list.renderNodes(1);
+		arena.nextFrame();
+	};
+
+	// Warm up, then no frame may touch the heap:
+	for (int c = 0; c < 10; c++)
+		frame();
+	unsigned long long before = heapAllocations;
+	for (int c = 0; c < 10; c++)
+		frame();
+	unsigned long long allocations = heapAllocations - before;
+	ASSERT_WITH_MESSAGE(allocations == 0, "steady-state frames must not allocate, got " << allocations << " operator new calls")
+	ASSERT_WITH_MESSAGE(clusters.getLights().size() == 40 && clusters.getGlobalLights() == 5, "wrong light count")
+	ASSERT_WITH_MESSAGE(batch.getOwner() == &list && batch.getDrawCount() > 0 && batch.getGroupCount() == 4, "the frame must go through the indirect batch")
+	ASSERT_WITH_MESSAGE(drawCalls > 0 && shaders.getVariantCount() == 2, "wrong draw calls")
+	ASSERT_WITH_MESSAGE(occlusion.getOccluders() > 1, "the boxes must be occluders")
+
+	engineStub = EngineStub();
+	for (Node *node : nodes)
+		delete node;
+}
+
+void testMeshPool()
+{
+	// Removed geometry leaves holes that the next meshes fill, the end of the buffers is given back:
+	MeshPool pool;
+	vector<float> vertices(3 * 100, 0.0f);
+	vector<unsigned int> faces(3 * 50, 0);
+	auto add = [&](unsigned int nVertices) { return pool.add(vertices.data(), vertices.data(), vertices.data(), nVertices, faces.data(), nVertices / 2); };
+	unsigned int a = add(40), b = add(20), c = add(40);
+	ASSERT_WITH_MESSAGE(pool.getVertexCount() == 100 && pool.getIndexCount() == 150 && pool.getEntryCount() == 3, "wrong pool size")
+	ASSERT_WITH_MESSAGE(pool.remove(b) && !pool.remove(b), "an entry is removed once")
+	ASSERT_WITH_MESSAGE(pool.getVertexCount() == 100 && pool.getEntryCount() == 2, "a hole must not shrink the pool")
+	unsigned int d = add(10);
+	ASSERT_WITH_MESSAGE(d == b && pool.getEntry(d).baseVertex == 40 && pool.getEntry(d).firstIndex == 60, "a hole and its ID must be reused")
+	ASSERT_WITH_MESSAGE(pool.getVertexCount() == 100, "a reused hole must not grow the pool")
+	pool.remove(c);
+	ASSERT_WITH_MESSAGE(pool.getVertexCount() == 50 && pool.getIndexCount() == 75, "the end of the pool must be given back")
+	pool.remove(d);
+	pool.remove(a);
+	ASSERT_WITH_MESSAGE(pool.getVertexCount() == 0 && pool.getIndexCount() == 0 && pool.getEntryCount() == 0, "merged holes must be given back")
+
+	// Scenes loaded and destroyed over and over, through the meshes, stay in the same buffers:
+	engineStub = EngineStub();
+	engineStub.meshPool = &pool;
+	unsigned int vertexCapacity = 0, indexCapacity = 0;
+	for (int load = 0; load < 10; load++)
+	{
+		vector<Mesh *> scene;
+		for (unsigned int m = 0; m < 20; m++)
+		{
+			Mesh *mesh = new Mesh();
+			mesh->fillData(new float[3 * 50](), new float[2 * 50](), new float[3 * 50](), 50 - m, new unsigned int[3 * 25](), 25 - m / 2);
+			scene.push_back(mesh);
+		}
+		if (load == 0)
+		{
+			vertexCapacity = pool.getVertexCapacity();
+			indexCapacity = pool.getIndexCapacity();
+		}
+		for (Mesh *mesh : scene)
+			delete mesh;
+		ASSERT_WITH_MESSAGE(pool.getVertexCount() == 0 && pool.getEntryCount() == 0, "destroyed meshes must leave the pool")
+	}
+	ASSERT_WITH_MESSAGE(pool.getVertexCapacity() == vertexCapacity && pool.getIndexCapacity() == indexCapacity, "reloading must not grow the pool")
+	engineStub = EngineStub();
+}
+
+
+struct Counted
+{
+	static int alive;
+	int value = 7;
+	Counted() { alive++; }
+	~Counted() { alive--; }
+};
+int Counted::alive = 0;
+
+void testPool()
+{
+	Pool<Counted, 4> pool;
+	vector<Pool<Counted, 4>::Handle> handles;
+	for (int c = 0; c < 10; c++)
+		handles.push_back(pool.create());
+	ASSERT_WITH_MESSAGE(pool.getCount() == 10 && Counted::alive == 10 && pool.getCapacity() == 12, "wrong pool size")
+
+	// Pointers never move when the pool grows:
+	Counted *first = pool.get(handles[0]);
+	for (int c = 0; c < 10; c++)
+		pool.create();
+	ASSERT_WITH_MESSAGE(pool.get(handles[0]) == first && pool.getHandle(first) == handles[0], "objects must not move")
+	ASSERT_WITH_MESSAGE(pool.get(handles[5]) == pool.get(handles[4]) + 1, "consecutive objects must be contiguous")
+
+	// Stale handles are detected, the slot is reused:
+	Counted *third = pool.get(handles[3]);
+	ASSERT_WITH_MESSAGE(pool.destroy(handles[3]) && !pool.destroy(handles[3]), "a handle destroys once")
+	ASSERT_WITH_MESSAGE(pool.get(handles[3]) == nullptr && Counted::alive == 19, "a destroyed object must be released")
+	Pool<Counted, 4>::Handle reused = pool.create();
+	ASSERT_WITH_MESSAGE(pool.get(reused) == third && pool.get(handles[3]) == nullptr, "the slot must be reused under a new handle")
+
+	// A slot is retired before its generation wraps around, old handles never become valid again:
+	Pool<Counted, 4> churn;
+	Pool<Counted, 4>::Handle oldest = churn.create(), handle = oldest;
+	for (int c = 0; c < 255; c++)
+	{
+		churn.destroy(handle);
+		handle = churn.create();
+		ASSERT_WITH_MESSAGE((handle & 0xFFFFFF) == (oldest & 0xFFFFFF) && churn.get(oldest) == nullptr, "the slot must be reused until its generation wraps")
+	}
+	churn.destroy(handle);
+	handle = churn.create();
+	ASSERT_WITH_MESSAGE((handle & 0xFFFFFF) != (oldest & 0xFFFFFF) && churn.get(oldest) == nullptr && churn.getCount() == 1, "a wrapped slot must be retired")
+	churn.clear();
+
+	// Creation order:
+	int visited = 0;
+	const Counted *previous = nullptr;
+	bool ordered = true;
+	pool.forEach([&](Counted &c) {
+		if (previous && (pool.getHandle(&c) & 0xFFFFFF) < (pool.getHandle(previous) & 0xFFFFFF))
+			ordered = false;
+		previous = &c;
+		visited++;
+	});
+	ASSERT_WITH_MESSAGE(visited == 20 && ordered, "forEach() must visit the live objects in slot order")
+
+	pool.clear();
+	ASSERT_WITH_MESSAGE(Counted::alive == 0 && pool.getCount() == 0, "clear() must release everything")
+
+	// Scene pools (see Engine::destroyNode()): a subtree is destroyed children first and its slots are reused,
+	// nodes from elsewhere are left alive:
+	ScenePools scene;
+	Node *kept = scene.createNode();
+	Node *sceneRoot = scene.createNode();
+	Mesh *mesh = scene.createMesh();
+	Light *light = scene.createLight();
+	Camera *camera = scene.createCamera();
+	Node outside;
+	sceneRoot->setParent(kept);
+	mesh->setParent(sceneRoot);
+	light->setParent(mesh);
+	camera->setParent(sceneRoot);
+	outside.setParent(mesh);
+	Registry index(kept);
+	ASSERT_WITH_MESSAGE(scene.getCount() == 5 && index.getCount() == 6, "wrong scene size")
+	int lightId = light->getId();
+	ASSERT_WITH_MESSAGE(scene.destroy(sceneRoot), "a subtree must be destroyed")
+	ASSERT_WITH_MESSAGE(scene.getCount() == 1 && kept->getChildren().empty(), "the whole subtree must be destroyed")
+	ASSERT_WITH_MESSAGE(index.getCount() == 1 && index.find(lightId) == nullptr, "destroyed nodes must leave the registry")
+	ASSERT_WITH_MESSAGE(outside.getParent() == nullptr && !scene.destroy(&outside), "other nodes must be detached, not destroyed")
+	ASSERT_WITH_MESSAGE(scene.createMesh() == mesh && scene.createCamera() == camera, "the slots must be reused")
+
+	// A root from elsewhere is rejected before anything changes:
+	Node foreign;
+	Node *pooledChild = scene.createNode();
+	Light *pooledLight = scene.createLight();
+	foreign.setParent(kept);
+	pooledChild->setParent(&foreign);
+	pooledLight->setParent(pooledChild);
+	unsigned int count = scene.getCount();
+	ASSERT_WITH_MESSAGE(!scene.destroy(&foreign), "a root not created by the pools must be rejected")
+	ASSERT_WITH_MESSAGE(foreign.getParent() == kept && pooledChild->getParent() == &foreign && pooledLight->getParent() == pooledChild
+		&& scene.getCount() == count, "a rejected root must leave the tree unchanged")
+	foreign.setParent(nullptr);
+	pooledChild->setParent(nullptr);
+	scene.clear();
+	ASSERT_WITH_MESSAGE(scene.getCount() == 0 && index.getRoot() == nullptr, "clear() must release everything")
+}
+
+void testNameTable()
+{
+	unsigned int a = NameTable::intern("Teapot.001");
+	unsigned int b = NameTable::intern("Teapot.002");
+	ASSERT_WITH_MESSAGE(a != b && NameTable::intern("Teapot.001") == a, "names must be interned once")
+	ASSERT_WITH_MESSAGE(NameTable::get(a) == "Teapot.001" && NameTable::getHash(a) == NameTable::hash("Teapot.001"), "wrong name")
+	ASSERT_WITH_MESSAGE(NameTable::find("Teapot.003") == NameTable::NOT_FOUND && NameTable::get(0).empty(), "unknown names are not found")
+
+	// Objects only keep the index:
+	Node node;
+	ASSERT_WITH_MESSAGE(node.getName().empty(), "objects start unnamed")
+	node.setName("Teapot.002");
+	ASSERT_WITH_MESSAGE(node.getName() == "Teapot.002" && node.getNameHash() == NameTable::getHash(b), "wrong object name")
+}
+
+// Depth-first, as the OVO loader does, with "filler" allocations in between like the geometry it reads:
+template <class F>
+Node *buildScene(unsigned int &count, unsigned int total, unsigned int depth, F create, vector<void *> &filler)
+{
+	Node *node = create(count);
+	count++;
+	filler.push_back(::operator new(64 + (rand() % 64) * 64));
+	for (int c = 0; c < 8 && count < total && depth < 6; c++)
+		buildScene(count, total, depth + 1, create, filler)->setParent(node);
+	return node;
+}
+
+size_t childrenBytes(Node *node)
+{
+	size_t bytes = node->getChildren().capacity() * sizeof(Node *);
+	for (Node *child : node->getChildren())
+		bytes += childrenBytes(child);
+	return bytes;
+}
+
+float traverseScene(Node *node, const glm::mat4 &parent)
+{
+	glm::mat4 world = parent * node->getPosMatrix();
+	float sum = world[3].x;
+	for (Node *child : node->getChildren())
+		sum += traverseScene(child, world);
+	return sum;
+}
+
+void benchmarkSceneStorage()
+{
+	const unsigned int total = 100000;
+	std::cout << "Scene storage benchmark (" << total << " nodes):" << std::endl;
+	vector<void *> filler;
+
+	// Before: nodes allocated one by one, each carrying its own string name:
+	struct NamedNode : public Node { string oldName; };
+	srand(1);
+	size_t nameBytes = 0;
+	unsigned int count = 0;
+	Node *heapRoot = buildScene(count, total, 0, [&nameBytes](unsigned int id) {
+		NamedNode *node = new NamedNode();
+		node->oldName = "SceneNode_" + std::to_string(id) + "_geometry";
+		nameBytes += node->oldName.capacity() > 15 ? node->oldName.capacity() + 1 : 0;
+		node->setPosMatrix(glm::translate(glm::mat4(1.0f), glm::vec3(0.001f * (id % 97))));
+		return (Node *)node;
+	}, filler);
+	double heapMemory = (double)(total * sizeof(NamedNode) + nameBytes + childrenBytes(heapRoot)) / total;
+
+	// After: pooled nodes with interned names:
+	Pool<Node> pool;
+	srand(1);
+	size_t namesBefore = NameTable::getMemory();
+	count = 0;
+	Node *poolRoot = buildScene(count, total, 0, [&pool](unsigned int id) {
+		Node *node = pool.get(pool.create());
+		node->setName("SceneNode_" + std::to_string(id) + "_geometry");
+		node->setPosMatrix(glm::translate(glm::mat4(1.0f), glm::vec3(0.001f * (id % 97))));
+		return node;
+	}, filler);
+	double poolMemory = (double)(pool.getMemory() + childrenBytes(poolRoot)) / total;
+	double tableMemory = (double)(NameTable::getMemory() - namesBefore) / total;
+
+	std::cout << "   heap nodes: " << heapMemory << " bytes per node, plus the headers of 3 allocations (node, name, children)" << std::endl;
+	std::cout << "   pooled nodes: " << poolMemory << " bytes per node, plus the headers of 1 allocation (children), "
+		<< tableMemory << " bytes per unique name in the table" << std::endl;
+
+	const int runs = 20;
+	float sink = 0.0f;
+	auto start = std::chrono::high_resolution_clock::now();
+	for (int r = 0; r < runs; r++)
+		sink += traverseScene(heapRoot, glm::mat4(1.0f));
+	double heapTime = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count() / runs;
+	start = std::chrono::high_resolution_clock::now();
+	for (int r = 0; r < runs; r++)
+		sink -= traverseScene(poolRoot, glm::mat4(1.0f));
+	double poolTime = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count() / runs;
+	std::cout << "   traversal: " << heapTime << " ms heap, " << poolTime << " ms pooled" << (sink == 12345.0f ? " " : "") << std::endl;
+
+	for (void *p : filler)
+		::operator delete(p);
+}
+
+// World matrices in depth-first order, as fillList() computed them before the flattened hierarchy:
+void recurseWorld(Node *node, const glm::mat4 &parent, vector<glm::mat4> &world)
+{
+	glm::mat4 f = parent * node->getPosMatrix();
+	world.push_back(f);
+	for (Node *child : node->getChildren())
+		recurseWorld(child, f, world);
+}
+
+Node *buildTransformScene(Pool<Node> &pool, unsigned int total, vector<void *> &filler)
+{
+	srand(2);
+	unsigned int count = 0;
+	return buildScene(count, total, 0, [&pool](unsigned int) {
+		Node *node = pool.get(pool.create());
+		glm::mat4 m = glm::translate(glm::mat4(1.0f), glm::vec3(rnd(), rnd(), rnd()));
+		m = glm::rotate(m, rnd() * 3.0f, glm::normalize(glm::vec3(rnd(), rnd(), rnd()) + glm::vec3(0.1f)));
+		node->setPosMatrix(glm::scale(m, glm::vec3(0.9f + 0.2f * rnd())));
+		return node;
+	}, filler);
+}
+
+float maxDifference(const glm::mat4 &a, const glm::mat4 &b)
+{
+	float d = 0.0f;
+	for (int c = 0; c < 4; c++)
+		for (int r = 0; r < 4; r++)
+			d = glm::max(d, glm::abs(a[c][r] - b[c][r]));
+	return d;
+}
+
+void testHierarchy()
+{
+	// SIMD product:
+	glm::mat4 a = glm::rotate(glm::translate(glm::mat4(1.0f), glm::vec3(1.0f, 2.0f, 3.0f)), 0.7f, glm::vec3(0.0f, 1.0f, 0.0f));
+	glm::mat4 b = glm::scale(glm::rotate(glm::mat4(1.0f), -1.2f, glm::vec3(1.0f, 0.0f, 0.0f)), glm::vec3(2.0f, 1.0f, 0.5f));
+	glm::mat4 product;
+	Hierarchy::multiply(a, b, product);
+	ASSERT_WITH_MESSAGE(maxDifference(product, a * b) < 1e-5f, "wrong matrix product")
+
+	// Same matrices as the recursion, in the same order, on one or more threads:
+	Pool<Node> pool;
+	vector<void *> filler;
+	Node *root = buildTransformScene(pool, 20000, filler);
+	glm::mat4 base = glm::translate(glm::mat4(1.0f), glm::vec3(0.0f, 0.0f, -5.0f));
+	vector<glm::mat4> expected;
+	recurseWorld(root, base, expected);
+
+	JobSystem jobs(4);
+	for (JobSystem *system : { (JobSystem *)nullptr, &jobs })
+	{
+		Hierarchy hierarchy;
+		hierarchy.setJobSystem(system);
+		ASSERT_WITH_MESSAGE(!hierarchy.isBuilt(root), "nothing built yet")
+		hierarchy.build(root);
+		ASSERT_WITH_MESSAGE(hierarchy.isBuilt(root) && hierarchy.getCount() == expected.size(), "wrong node count")
+		ASSERT_WITH_MESSAGE(hierarchy.getParent(0) == Hierarchy::NO_PARENT && hierarchy.getSubtreeEnd(0) == expected.size(), "wrong root")
+		hierarchy.update(base);
+		float error = 0.0f;
+		for (unsigned int i = 1; i < hierarchy.getCount(); i++)
+		{
+			ASSERT_WITH_MESSAGE(hierarchy.getParent(i) < i && hierarchy.getSubtreeEnd(i) <= hierarchy.getSubtreeEnd(hierarchy.getParent(i)), "parents must come first")
+			error = glm::max(error, maxDifference(hierarchy.getWorld()[i], expected[i]));
+		}
+		ASSERT_WITH_MESSAGE(error < 1e-3f, "world matrices differ from the recursion")
+	}
+
+	// Changing the tree invalidates the linearization:
+	Hierarchy hierarchy;
+	hierarchy.build(root);
+	Node *leaf = pool.get(pool.create());
+	leaf->setParent(root);
+	ASSERT_WITH_MESSAGE(!hierarchy.isBuilt(root), "reparenting must invalidate the hierarchy")
+	hierarchy.build(root);
+	ASSERT_WITH_MESSAGE(hierarchy.isBuilt(root) && hierarchy.getNode(hierarchy.getCount() - 1) == leaf, "the new child is the last one of the root")
+
+	for (void *p : filler)
+		::operator delete(p);
+}
+
+void benchmarkHierarchy()
+{
+	const unsigned int total = 100000;
+	const int runs = 20;
+	Pool<Node> pool;
+	vector<void *> filler;
+	Node *root = buildTransformScene(pool, total, filler);
+	std::cout << "Transform hierarchy benchmark (" << total << " nodes, matrices per second):" << std::endl;
+
+	// Before: one recursive call and one glm product per node:
+	vector<glm::mat4> world;
+	world.reserve(total);
+	auto start = std::chrono::high_resolution_clock::now();
+	for (int r = 0; r < runs; r++)
+	{
+		world.clear();
+		recurseWorld(root, glm::mat4(1.0f), world);
+	}
+	double recursion = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start).count() / runs;
+
+	// After: forward pass over the flattened arrays, with and without reading the nodes, on one and on all threads:
+	JobSystem jobs;
+	Hierarchy hierarchy;
+	hierarchy.build(root);
+	double flat[2][2];
+	for (int t = 0; t < 2; t++)
+	{
+		hierarchy.setJobSystem(t == 0 ? nullptr : &jobs);
+		for (int gather = 0; gather < 2; gather++)
+		{
+			start = std::chrono::high_resolution_clock::now();
+			for (int r = 0; r < runs; r++)
+				if (gather)
+					hierarchy.update(glm::mat4(1.0f));
+				else
+					hierarchy.computeWorld(glm::mat4(1.0f));
+			flat[t][gather] = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start).count() / runs;
+		}
+	}
+	ASSERT_WITH_MESSAGE(maxDifference(hierarchy.getWorld()[total - 1], world[total - 1]) < 1e-3f, "world matrices differ from the recursion")
+
+	std::cout << "   recursion: " << total / recursion / 1e6 << " M/s" << std::endl;
+	std::cout << "   flat, 1 thread: " << total / flat[0][1] / 1e6 << " M/s reading the nodes, " << total / flat[0][0] / 1e6 << " M/s from the local array" << std::endl;
+	std::cout << "   flat, " << hierarchy.getThreads() << " threads: " << total / flat[1][1] / 1e6 << " M/s reading the nodes, " << total / flat[1][0] / 1e6 << " M/s from the local array" << std::endl;
+
+	for (void *p : filler)
+		::operator delete(p);
+}
+
+// Final matrix as Node::getFinal() computed it before the cache, walking to the root on every call:
+glm::mat4 uncachedFinal(Node *node)
+{
+	if (node->getParent() == nullptr)
+		return node->getPosMatrix();
+	return uncachedFinal(node->getParent()) * node->getPosMatrix();
+}
+
+void testNodeWorldCache()
+{
+	Node root, middle, leaf, other;
+	middle.setParent(&root);
+	leaf.setParent(&middle);
+	root.setPosMatrix(glm::translate(glm::mat4(1.0f), glm::vec3(1.0f, 0.0f, 0.0f)));
+	middle.setPosMatrix(glm::rotate(glm::mat4(1.0f), 0.5f, glm::vec3(0.0f, 0.0f, 1.0f)));
+	leaf.setPosMatrix(glm::scale(glm::mat4(1.0f), glm::vec3(2.0f)));
+	ASSERT_WITH_MESSAGE(maxDifference(leaf.getFinal(), uncachedFinal(&leaf)) < 1e-6f, "wrong final matrix")
+	ASSERT_WITH_MESSAGE(maxDifference(leaf.getFinalInverse() * leaf.getFinal(), glm::mat4(1.0f)) < 1e-5f, "wrong inverse")
+
+	// Reads do not change anything, moving a parent invalidates its subtree only:
+	unsigned long long leafVersion = leaf.getWorldVersion();
+	unsigned long long rootVersion = root.getWorldVersion();
+	leaf.getFinal();
+	ASSERT_WITH_MESSAGE(leaf.getWorldVersion() == leafVersion, "reading must not bump the version")
+	middle.setPosMatrix(glm::rotate(glm::mat4(1.0f), -0.3f, glm::vec3(0.0f, 1.0f, 0.0f)));
+	ASSERT_WITH_MESSAGE(leaf.getWorldVersion() != leafVersion && root.getWorldVersion() == rootVersion, "only the subtree is invalidated")
+	ASSERT_WITH_MESSAGE(maxDifference(leaf.getFinal(), uncachedFinal(&leaf)) < 1e-6f, "stale final matrix after moving a parent")
+	ASSERT_WITH_MESSAGE(maxDifference(leaf.getFinalInverse(), glm::inverse(uncachedFinal(&leaf))) < 1e-5f, "stale inverse after moving a parent")
+
+	// Moving it again before reading, while the subtree is already dirty:
+	middle.setPosMatrix(glm::rotate(glm::mat4(1.0f), 0.2f, glm::vec3(0.0f, 1.0f, 0.0f)));
+	leafVersion = leaf.getWorldVersion();
+	middle.setPosMatrix(glm::rotate(glm::mat4(1.0f), 0.7f, glm::vec3(1.0f, 0.0f, 0.0f)));
+	ASSERT_WITH_MESSAGE(leaf.getWorldVersion() != leafVersion, "moving a dirty parent must bump the version")
+	leafVersion = leaf.getWorldVersion();
+	root.setPosMatrix(glm::translate(glm::mat4(1.0f), glm::vec3(0.0f, 0.0f, -3.0f)));
+	ASSERT_WITH_MESSAGE(leaf.getWorldVersion() != leafVersion, "moving a dirty grandparent must bump the version")
+	ASSERT_WITH_MESSAGE(maxDifference(leaf.getFinal(), uncachedFinal(&leaf)) < 1e-6f, "stale final matrix after moving a dirty parent")
+	ASSERT_WITH_MESSAGE(maxDifference(middle.getFinal(), uncachedFinal(&middle)) < 1e-6f, "stale final matrix of the parent")
+
+	// Reparenting as well:
+	other.setPosMatrix(glm::translate(glm::mat4(1.0f), glm::vec3(0.0f, 5.0f, 0.0f)));
+	leafVersion = leaf.getWorldVersion();
+	leaf.setParent(&other);
+	ASSERT_WITH_MESSAGE(leaf.getWorldVersion() != leafVersion, "reparenting must bump the version")
+	ASSERT_WITH_MESSAGE(maxDifference(leaf.getFinal(), other.getPosMatrix() * leaf.getPosMatrix()) < 1e-6f, "stale final matrix after reparenting")
+}
+
+void benchmarkNodeWorldCache()
+{
+	const unsigned int depth = 1000;
+	const int runs = 1000;
+	Pool<Node> pool;
+	Node *root = pool.get(pool.create());
+	Node *leaf = root;
+	for (unsigned int d = 1; d < depth; d++)
+	{
+		Node *node = pool.get(pool.create());
+		node->setPosMatrix(glm::rotate(glm::translate(glm::mat4(1.0f), glm::vec3(0.01f, 0.0f, 0.0f)), 0.001f, glm::vec3(0.0f, 0.0f, 1.0f)));
+		node->setParent(leaf);
+		leaf = node;
+	}
+	std::cout << "World matrix cache benchmark (chain of " << depth << " nodes):" << std::endl;
+
+	// A camera at the end of the chain, read several times per frame (view matrix, eye position, ...):
+	float sink = 0.0f;
+	auto start = std::chrono::high_resolution_clock::now();
+	for (int r = 0; r < runs; r++)
+		sink += glm::inverse(uncachedFinal(leaf))[3].x + uncachedFinal(leaf)[3].x;
+	double before = std::chrono::duration<double, std::micro>(std::chrono::high_resolution_clock::now() - start).count() / runs;
+	start = std::chrono::high_resolution_clock::now();
+	for (int r = 0; r < runs; r++)
+		sink -= leaf->getFinalInverse()[3].x + leaf->getFinal()[3].x;
+	double cached = std::chrono::duration<double, std::micro>(std::chrono::high_resolution_clock::now() - start).count() / runs;
+
+	// Same, with the root moving every frame:
+	start = std::chrono::high_resolution_clock::now();
+	for (int r = 0; r < runs; r++)
+	{
+		root->setPosMatrix(glm::translate(glm::mat4(1.0f), glm::vec3(0.001f * r)));
+		sink -= leaf->getFinalInverse()[3].x + leaf->getFinal()[3].x;
+	}
+	double moving = std::chrono::duration<double, std::micro>(std::chrono::high_resolution_clock::now() - start).count() / runs;
+	ASSERT_WITH_MESSAGE(maxDifference(leaf->getFinal(), uncachedFinal(leaf)) < 1e-3f, "wrong cached final matrix")
+
+	std::cout << "   uncached: " << before << " us per frame" << std::endl;
+	std::cout << "   cached: " << cached << " us per frame when nothing moves, " << moving << " us when the root moves" << (sink == 12345.0f ? " " : "") << std::endl;
+}
+
+// Stand-ins for Light and Mesh, whose sources need OpenGL:
+struct TestLight : public Node
+{
+	static const Kind KIND = KIND_LIGHT;
+	TestLight() { setKind(KIND_LIGHT); }
+	string getType() { return "light"; }
+	int priority = 0;
+};
+
+struct TestMesh : public Node
+{
+	static const Kind KIND = KIND_MESH;
+	TestMesh() { setKind(KIND_MESH); }
+	string getType() { return "mesh"; }
+	unsigned int features = 1;
+};
+
+void testKindDispatch()
+{
+	Node node;
+	TestLight light;
+	TestMesh mesh;
+	ASSERT_WITH_MESSAGE(node.getKind() == Object::KIND_NODE && light.getKind() == Object::KIND_LIGHT && mesh.getKind() == Object::KIND_MESH, "wrong kind")
+	ASSERT_WITH_MESSAGE(node.as<Node>() == &node && node.as<TestLight>() == nullptr && node.as<TestMesh>() == nullptr, "wrong node downcast")
+	Node *base = &light;
+	ASSERT_WITH_MESSAGE(base->as<TestLight>() == &light && base->as<TestMesh>() == nullptr, "wrong light downcast")
+	base = &mesh;
+	ASSERT_WITH_MESSAGE(base->as<TestMesh>() == &mesh && base->as<TestLight>() == nullptr, "wrong mesh downcast")
+}
+
+void benchmarkKindDispatch()
+{
+	const unsigned int total = 100000;
+	const int runs = 20;
+	Pool<TestMesh> meshes;
+	Pool<TestLight> lights;
+	vector<Node *> nodes;
+	srand(3);
+	for (unsigned int i = 0; i < total; i++)
+		if (rand() % 100 == 0)
+			nodes.push_back(lights.get(lights.create()));
+		else if (rand() % 10 == 0)
+			nodes.push_back(new Node());
+		else
+			nodes.push_back(meshes.get(meshes.create()));
+	std::cout << "List construction benchmark (" << total << " nodes):" << std::endl;
+
+	// Same dispatch as List::addNode() and List::buildQueue(), before and after the kind tag:
+	vector<Node *> lightList, meshList;
+	lightList.reserve(total);
+	meshList.reserve(total);
+	unsigned int sink = 0;
+	auto start = std::chrono::high_resolution_clock::now();
+	for (int r = 0; r < runs; r++)
+	{
+		lightList.clear();
+		meshList.clear();
+		for (Node *node : nodes)
+		{
+			if (node->getType().compare("light") == 0)
+			{
+				lightList.push_back(node);
+				sink += dynamic_cast<TestLight *>(node)->priority;
+			}
+			else
+				meshList.push_back(node);
+		}
+		for (Node *node : meshList)
+		{
+			TestMesh *mesh = dynamic_cast<TestMesh *>(node);
+			sink += mesh != nullptr ? mesh->features : 0;
+		}
+	}
+	double before = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count() / runs;
+
+	start = std::chrono::high_resolution_clock::now();
+	for (int r = 0; r < runs; r++)
+	{
+		lightList.clear();
+		meshList.clear();
+		for (Node *node : nodes)
+		{
+			TestLight *light = node->as<TestLight>();
+			if (light != nullptr)
+			{
+				lightList.push_back(node);
+				sink -= light->priority;
+			}
+			else
+				meshList.push_back(node);
+		}
+		for (Node *node : meshList)
+		{
+			TestMesh *mesh = node->as<TestMesh>();
+			sink -= mesh != nullptr ? mesh->features : 0;
+		}
+	}
+	double after = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count() / runs;
+	ASSERT_WITH_MESSAGE(sink == 0, "both dispatches must find the same nodes")
+
+	std::cout << "   getType() and dynamic_cast: " << before << " ms" << std::endl;
+	std::cout << "   kind tag and static_cast: " << after << " ms" << std::endl;
+
+	for (Node *node : nodes)
+		if (node->getKind() == Object::KIND_NODE)
+			delete node;
+}
+
+void testReparenting()
+{
+	Node parent, other, a, b, c;
+	a.setParent(&parent);
+	b.setParent(&parent);
+	c.setParent(&parent);
+
+	// The last sibling takes the place of the removed node:
+	a.setParent(&other);
+	ASSERT_WITH_MESSAGE(parent.getChildren().size() == 2 && parent.getChildren()[0] == &c && parent.getChildren()[1] == &b, "wrong siblings after reparenting")
+	ASSERT_WITH_MESSAGE(other.getChildren().size() == 1 && a.getParent() == &other, "wrong new parent")
+	c.setParent(nullptr);
+	ASSERT_WITH_MESSAGE(parent.getChildren().size() == 1 && parent.getChildren()[0] == &b && c.getParent() == nullptr, "wrong detach")
+	b.setParent(&parent);
+	ASSERT_WITH_MESSAGE(parent.getChildren().size() == 1, "setting the same parent must not duplicate the child")
+
+	// Destroyed nodes leave the tree:
+	{
+		Node temporary;
+		temporary.setParent(&parent);
+		c.setParent(&temporary);
+	}
+	ASSERT_WITH_MESSAGE(parent.getChildren().size() == 1 && c.getParent() == nullptr, "destroyed nodes must be detached")
+	other.deleteChildren();
+	ASSERT_WITH_MESSAGE(other.getChildren().empty() && a.getParent() == nullptr, "deleted children are left without a parent")
+}
+
+void testRegistry()
+{
+	Node root, a, b, c;
+	root.setName("Root");
+	a.setName("Arm");
+	b.setName("Hand");
+	c.setName("Hand");
+	a.setParent(&root);
+	b.setParent(&a);
+	c.setParent(&root);
+
+	Registry registry(&root);
+	ASSERT_WITH_MESSAGE(registry.getCount() == 4 && registry.find(b.getId()) == &b && registry.find(12345678) == nullptr, "wrong id lookup")
+	ASSERT_WITH_MESSAGE(registry.find("Arm") == &a && registry.find("Hand") == &b && registry.find("Leg") == nullptr, "wrong name lookup")
+	unsigned int builds = registry.getBuilds();
+	for (int i = 0; i < 100; i++)
+		registry.find("Arm");
+	ASSERT_WITH_MESSAGE(registry.getBuilds() == builds, "lookups must not rebuild an unchanged index")
+
+	// Changes are picked up without rebuilding the index:
+	b.setParent(nullptr);
+	ASSERT_WITH_MESSAGE(registry.find(b.getId()) == nullptr && registry.find("Hand") == &c && registry.getCount() == 3, "detached nodes must leave the index")
+	a.setName("Leg");
+	ASSERT_WITH_MESSAGE(registry.find("Leg") == &a && registry.find("Arm") == nullptr, "renamed nodes must be found by their new name")
+	b.setParent(&c);
+	ASSERT_WITH_MESSAGE(registry.find(b.getId()) == &b && registry.find("Hand") == &b, "the node created first must win a shared name")
+	Node subtree, leaf;
+	leaf.setName("Finger");
+	leaf.setParent(&subtree);
+	subtree.setParent(&b);
+	ASSERT_WITH_MESSAGE(registry.find("Finger") == &leaf && registry.getCount() == 6, "attached subtrees must join the index")
+	int id = leaf.getId();
+	leaf.setId(12345678);
+	ASSERT_WITH_MESSAGE(registry.find(12345678) == &leaf && registry.find(id) == nullptr, "nodes must be found by their new id")
+	Node *destroyed = new Node();
+	destroyed->setParent(&leaf);
+	id = destroyed->getId();
+	ASSERT_WITH_MESSAGE(registry.find(id) == destroyed, "wrong id lookup")
+	delete destroyed;
+	ASSERT_WITH_MESSAGE(registry.find(id) == nullptr && registry.getCount() == 6, "destroyed nodes must leave the index")
+	ASSERT_WITH_MESSAGE(registry.getBuilds() == builds, "edits must not rebuild the index")
+
+	// The root of another registry keeps its own nodes:
+	Node other, otherChild;
+	otherChild.setParent(&other);
+	{
+		Registry nested(&other);
+		other.setParent(&a);
+		ASSERT_WITH_MESSAGE(registry.find(other.getId()) == nullptr && nested.find(otherChild.getId()) == &otherChild, "registries must not share nodes")
+	}
+	ASSERT_WITH_MESSAGE(registry.find(otherChild.getId()) == nullptr, "wrong id lookup")
+	subtree.setParent(nullptr);
+	ASSERT_WITH_MESSAGE(registry.find("Finger") == nullptr && registry.getCount() == 4, "detached subtrees must leave the index")
+
+	// Lookups from another thread while the owner edits the scene, as the render thread does during the simulation:
+	std::atomic<bool> editing(true);
+	std::thread owner([&]() {
+		for (int c = 0; c < 20000; c++)
+		{
+			subtree.setParent(c % 2 ? nullptr : &a);
+			leaf.setName("Finger" + std::to_string(c % 50));
+		}
+		editing = false;
+	});
+	while (editing)
+	{
+		Node *n = registry.find(leaf.getId());
+		ASSERT_WITH_MESSAGE(n == nullptr || n == &leaf, "wrong concurrent lookup")
+		n = registry.find("Finger7");
+		ASSERT_WITH_MESSAGE(n == nullptr || n == &leaf, "wrong concurrent lookup")
+	}
+	owner.join();
+	ASSERT_WITH_MESSAGE(registry.getCount() == 4 && registry.find(leaf.getId()) == nullptr, "the index must survive concurrent lookups")
+}
+
+void benchmarkRegistry()
+{
+	const unsigned int total = 100000;
+	const unsigned int lookups = 1000;
+	std::cout << "Scene registry benchmark (" << total << " nodes, " << lookups << " lookups):" << std::endl;
+	Pool<Node> pool;
+	vector<void *> filler;
+	srand(4);
+	unsigned int count = 0;
+	vector<Node *> nodes;
+	Node *root = buildScene(count, total, 0, [&pool, &nodes](unsigned int id) {
+		Node *node = pool.get(pool.create());
+		node->setName("Registry_" + std::to_string(id));
+		nodes.push_back(node);
+		return node;
+	}, filler);
+
+	vector<int> ids;
+	for (unsigned int i = 0; i < lookups; i++)
+		ids.push_back(nodes[rand() % total]->getId());
+	int sink = 0;
+	auto start = std::chrono::high_resolution_clock::now();
+	for (int id : ids)
+		sink += root->search(id)->getId();
+	double search = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+
+	start = std::chrono::high_resolution_clock::now();
+	Registry registry(root);
+	unsigned int builds = registry.getBuilds();
+	double build = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+	start = std::chrono::high_resolution_clock::now();
+	for (int id : ids)
+		sink -= registry.find(id)->getId();
+	double byId = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+	start = std::chrono::high_resolution_clock::now();
+	for (int id : ids)
+		sink += registry.find("Registry_" + std::to_string(id - nodes[0]->getId()))->getId() - id;
+	double byName = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+	ASSERT_WITH_MESSAGE(sink == 0, "lookups must find the same nodes")
+
+	// Moving every child of a wide node to another one:
+	Node *from = pool.get(pool.create());
+	Node *to = pool.get(pool.create());
+	for (unsigned int i = 0; i < 10000; i++)
+		pool.get(pool.create())->setParent(from);
+	start = std::chrono::high_resolution_clock::now();
+	while (!from->getChildren().empty())
+		from->getChildren()[rand() % from->getChildren().size()]->setParent(to);
+	double reparent = std::chrono::duration<double, std::micro>(std::chrono::high_resolution_clock::now() - start).count() / 10000;
+	ASSERT_WITH_MESSAGE(to->getChildren().size() == 10000, "wrong reparenting")
+
+	// Editing the scene between lookups, as tools do:
+	builds = registry.getBuilds();
+	start = std::chrono::high_resolution_clock::now();
+	for (unsigned int i = 0; i < lookups; i++)
+	{
+		Node *moved = nodes[1 + rand() % (total - 1)];
+		Node *parent = nodes[rand() % total];
+		if (moved->getChildren().empty() && parent != moved)		// Leaves only, no cycles
+			moved->setParent(parent);
+		sink += registry.find(ids[i])->getId() - ids[i];
+	}
+	double interleaved = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+	ASSERT_WITH_MESSAGE(sink == 0 && registry.getBuilds() == builds && registry.getCount() == total, "edits must keep the index without rebuilding it")
+
+	std::cout << "   recursive search: " << search << " ms" << std::endl;
+	std::cout << "   registry: " << build << " ms to build, " << byId << " ms by id, " << byName << " ms by name" << std::endl;
+	std::cout << "   reparenting out of 10000 siblings: " << reparent << " us per node" << std::endl;
+	std::cout << "   " << lookups << " reparentings and lookups in turn: " << interleaved << " ms" << std::endl;
+
+	for (void *p : filler)
+		::operator delete(p);
+}
+
+void testJobSystem()
+{
+	JobSystem jobs(4);
+	ASSERT_WITH_MESSAGE(jobs.getThreads() == 4 && JobSystem::getWorker() == 0, "wrong threads")
+
+	// Every index exactly once:
+	vector<std::atomic<int>> hits(100000);
+	jobs.parallelFor("test", (unsigned int)hits.size(), 100, [&hits](unsigned int begin, unsigned int end) {
+		for (unsigned int i = begin; i < end; i++)
+			hits[i]++;
+	});
+	for (std::atomic<int> &h : hits)
+		ASSERT_WITH_MESSAGE(h == 1, "every index must be run once")
+
+	// More jobs than a queue holds, nested loops:
+	std::atomic<unsigned int> sum(0);
+	jobs.parallelFor("outer", 64, 1, [&](unsigned int, unsigned int) {
+		jobs.parallelFor("inner", JobSystem::QUEUE_SIZE, 1, [&](unsigned int begin, unsigned int end) {
+			sum += end - begin;
+		});
+	});
+	ASSERT_WITH_MESSAGE(sum == 64 * JobSystem::QUEUE_SIZE, "nested loops must run every job")
+
+	// Dependencies: the second job waits on the first one's counter, helping meanwhile:
+	struct Chain
+	{
+		JobSystem *jobs;
+		JobSystem::Counter first{ 0 };
+		std::atomic<int> value{ 0 };
+		int seen = -1;
+	} chain;
+	chain.jobs = &jobs;
+	JobSystem::Counter done(0);
+	jobs.run("first", [](void *data, unsigned int, unsigned int) {
+		std::this_thread::sleep_for(std::chrono::milliseconds(5));
+		((Chain *)data)->value = 42;
+	}, &chain, 0, 1, chain.first);
+	jobs.run("second", [](void *data, unsigned int, unsigned int) {
+		Chain *chain = (Chain *)data;
+		chain->jobs->wait(chain->first);
+		chain->seen = chain->value;
+	}, &chain, 0, 1, done);
+	jobs.wait(done);
+	ASSERT_WITH_MESSAGE(chain.seen == 42 && chain.first == 0, "a job must see the results of the jobs it waits on")
+
+	// Trace hook:
+	std::atomic<unsigned int> traced(0);
+	std::atomic<bool> ordered(true);
+	jobs.getExecuted();
+	jobs.setTrace([&](const char *name, unsigned int worker, long long start, long long end) {
+		if (strcmp(name, "traced") == 0 && worker < 4 && start <= end)
+			traced++;
+		else
+			ordered = false;
+	});
+	jobs.parallelFor("traced", 1000, 10, [](unsigned int, unsigned int) {});
+	jobs.setTrace(nullptr);
+	ASSERT_WITH_MESSAGE(traced == 100 && ordered && jobs.getExecuted() == 100, "every job must be traced")
+
+	// Culling gives the same result on the job system:
+	Culling serial, parallel;
+	parallel.setJobSystem(&jobs);
+	for (int c = 0; c < 5000; c++)
+	{
+		glm::mat4 m = box(rnd() * 80.0f - 40.0f, rnd() * 80.0f - 20.0f);
+		serial.add(m, 0.9f, boxMin, boxMax);
+		parallel.add(m, 0.9f, boxMin, boxMax);
+	}
+	glm::mat4 viewProj[2] = { cameraViewProj(glm::vec3(-0.03f, 0.0f, 0.0f)), cameraViewProj(glm::vec3(0.03f, 0.0f, 0.0f)) };
+	serial.cull(viewProj, 2);
+	parallel.cull(viewProj, 2);
+	ASSERT_WITH_MESSAGE(serial.getCulled() == parallel.getCulled() && serial.getDrawn(0) == parallel.getDrawn(0) && serial.getDrawn(1) == parallel.getDrawn(1), "wrong parallel culling stats")
+	for (unsigned int c = 0; c < 5000; c++)
+		ASSERT_WITH_MESSAGE(serial.getViewMask(c) == parallel.getViewMask(c), "wrong parallel culling")
+}
+
+void benchmarkJobSystem()
+{
+	const unsigned int total = 200000;
+	const int runs = 10;
+	Pool<Node> pool;
+	vector<void *> filler;
+	Node *root = buildTransformScene(pool, total, filler);
+	vector<glm::mat4> models(total);
+	for (glm::mat4 &m : models)
+		m = box(rnd() * 200.0f - 100.0f, rnd() * 200.0f - 50.0f);
+	glm::mat4 viewProj[2] = { cameraViewProj(glm::vec3(-0.03f, 0.0f, 0.0f)), cameraViewProj(glm::vec3(0.03f, 0.0f, 0.0f)) };
+	std::cout << "Job system scaling benchmark (" << total << " transforms and bounds, "
+		<< std::thread::hardware_concurrency() << " hardware threads):" << std::endl;
+
+	vector<unsigned int> counts;
+	for (unsigned int t = 1; t < std::thread::hardware_concurrency(); t *= 2)
+		counts.push_back(t);
+	counts.push_back(glm::max(std::thread::hardware_concurrency(), 1u));
+	for (unsigned int threads : counts)
+	{
+		JobSystem jobs(threads);
+		Hierarchy hierarchy;
+		hierarchy.setJobSystem(&jobs);
+		hierarchy.build(root);
+		Culling culling;
+		culling.setJobSystem(&jobs);
+		for (const glm::mat4 &m : models)
+			culling.add(m, 0.9f, boxMin, boxMax);
+
+		auto start = std::chrono::high_resolution_clock::now();
+		for (int r = 0; r < runs; r++)
+			hierarchy.update(glm::mat4(1.0f));
+		double transforms = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count() / runs;
+		start = std::chrono::high_resolution_clock::now();
+		for (int r = 0; r < runs; r++)
+			culling.cull(viewProj, 2);
+		double cull = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count() / runs;
+		jobs.getExecuted();
+		unsigned int stolen = jobs.getStolen();
+		std::cout << "   " << threads << " threads: transforms " << transforms << " ms, culling " << cull << " ms, "
+			<< stolen / (2 * runs) << " jobs stolen per pass" << std::endl;
+	}
+
+	for (void *p : filler)
+		::operator delete(p);
+}
+
+void testSimulation()
+{
+	// Root moved by the update, a child, a camera and two lights with different priorities:
+	Node root, child;
+	Camera camera, outside;
+	Light low, high;
+	child.setParent(&root);
+	child.setPosMatrix(glm::translate(glm::mat4(1.0f), glm::vec3(0.0f, 2.0f, 0.0f)));
+	camera.setParent(&root);
+	low.setParent(&root);
+	high.setParent(&child);
+	camera.setPosMatrix(glm::mat4(1.0f));
+	low.setPosMatrix(glm::mat4(1.0f));
+	high.setPosMatrix(glm::mat4(1.0f));
+	low.setPriority(1);
+	high.setPriority(5);
+	high.toggle();
+
+	Simulation simulation;
+	std::atomic<unsigned long long> updates(0);
+	std::thread::id simulationThread;
+	simulation.setCamera(&camera);
+	simulation.start(&root, [&](double) {
+		root.setPosMatrix(glm::translate(glm::mat4(1.0f), glm::vec3((float)++updates, 0.0f, 0.0f)));
+		simulationThread = std::this_thread::get_id();
+	}, 500.0);
+	ASSERT_WITH_MESSAGE(simulation.isRunning(), "the simulation must be running")
+
+	// Posted events run on the simulation thread, before the next update:
+	std::atomic<bool> posted(false);
+	std::thread::id postedThread;
+	simulation.post([&]() {
+		postedThread = std::this_thread::get_id();
+		posted = true;
+	});
+
+	// Every snapshot is complete and consistent, whatever the update is doing meanwhile:
+	unsigned long long last = 0;
+	unsigned int seen = 0;
+	auto until = std::chrono::high_resolution_clock::now() + std::chrono::milliseconds(200);
+	while (std::chrono::high_resolution_clock::now() < until)
+	{
+		const Snapshot *snapshot = simulation.acquire();
+		if (snapshot == nullptr)
+			continue;
+		ASSERT_WITH_MESSAGE(snapshot->getStep() >= last, "snapshots must not go back in time")
+		if (snapshot->getStep() != last)
+			seen++;
+		last = snapshot->getStep();
+
+		ASSERT_WITH_MESSAGE(snapshot->getCount() == 5 && snapshot->getRoot() == &root && snapshot->getCamera() == &camera, "wrong snapshot contents")
+		float x = snapshot->getWorld(0)[3].x;
+		ASSERT_WITH_MESSAGE(x == (float)snapshot->getStep(), "the snapshot must match its step")
+		for (unsigned int i = 1; i < snapshot->getCount(); i++)
+			ASSERT_WITH_MESSAGE(snapshot->getWorld(i)[3].x == x, "torn snapshot")
+		const Snapshot::CameraState *state = snapshot->findCamera(&camera);
+		ASSERT_WITH_MESSAGE(snapshot->getCameraCount() == 1 && state != nullptr && state->world[3].x == x && state->view[3].x == -x, "wrong camera matrices")
+		ASSERT_WITH_MESSAGE(state->projection == camera.getProjMatrix() && snapshot->findCamera(&outside) == nullptr, "wrong cameras")
+
+		// Highest priority first, off lights kept but marked:
+		ASSERT_WITH_MESSAGE(snapshot->getLightCount() == 2, "wrong light count")
+		const Snapshot::LightState &first = snapshot->getLight(0), &second = snapshot->getLight(1);
+		ASSERT_WITH_MESSAGE(first.light == &high && !first.on && second.light == &low && second.on, "wrong light order")
+		ASSERT_WITH_MESSAGE(second.data.position == glm::vec4(x, 0.0f, 0.0f, 1.0f), "wrong light data")
+	}
+	simulation.stop();
+	ASSERT_WITH_MESSAGE(!simulation.isRunning() && seen > 10, "too few snapshots")
+	ASSERT_WITH_MESSAGE(posted && postedThread == simulationThread && postedThread != std::this_thread::get_id(), "posted events must run on the simulation thread")
+	ASSERT_WITH_MESSAGE(simulation.getSteps() == updates, "wrong step count")
+
+	// An active camera outside the tree is captured too, from the next snapshot on:
+	outside.setPosMatrix(glm::translate(glm::mat4(1.0f), glm::vec3(0.0f, 0.0f, 3.0f)));
+	simulation.setCamera(&outside);
+	simulation.start(&root, Simulation::Update(), 500.0);
+	const Snapshot *snapshot = nullptr;
+	while (snapshot == nullptr || snapshot->getCamera() != &outside)
+		snapshot = simulation.acquire();
+	simulation.stop();
+	const Snapshot::CameraState *outsideState = snapshot->findCamera(&outside);
+	ASSERT_WITH_MESSAGE(snapshot->getCameraCount() == 2 && outsideState != nullptr && outsideState->world[3].z == 3.0f && snapshot->findCamera(&camera) != nullptr, "the active camera must be captured")
+
+	// A subtree is listed from its range of the snapshot, with its own lights only:
+	unsigned int index = snapshot->find(&child);
+	ASSERT_WITH_MESSAGE(index != Snapshot::NOT_FOUND && snapshot->find(&outside) == Snapshot::NOT_FOUND, "wrong snapshot lookup")
+	List subtree;
+	subtree.fill(snapshot, index);
+	ASSERT_WITH_MESSAGE((subtree.getNodes() == vector<Node *>{ &high, &child }) && subtree.getLightsCount() == 1, "wrong subtree list")
+	subtree.fill(snapshot);
+	ASSERT_WITH_MESSAGE(subtree.getNodes().size() == 5 && subtree.getLightsCount() == 2, "the whole snapshot must be listed")
+}
+
+/**
+ * Busy wait, a stand-in for CPU work that does not depend on the number of cores
+ */
+void spin(double ms)
+{
+	auto until = std::chrono::high_resolution_clock::now() + std::chrono::duration_cast<std::chrono::high_resolution_clock::duration>(std::chrono::duration<double, std::milli>(ms));
+	while (std::chrono::high_resolution_clock::now() < until);
+}
+
+void benchmarkSimulation()
+{
+	// Update taking 1 ms, every 10th one 15 ms (a physics spike, a level streaming hitch), rendering 2 ms, 90 Hz budget:
+	const int frames = 270;
+	const double budget = 1000.0 / 90.0;
+	unsigned int updates = 0;
+	auto update = [&updates](double) {
+		std::this_thread::sleep_for(std::chrono::milliseconds(updates++ % 10 == 9 ? 15 : 1));
+	};
+	auto report = [budget](const char *label, const vector<double> &times) {
+		double mean = 0.0, variance = 0.0;
+		unsigned int over = 0;
+		for (double t : times)
+			mean += t / times.size();
+		for (double t : times)
+		{
+			variance += (t - mean) * (t - mean) / times.size();
+			if (t > budget)
+				over++;
+		}
+		std::cout << "   " << label << ": " << mean << " ms per frame, deviation " << sqrt(variance) << " ms, "
+			<< over << " frames over " << budget << " ms" << std::endl;
+	};
+	std::cout << "Simulation thread benchmark (" << frames << " frames):" << std::endl;
+
+	// Update and render on the same thread:
+	vector<double> times;
+	auto previous = std::chrono::high_resolution_clock::now();
+	for (int f = 0; f < frames; f++)
+	{
+		update(0.0);
+		spin(2.0);
+		auto now = std::chrono::high_resolution_clock::now();
+		times.push_back(std::chrono::duration<double, std::milli>(now - previous).count());
+		previous = now;
+	}
+	report("single thread", times);
+
+	// Render thread taking the latest snapshot:
+	Node root, child;
+	child.setParent(&root);
+	root.setPosMatrix(glm::mat4(1.0f));
+	child.setPosMatrix(glm::mat4(1.0f));
+	Simulation simulation;
+	updates = 0;
+	simulation.start(&root, update, 90.0);
+	while (simulation.acquire() == nullptr)
+		std::this_thread::yield();
+	times.clear();
+	previous = std::chrono::high_resolution_clock::now();
+	for (int f = 0; f < frames; f++)
+	{
+		simulation.acquire();
+		spin(2.0);
+		auto now = std::chrono::high_resolution_clock::now();
+		times.push_back(std::chrono::duration<double, std::milli>(now - previous).count());
+		previous = now;
+	}
+	simulation.stop();
+	report("simulation thread", times);
+}
+
+/**
+ * Stand-in for an OpenXR runtime's frame loop: displays at 90 Hz, xrWaitFrame() blocks until the next vsync and
+ * predicts the frame to be displayed one period later
+ */
+struct TestRuntime
+{
+	const long long period = 11111111;
+	std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+	std::mutex mutex;
+	long long lastVsync = 0;
+	bool outstanding = false;		//waited, not begun yet
+	bool violated = false;			//two waits without a begin
+	unsigned int late = 0;
+
+	long long now()
+	{
+		return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::high_resolution_clock::now() - start).count();
+	}
+
+	bool wait(FramePacer::Frame &frame)
+	{
+		long long vsync;
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			if (outstanding)
+				violated = true;
+			vsync = glm::max(now() / period + 1, lastVsync + 1);
+			lastVsync = vsync;
+		}
+		std::this_thread::sleep_until(start + std::chrono::nanoseconds(vsync * period));
+		std::lock_guard<std::mutex> lock(mutex);
+		outstanding = true;
+		frame.displayTime = (vsync + 1) * period;
+		frame.period = period;
+		frame.shouldRender = true;
+		return true;
+	}
+
+	void begin()
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		outstanding = false;
+	}
+
+	void end(long long displayTime)
+	{
+		if (now() > displayTime)
+			late++;
+	}
+};
+
+/**
+ * Frames rendered in "seconds" with "cpu" milliseconds of preparation and submission each, waiting for the frames on
+ * the render thread or on a frame pacing thread. Returns the frame rate, reports the latency and the missed frames.
+ */
+double runFrames(TestRuntime &runtime, bool pipelined, double cpu, double seconds)
+{
+	FramePacer pacer;
+	if (pipelined)
+		pacer.start([&runtime](FramePacer::Frame &frame) { return runtime.wait(frame); });
+
+	unsigned int frames = 0;
+	long long latency = 0;
+	auto start = std::chrono::high_resolution_clock::now();
+	std::chrono::duration<double> elapsed(0.0);
+	while (elapsed.count() < seconds)
+	{
+		FramePacer::Frame frame;
+		long long waited;
+		if (pipelined)
+		{
+			ASSERT_WITH_MESSAGE(pacer.acquire(frame), "the pacer must hand out frames")
+			waited = runtime.now();
+			runtime.begin();
+			pacer.begun();
+		}
+		else
+		{
+			runtime.wait(frame);
+			waited = runtime.now();
+			runtime.begin();
+		}
+		std::this_thread::sleep_for(std::chrono::microseconds((long long)(cpu * 1000.0)));
+		runtime.end(frame.displayTime);
+		if (pipelined)
+			pacer.submitted();
+		latency += frame.displayTime - waited;
+		frames++;
+		elapsed = std::chrono::high_resolution_clock::now() - start;
+	}
+	pacer.stop();
+
+	std::cout << "   " << (pipelined ? "pacing thread" : "render thread") << ", " << cpu << " ms per frame: "
+		<< frames / elapsed.count() << " fps, " << latency / frames / 1000 << " us from wait to display, "
+		<< runtime.late << " frames late" << std::endl;
+	return frames / elapsed.count();
+}
+
+void testFramePacer()
+{
+	// Display times go forward, one wait per begun frame:
+	TestRuntime runtime;
+	FramePacer pacer;
+	std::atomic<unsigned int> waits(0);
+	pacer.start([&](FramePacer::Frame &frame) {
+		waits++;
+		return runtime.wait(frame);
+	});
+	ASSERT_WITH_MESSAGE(pacer.isRunning(), "the pacer must be running")
+	long long previous = 0;
+	for (int f = 0; f < 20; f++)
+	{
+		FramePacer::Frame frame;
+		ASSERT_WITH_MESSAGE(pacer.acquire(frame), "the pacer must hand out frames")
+		ASSERT_WITH_MESSAGE(frame.displayTime > previous && frame.period == runtime.period && frame.shouldRender, "wrong frame")
+		previous = frame.displayTime;
+		runtime.begin();
+		pacer.begun();
+		std::this_thread::sleep_for(std::chrono::milliseconds(4));
+		pacer.submitted();
+	}
+	ASSERT_WITH_MESSAGE(!runtime.violated, "a frame must begin before the next wait")
+	ASSERT_WITH_MESSAGE(pacer.getFrames() == 20 && pacer.getLatency() > 0, "wrong stats")
+
+	// At most one frame ahead: no wait while a frame is acquired but not begun
+	FramePacer::Frame frame;
+	pacer.acquire(frame);
+	unsigned int before = waits;
+	std::this_thread::sleep_for(std::chrono::milliseconds(30));
+	ASSERT_WITH_MESSAGE(waits == before, "the pacer must not wait for a frame before the previous one has begun")
+
+	// Stopping with a frame in hand:
+	pacer.stop();
+	ASSERT_WITH_MESSAGE(!pacer.isRunning() && !pacer.acquire(frame), "a stopped pacer has no frames")
+
+	// A failed wait stops the pacer, the render thread is not left blocked:
+	std::cout << "(expected error) ";
+	pacer.start([](FramePacer::Frame &) { return false; });
+	ASSERT_WITH_MESSAGE(!pacer.acquire(frame) && !pacer.isRunning(), "a failed wait must stop the pacer")
+}
+
+void benchmarkFramePacer()
+{
+	// Within the frame budget and over it:
+	std::cout << "Frame pacing benchmark (90 Hz runtime):" << std::endl;
+	for (double cpu : { 6.0, 14.0 })
+	{
+		TestRuntime serial, pipelined;
+		double serialFps = runFrames(serial, false, cpu, 1.0);
+		double pipelinedFps = runFrames(pipelined, true, cpu, 1.0);
+		ASSERT_WITH_MESSAGE(!serial.violated && !pipelined.violated, "a frame must begin before the next wait")
+		if (cpu > 1000.0 / 90.0)
+			ASSERT_WITH_MESSAGE(pipelinedFps > serialFps, "pipelined frames must overlap the wait")
+	}
+}
+
+/**
+ * Synthetic GPU: a frame costs "fixed" plus "load" milliseconds at full resolution, scaled with the pixels, and its
+ * time is read back 3 frames late, like the engine's timer queries. Returns the frames over the budget.
+ */
+unsigned int runResolutionTrace(DynamicResolution &controller, const vector<double> &load, double fixed, vector<float> &scales)
+{
+	const unsigned int latency = 3;
+	vector<double> times;
+	unsigned int missed = 0;
+	scales.clear();
+	for (size_t f = 0; f < load.size(); f++)
+	{
+		float scale = controller.getScale();
+		scales.push_back(scale);
+		times.push_back(fixed + load[f] * scale * scale);
+		if (times.back() > controller.getBudget())
+			missed++;
+		controller.update(f >= latency ? times[f - latency] : 0.0);
+	}
+	return missed;
+}
+
+void testDynamicResolution()
+{
+	const double budget = 1000.0 / 90.0;
+	vector<float> scales;
+	unsigned int logged = 0;
+	float lastTo = 0.0f;
+	auto log = [&](unsigned int, float from, float to, double gpuTime) {
+		logged++;
+		lastTo = to;
+		ASSERT_WITH_MESSAGE(from != to && gpuTime > 0.0, "wrong log entry")
+	};
+
+	// Light load: full resolution, nothing to log
+	DynamicResolution light(budget, 0.5f, 1.0f);
+	light.setLog(log);
+	ASSERT_WITH_MESSAGE(runResolutionTrace(light, vector<double>(300, 5.0), 1.0, scales) == 0 && light.getScale() == 1.0f && logged == 0, "light load must keep the full resolution")
+
+	// Spike from frame 100 to 300: the scale drops within a few frames, then recovers slowly, by limited steps
+	vector<double> load(800, 6.0);
+	for (int f = 100; f < 300; f++)
+		load[f] = 18.0;
+	DynamicResolution spike(budget, 0.5f, 1.0f);
+	spike.setLog(log);
+	unsigned int missed = runResolutionTrace(spike, load, 1.0, scales);
+	ASSERT_WITH_MESSAGE(missed <= 8, "the controller must react to the spike within a few frames")
+	ASSERT_WITH_MESSAGE(scales[120] < 0.9f && scales[299] >= 0.5f, "wrong scale during the spike")
+	for (int f = 301; f < 800; f++)
+		ASSERT_WITH_MESSAGE(scales[f] >= scales[f - 1] && scales[f] - scales[f - 1] <= 0.05f + 1e-5f, "the scale must go back up by limited steps")
+	ASSERT_WITH_MESSAGE(scales.back() == 1.0f, "the full resolution must come back after the spike")
+	ASSERT_WITH_MESSAGE(logged == spike.getChanges() && logged > 0 && lastTo == 1.0f, "every change must be logged")
+
+	// Noise inside the hysteresis band: no change
+	vector<double> noisy(1000);
+	for (double &l : noisy)
+		l = budget * 0.8 - 1.0 + (rnd() - 0.5) * budget * 0.15;
+	DynamicResolution steady(budget, 0.5f, 1.0f);
+	runResolutionTrace(steady, noisy, 1.0, scales);
+	ASSERT_WITH_MESSAGE(steady.getChanges() == 0, "noise inside the band must not change the scale")
+
+	// Bounds:
+	DynamicResolution bounded(budget, 0.6f, 0.9f);
+	ASSERT_WITH_MESSAGE(bounded.getScale() == 0.9f, "the controller must start at the largest scale")
+	runResolutionTrace(bounded, vector<double>(200, 100.0), 1.0, scales);
+	ASSERT_WITH_MESSAGE(bounded.getScale() == 0.6f, "the scale must stop at the lower bound")
+	runResolutionTrace(bounded, vector<double>(2000, 1.0), 1.0, scales);
+	ASSERT_WITH_MESSAGE(bounded.getScale() == 0.9f, "the scale must stop at the upper bound")
+	bounded.reset(2.0f);
+	ASSERT_WITH_MESSAGE(bounded.getScale() == 0.9f && bounded.update(0.0) == 0.9f, "reset and missing timings must respect the bounds")
+}
+
+void benchmarkDynamicResolution()
+{
+	// Load spikes of 2 to 60 frames, up to twice the budget:
+	const double budget = 1000.0 / 90.0;
+	vector<double> load;
+	while (load.size() < 9000)
+	{
+		unsigned int calm = 60 + (unsigned int)(rnd() * 300.0f), spike = 2 + (unsigned int)(rnd() * 58.0f);
+		double heavy = budget * (1.0 + rnd());
+		load.insert(load.end(), calm, budget * 0.6);
+		load.insert(load.end(), spike, heavy);
+	}
+
+	vector<float> scales;
+	DynamicResolution fixed(budget, 1.0f, 1.0f);
+	unsigned int fixedMissed = runResolutionTrace(fixed, load, 1.0, scales);
+	DynamicResolution dynamic(budget, 0.5f, 1.0f);
+	unsigned int dynamicMissed = runResolutionTrace(dynamic, load, 1.0, scales);
+	double mean = 0.0;
+	for (float scale : scales)
+		mean += scale / scales.size();
+	std::cout << "Dynamic resolution benchmark (" << load.size() << " frames with load spikes):" << std::endl;
+	std::cout << "   fixed resolution: " << fixedMissed << " frames over budget" << std::endl;
+	std::cout << "   dynamic resolution: " << dynamicMissed << " frames over budget, " << dynamic.getChanges() << " changes, mean scale " << mean << std::endl;
+	ASSERT_WITH_MESSAGE(dynamicMissed * 3 < fixedMissed, "dynamic resolution must hold the frame rate")
+}
+
+/**
+ * True if a pixel of the eye outside the inset samples the periphery's hole when upscaled with bilinear filtering.
+ */
+bool foveationReadsHole(const Foveation &f, unsigned int width, unsigned int height)
+{
+	const Foveation::Rect &inset = f.getInset();
+	const Foveation::Rect &hole = f.getHole();
+	float toPeripheryX = (float)f.getPeripheryWidth() / width;
+	float toPeripheryY = (float)f.getPeripheryHeight() / height;
+	for (int y = 0; y < (int)height; y++)
+		for (int x = 0; x < (int)width; x++)
+		{
+			if (x >= inset.x && x < inset.x + inset.width && y >= inset.y && y < inset.y + inset.height)
+				continue;
+			int sx = (int)floor((x + 0.5f) * toPeripheryX - 0.5f);
+			int sy = (int)floor((y + 0.5f) * toPeripheryY - 0.5f);
+			for (int ty = sy; ty <= sy + 1; ty++)
+				for (int tx = sx; tx <= sx + 1; tx++)
+					if (tx >= hole.x && tx < hole.x + hole.width && ty >= hole.y && ty < hole.y + hole.height)
+						return true;
+		}
+	return false;
+}
+
+void testFoveation()
+{
+	// Centered inset, half resolution periphery:
+	Foveation f(0.4f, 0.4f, 0.5f);
+	f.layout(1000, 1000, glm::vec2(0.0f));
+	const Foveation::Rect &inset = f.getInset();
+	const Foveation::Rect &hole = f.getHole();
+	ASSERT_WITH_MESSAGE(inset.x == 300 && inset.y == 300 && inset.width == 400 && inset.height == 400, "wrong inset")
+	ASSERT_WITH_MESSAGE(f.getPeripheryWidth() == 500 && f.getPeripheryHeight() == 500, "wrong periphery size")
+	ASSERT_WITH_MESSAGE(hole.x == 151 && hole.y == 151 && hole.width == 198 && hole.height == 198, "wrong hole")
+	ASSERT_WITH_MESSAGE(f.getFullPixels() == 1000000 && f.getShadedPixels() == 500ull * 500 - 198ull * 198 + 400ull * 400, "wrong shaded pixels")
+
+	// The upscale never reads the hole, whatever the sizes, scales and centers:
+	const glm::vec2 centers[] = { glm::vec2(0.0f), glm::vec2(-0.15f, 0.1f), glm::vec2(0.33f, -0.27f) };
+	const float scales[] = { 0.5f, 0.33f, 0.7f };
+	for (const glm::vec2 &center : centers)
+		for (float scale : scales)
+		{
+			Foveation g(0.35f, 0.45f, scale);
+			g.layout(317, 289, center);
+			ASSERT_WITH_MESSAGE(g.getHole().width > 0 && !foveationReadsHole(g, 317, 289), "the periphery must be shaded wherever the upscale reads it")
+			ASSERT_WITH_MESSAGE(g.getShadedPixels() < g.getFullPixels(), "foveation must shade fewer pixels")
+		}
+
+	// Off-center projection: the inset follows the view direction, and stays inside the viewport:
+	glm::vec2 center = Foveation::getCenter(glm::frustum(-1.0f, 0.5f, -0.75f, 0.75f, 0.1f, 100.0f));
+	ASSERT_WITH_MESSAGE(fabs(center.x - 1.0f / 3.0f) < 1e-5f && fabs(center.y) < 1e-5f, "wrong projection center")
+	ASSERT_WITH_MESSAGE(glm::length(Foveation::getCenter(glm::perspective(1.5f, 0.9f, 0.1f, 100.0f))) < 1e-5f, "a symmetric projection is centered")
+	Foveation edge(0.5f, 0.5f, 0.5f);
+	edge.layout(400, 400, glm::vec2(0.9f, -0.9f));
+	const Foveation::Rect &clamped = edge.getInset();
+	ASSERT_WITH_MESSAGE(clamped.x + clamped.width == 400 && clamped.y == 0 && clamped.width == 120 && clamped.height == 120, "the inset must be clamped to the viewport")
+	ASSERT_WITH_MESSAGE(!foveationReadsHole(edge, 400, 400), "a clamped inset must keep the filtering margin")
+
+	// An inset smaller than the filtering margin leaves no hole:
+	Foveation tiny(0.01f, 0.01f, 0.5f);
+	tiny.layout(200, 200, glm::vec2(0.0f));
+	ASSERT_WITH_MESSAGE(tiny.getHole().width == 0 && tiny.getHole().height == 0, "a tiny inset must not leave a hole")
+
+	// Settings are clamped:
+	Foveation clamp(2.0f, -1.0f, 0.0f);
+	ASSERT_WITH_MESSAGE(clamp.getRadiusX() == 1.0f && clamp.getRadiusY() == 0.0f && clamp.getScale() > 0.0f, "wrong settings")
+}
+
+void benchmarkFoveation()
+{
+	// Pixels shaded per eye at a typical recommended resolution, from the layout: the samples actually passed are in the engine stats
+	const unsigned int width = 1440, height = 1600;
+	const float radii[] = { 0.25f, 0.35f, 0.5f };
+	const float scales[] = { 0.5f, 0.33f };
+	std::cout << "Foveation benchmark (" << width << "x" << height << " per eye):" << std::endl;
+	for (float scale : scales)
+		for (float radius : radii)
+		{
+			Foveation f(radius, radius, scale);
+			f.layout(width, height, glm::vec2(0.0f));
+			double shaded = (double)f.getShadedPixels() / f.getFullPixels();
+			std::cout << "   inset radius " << radius << ", periphery scale " << scale << ": " << 100.0 * shaded << "% of the pixels shaded (estimate)" << std::endl;
+			ASSERT_WITH_MESSAGE(shaded < radius * radius + scale * scale + 0.01f, "foveation must save fill rate")
+		}
+}
+void testQuadLayerOrder()
+{
+	// Added in this order: released, hidden or not yet released:
+	struct { int order; bool visible; bool rendered; } added[] = {
+		{ 1, true, true }, { -1, true, true }, { 0, true, true }, { 2, false, true }, { -2, true, false }, { -1, true, true }, { 3, true, true } };
+	vector<OvXR::QuadLayer> quads;
+	vector<unsigned int> order;
+	for (auto &a : added)
+	{
+		OvXR::QuadLayer quad = {};
+		quad.order = a.order;
+		quad.visible = a.visible;
+		quad.rendered = a.rendered;
+		quads.push_back(quad);
+		order.push_back((unsigned int)order.size());
+		OvXR::sortQuadLayers(quads, order);
+	}
+	ASSERT_WITH_MESSAGE((order == vector<unsigned int>{ 4, 1, 5, 2, 0, 3, 6 }), "quads must be sorted by order, equal orders in sequence")
+
+	// Back to front: negative orders behind the projection layer, order 0 and up in front of it:
+	XrCompositionLayerProjection projection = {};
+	auto header = [](void *layer) { return reinterpret_cast<XrCompositionLayerBaseHeader *>(layer); };
+	vector<XrCompositionLayerBaseHeader *> layers;
+	OvXR::composeLayers(quads, order, projection, layers);
+	ASSERT_WITH_MESSAGE((layers == vector<XrCompositionLayerBaseHeader *>{ header(&quads[1].layer), header(&quads[5].layer), header(&projection),
+		header(&quads[2].layer), header(&quads[0].layer), header(&quads[6].layer) }), "wrong composition order")
+
+	// Only quads behind, and no quads at all: the projection layer comes last:
+	vector<unsigned int> behind = { 1, 5 };
+	OvXR::composeLayers(quads, behind, projection, layers);
+	ASSERT_WITH_MESSAGE((layers == vector<XrCompositionLayerBaseHeader *>{ header(&quads[1].layer), header(&quads[5].layer), header(&projection) }), "the projection layer must be in front")
+	OvXR::composeLayers(quads, {}, projection, layers);
+	ASSERT_WITH_MESSAGE((layers == vector<XrCompositionLayerBaseHeader *>{ header(&projection) }), "the projection layer is always submitted")
+}
+
+int main()
+{
+	testOcclusionWall();
+	testOcclusionNearPlane();
+	testOcclusionBudget();
+	testOcclusionDeterminism();
+	testTransformClassify();
+	testTransformCache();
+	testFrameGraphCulling();
+	testFrameGraphAliasing();
+	testCullingSimd();
+	testClusters();
+	testFrameArena();
+	testSteadyStateFrame();
+	testMeshPool();
+	testPool();
+	testNameTable();
+	testHierarchy();
+	testNodeWorldCache();
+	testKindDispatch();
+	testReparenting();
+	testRegistry();
+	testJobSystem();
+	testSimulation();
+	testFramePacer();
+	testDynamicResolution();
+	testFoveation();
+	testQuadLayerOrder();
+	benchmarkClusters();
+	benchmarkOcclusion();
+	benchmarkTransforms();
+	benchmarkSceneStorage();
+	benchmarkHierarchy();
+	benchmarkNodeWorldCache();
+	benchmarkKindDispatch();
+	benchmarkRegistry();
+	benchmarkJobSystem();
+	benchmarkSimulation();
+	benchmarkFramePacer();
+	benchmarkDynamicResolution();
+	benchmarkFoveation();
+
+	// Done:
+	std::cout << std::endl;
+	std::cout << "+------------------------+" << std::endl;
+	std::cout << "|--- ALL TESTS PASSED ---|" << std::endl;
+	std::cout << "+------------------------+" << std::endl;
+	return 0;
+}
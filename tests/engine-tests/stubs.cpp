@@ -0,0 +1,185 @@
+/**
+ * @file		stubs.cpp
+ * @brief	Stand-ins for the global operator new, the OpenGL entry points and the Engine singleton, see stubs.h
+ */
+
+
+ //////////////
+ // #INCLUDE //
+ //////////////
+
+// C/C++:
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+// Engine:
+#include "Engine.h"
+
+// Glew (include it before GL.h):
+#include <GL/glew.h>
+
+// Tests:
+#include "stubs.h"
+
+
+EngineStub engineStub;
+
+
+///////////
+// #HEAP //
+///////////
+
+std::atomic<unsigned long long> heapAllocations{ 0 };
+
+void *operator new(size_t size)
+{
+	heapAllocations++;
+	void *p = malloc(size ? size : 1);
+	if (!p)
+		throw std::bad_alloc();
+	return p;
+}
+
+void operator delete(void *p) noexcept
+{
+	free(p);
+}
+
+void operator delete(void *p, size_t) noexcept
+{
+	free(p);
+}
+
+
+/////////////
+// #ENGINE //
+/////////////
+
+Engine::Engine()
+{
+}
+
+Engine &Engine::getInstance()
+{
+	static Engine instance;
+	return instance;
+}
+
+Camera *Engine::getActiveCamera() { return nullptr; }
+int Engine::getMaxRenderLights() { return engineStub.maxRenderLights; }
+bool Engine::isIndirect() { return engineStub.indirect; }
+bool Engine::isGpuCulling() { return false; }
+Engine::DepthMode Engine::getDepthMode() { return engineStub.depthMode; }
+Engine::StereoMode Engine::getStereoMode() { return STEREO_OFF; }
+Program *Engine::getProgram() { return nullptr; }
+ShaderCache *Engine::getShaderCache() { return engineStub.shaderCache; }
+MeshPool *Engine::getMeshPool() { return engineStub.meshPool; }
+IndirectBatch *Engine::getIndirectBatch() { return engineStub.indirectBatch; }
+HiZ *Engine::getHiZ() { return nullptr; }
+Ubo *Engine::getFrameUbo() { return nullptr; }
+Clusters *Engine::getClusters() { return engineStub.clusters; }
+Culling *Engine::getCulling() { return engineStub.culling; }
+FrameArena *Engine::getFrameArena() { return engineStub.frameArena; }
+void Engine::loadFrames(List *, FrameBlock *, int) {}
+
+// GPU culling is off, see Engine::isGpuCulling():
+bool HiZ::build(unsigned int) { return false; }
+bool HiZ::cull(IndirectBatch &, unsigned int, unsigned int) { return false; }
+
+
+/////////
+// #GL //
+/////////
+
+// Entry points doing nothing and returning 0, for any signature:
+template <typename F> struct NoOp;
+template <typename R, typename... A> struct NoOp<R (GLAPIENTRY *)(A...)>
+{
+	static R GLAPIENTRY call(A...) { return R(); }
+};
+
+// Object names, so that the objects look valid:
+static GLuint names = 0;
+
+static void GLAPIENTRY genNames(GLsizei n, GLuint *ids)
+{
+	for (GLsizei c = 0; c < n; c++)
+		ids[c] = ++names;
+}
+
+// Every shader compiles and every program links:
+static void GLAPIENTRY getStatus(GLuint, GLenum, GLint *param)
+{
+	*param = GL_TRUE;
+}
+
+static void GLAPIENTRY getInfoLog(GLuint, GLsizei size, GLsizei *length, GLchar *log)
+{
+	if (length)
+		*length = 0;
+	if (size > 0)
+		log[0] = '\0';
+}
+
+#define STUB(name) decltype(name) name = NoOp<decltype(name)>::call
+
+extern "C"
+{
+	GLboolean __GLEW_ARB_pipeline_statistics_query = GL_FALSE;
+
+	decltype(__glewGenBuffers) __glewGenBuffers = genNames;
+	decltype(__glewGenVertexArrays) __glewGenVertexArrays = genNames;
+	decltype(__glewGenQueries) __glewGenQueries = genNames;
+	decltype(__glewCreateProgram) __glewCreateProgram = []() { return ++names; };
+	decltype(__glewCreateShader) __glewCreateShader = [](GLenum) { return ++names; };
+	decltype(__glewGetShaderiv) __glewGetShaderiv = getStatus;
+	decltype(__glewGetProgramiv) __glewGetProgramiv = getStatus;
+	decltype(__glewGetShaderInfoLog) __glewGetShaderInfoLog = getInfoLog;
+	decltype(__glewGetProgramInfoLog) __glewGetProgramInfoLog = getInfoLog;
+
+	STUB(__glewAttachShader);
+	STUB(__glewBeginQuery);
+	STUB(__glewBindAttribLocation);
+	STUB(__glewBindBuffer);
+	STUB(__glewBindBufferBase);
+	STUB(__glewBindBufferRange);
+	STUB(__glewBindVertexArray);
+	STUB(__glewBufferData);
+	STUB(__glewBufferSubData);
+	STUB(__glewCompileShader);
+	STUB(__glewCopyBufferSubData);
+	STUB(__glewDeleteBuffers);
+	STUB(__glewDeleteProgram);
+	STUB(__glewDeleteQueries);
+	STUB(__glewDeleteShader);
+	STUB(__glewDeleteVertexArrays);
+	STUB(__glewDrawElementsInstanced);
+	STUB(__glewEnableVertexAttribArray);
+	STUB(__glewEndQuery);
+	STUB(__glewGetBufferSubData);
+	STUB(__glewGetQueryObjectiv);
+	STUB(__glewGetQueryObjectui64v);
+	STUB(__glewGetUniformLocation);
+	STUB(__glewLinkProgram);
+	STUB(__glewMemoryBarrier);
+	STUB(__glewMultiDrawElementsIndirect);
+	STUB(__glewShaderSource);
+	STUB(__glewUniform1f);
+	STUB(__glewUniform1i);
+	STUB(__glewUniform3fv);
+	STUB(__glewUniform4fv);
+	STUB(__glewUniformMatrix3fv);
+	STUB(__glewUniformMatrix4fv);
+	STUB(__glewUseProgram);
+	STUB(__glewValidateProgram);
+	STUB(__glewVertexAttribDivisor);
+	STUB(__glewVertexAttribIPointer);
+	STUB(__glewVertexAttribPointer);
+
+	void GLAPIENTRY glColorMask(GLboolean, GLboolean, GLboolean, GLboolean) {}
+	void GLAPIENTRY glDepthFunc(GLenum) {}
+	void GLAPIENTRY glDepthMask(GLboolean) {}
+	void GLAPIENTRY glDrawElements(GLenum, GLsizei, GLenum, const void *) {}
+	void GLAPIENTRY glGetIntegerv(GLenum, GLint *) {}
+}
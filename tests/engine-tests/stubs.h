@@ -0,0 +1,35 @@
+/**
+ * @file		stubs.h
+ * @brief	Stand-ins for the global operator new, the OpenGL entry points and the Engine singleton (see stubs.cpp),
+ *          so that the render list code (List, IndirectBatch, MeshPool, ShaderCache) runs without an OpenGL context:
+ *          allocations are counted, GL calls do nothing, Engine::getInstance() hands out the objects set in engineStub.
+ */
+#pragma once
+
+
+/**
+@var heapAllocations
+Calls to the global operator new, see testSteadyStateFrame(). The replacement lives in its own file so that the
+compiler does not pair the inlined free() with the allocation of the caller.
+*/
+extern std::atomic<unsigned long long> heapAllocations;
+
+
+/**
+@struct EngineStub
+What the stubbed Engine accessors return
+*/
+struct EngineStub
+{
+	int maxRenderLights = 8;
+	FrameArena *frameArena = nullptr;
+	Clusters *clusters = nullptr;
+	Culling *culling = nullptr;
+	ShaderCache *shaderCache = nullptr;
+	MeshPool *meshPool = nullptr;
+	IndirectBatch *indirectBatch = nullptr;
+	bool indirect = false;
+	Engine::DepthMode depthMode = Engine::DEPTH_UNSORTED;
+};
+
+extern EngineStub engineStub;
@@ -0,0 +1,440 @@
+/**
+ * @file		main.cpp
+ * @brief	Offscreen fill-rate measurement of the foveated eye passes (see Foveation.h), on any EGL driver without a window
+ *          or headset, e.g. Mesa's llvmpipe: LIBGL_ALWAYS_SOFTWARE=1 ./foveation-tests [width height frames]
+ *
+ *          Both eyes of a lit scene are rendered with the pass sequence of the engine's OpenXR frame graph (loadXrGraph()
+ *          in Engine.cpp), at full resolution and then foveated: the periphery at a reduced resolution with the inset's hole
+ *          rejected by a depth of 0, upscaled into the eye with a linear blit, then the inset at full resolution under a
+ *          scissor. The GPU time and the samples passed of both are compared, and the inset must match the full image.
+ */
+
+
+ //////////////
+ // #INCLUDE //
+ //////////////
+
+// C/C++:
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <vector>
+
+// Engine (Foveation only, the passes below replay its GL calls):
+#include "Engine.h"
+
+// OpenGL, from the driver's own library, and EGL:
+#define GL_GLEXT_PROTOTYPES
+#include <GL/gl.h>
+#include <GL/glext.h>
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+
+#define  ASSERT_WITH_MESSAGE(res, msg)				\
+	if (!(res)) {									\
+		std::cout << "[ERROR] " << msg << std::endl;	\
+		exit(1);									\
+	}
+
+
+/////////////
+// #SCENE //
+/////////////
+
+// Boxes on a grid, lit by point lights: the cost is in the fragment shader, as in the engine's clustered lighting
+#define GRID 12
+#define LIGHTS 32
+#define STRING(x) #x
+#define VALUE(x) STRING(x)
+
+static const char *shaderHeader = "#version 440 core\n#define GRID " VALUE(GRID) "\n#define LIGHTS " VALUE(LIGHTS) "\n";
+
+static const char *vertexShader = R"(
+   uniform mat4 viewProj;
+   layout(location = 0) in vec3 in_Position;
+   layout(location = 1) in vec3 in_Normal;
+   out vec3 worldPosition;
+   out vec3 normal;
+
+   void main(void)
+   {
+      // One box per instance, on a GRID x GRID floor going away from the eyes:
+      vec3 offset = vec3(float(gl_InstanceID % GRID) * 3.0 - float(GRID) * 1.5, -1.5, -3.0 - float(gl_InstanceID / GRID) * 3.0);
+      worldPosition = in_Position + offset;
+      normal = in_Normal;
+      gl_Position = viewProj * vec4(worldPosition, 1.0);
+   }
+)";
+
+static const char *fragmentShader = R"(
+   uniform vec3 eyePosition;
+   uniform vec4 lights[LIGHTS];
+   in vec3 worldPosition;
+   in vec3 normal;
+   out vec4 fragOutput;
+
+   void main(void)
+   {
+      vec3 n = normalize(normal);
+      vec3 v = normalize(eyePosition - worldPosition);
+      vec3 color = vec3(0.05);
+      for (int c = 0; c < LIGHTS; c++)
+      {
+         vec3 l = lights[c].xyz - worldPosition;
+         float d = length(l);
+         l /= d;
+         float fade = clamp(1.0 - d / lights[c].w, 0.0, 1.0);
+         float diffuse = max(dot(n, l), 0.0);
+         float specular = pow(max(dot(n, normalize(l + v)), 0.0), 32.0);
+         color += fade * fade * (diffuse * vec3(0.6, 0.5, 0.4) + specular * vec3(0.4));
+      }
+      fragOutput = vec4(color, 1.0);
+   }
+)";
+
+GLuint program = 0;
+GLuint vao = 0;
+GLint viewProjLocation = -1;
+GLint eyeLocation = -1;
+unsigned int boxVertices = 0;
+
+GLuint compile(GLenum type, const char *source)
+{
+	GLuint shader = glCreateShader(type);
+	const char *sources[] = { shaderHeader, source };
+	glShaderSource(shader, 2, sources, nullptr);
+	glCompileShader(shader);
+	GLint status;
+	glGetShaderiv(shader, GL_COMPILE_STATUS, &status);
+	if (!status)
+	{
+		char log[4096];
+		glGetShaderInfoLog(shader, sizeof(log), nullptr, log);
+		std::cout << log << std::endl;
+	}
+	ASSERT_WITH_MESSAGE(status, "shader compilation failed")
+	return shader;
+}
+
+void buildScene()
+{
+	program = glCreateProgram();
+	glAttachShader(program, compile(GL_VERTEX_SHADER, vertexShader));
+	glAttachShader(program, compile(GL_FRAGMENT_SHADER, fragmentShader));
+	glLinkProgram(program);
+	GLint status;
+	glGetProgramiv(program, GL_LINK_STATUS, &status);
+	ASSERT_WITH_MESSAGE(status, "shader link failed")
+	glUseProgram(program);
+	viewProjLocation = glGetUniformLocation(program, "viewProj");
+	eyeLocation = glGetUniformLocation(program, "eyePosition");
+
+	// Lights scattered over the boxes, fixed seed:
+	std::vector<glm::vec4> lights(LIGHTS);
+	srand(7);
+	for (glm::vec4 &l : lights)
+		l = glm::vec4(rand() % 100 / 100.0f * 36.0f - 18.0f, rand() % 100 / 100.0f * 4.0f, -3.0f - rand() % 100 / 100.0f * 36.0f, 12.0f);
+	glUniform4fv(glGetUniformLocation(program, "lights"), LIGHTS, &lights[0].x);
+
+	// A unit box, position and normal per vertex:
+	std::vector<float> box;
+	for (int axis = 0; axis < 3; axis++)
+		for (int side = -1; side <= 1; side += 2)
+		{
+			glm::vec3 n(0.0f), u(0.0f), v(0.0f);
+			n[axis] = (float)side;
+			u[(axis + 1) % 3] = 1.0f;
+			v[(axis + 2) % 3] = 1.0f;
+			if (side < 0)
+				std::swap(u, v);
+			glm::vec3 corners[4] = { n - u - v, n + u - v, n + u + v, n - u + v };
+			const int triangles[6] = { 0, 1, 2, 0, 2, 3 };
+			for (int c : triangles)
+			{
+				box.insert(box.end(), { corners[c].x, corners[c].y, corners[c].z, n.x, n.y, n.z });
+				boxVertices++;
+			}
+		}
+	glGenVertexArrays(1, &vao);
+	glBindVertexArray(vao);
+	GLuint vbo;
+	glGenBuffers(1, &vbo);
+	glBindBuffer(GL_ARRAY_BUFFER, vbo);
+	glBufferData(GL_ARRAY_BUFFER, box.size() * sizeof(float), box.data(), GL_STATIC_DRAW);
+	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 6 * sizeof(float), nullptr);
+	glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 6 * sizeof(float), (void *)(3 * sizeof(float)));
+	glEnableVertexAttribArray(0);
+	glEnableVertexAttribArray(1);
+}
+
+void drawScene(const glm::mat4 &viewProj, const glm::vec3 &eye)
+{
+	glUniformMatrix4fv(viewProjLocation, 1, GL_FALSE, &viewProj[0][0]);
+	glUniform3fv(eyeLocation, 1, &eye.x);
+	glDrawArraysInstanced(GL_TRIANGLES, 0, boxVertices, GRID * GRID);
+}
+
+
+///////////////
+// #TARGETS //
+///////////////
+
+/**
+@struct Target
+Color and depth textures with their framebuffer, like the ones the frame graph allocates
+*/
+struct Target
+{
+	GLuint fbo;
+	GLuint color;
+	GLuint depth;
+	unsigned int width;
+	unsigned int height;
+};
+
+Target createTarget(unsigned int width, unsigned int height)
+{
+	Target t = { 0, 0, 0, width, height };
+	glGenTextures(1, &t.color);
+	glBindTexture(GL_TEXTURE_2D, t.color);
+	glTexStorage2D(GL_TEXTURE_2D, 1, GL_RGBA8, width, height);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	glGenTextures(1, &t.depth);
+	glBindTexture(GL_TEXTURE_2D, t.depth);
+	glTexStorage2D(GL_TEXTURE_2D, 1, GL_DEPTH_COMPONENT24, width, height);
+	glGenFramebuffers(1, &t.fbo);
+	glBindFramebuffer(GL_FRAMEBUFFER, t.fbo);
+	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, t.color, 0);
+	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, t.depth, 0);
+	ASSERT_WITH_MESSAGE(glCheckFramebufferStatus(GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE, "incomplete framebuffer")
+	return t;
+}
+
+void destroyTarget(Target &t)
+{
+	glDeleteFramebuffers(1, &t.fbo);
+	glDeleteTextures(1, &t.color);
+	glDeleteTextures(1, &t.depth);
+}
+
+
+//////////////
+// #PASSES //
+//////////////
+
+/**
+@struct Eye
+What the engine's eye passes read: the eye's target (the swapchain image), its camera and its foveation layout
+*/
+struct Eye
+{
+	Target image;
+	Target periphery;
+	glm::mat4 projection;
+	glm::mat4 viewProj;
+	glm::vec3 position;
+	Foveation foveation;
+};
+
+// The eye pass at full resolution
+void renderFull(Eye &e)
+{
+	glBindFramebuffer(GL_DRAW_FRAMEBUFFER, e.image.fbo);
+	glViewport(0, 0, e.image.width, e.image.height);
+	glClearColor(0, 0, 0, 1);
+	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+	drawScene(e.viewProj, e.position);
+}
+
+// The periphery pass and the eye pass, foveated
+void renderFoveated(Eye &e)
+{
+	const Foveation &f = e.foveation;
+	glBindFramebuffer(GL_DRAW_FRAMEBUFFER, e.periphery.fbo);
+	glViewport(0, 0, f.getPeripheryWidth(), f.getPeripheryHeight());
+	glClearColor(0, 0, 0, 1);
+	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+	// Nothing to shade under the inset, a depth of 0 rejects it before the fragment shader:
+	const Foveation::Rect &hole = f.getHole();
+	if (hole.width > 0)
+	{
+		glEnable(GL_SCISSOR_TEST);
+		glScissor(hole.x, hole.y, hole.width, hole.height);
+		glClearDepth(0.0);
+		glClear(GL_DEPTH_BUFFER_BIT);
+		glClearDepth(1.0);
+		glDisable(GL_SCISSOR_TEST);
+	}
+	drawScene(e.viewProj, e.position);
+
+	// Periphery upscaled over the whole eye, then the inset on top:
+	glBindFramebuffer(GL_DRAW_FRAMEBUFFER, e.image.fbo);
+	glViewport(0, 0, e.image.width, e.image.height);
+	glBindFramebuffer(GL_READ_FRAMEBUFFER, e.periphery.fbo);
+	glBlitFramebuffer(0, 0, f.getPeripheryWidth(), f.getPeripheryHeight(), 0, 0, e.image.width, e.image.height, GL_COLOR_BUFFER_BIT, GL_LINEAR);
+	const Foveation::Rect &inset = f.getInset();
+	glEnable(GL_SCISSOR_TEST);
+	glScissor(inset.x, inset.y, inset.width, inset.height);
+	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+	drawScene(e.viewProj, e.position);
+	glDisable(GL_SCISSOR_TEST);
+}
+
+/**
+@struct Measure
+GPU time and samples passed per frame, both eyes
+*/
+struct Measure
+{
+	double gpuMs;
+	double wallMs;
+	double samples;
+};
+
+template <class F> Measure measure(Eye *eyes, unsigned int frames, const F &render)
+{
+	GLuint queries[2];
+	glGenQueries(2, queries);
+	Measure m = { 0.0, 0.0, 0.0 };
+
+	// One frame to warm up the driver's shader cache:
+	for (int i = 0; i < 2; i++)
+		render(eyes[i]);
+	glFinish();
+
+	auto start = std::chrono::high_resolution_clock::now();
+	for (unsigned int frame = 0; frame < frames; frame++)
+	{
+		glBeginQuery(GL_TIME_ELAPSED, queries[0]);
+		glBeginQuery(GL_SAMPLES_PASSED, queries[1]);
+		for (int i = 0; i < 2; i++)
+			render(eyes[i]);
+		glEndQuery(GL_SAMPLES_PASSED);
+		glEndQuery(GL_TIME_ELAPSED);
+		GLuint64 time, samples;
+		glGetQueryObjectui64v(queries[0], GL_QUERY_RESULT, &time);
+		glGetQueryObjectui64v(queries[1], GL_QUERY_RESULT, &samples);
+		m.gpuMs += time / 1e6 / frames;
+		m.samples += (double)samples / frames;
+	}
+	m.wallMs = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count() / frames;
+	glDeleteQueries(2, queries);
+	return m;
+}
+
+std::vector<unsigned char> readInset(const Eye &e)
+{
+	const Foveation::Rect &inset = e.foveation.getInset();
+	std::vector<unsigned char> pixels(inset.width * inset.height * 4);
+	glBindFramebuffer(GL_READ_FRAMEBUFFER, e.image.fbo);
+	glReadPixels(inset.x, inset.y, inset.width, inset.height, GL_RGBA, GL_UNSIGNED_BYTE, pixels.data());
+	return pixels;
+}
+
+
+////////////
+// #EGL //
+////////////
+
+/**
+Makes a headless OpenGL 4.4 core context current, on Mesa's surfaceless platform when there is one
+*/
+bool createContext()
+{
+	EGLDisplay display = EGL_NO_DISPLAY;
+	PFNEGLGETPLATFORMDISPLAYEXTPROC getPlatformDisplay = (PFNEGLGETPLATFORMDISPLAYEXTPROC)eglGetProcAddress("eglGetPlatformDisplayEXT");
+	if (getPlatformDisplay)
+		display = getPlatformDisplay(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, nullptr);
+	if (display == EGL_NO_DISPLAY)
+		display = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+	EGLint major, minor;
+	if (display == EGL_NO_DISPLAY || !eglInitialize(display, &major, &minor) || !eglBindAPI(EGL_OPENGL_API))
+		return false;
+
+	const EGLint attributes[] = { EGL_CONTEXT_MAJOR_VERSION, 4, EGL_CONTEXT_MINOR_VERSION, 4,
+		EGL_CONTEXT_OPENGL_PROFILE_MASK, EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT, EGL_NONE };
+	EGLContext context = eglCreateContext(display, EGL_NO_CONFIG_KHR, EGL_NO_CONTEXT, attributes);
+	return context != EGL_NO_CONTEXT && eglMakeCurrent(display, EGL_NO_SURFACE, EGL_NO_SURFACE, context);
+}
+
+
+//////////
+// MAIN //
+//////////
+
+int main(int argc, char *argv[])
+{
+	// Per eye resolution, a quarter of a typical headset's by default so that a software rasterizer runs it in seconds:
+	unsigned int width = argc > 2 ? atoi(argv[1]) : 720;
+	unsigned int height = argc > 2 ? atoi(argv[2]) : 800;
+	unsigned int frames = argc > 3 ? atoi(argv[3]) : 5;
+	ASSERT_WITH_MESSAGE(width > 0 && height > 0 && frames > 0, "usage: foveation-tests [width height frames]")
+	ASSERT_WITH_MESSAGE(createContext(), "no headless OpenGL 4.4 context (EGL)")
+	std::cout << "Foveation fill-rate measurement, " << glGetString(GL_RENDERER) << ", " << width << "x" << height << " per eye, "
+		<< frames << " frames:" << std::endl;
+
+	buildScene();
+	glEnable(GL_DEPTH_TEST);
+	glDepthFunc(GL_LESS);
+	glEnable(GL_CULL_FACE);
+
+	// Off-center projections as on a headset, the insets follow the projection centers:
+	Eye eyes[2];
+	for (int i = 0; i < 2; i++)
+	{
+		float inner = 0.8f, outer = 1.0f;
+		eyes[i].projection = glm::frustum(i == 0 ? -outer * 0.1f : -inner * 0.1f, i == 0 ? inner * 0.1f : outer * 0.1f,
+			-0.1f * height / width, 0.1f * height / width, 0.1f, 100.0f);
+		eyes[i].position = glm::vec3(i == 0 ? -0.032f : 0.032f, 0.0f, 0.0f);
+		eyes[i].viewProj = eyes[i].projection * glm::translate(glm::mat4(1.0f), -eyes[i].position);
+		eyes[i].image = createTarget(width, height);
+	}
+
+	const float radii[] = { 0.25f, 0.35f, 0.5f };
+	const float scales[] = { 0.5f, 0.33f };
+	Measure full = measure(eyes, frames, renderFull);
+	std::vector<unsigned char> fullInset[2];
+	std::cout << "   full resolution: " << full.gpuMs << " ms GPU, " << full.wallMs << " ms wall, "
+		<< (unsigned long long)full.samples << " samples per frame" << std::endl;
+	for (float scale : scales)
+		for (float radius : radii)
+		{
+			unsigned long long estimate = 0, pixels = 0;
+			for (int i = 0; i < 2; i++)
+			{
+				Eye &e = eyes[i];
+				e.foveation = Foveation(radius, radius, scale);
+				e.foveation.layout(width, height, Foveation::getCenter(e.projection));
+				e.periphery = createTarget(e.foveation.getPeripheryWidth(), e.foveation.getPeripheryHeight());
+				estimate += e.foveation.getShadedPixels();
+				pixels += e.foveation.getFullPixels();
+
+				// Reference for the inset, rendered the same way at full resolution:
+				renderFull(e);
+				fullInset[i] = readInset(e);
+			}
+
+			Measure foveated = measure(eyes, frames, renderFoveated);
+			for (int i = 0; i < 2; i++)
+			{
+				ASSERT_WITH_MESSAGE(readInset(eyes[i]) == fullInset[i], "the inset must match the full resolution image, eye " << i)
+				destroyTarget(eyes[i].periphery);
+			}
+			std::cout << "   inset radius " << radius << ", periphery scale " << scale << ": " << foveated.gpuMs << " ms GPU ("
+				<< 100.0 * foveated.gpuMs / full.gpuMs << "%), " << foveated.wallMs << " ms wall, " << 100.0 * foveated.samples / full.samples
+				<< "% of the samples (" << 100.0 * estimate / pixels << "% of the pixels estimated)" << std::endl;
+			ASSERT_WITH_MESSAGE(foveated.samples < full.samples, "foveation must shade fewer samples")
+		}
+
+	for (int i = 0; i < 2; i++)
+		destroyTarget(eyes[i].image);
+
+	// Done:
+	std::cout << std::endl;
+	std::cout << "+------------------------+" << std::endl;
+	std::cout << "|--- ALL TESTS PASSED ---|" << std::endl;
+	std::cout << "+------------------------+" << std::endl;
+	return 0;
+}